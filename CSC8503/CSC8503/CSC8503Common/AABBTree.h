@@ -0,0 +1,591 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <assert.h>
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		A dynamic bounding volume hierarchy, that persists between frames.
+		Every leaf stores a 'fat' AABB, grown by a margin around the object's
+		real bounds, so an object that moves a little doesn't need touching.
+		Only when an object leaves its fat box is it removed and reinserted,
+		and the tree is kept balanced with AVL style rotations as it changes.
+
+		Leaves are referred to by a proxy ID, which stays valid until that
+		leaf is removed. Nodes are stored in a flat array, with unused
+		ones kept in a free list, so the tree doesn't allocate as it moves.
+		*/
+		template<class T>
+		class AABBTree {
+		public:
+			AABBTree(float fatMargin = 0.5f) {
+				margin		= fatMargin;
+				root		= -1;
+				freeList	= -1;
+				leafCount	= 0;
+			}
+			~AABBTree() {
+			}
+
+			void Clear() {
+				nodes.clear();
+				root		= -1;
+				freeList	= -1;
+				leafCount	= 0;
+			}
+
+			int Insert(const T& object, const Vector3& pos, const Vector3& halfSize) {
+				int proxy = AllocateNode();
+				Vector3 fatSize = halfSize + Vector3(margin, margin, margin);
+
+				nodes[proxy].min	= pos - fatSize;
+				nodes[proxy].max	= pos + fatSize;
+				nodes[proxy].object = object;
+				nodes[proxy].height = 0;
+
+				InsertLeaf(proxy);
+				leafCount++;
+				return proxy;
+			}
+
+			void Remove(int proxy) {
+				assert(nodes[proxy].IsLeaf());
+				RemoveLeaf(proxy);
+				FreeNode(proxy);
+				leafCount--;
+			}
+
+			/*
+			Returns true if the object had moved outside of its fat AABB, and
+			so had to be reinserted into the tree.
+			*/
+			bool Move(int proxy, const Vector3& pos, const Vector3& halfSize) {
+				assert(nodes[proxy].IsLeaf());
+				Vector3 boxMin = pos - halfSize;
+				Vector3 boxMax = pos + halfSize;
+
+				if (Contains(nodes[proxy].min, nodes[proxy].max, boxMin, boxMax)) {
+					return false;
+				}
+				RemoveLeaf(proxy);
+
+				Vector3 fatSize = halfSize + Vector3(margin, margin, margin);
+				nodes[proxy].min = pos - fatSize;
+				nodes[proxy].max = pos + fatSize;
+
+				InsertLeaf(proxy);
+				return true;
+			}
+
+			const T& GetObject(int proxy) const {
+				return nodes[proxy].object;
+			}
+
+			void GetFatAABB(int proxy, Vector3& outMin, Vector3& outMax) const {
+				outMin = nodes[proxy].min;
+				outMax = nodes[proxy].max;
+			}
+
+			int GetLeafCount() const {
+				return leafCount;
+			}
+
+			int GetHeight() const {
+				return root == -1 ? 0 : nodes[root].height;
+			}
+
+			/*
+			Calls func for every object whose fat AABB overlaps the given box.
+			The function can return false to stop the query early.
+			*/
+			template<class F>
+			void Query(const Vector3& pos, const Vector3& halfSize, F func) const {
+				QueryBox(pos - halfSize, pos + halfSize, -1, [&](int leaf) {
+					return func(nodes[leaf].object);
+				});
+			}
+
+			/*
+			Calls func(object, other) for every leaf whose fat AABB overlaps the
+			fat AABB of the given proxy. This is how the physics system builds
+			its broadphase pairs - by only calling it for objects that can move,
+			static geometry never has to be visited except as the 'other' half.
+			*/
+			template<class F>
+			void QueryPairs(int proxy, F func) const {
+				const T& object = nodes[proxy].object;
+				QueryBox(nodes[proxy].min, nodes[proxy].max, proxy, [&](int leaf) {
+					func(object, nodes[leaf].object);
+					return true;
+				});
+			}
+
+			/*
+			Walks the tree front to back along a ray, calling
+			func(object, maxDistance) for every leaf whose fat box the ray
+			enters closer than maxDistance. The function returns how far the
+			search should carry on to - the distance of whatever it hit, so
+			only closer leaves are visited after it, or 0 to stop there.
+			*/
+			template<class F>
+			void RayCast(const Vector3& origin, const Vector3& direction, float maxDistance, F func) const {
+				if (root == -1) {
+					return;
+				}
+				Vector3 inverse = InverseDirection(direction);
+
+				struct Entry {
+					int		index;
+					float	distance;
+				};
+				Entry	stack[256];
+				int		stackSize = 0;
+
+				float entry;
+				if (!RayBox(origin, inverse, nodes[root].min, nodes[root].max, maxDistance, entry)) {
+					return;
+				}
+				stack[stackSize++] = { root, entry };
+
+				while (stackSize > 0) {
+					Entry e = stack[--stackSize];
+					if (e.distance > maxDistance) {
+						continue;
+					}
+					const Node& n = nodes[e.index];
+					if (n.IsLeaf()) {
+						maxDistance = func(n.object, maxDistance);
+						if (maxDistance <= 0.0f) {
+							return;
+						}
+						continue;
+					}
+					float entry0;
+					float entry1;
+					bool hit0 = RayBox(origin, inverse, nodes[n.children[0]].min, nodes[n.children[0]].max, maxDistance, entry0);
+					bool hit1 = RayBox(origin, inverse, nodes[n.children[1]].min, nodes[n.children[1]].max, maxDistance, entry1);
+
+					//The nearer child goes on the stack last, so it's visited first
+					assert(stackSize + 2 <= 256);
+					if (hit0 && hit1) {
+						bool nearFirst = entry0 <= entry1;
+						stack[stackSize++] = nearFirst ? Entry{ n.children[1], entry1 } : Entry{ n.children[0], entry0 };
+						stack[stackSize++] = nearFirst ? Entry{ n.children[0], entry0 } : Entry{ n.children[1], entry1 };
+					}
+					else if (hit0) {
+						stack[stackSize++] = { n.children[0], entry0 };
+					}
+					else if (hit1) {
+						stack[stackSize++] = { n.children[1], entry1 };
+					}
+				}
+			}
+
+			static const int PacketSize = 64;
+
+			/*
+			The same, but for up to PacketSize rays at once, which share a
+			single walk down the tree. Each node is tested against the whole
+			packet in one go, with the rays laid out in arrays of their x, y
+			and z values so the compiler can test several at a time, and the
+			walk only goes down into children that at least one ray reaches.
+			This pays off when the rays are going roughly the same way from
+			roughly the same place, such as a batch of line of sight checks.
+			maxDistances is updated with whatever func(ray, object, maxDistance)
+			returns, as above.
+			*/
+			template<class F>
+			void RayCastPacket(const Vector3* origins, const Vector3* directions, float* maxDistances, int count, F func) const {
+				if (root == -1 || count <= 0) {
+					return;
+				}
+				assert(count <= PacketSize);
+
+				float originX[PacketSize], originY[PacketSize], originZ[PacketSize];
+				float inverseX[PacketSize], inverseY[PacketSize], inverseZ[PacketSize];
+				float distance[PacketSize];
+				bool  hits[PacketSize];
+
+				Vector3 averageDirection;
+				for (int i = 0; i < count; ++i) {
+					Vector3 inverse = InverseDirection(directions[i]);
+					originX[i]	= origins[i].x;
+					originY[i]	= origins[i].y;
+					originZ[i]	= origins[i].z;
+					inverseX[i]	= inverse.x;
+					inverseY[i]	= inverse.y;
+					inverseZ[i]	= inverse.z;
+					//Rays that can't go anywhere never pass a box test
+					distance[i]	= maxDistances[i] > 0.0f ? maxDistances[i] : -1.0f;
+					averageDirection += directions[i];
+				}
+
+				struct Entry {
+					int			index;
+					uint64_t	rays;
+				};
+				Entry	stack[256];
+				int		stackSize = 0;
+				stack[stackSize++] = { root, ~(uint64_t)0 };
+
+				while (stackSize > 0) {
+					Entry e = stack[--stackSize];
+					const Node& n = nodes[e.index];
+
+					for (int i = 0; i < count; ++i) {
+						float x0 = (n.min.x - originX[i]) * inverseX[i];
+						float x1 = (n.max.x - originX[i]) * inverseX[i];
+						float y0 = (n.min.y - originY[i]) * inverseY[i];
+						float y1 = (n.max.y - originY[i]) * inverseY[i];
+						float z0 = (n.min.z - originZ[i]) * inverseZ[i];
+						float z1 = (n.max.z - originZ[i]) * inverseZ[i];
+
+						float nearest	= std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+						float furthest	= std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), distance[i]));
+						hits[i] = nearest <= furthest;
+					}
+					uint64_t rays = 0;
+					for (int i = 0; i < count; ++i) {
+						rays |= (uint64_t)hits[i] << i;
+					}
+					rays &= e.rays;
+					if (!rays) {
+						continue;
+					}
+					if (n.IsLeaf()) {
+						for (int i = 0; i < count; ++i) {
+							if ((rays >> i) & 1) {
+								float d = func(i, n.object, distance[i]);
+								distance[i] = d > 0.0f ? d : -1.0f;
+							}
+						}
+						continue;
+					}
+					//There's no one nearest child for a whole packet, so go by which way the rays are heading on average
+					const Node& child0		= nodes[n.children[0]];
+					const Node& child1		= nodes[n.children[1]];
+					Vector3		offset		= (child1.min + child1.max) - (child0.min + child0.max);
+					bool		nearFirst	= Vector3::Dot(offset, averageDirection) >= 0.0f;
+
+					assert(stackSize + 2 <= 256);
+					stack[stackSize++] = { nearFirst ? n.children[1] : n.children[0], rays };
+					stack[stackSize++] = { nearFirst ? n.children[0] : n.children[1], rays };
+				}
+				for (int i = 0; i < count; ++i) {
+					if (maxDistances[i] > 0.0f) {
+						maxDistances[i] = std::max(distance[i], 0.0f);
+					}
+				}
+			}
+
+		protected:
+			struct Node {
+				Vector3 min;
+				Vector3 max;
+				T		object;
+
+				int parent;		//Doubles as the 'next' pointer while in the free list
+				int children[2];
+				int height;		//Leaves have a height of 0, free nodes -1
+
+				bool IsLeaf() const {
+					return children[0] == -1;
+				}
+			};
+
+			static Vector3 MinOf(const Vector3& a, const Vector3& b) {
+				return Vector3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+			}
+
+			static Vector3 MaxOf(const Vector3& a, const Vector3& b) {
+				return Vector3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+			}
+
+			//Half the surface area is all that's needed to compare costs
+			static float Area(const Vector3& min, const Vector3& max) {
+				Vector3 d = max - min;
+				return d.x * d.y + d.y * d.z + d.z * d.x;
+			}
+
+			static bool Overlaps(const Vector3& minA, const Vector3& maxA, const Vector3& minB, const Vector3& maxB) {
+				return	minA.x <= maxB.x && maxA.x >= minB.x &&
+						minA.y <= maxB.y && maxA.y >= minB.y &&
+						minA.z <= maxB.z && maxA.z >= minB.z;
+			}
+
+			static bool Contains(const Vector3& outerMin, const Vector3& outerMax, const Vector3& innerMin, const Vector3& innerMax) {
+				return	outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+						innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+			}
+
+			//Axes the ray doesn't move along get a huge value rather than infinity, so 0 * it can't make a NaN
+			static Vector3 InverseDirection(const Vector3& d) {
+				return Vector3(	d.x != 0.0f ? 1.0f / d.x : FLT_MAX,
+								d.y != 0.0f ? 1.0f / d.y : FLT_MAX,
+								d.z != 0.0f ? 1.0f / d.z : FLT_MAX);
+			}
+
+			//The slab test - entry is how far along the ray it goes into the box (0 if it starts inside)
+			static bool RayBox(const Vector3& origin, const Vector3& inverse, const Vector3& min, const Vector3& max, float maxDistance, float& entry) {
+				float nearest	= 0.0f;
+				float furthest	= maxDistance;
+				for (int axis = 0; axis < 3; ++axis) {
+					float t0 = (min[axis] - origin[axis]) * inverse[axis];
+					float t1 = (max[axis] - origin[axis]) * inverse[axis];
+					if (t0 > t1) {
+						std::swap(t0, t1);
+					}
+					nearest		= std::max(nearest, t0);
+					furthest	= std::min(furthest, t1);
+					if (nearest > furthest) {
+						return false;
+					}
+				}
+				entry = nearest;
+				return true;
+			}
+
+			template<class F>
+			void QueryBox(const Vector3& boxMin, const Vector3& boxMax, int skip, F func) const {
+				if (root == -1) {
+					return;
+				}
+				int stack[256];
+				int stackSize = 0;
+				stack[stackSize++] = root;
+
+				while (stackSize > 0) {
+					int index = stack[--stackSize];
+					const Node& n = nodes[index];
+
+					if (!Overlaps(n.min, n.max, boxMin, boxMax)) {
+						continue;
+					}
+					if (n.IsLeaf()) {
+						if (index != skip && !func(index)) {
+							return;
+						}
+					}
+					else {
+						assert(stackSize + 2 <= 256);
+						stack[stackSize++] = n.children[0];
+						stack[stackSize++] = n.children[1];
+					}
+				}
+			}
+
+			int AllocateNode() {
+				int index;
+				if (freeList != -1) {
+					index		= freeList;
+					freeList	= nodes[index].parent;
+				}
+				else {
+					index = (int)nodes.size();
+					nodes.emplace_back();
+				}
+				Node& n			= nodes[index];
+				n.parent		= -1;
+				n.children[0]	= -1;
+				n.children[1]	= -1;
+				n.height		= 0;
+				return index;
+			}
+
+			void FreeNode(int index) {
+				nodes[index].parent = freeList;
+				nodes[index].height = -1;
+				freeList = index;
+			}
+
+			/*
+			Walks down from the root, picking whichever child would grow the
+			least in surface area to hold the new leaf, then splits the node it
+			ends up at into a new parent of both.
+			*/
+			void InsertLeaf(int leaf) {
+				if (root == -1) {
+					root = leaf;
+					nodes[root].parent = -1;
+					return;
+				}
+				Vector3 leafMin = nodes[leaf].min;
+				Vector3 leafMax = nodes[leaf].max;
+
+				int index = root;
+				while (!nodes[index].IsLeaf()) {
+					int child0 = nodes[index].children[0];
+					int child1 = nodes[index].children[1];
+
+					float area			= Area(nodes[index].min, nodes[index].max);
+					float combinedArea	= Area(MinOf(nodes[index].min, leafMin), MaxOf(nodes[index].max, leafMax));
+
+					//Cost of making a new parent here, and the minimum cost of pushing the leaf further down
+					float cost			= 2.0f * combinedArea;
+					float inheritance	= 2.0f * (combinedArea - area);
+
+					float cost0 = ChildCost(child0, leafMin, leafMax) + inheritance;
+					float cost1 = ChildCost(child1, leafMin, leafMax) + inheritance;
+
+					if (cost < cost0 && cost < cost1) {
+						break;
+					}
+					index = (cost0 < cost1) ? child0 : child1;
+				}
+				int sibling		= index;
+				int oldParent	= nodes[sibling].parent;
+				int newParent	= AllocateNode();
+
+				nodes[newParent].parent		= oldParent;
+				nodes[newParent].min		= MinOf(leafMin, nodes[sibling].min);
+				nodes[newParent].max		= MaxOf(leafMax, nodes[sibling].max);
+				nodes[newParent].height		= nodes[sibling].height + 1;
+				nodes[newParent].children[0] = sibling;
+				nodes[newParent].children[1] = leaf;
+
+				nodes[sibling].parent	= newParent;
+				nodes[leaf].parent		= newParent;
+
+				if (oldParent != -1) {
+					if (nodes[oldParent].children[0] == sibling) {
+						nodes[oldParent].children[0] = newParent;
+					}
+					else {
+						nodes[oldParent].children[1] = newParent;
+					}
+				}
+				else {
+					root = newParent;
+				}
+				RefitFrom(nodes[leaf].parent);
+			}
+
+			float ChildCost(int child, const Vector3& leafMin, const Vector3& leafMax) const {
+				float grownArea = Area(MinOf(nodes[child].min, leafMin), MaxOf(nodes[child].max, leafMax));
+				if (nodes[child].IsLeaf()) {
+					return grownArea;
+				}
+				return grownArea - Area(nodes[child].min, nodes[child].max);
+			}
+
+			void RemoveLeaf(int leaf) {
+				if (leaf == root) {
+					root = -1;
+					return;
+				}
+				int parent		= nodes[leaf].parent;
+				int grandParent = nodes[parent].parent;
+				int sibling		= nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+				if (grandParent != -1) {
+					if (nodes[grandParent].children[0] == parent) {
+						nodes[grandParent].children[0] = sibling;
+					}
+					else {
+						nodes[grandParent].children[1] = sibling;
+					}
+					nodes[sibling].parent = grandParent;
+					FreeNode(parent);
+					RefitFrom(grandParent);
+				}
+				else {
+					root = sibling;
+					nodes[sibling].parent = -1;
+					FreeNode(parent);
+				}
+			}
+
+			//Walks back up the tree, rebalancing and refitting bounds as it goes
+			void RefitFrom(int index) {
+				while (index != -1) {
+					index = Balance(index);
+
+					int child0 = nodes[index].children[0];
+					int child1 = nodes[index].children[1];
+
+					nodes[index].height = 1 + std::max(nodes[child0].height, nodes[child1].height);
+					nodes[index].min	= MinOf(nodes[child0].min, nodes[child1].min);
+					nodes[index].max	= MaxOf(nodes[child0].max, nodes[child1].max);
+
+					index = nodes[index].parent;
+				}
+			}
+
+			/*
+			If one child of node A is more than one level taller than the other,
+			the taller child C is rotated up to take A's place, and A adopts one
+			of C's children. Returns the index of the node now in A's position.
+			*/
+			int Balance(int a) {
+				Node& nodeA = nodes[a];
+				if (nodeA.IsLeaf() || nodeA.height < 2) {
+					return a;
+				}
+				int b = nodeA.children[0];
+				int c = nodeA.children[1];
+
+				int balance = nodes[c].height - nodes[b].height;
+
+				if (balance > 1) {
+					return Rotate(a, c, b, 1);
+				}
+				if (balance < -1) {
+					return Rotate(a, b, c, 0);
+				}
+				return a;
+			}
+
+			//Rotates the child 'up' above a, where upSlot is which of a's child slots it came from
+			int Rotate(int a, int up, int other, int upSlot) {
+				int f = nodes[up].children[0];
+				int g = nodes[up].children[1];
+
+				nodes[up].children[0]	= a;
+				nodes[up].parent		= nodes[a].parent;
+				nodes[a].parent			= up;
+
+				if (nodes[up].parent != -1) {
+					int p = nodes[up].parent;
+					if (nodes[p].children[0] == a) {
+						nodes[p].children[0] = up;
+					}
+					else {
+						nodes[p].children[1] = up;
+					}
+				}
+				else {
+					root = up;
+				}
+
+				//Keep the taller grandchild up high, and hand the shorter one down to a
+				int keep	= nodes[f].height > nodes[g].height ? f : g;
+				int give	= keep == f ? g : f;
+
+				nodes[up].children[1]	= keep;
+				nodes[a].children[upSlot] = give;
+				nodes[give].parent		= a;
+
+				nodes[a].min	= MinOf(nodes[other].min, nodes[give].min);
+				nodes[a].max	= MaxOf(nodes[other].max, nodes[give].max);
+				nodes[a].height = 1 + std::max(nodes[other].height, nodes[give].height);
+
+				nodes[up].min		= MinOf(nodes[a].min, nodes[keep].min);
+				nodes[up].max		= MaxOf(nodes[a].max, nodes[keep].max);
+				nodes[up].height	= 1 + std::max(nodes[a].height, nodes[keep].height);
+
+				return up;
+			}
+
+			std::vector<Node>	nodes;
+			int					root;
+			int					freeList;
+			int					leafCount;
+			float				margin;
+		};
+	}
+}
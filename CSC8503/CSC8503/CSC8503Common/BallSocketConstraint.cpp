@@ -0,0 +1,30 @@
+#include "BallSocketConstraint.h"
+#include "GameObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+BallSocketConstraint::BallSocketConstraint(GameObject* a, GameObject* b, const Vector3& worldPivot)
+	: Constraint(a, b) {
+	const Transform& transformA = a->GetTransform();
+	const Transform& transformB = b->GetTransform();
+
+	anchorA = transformA.GetOrientation().Conjugate() * (worldPivot - transformA.GetPosition());
+	anchorB = transformB.GetOrientation().Conjugate() * (worldPivot - transformB.GetPosition());
+}
+
+int BallSocketConstraint::BuildRows(ConstraintRow* rows, float dt) {
+	const Transform& transformA = objectA->GetTransform();
+	const Transform& transformB = objectB->GetTransform();
+
+	Vector3 relativeA	= transformA.GetOrientation() * anchorA;
+	Vector3 relativeB	= transformB.GetOrientation() * anchorB;
+	Vector3 offset		= (transformB.GetPosition() + relativeB) - (transformA.GetPosition() + relativeA);
+
+	for (int i = 0; i < 3; ++i) {
+		Vector3 axis;
+		axis[i] = 1.0f;
+		LinearRow(rows[i], axis, relativeA, relativeB, offset[i], dt);
+	}
+	return 3;
+}
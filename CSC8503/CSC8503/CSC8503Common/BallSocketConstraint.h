@@ -0,0 +1,22 @@
+#pragma once
+#include "Constraint.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Pins the two objects together at a point, leaving them free to turn
+		about it in any direction, like a shoulder joint.
+		*/
+		class BallSocketConstraint : public Constraint {
+		public:
+			BallSocketConstraint(GameObject* a, GameObject* b, const Vector3& worldPivot);
+			~BallSocketConstraint() {}
+
+			int BuildRows(ConstraintRow* rows, float dt) override;
+
+		protected:
+			Vector3 anchorA;
+			Vector3 anchorB;
+		};
+	}
+}
@@ -0,0 +1,74 @@
+#include "BenchmarkMap.h"
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+#include "NavigationGrid.h"
+#include "AABBVolume.h"
+#include "OBBVolume.h"
+#include "SphereVolume.h"
+#include "MeshVolume.h"
+
+#include <cstdlib>
+
+using namespace NCL;
+using namespace CSC8503;
+
+void NCL::CSC8503::BuildBenchmarkMap(GameWorld& world, const std::string& filename, int copies, const std::string& directory, bool staticMesh) {
+	NavigationGrid grid(filename, directory);
+	int		nodeSize	= grid.GetGridNodeSize();
+	int		mapWidth	= grid.GetGridWidth();
+	int		mapHeight	= grid.GetGridHeight();
+	float	copyOffset	= (float)(mapWidth * nodeSize);
+
+	auto addObject = [&](const Vector3& pos, CollisionVolume* volume, float inverseMass) {
+		GameObject* o = new GameObject();
+		o->SetBoundingVolume(volume);
+		o->GetTransform().SetPosition(pos);
+		o->SetPhysicsObject(new PhysicsObject(&o->GetTransform(), o->GetBoundingVolume()));
+		o->GetPhysicsObject()->SetInverseMass(inverseMass);
+		world.AddGameObject(o);
+		return o;
+	};
+
+	MeshVolume* level = staticMesh ? new MeshVolume() : nullptr;
+
+	//The slopes are tipped over by the given angle, everything else is axis aligned
+	auto addStatic = [&](const Vector3& pos, const Vector3& halfSize, float slopeAngle) {
+		Quaternion orientation = Quaternion::AxisAngleToQuaterion(Vector3(0, 0, 1), slopeAngle);
+		if (level) {
+			level->AddBox(pos, halfSize, orientation);
+		}
+		else if (slopeAngle == 0.0f) {
+			addObject(pos, (CollisionVolume*)new AABBVolume(halfSize), 0.0f);
+		}
+		else {
+			addObject(pos, (CollisionVolume*)new OBBVolume(halfSize), 0.0f)->GetTransform().SetOrientation(orientation);
+		}
+	};
+
+	for (int c = 0; c < copies; ++c) {
+		for (int i = 0; i < mapWidth * mapHeight; ++i) {
+			GridNode& n = grid.GetNodes()[i];
+			Vector3 pos = n.position + Vector3(c * copyOffset, 0, 0);
+
+			if (n.type == 'x') {
+				addStatic(pos + Vector3(0, 6, 0), Vector3(0.5, 0.5, 0.5) * nodeSize, 0.0f);
+			}
+			else if (n.type == '/' || n.type == '\\') {
+				addStatic(pos + Vector3(0, 3, 0), Vector3(0.5, 0.1, 0.5) * nodeSize, n.type == '/' ? 30.0f : -30.0f);
+			}
+			else if (n.type != 'n') {
+				addStatic(pos, Vector3(0.5, 0.1, 0.5) * nodeSize, 0.0f);
+				addObject(pos + Vector3(0, 5, 0), (CollisionVolume*)new SphereVolume(0.3f), 0.0f)->GetPhysicsObject()->SetTrigger(true);
+
+				GameObject* ball = addObject(pos + Vector3(0, 2, 0), (CollisionVolume*)new SphereVolume(1.0f), 1.0f);
+				ball->GetPhysicsObject()->SetLinearVelocity(Vector3(rand() % 21 - 10.0f, 0, rand() % 21 - 10.0f));
+			}
+		}
+	}
+
+	if (level) {
+		level->Build();
+		addObject(Vector3(), (CollisionVolume*)level, 0.0f);
+	}
+}
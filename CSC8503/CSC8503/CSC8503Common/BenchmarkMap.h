@@ -0,0 +1,22 @@
+#pragma once
+#include "../../Common/Assets.h"
+#include <string>
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameWorld;
+
+		/*
+		Fills a world with the given coursework map, repeated side by side
+		along the x axis the given number of times. Every floor tile gets a
+		rolling ball, so that there's plenty of coherent movement, as there
+		would be in a real game. Used by the benchmarks in the game and by
+		the headless build, so they both measure the same thing.
+
+		With staticMesh set, the walls, floors and slopes all go into a
+		single MeshVolume rather than being an object each.
+		*/
+		void BuildBenchmarkMap(GameWorld& world, const std::string& filename, int copies,
+			const std::string& directory = Assets::DATADIR, bool staticMesh = false);
+	}
+}
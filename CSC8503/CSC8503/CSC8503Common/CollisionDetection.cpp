@@ -3,12 +3,16 @@
 #include "AABBVolume.h"
 #include "OBBVolume.h"
 #include "SphereVolume.h"
+#include "MeshCollision.h"
 #include "../../Common/Vector2.h"
-#include "../../Common/Window.h"
 #include "../../Common/Maths.h"
 #include "Debug.h"
+#include "SATAlgorithm.h"
+#include "GJK.h"
+#include "CollisionKernels.h"
 
 #include <list>
+#include <algorithm>
 
 using namespace NCL;
 
@@ -45,6 +49,9 @@ bool CollisionDetection::RayIntersection(const Ray& r,GameObject& object, RayCol
 		case VolumeType::OBB:		hasCollided = RayOBBIntersection(r, worldTransform, (const OBBVolume&)*volume	, collision); break;
 		case VolumeType::Sphere:	hasCollided = RaySphereIntersection(r, worldTransform, (const SphereVolume&)*volume	, collision); break;
 		case VolumeType::Capsule:	hasCollided = RayCapsuleIntersection(r, worldTransform, (const CapsuleVolume&)*volume, collision); break;
+		case VolumeType::Mesh:		hasCollided = RayMeshIntersection(r, worldTransform, (const MeshVolume&)*volume, collision); break;
+		case VolumeType::Compound:	hasCollided = RayCompoundIntersection(r, worldTransform, (const CompoundVolume&)*volume, collision); break;
+		default: break;
 	}
 
 	return hasCollided;
@@ -116,8 +123,103 @@ bool CollisionDetection::RayOBBIntersection(const Ray&r, const Transform& worldT
 	return collided;
 }
 
+bool CollisionDetection::RayMeshIntersection(const Ray& r, const Transform& worldTransform, const MeshVolume& volume, RayCollision& collision) {
+	return MeshCollision::RayIntersection(r, worldTransform, volume, collision);
+}
+
+//The nearest hit on any of the children
+bool CollisionDetection::RayCompoundIntersection(const Ray& r, const Transform& worldTransform, const CompoundVolume& volume, RayCollision& collision) {
+	Quaternion	orientation = worldTransform.GetOrientation();
+	bool		hasCollided	= false;
+
+	for (int i = 0; i < volume.GetChildCount(); ++i) {
+		Transform childTransform;
+		childTransform.SetPosition(worldTransform.GetPosition() + (orientation * volume.GetChildPosition(i)));
+		childTransform.SetOrientation(orientation * volume.GetChildOrientation(i));
+
+		const CollisionVolume&	child = volume.GetChildVolume(i);
+		RayCollision			childCollision;
+		bool					childHit = false;
+		switch (child.type) {
+			case VolumeType::OBB:		childHit = RayOBBIntersection(r, childTransform, (const OBBVolume&)child, childCollision); break;
+			case VolumeType::Sphere:	childHit = RaySphereIntersection(r, childTransform, (const SphereVolume&)child, childCollision); break;
+			case VolumeType::Capsule:	childHit = RayCapsuleIntersection(r, childTransform, (const CapsuleVolume&)child, childCollision); break;
+			default: break;
+		}
+		if (childHit && (!hasCollided || childCollision.rayDistance < collision.rayDistance)) {
+			collision.collidedAt	= childCollision.collidedAt;
+			collision.rayDistance	= childCollision.rayDistance;
+			hasCollided				= true;
+		}
+	}
+	return hasCollided;
+}
+
+/*
+A capsule is a cylinder with a sphere on each end, so the ray hits it
+wherever it first hits any of those 3 parts.
+*/
 bool CollisionDetection::RayCapsuleIntersection(const Ray& r, const Transform& worldTransform, const CapsuleVolume& volume, RayCollision& collision) {
-	return false;
+	Vector3 start, end;
+	CapsuleSegment(volume, worldTransform, start, end);
+
+	float	radius		= volume.GetRadius();
+	Vector3 rayPos		= r.GetPosition();
+	Vector3 rayDir		= r.GetDirection();
+
+	//A ray starting inside the capsule hits it straight away
+	Vector3 closest = start + (end - start) * ClosestPointOnSegment(rayPos, start, end);
+	if ((rayPos - closest).LengthSquared() <= radius * radius) {
+		collision.collidedAt	= rayPos;
+		collision.rayDistance	= 0.0f;
+		return true;
+	}
+
+	float bestT		= FLT_MAX;
+	float dirLength = Vector3::Dot(rayDir, rayDir);
+
+	Vector3 ends[2] = { start, end };
+	for (int i = 0; i < 2; ++i) {
+		Vector3 offset	= rayPos - ends[i];
+		float b			= Vector3::Dot(offset, rayDir);
+		float c			= Vector3::Dot(offset, offset) - (radius * radius);
+		float disc		= (b * b) - (dirLength * c);
+		if (b < 0.0f && disc >= 0.0f) {
+			bestT = std::min(bestT, (-b - std::sqrt(disc)) / dirLength);
+		}
+	}
+
+	/*
+	For the cylinder, the ray is projected onto the plane at right angles
+	to the segment, where the cylinder's just a circle. The hit only counts
+	if it's between the two ends - anywhere else is the spheres' job.
+	*/
+	Vector3 axis		= end - start;
+	Vector3 offset		= rayPos - start;
+	float axisLength	= Vector3::Dot(axis, axis);
+	float dirAxis		= Vector3::Dot(rayDir, axis);
+	float offsetAxis	= Vector3::Dot(offset, axis);
+	float a				= (axisLength * dirLength) - (dirAxis * dirAxis);
+
+	if (axisLength > 0.0f && a > 1e-6f * axisLength * dirLength) {
+		float b		= (axisLength * Vector3::Dot(offset, rayDir)) - (dirAxis * offsetAxis);
+		float c		= (axisLength * (Vector3::Dot(offset, offset) - (radius * radius))) - (offsetAxis * offsetAxis);
+		float disc	= (b * b) - (a * c);
+		if (disc >= 0.0f) {
+			float t		= (-b - std::sqrt(disc)) / a;
+			float along = offsetAxis + (t * dirAxis);
+			if (t >= 0.0f && along >= 0.0f && along <= axisLength) {
+				bestT = std::min(bestT, t);
+			}
+		}
+	}
+
+	if (bestT == FLT_MAX) {
+		return false;
+	}
+	collision.collidedAt	= rayPos + (rayDir * bestT);
+	collision.rayDistance	= bestT;
+	return true;
 }
 
 bool CollisionDetection::RaySphereIntersection(const Ray&r, const Transform& worldTransform, const SphereVolume& volume, RayCollision& collision) {
@@ -145,171 +247,280 @@ bool CollisionDetection::RaySphereIntersection(const Ray&r, const Transform& wor
 	return true;
 }
 
-Matrix4 GenerateInverseView(const Camera &c) {
-	float pitch = c.GetPitch();
-	float yaw	= c.GetYaw();
-	Vector3 position = c.GetPosition();
+/*
+Which test to run for each pair of volume types lives in a table, filled
+in when the program is compiled. Each test is written for one order of
+its two volumes, and is added the other way round too, through a wrapper
+that swaps the volumes over and then flips the contacts it made back to
+match - so every entry's contacts point from the first volume to the
+second, whichever order the test itself wants them in.
+
+Pairs of convex volumes with no test of their own fall back to GJK, and
+everything else is left empty, and never collides.
+*/
+namespace {
+	typedef CollisionDetection::CollisionInfo	CollisionInfo;
+	typedef CollisionDetection::PairTest		PairTest;
+
+	template<class VolumeA, class VolumeB,
+		bool (*Test)(const VolumeA&, const Transform&, const VolumeB&, const Transform&, CollisionInfo&)>
+	bool Forwards(const CollisionVolume& volumeA, const Transform& worldTransformA,
+		const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo, SimplexCache* /*cache*/) {
+		return Test((const VolumeA&)volumeA, worldTransformA, (const VolumeB&)volumeB, worldTransformB, collisionInfo);
+	}
 
-	Matrix4 iview =
-		Matrix4::Translation(position) *
-		Matrix4::Rotation(-yaw, Vector3(0, -1, 0)) *
-		Matrix4::Rotation(-pitch, Vector3(-1, 0, 0));
+	template<class VolumeA, class VolumeB,
+		bool (*Test)(const VolumeA&, const Transform&, const VolumeB&, const Transform&, CollisionInfo&)>
+	bool Backwards(const CollisionVolume& volumeA, const Transform& worldTransformA,
+		const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo, SimplexCache* /*cache*/) {
+		int first = collisionInfo.pointCount;
+		if (!Test((const VolumeA&)volumeB, worldTransformB, (const VolumeB&)volumeA, worldTransformA, collisionInfo)) {
+			return false;
+		}
+		for (int i = first; i < collisionInfo.pointCount; ++i) {
+			CollisionDetection::ContactPoint& p = collisionInfo.points[i];
+			std::swap(p.localA, p.localB);
+			p.normal = -p.normal;
+		}
+		return true;
+	}
 
-	return iview;
-}
+	bool GJKTest(const CollisionVolume& volumeA, const Transform& worldTransformA,
+		const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo, SimplexCache* cache) {
+		return GJK::Intersection(volumeA, worldTransformA, volumeB, worldTransformB, collisionInfo, cache);
+	}
 
-Vector3 CollisionDetection::Unproject(const Vector3& screenPos, const Camera& cam) {
-	Vector2 screenSize = Window::GetWindow()->GetScreenSize();
+	const int typeCount = CollisionDetection::VolumeTypeCount;
 
-	float aspect	= screenSize.x / screenSize.y;
-	float fov		= cam.GetFieldOfVision();
-	float nearPlane = cam.GetNearPlane();
-	float farPlane  = cam.GetFarPlane();
+	struct DispatchTable {
+		PairTest tests[typeCount][typeCount];
+	};
 
-	//Create our inverted matrix! Note how that to get a correct inverse matrix,
-	//the order of matrices used to form it are inverted, too.
-	Matrix4 invVP = GenerateInverseView(cam) * GenerateInverseProjection(aspect, fov, nearPlane, farPlane);
+	constexpr bool IsConvexType(int type) {
+		return	type == CollisionDetection::VolumeTypeIndex(VolumeType::AABB)		||
+				type == CollisionDetection::VolumeTypeIndex(VolumeType::OBB)		||
+				type == CollisionDetection::VolumeTypeIndex(VolumeType::Sphere)	||
+				type == CollisionDetection::VolumeTypeIndex(VolumeType::Capsule);
+	}
 
-	//Our mouse position x and y values are in 0 to screen dimensions range,
-	//so we need to turn them into the -1 to 1 axis range of clip space.
-	//We can do that by dividing the mouse values by the width and height of the
-	//screen (giving us a range of 0.0 to 1.0), multiplying by 2 (0.0 to 2.0)
-	//and then subtracting 1 (-1.0 to 1.0).
-	Vector4 clipSpace = Vector4(
-		(screenPos.x / (float)screenSize.x) * 2.0f - 1.0f,
-		(screenPos.y / (float)screenSize.y) * 2.0f - 1.0f,
-		(screenPos.z),
-		1.0f
-	);
+	template<class VolumeA, class VolumeB,
+		bool (*Test)(const VolumeA&, const Transform&, const VolumeB&, const Transform&, CollisionInfo&)>
+	constexpr void AddTest(DispatchTable& table, VolumeType typeA, VolumeType typeB) {
+		int a = CollisionDetection::VolumeTypeIndex(typeA);
+		int b = CollisionDetection::VolumeTypeIndex(typeB);
+		table.tests[a][b] = &Forwards<VolumeA, VolumeB, Test>;
+		if (a != b) {
+			table.tests[b][a] = &Backwards<VolumeA, VolumeB, Test>;
+		}
+	}
 
-	//Then, we multiply our clipspace coordinate by our inverted matrix
-	Vector4 transformed = invVP * clipSpace;
+	constexpr DispatchTable BuildDispatchTable() {
+		DispatchTable table = {};
+		for (int a = 0; a < typeCount; ++a) {
+			for (int b = 0; b < typeCount; ++b) {
+				table.tests[a][b] = (IsConvexType(a) && IsConvexType(b)) ? &GJKTest : nullptr;
+			}
+		}
+		AddTest<AABBVolume,		AABBVolume,		&CollisionDetection::AABBIntersection>			(table, VolumeType::AABB,	VolumeType::AABB);
+		AddTest<SphereVolume,	SphereVolume,	&CollisionDetection::SphereIntersection>		(table, VolumeType::Sphere,	VolumeType::Sphere);
+		AddTest<OBBVolume,		OBBVolume,		&CollisionDetection::OBBIntersection>			(table, VolumeType::OBB,	VolumeType::OBB);
+		AddTest<AABBVolume,		SphereVolume,	&CollisionDetection::AABBSphereIntersection>	(table, VolumeType::AABB,	VolumeType::Sphere);
+		AddTest<OBBVolume,		SphereVolume,	&CollisionDetection::OBBSphereIntersection>		(table, VolumeType::OBB,	VolumeType::Sphere);
+		AddTest<AABBVolume,		OBBVolume,		&CollisionDetection::AABBOBBIntersection>		(table, VolumeType::AABB,	VolumeType::OBB);
+		AddTest<CapsuleVolume,	SphereVolume,	&CollisionDetection::SphereCapsuleIntersection>	(table, VolumeType::Capsule,	VolumeType::Sphere);
+		AddTest<CapsuleVolume,	CapsuleVolume,	&CollisionDetection::CapsuleIntersection>		(table, VolumeType::Capsule,	VolumeType::Capsule);
+		AddTest<AABBVolume,		CapsuleVolume,	&CollisionDetection::AABBCapsuleIntersection>	(table, VolumeType::AABB,	VolumeType::Capsule);
+		AddTest<OBBVolume,		CapsuleVolume,	&CollisionDetection::OBBCapsuleIntersection>	(table, VolumeType::OBB,	VolumeType::Capsule);
+		AddTest<MeshVolume,		SphereVolume,	&CollisionDetection::MeshSphereIntersection>	(table, VolumeType::Mesh,	VolumeType::Sphere);
+		AddTest<MeshVolume,		CapsuleVolume,	&CollisionDetection::MeshCapsuleIntersection>	(table, VolumeType::Mesh,	VolumeType::Capsule);
+		AddTest<MeshVolume,		AABBVolume,		&CollisionDetection::MeshAABBIntersection>		(table, VolumeType::Mesh,	VolumeType::AABB);
+		AddTest<MeshVolume,		OBBVolume,		&CollisionDetection::MeshOBBIntersection>		(table, VolumeType::Mesh,	VolumeType::OBB);
+
+		const VolumeType compoundOthers[] = { VolumeType::AABB, VolumeType::OBB, VolumeType::Sphere, VolumeType::Mesh, VolumeType::Capsule, VolumeType::Compound };
+		for (VolumeType other : compoundOthers) {
+			AddTest<CompoundVolume, CollisionVolume, &CollisionDetection::CompoundIntersection>(table, VolumeType::Compound, other);
+		}
+		return table;
+	}
 
-	//our transformed w coordinate is now the 'inverse' perspective divide, so
-	//we can reconstruct the final world space by dividing x,y,and z by w.
-	return Vector3(transformed.x / transformed.w, transformed.y / transformed.w, transformed.z / transformed.w);
+	constexpr DispatchTable dispatchTable = BuildDispatchTable();
 }
 
-Ray CollisionDetection::BuildRayFromMouse(const Camera& cam) {
-	Vector2 screenMouse = Window::GetMouse()->GetAbsolutePosition();
-	Vector2 screenSize	= Window::GetWindow()->GetScreenSize();
-
-	//We remove the y axis mouse position from height as OpenGL is 'upside down',
-	//and thinks the bottom left is the origin, instead of the top left!
-	Vector3 nearPos = Vector3(screenMouse.x,
-		screenSize.y - screenMouse.y,
-		-0.99999f
-	);
-
-	//We also don't use exactly 1.0 (the normalised 'end' of the far plane) as this
-	//causes the unproject function to go a bit weird. 
-	Vector3 farPos = Vector3(screenMouse.x,
-		screenSize.y - screenMouse.y,
-		0.99999f
-	);
-
-	Vector3 a = Unproject(nearPos, cam);
-	Vector3 b = Unproject(farPos, cam);
-	Vector3 c = b - a;
-
-	c.Normalise();
-
-	//std::cout << "Ray Direction:" << c << std::endl;
-
-	return Ray(cam.GetPosition(), c);
+CollisionDetection::PairTest CollisionDetection::GetPairTest(int pairType) {
+	if (pairType < 0 || pairType >= VolumeTypeCount * VolumeTypeCount) {
+		return nullptr;
+	}
+	return dispatchTable.tests[pairType / VolumeTypeCount][pairType % VolumeTypeCount];
 }
 
-//http://bookofhook.com/mousepick.pdf
-Matrix4 CollisionDetection::GenerateInverseProjection(float aspect, float fov, float nearPlane, float farPlane) {
-	Matrix4 m;
-
-	float t = tan(fov*PI_OVER_360);
-
-	float neg_depth = nearPlane - farPlane;
-
-	const float h = 1.0f / t;
-
-	float c = (farPlane + nearPlane) / neg_depth;
-	float e = -1.0f;
-	float d = 2.0f*(nearPlane*farPlane) / neg_depth;
-
-	m.array[0]  = aspect / h;
-	m.array[5]  = tan(fov*PI_OVER_360);
+bool CollisionDetection::CompoundIntersection(
+	const CompoundVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	Vector3 boundsMin, boundsMax;
+	VolumeBounds(volumeB, worldTransformB, boundsMin, boundsMax);
+
+	//The other volume's box, turned into a box in the compound's space
+	Vector3		position		= worldTransformA.GetPosition();
+	Quaternion	orientation		= worldTransformA.GetOrientation();
+	Quaternion	invOrientation	= orientation.Conjugate();
+	Vector3		centre			= invOrientation * (((boundsMin + boundsMax) * 0.5f) - position);
+	Vector3		extent			= Matrix3(invOrientation).Absolute() * ((boundsMax - boundsMin) * 0.5f);
+
+	ContactPoint	points[MaxCompoundContacts];
+	int				pointCount = 0;
+
+	volumeA.QueryBox(centre - extent, centre + extent, [&](int i) {
+		const CollisionVolume& child = volumeA.GetChildVolume(i);
+		PairTest test = GetPairTest(PairType(child, volumeB));
+		if (!test) {
+			return;
+		}
+		Vector3 offset = orientation * volumeA.GetChildPosition(i);
 
-	m.array[10] = 0.0f;
-	m.array[11] = 1.0f / d;
+		Transform childTransform;
+		childTransform.SetPosition(position + offset);
+		childTransform.SetOrientation(orientation * volumeA.GetChildOrientation(i));
 
-	m.array[14] = 1.0f / e;
+		//The children don't get a simplex cache, as there's only one for the whole pair
+		CollisionInfo childInfo;
+		if (!test(child, childTransform, volumeB, worldTransformB, childInfo, nullptr)) {
+			return;
+		}
+		for (int p = 0; p < childInfo.pointCount && pointCount < MaxCompoundContacts; ++p) {
+			points[pointCount]			= childInfo.points[p];
+			points[pointCount].localA	+= offset;
+			pointCount++;
+		}
+	});
+	if (pointCount == 0) {
+		return false;
+	}
+	AddReducedContacts(points, pointCount, collisionInfo);
+	return true;
+}
 
-	m.array[15] = -c / (d*e);
+void CollisionDetection::VolumeBounds(const CollisionVolume& volume, const Transform& worldTransform, Vector3& outMin, Vector3& outMax) {
+	Vector3		position	= worldTransform.GetPosition();
+	Quaternion	orientation = worldTransform.GetOrientation();
+	Vector3		extent;
+
+	switch (volume.type) {
+		case VolumeType::AABB:		extent = ((const AABBVolume&)volume).GetHalfDimensions(); break;
+		case VolumeType::OBB:		extent = Matrix3(orientation).Absolute() * ((const OBBVolume&)volume).GetHalfDimensions(); break;
+		case VolumeType::Sphere: {
+			float r = ((const SphereVolume&)volume).GetRadius();
+			extent	= Vector3(r, r, r);
+		}break;
+		case VolumeType::Capsule: {
+			Vector3 start, end;
+			CapsuleSegment((const CapsuleVolume&)volume, worldTransform, start, end);
+			float r = ((const CapsuleVolume&)volume).GetRadius();
+			outMin	= Vector3(std::min(start.x, end.x) - r, std::min(start.y, end.y) - r, std::min(start.z, end.z) - r);
+			outMax	= Vector3(std::max(start.x, end.x) + r, std::max(start.y, end.y) + r, std::max(start.z, end.z) + r);
+		}return;
+		case VolumeType::Mesh:
+		case VolumeType::Compound: {
+			//These have bounds in their own space, which needn't be centred on the origin
+			Vector3 localMin, localMax;
+			if (volume.type == VolumeType::Mesh) {
+				((const MeshVolume&)volume).GetBounds(localMin, localMax);
+			}
+			else {
+				((const CompoundVolume&)volume).GetBounds(localMin, localMax);
+			}
+			Vector3 localCentre = orientation * ((localMin + localMax) * 0.5f);
+			extent		= Matrix3(orientation).Absolute() * ((localMax - localMin) * 0.5f);
+			position	= position + localCentre;
+		}break;
+		default: break;
+	}
+	outMin = position - extent;
+	outMax = position + extent;
+}
 
-	return m;
+float CollisionDetection::InnerRadius(const CollisionVolume& volume) {
+	switch (volume.type) {
+		case VolumeType::Sphere:	return ((const SphereVolume&)volume).GetRadius();
+		case VolumeType::Capsule:	return ((const CapsuleVolume&)volume).GetRadius();
+		case VolumeType::AABB:
+		case VolumeType::OBB: {
+			Vector3 h = volume.type == VolumeType::AABB ?
+				((const AABBVolume&)volume).GetHalfDimensions() : ((const OBBVolume&)volume).GetHalfDimensions();
+			return std::min(h.x, std::min(h.y, h.z));
+		}
+		case VolumeType::Compound: {
+			//Its thinnest child could skip over a wall the rest of it couldn't, so it's stepped along by that
+			const CompoundVolume& compound = (const CompoundVolume&)volume;
+			if (compound.GetChildCount() == 0) {
+				return 0.0f;
+			}
+			float radius = InnerRadius(compound.GetChildVolume(0));
+			for (int i = 1; i < compound.GetChildCount(); ++i) {
+				radius = std::min(radius, InnerRadius(compound.GetChildVolume(i)));
+			}
+			return radius;
+		}
+		default: return 0.0f;
+	}
 }
 
 /*
-And here's how we generate an inverse view matrix. It's pretty much
-an exact inversion of the BuildViewMatrix function of the Camera class!
+The candidates are compared by where they are on b, as every point's
+localB is measured from the same place.
 */
-Matrix4 CollisionDetection::GenerateInverseView(const Camera &c) {
-	float pitch = c.GetPitch();
-	float yaw	= c.GetYaw();
-	Vector3 position = c.GetPosition();
+void CollisionDetection::AddReducedContacts(const ContactPoint* points, int count, CollisionInfo& collisionInfo) {
+	int chosen[MaxContactPoints];
+	int chosenCount = 0;
 
-	Matrix4 iview =
-Matrix4::Translation(position) *
-Matrix4::Rotation(yaw, Vector3(0, 1, 0)) *
-Matrix4::Rotation(pitch, Vector3(1, 0, 0));
-
-return iview;
+	if (count <= MaxContactPoints) {
+		for (int i = 0; i < count; ++i) {
+			chosen[chosenCount++] = i;
+		}
+	}
+	else {
+		auto Furthest = [&](auto score) {
+			int		best		= -1;
+			float	bestScore	= -1.0f;
+			for (int i = 0; i < count; ++i) {
+				if (std::find(chosen, chosen + chosenCount, i) != chosen + chosenCount) {
+					continue;
+				}
+				float s = score(points[i].localB);
+				if (s > bestScore) {
+					bestScore	= s;
+					best		= i;
+				}
+			}
+			return best;
+		};
+		int deepest = 0;
+		for (int i = 1; i < count; ++i) {
+			if (points[i].penetration > points[deepest].penetration) {
+				deepest = i;
+			}
+		}
+		chosen[chosenCount++] = deepest;
+
+		Vector3 first = points[chosen[0]].localB;
+		chosen[chosenCount++] = Furthest([&](const Vector3& p) {
+			return (p - first).LengthSquared();
+		});
+		Vector3 second = points[chosen[1]].localB;
+		chosen[chosenCount++] = Furthest([&](const Vector3& p) {
+			return Vector3::Cross(p - first, second - first).LengthSquared();
+		});
+		Vector3 middle = (first + second + points[chosen[2]].localB) / 3.0f;
+		chosen[chosenCount++] = Furthest([&](const Vector3& p) {
+			return (p - middle).LengthSquared();
+		});
+	}
+	for (int i = 0; i < chosenCount; ++i) {
+		const ContactPoint& p = points[chosen[i]];
+		collisionInfo.AddContactPoint(p.localA, p.localB, p.normal, p.penetration);
+	}
 }
 
-
-/*
-If you've read through the Deferred Rendering tutorial you should have a pretty
-good idea what this function does. It takes a 2D position, such as the mouse
-position, and 'unprojects' it, to generate a 3D world space position for it.
-
-Just as we turn a world space position into a clip space position by multiplying
-it by the model, view, and projection matrices, we can turn a clip space
-position back to a 3D position by multiply it by the INVERSE of the
-view projection matrix (the model matrix has already been assumed to have
-'transformed' the 2D point). As has been mentioned a few times, inverting a
-matrix is not a nice operation, either to understand or code. But! We can cheat
-the inversion process again, just like we do when we create a view matrix using
-the camera.
-
-So, to form the inverted matrix, we need the aspect and fov used to create the
-projection matrix of our scene, and the camera used to form the view matrix.
-
-*/
-Vector3	CollisionDetection::UnprojectScreenPosition(Vector3 position, float aspect, float fov, const Camera &c) {
-	//Create our inverted matrix! Note how that to get a correct inverse matrix,
-	//the order of matrices used to form it are inverted, too.
-	Matrix4 invVP = GenerateInverseView(c) * GenerateInverseProjection(aspect, fov, c.GetNearPlane(), c.GetFarPlane());
-
-	Vector2 screenSize = Window::GetWindow()->GetScreenSize();
-
-	//Our mouse position x and y values are in 0 to screen dimensions range,
-	//so we need to turn them into the -1 to 1 axis range of clip space.
-	//We can do that by dividing the mouse values by the width and height of the
-	//screen (giving us a range of 0.0 to 1.0), multiplying by 2 (0.0 to 2.0)
-	//and then subtracting 1 (-1.0 to 1.0).
-	Vector4 clipSpace = Vector4(
-		(position.x / (float)screenSize.x) * 2.0f - 1.0f,
-		(position.y / (float)screenSize.y) * 2.0f - 1.0f,
-		(position.z) - 1.0f,
-		1.0f
-	);
-
-	//Then, we multiply our clipspace coordinate by our inverted matrix
-	Vector4 transformed = invVP * clipSpace;
-
-	//our transformed w coordinate is now the 'inverse' perspective divide, so
-	//we can reconstruct the final world space by dividing x,y,and z by w.
-	return Vector3(transformed.x / transformed.w, transformed.y / transformed.w, transformed.z / transformed.w);
-}
-
-bool CollisionDetection::ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+bool CollisionDetection::ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo, SimplexCache* cache) {
 	const CollisionVolume* volA = a->GetBoundingVolume();
 	const CollisionVolume* volB = b->GetBoundingVolume();
 
@@ -320,51 +531,270 @@ bool CollisionDetection::ObjectIntersection(GameObject* a, GameObject* b, Collis
 	collisionInfo.a = a;
 	collisionInfo.b = b;
 
-	Transform& transformA = a->GetTransform();
-	Transform& transformB = b->GetTransform();
+	PairTest test = GetPairTest(PairType(*volA, *volB));
+	if (!test) {
+		return false;
+	}
+	return test(*volA, a->GetTransform(), *volB, b->GetTransform(), collisionInfo, cache);
+}
 
-	VolumeType pairType = (VolumeType)((int)volA->type | (int)volB->type);
+bool CollisionDetection::VolumeIntersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	PairTest test = GetPairTest(PairType(volumeA, volumeB));
+	if (!test) {
+		return false;
+	}
+	return test(volumeA, worldTransformA, volumeB, worldTransformB, collisionInfo, nullptr);
+}
 
-	if (pairType == VolumeType::AABB) {
-		return AABBIntersection((AABBVolume&)*volA, transformA, (AABBVolume&)*volB, transformB, collisionInfo);
+/*
+Triggers only need to know whether they're overlapping something, not the
+contact points, so spheres just compare distances and any other convex
+pair stops as soon as GJK encloses the origin, without running EPA.
+*/
+bool CollisionDetection::VolumeOverlap(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB) {
+	if (volumeA.type == VolumeType::Sphere && volumeB.type == VolumeType::Sphere) {
+		float radii = ((const SphereVolume&)volumeA).GetRadius() + ((const SphereVolume&)volumeB).GetRadius();
+		return (worldTransformB.GetPosition() - worldTransformA.GetPosition()).LengthSquared() < radii * radii;
+	}
+	if (GJK::IsConvex(volumeA) && GJK::IsConvex(volumeB)) {
+		return GJK::Overlap(volumeA, worldTransformA, volumeB, worldTransformB);
 	}
+	CollisionInfo info;
+	return VolumeIntersection(volumeA, worldTransformA, volumeB, worldTransformB, info);
+}
+
+static const int sweepBisections = 10;
 
-	if (pairType == VolumeType::Sphere) {
-		return SphereIntersection((SphereVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
+bool CollisionDetection::SweepIntersection(const CollisionVolume& volumeA, const Transform& worldTransformA, const Vector3& motion,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, float maxFraction, float& outFraction, CollisionInfo& collisionInfo) {
+	PairTest test = GetPairTest(PairType(volumeA, volumeB));
+	if (!test) {
+		return false;
+	}
+	Transform	swept = worldTransformA;
+	Vector3		start = worldTransformA.GetPosition();
+
+	auto touchesAt = [&](float t) {
+		collisionInfo.pointCount = 0;
+		swept.SetPosition(start + (motion * t));
+		return test(volumeA, swept, volumeB, worldTransformB, collisionInfo, nullptr);
+	};
+	if (touchesAt(0.0f)) {
+		outFraction = 0.0f;
+		return true;
+	}
+	float distance		= motion.Length();
+	float stepLength	= InnerRadius(volumeA);
+	if (distance <= 0.0f || stepLength <= 0.0f) {
+		return false;
 	}
+	int		stepCount	= (int)std::ceil(distance / stepLength);
+	float	stepSize	= 1.0f / stepCount;
 
-	if (pairType == VolumeType::OBB) {
-		return OBBIntersection((OBBVolume&)*volA, transformA, (OBBVolume&)*volB, transformB, collisionInfo);
+	for (int i = 1; i <= stepCount && (i - 1) * stepSize < maxFraction; ++i) {
+		float t = std::min(i * stepSize, 1.0f);
+		if (!touchesAt(t)) {
+			continue;
+		}
+		float free		= (i - 1) * stepSize;
+		float touching	= t;
+		for (int j = 0; j < sweepBisections; ++j) {
+			float mid = (free + touching) * 0.5f;
+			if (touchesAt(mid)) {
+				touching = mid;
+			}
+			else {
+				free = mid;
+			}
+		}
+		if (touching >= maxFraction) {
+			return false;
+		}
+		outFraction = touching;
+		return touchesAt(touching);
 	}
+	return false;
+}
 
-	if (volA->type == VolumeType::AABB && volB->type == VolumeType::Sphere) {
-		return AABBSphereIntersection((AABBVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
+/*
+Copies the positions and sizes of up to a batch worth of pairs into the
+arrays the kernels read from. Any lanes past the end of the run are
+filled with the first pair again, so that the kernels never work on
+garbage - their results are masked off afterwards anyway.
+*/
+namespace {
+	const int sphereSphereType	= CollisionDetection::VolumeTypeIndex(VolumeType::Sphere) * typeCount + CollisionDetection::VolumeTypeIndex(VolumeType::Sphere);
+	const int aabbAABBType		= CollisionDetection::VolumeTypeIndex(VolumeType::AABB) * typeCount + CollisionDetection::VolumeTypeIndex(VolumeType::AABB);
+	const int aabbSphereType	= CollisionDetection::VolumeTypeIndex(VolumeType::AABB) * typeCount + CollisionDetection::VolumeTypeIndex(VolumeType::Sphere);
+	const int sphereAABBType	= CollisionDetection::VolumeTypeIndex(VolumeType::Sphere) * typeCount + CollisionDetection::VolumeTypeIndex(VolumeType::AABB);
+
+	void GatherObject(GameObject* object, float position[3][CollisionKernels::BatchSize], float size[3][CollisionKernels::BatchSize], int lane) {
+		Vector3 p = object->GetTransform().GetPosition();
+		Vector3 s;
+		const CollisionVolume* volume = object->GetBoundingVolume();
+		if (volume->type == VolumeType::Sphere) {
+			s.x = ((const SphereVolume*)volume)->GetRadius();
+		}
+		else {
+			s = ((const AABBVolume*)volume)->GetHalfDimensions();
+		}
+		for (int axis = 0; axis < 3; ++axis) {
+			position[axis][lane]	= p[axis];
+			size[axis][lane]		= s[axis];
+		}
 	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::AABB) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return AABBSphereIntersection((AABBVolume&)*volB, transformB, (SphereVolume&)*volA, transformA, collisionInfo);
+
+	int GatherBatch(const CollisionDetection::PairQuery* pairs, int count, CollisionKernels::PairBatch& batch, bool swapped) {
+		int lanes = std::min(count, CollisionKernels::BatchSize);
+		for (int i = 0; i < lanes; ++i) {
+			GatherObject(swapped ? pairs[i].b : pairs[i].a, batch.positionA, batch.sizeA, i);
+			GatherObject(swapped ? pairs[i].a : pairs[i].b, batch.positionB, batch.sizeB, i);
+		}
+		for (int i = lanes; i < CollisionKernels::BatchSize; ++i) {
+			for (int axis = 0; axis < 3; ++axis) {
+				batch.positionA[axis][i]	= batch.positionA[axis][0];
+				batch.positionB[axis][i]	= batch.positionB[axis][0];
+				batch.sizeA[axis][i]		= batch.sizeA[axis][0];
+				batch.sizeB[axis][i]		= batch.sizeB[axis][0];
+			}
+		}
+		return lanes;
 	}
+}
+
+int CollisionDetection::SphereBatchIntersection(const PairQuery* pairs, int count, CollisionInfo* results) {
+	CollisionKernels::PairBatch		batch;
+	CollisionKernels::ContactBatch	contacts;
+	bool avx = CollisionKernels::GetPath() == CollisionKernels::Path::AVX;
+
+	int hits = 0;
+	for (int start = 0; start < count; start += CollisionKernels::BatchSize) {
+		int lanes	= GatherBatch(pairs + start, count - start, batch, false);
+		int mask	= avx ? CollisionKernels::SpheresAVX(batch, contacts) : CollisionKernels::SpheresSSE(batch, contacts);
+		for (int i = 0; i < lanes; ++i) {
+			if (!(mask & (1 << i))) {
+				continue;
+			}
+			CollisionInfo& info = results[hits++];
+			info.a			= pairs[start + i].a;
+			info.b			= pairs[start + i].b;
+			info.pointCount = 0;
 
-	if (volA->type == VolumeType::Capsule && volB->type == VolumeType::Sphere) {
-		return SphereCapsuleIntersection((CapsuleVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
+			Vector3 normal(contacts.normal[0][i], contacts.normal[1][i], contacts.normal[2][i]);
+			info.AddContactPoint(normal * batch.sizeA[0][i], -normal * batch.sizeB[0][i], normal, contacts.penetration[i]);
+		}
 	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::Capsule) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return SphereCapsuleIntersection((CapsuleVolume&)*volB, transformB, (SphereVolume&)*volA, transformA, collisionInfo);
+	return hits;
+}
+
+int CollisionDetection::AABBSphereBatchIntersection(const PairQuery* pairs, int count, CollisionInfo* results, bool sphereFirst) {
+	CollisionKernels::PairBatch		batch;
+	CollisionKernels::ContactBatch	contacts;
+	bool avx = CollisionKernels::GetPath() == CollisionKernels::Path::AVX;
+
+	int hits = 0;
+	for (int start = 0; start < count; start += CollisionKernels::BatchSize) {
+		//The kernels always want the box first
+		int lanes	= GatherBatch(pairs + start, count - start, batch, sphereFirst);
+		int mask	= avx ? CollisionKernels::AABBSpheresAVX(batch, contacts) : CollisionKernels::AABBSpheresSSE(batch, contacts);
+		for (int i = 0; i < lanes; ++i) {
+			if (!(mask & (1 << i))) {
+				continue;
+			}
+			CollisionInfo& info = results[hits++];
+			info.a			= pairs[start + i].a;
+			info.b			= pairs[start + i].b;
+			info.pointCount = 0;
+
+			Vector3 normal(contacts.normal[0][i], contacts.normal[1][i], contacts.normal[2][i]);
+			Vector3 onSphere = -normal * batch.sizeB[0][i];
+			if (sphereFirst) {
+				info.AddContactPoint(onSphere, Vector3(), -normal, contacts.penetration[i]);
+			}
+			else {
+				info.AddContactPoint(Vector3(), onSphere, normal, contacts.penetration[i]);
+			}
+		}
 	}
+	return hits;
+}
 
-	if (volA->type == VolumeType::OBB && volB->type == VolumeType::Sphere) {
-		return OBBSphereIntersection((OBBVolume&)* volA, transformA, (SphereVolume&)* volB, transformB, collisionInfo);
+//Only the overlap test is batched here, as boxes that touch need a whole manifold building
+int CollisionDetection::AABBBatchIntersection(const PairQuery* pairs, int count, CollisionInfo* results) {
+	CollisionKernels::PairBatch batch;
+	bool avx = CollisionKernels::GetPath() == CollisionKernels::Path::AVX;
+
+	int hits = 0;
+	for (int start = 0; start < count; start += CollisionKernels::BatchSize) {
+		int lanes	= GatherBatch(pairs + start, count - start, batch, false);
+		int mask	= avx ? CollisionKernels::AABBsAVX(batch) : CollisionKernels::AABBsSSE(batch);
+		for (int i = 0; i < lanes; ++i) {
+			if (!(mask & (1 << i))) {
+				continue;
+			}
+			const PairQuery&	pair = pairs[start + i];
+			CollisionInfo&		info = results[hits];
+			info.a			= pair.a;
+			info.b			= pair.b;
+			info.pointCount = 0;
+			if (AABBIntersection((const AABBVolume&)*pair.a->GetBoundingVolume(), pair.a->GetTransform(),
+								 (const AABBVolume&)*pair.b->GetBoundingVolume(), pair.b->GetTransform(), info)) {
+				hits++;
+			}
+		}
 	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::OBB) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return OBBSphereIntersection((OBBVolume&)* volB, transformB, (SphereVolume&)* volA, transformA, collisionInfo);
+	return hits;
+}
+
+/*
+Runs of pairs of the same types all call the same test, so the test is
+only looked up once per run, and the branch predictor only has one call
+target to learn at a time. Runs of spheres and AABBs are handed to the
+SIMD kernels whole, unless the CPU can't run them.
+*/
+int CollisionDetection::BatchIntersection(const PairQuery* pairs, int count, CollisionInfo* results) {
+	bool useKernels = CollisionKernels::GetPath() != CollisionKernels::Path::Scalar;
+
+	int hits = 0;
+	for (int start = 0; start < count; ) {
+		int type	= pairs[start].pairType;
+		int end		= start + 1;
+		while (end < count && pairs[end].pairType == type) {
+			end++;
+		}
+		PairTest test = GetPairTest(type);
+		if (useKernels && type == sphereSphereType) {
+			hits += SphereBatchIntersection(pairs + start, end - start, results + hits);
+		}
+		else if (useKernels && type == aabbAABBType) {
+			hits += AABBBatchIntersection(pairs + start, end - start, results + hits);
+		}
+		else if (useKernels && (type == aabbSphereType || type == sphereAABBType)) {
+			hits += AABBSphereBatchIntersection(pairs + start, end - start, results + hits, type == sphereAABBType);
+		}
+		else if (test) {
+			for (int i = start; i < end; ++i) {
+				const PairQuery&	pair = pairs[i];
+				CollisionInfo&		info = results[hits];
+
+				info.a			= pair.a;
+				info.b			= pair.b;
+				info.pointCount = 0;
+				if (test(*pair.a->GetBoundingVolume(), pair.a->GetTransform(),
+						 *pair.b->GetBoundingVolume(), pair.b->GetTransform(), info, pair.cache)) {
+					hits++;
+				}
+			}
+		}
+		start = end;
 	}
+	return hits;
+}
 
-	return false;
+bool CollisionDetection::UsesGJK(const CollisionVolume& volumeA, const CollisionVolume& volumeB) {
+	return GetPairTest(PairType(volumeA, volumeB)) == &GJKTest;
 }
 
 bool CollisionDetection::AABBTest(const Vector3& posA, const Vector3& posB, const Vector3& halfSizeA, const Vector3& halfSizeB) {
@@ -372,9 +802,10 @@ bool CollisionDetection::AABBTest(const Vector3& posA, const Vector3& posB, cons
 	Vector3 delta = posB - posA;
 	Vector3 totalSize = halfSizeA + halfSizeB;
 
-	if (abs(delta.x) < totalSize.x &&
-		abs(delta.y) < totalSize.y &&
-		abs(delta.z) < totalSize.z)
+	//std::abs, as plain abs only takes ints, and rounds the deltas down
+	if (std::abs(delta.x) < totalSize.x &&
+		std::abs(delta.y) < totalSize.y &&
+		std::abs(delta.z) < totalSize.z)
 	{
 		return true;
 	}
@@ -421,6 +852,7 @@ bool CollisionDetection::AABBIntersection(
 		};
 		float penetration = FLT_MAX;
 		Vector3 bestAxis;
+		int bestFace = 0;
 
 		for (int i = 0; i < 6; i++)
 		{
@@ -428,9 +860,44 @@ bool CollisionDetection::AABBIntersection(
 			{
 				penetration = distances[i];
 				bestAxis	= faces[i];
+				bestFace	= i;
+			}
+		}
+
+		/*
+		The boxes touch across the rectangle where their faces overlap, so
+		there's a contact point at each of its corners - one on the face of
+		each box. If the rectangle is just an edge or a point, the corners
+		that end up on top of each other are only added once.
+		*/
+		int axis	= bestFace / 2;
+		int u		= (axis + 1) % 3;
+		int v		= (axis + 2) % 3;
+
+		float faceA	= (bestFace % 2) ? maxA[axis] : minA[axis];
+		float faceB	= (bestFace % 2) ? minB[axis] : maxB[axis];
+
+		float rangeU[2] = { std::max(minA[u], minB[u]), std::min(maxA[u], maxB[u]) };
+		float rangeV[2] = { std::max(minA[v], minB[v]), std::min(maxA[v], maxB[v]) };
+
+		int countU = (rangeU[1] - rangeU[0] > 0.001f) ? 2 : 1;
+		int countV = (rangeV[1] - rangeV[0] > 0.001f) ? 2 : 1;
+
+		for (int i = 0; i < countU; ++i)
+		{
+			for (int j = 0; j < countV; ++j)
+			{
+				Vector3 pointA;
+				pointA[axis]	= faceA;
+				pointA[u]		= rangeU[i];
+				pointA[v]		= rangeV[j];
+
+				Vector3 pointB	= pointA;
+				pointB[axis]	= faceB;
+
+				collisionInfo.AddContactPoint(pointA - boxAPos, pointB - boxBPos, bestAxis, penetration);
 			}
 		}
-		collisionInfo.AddContactPoint(Vector3(), Vector3(), bestAxis, penetration);
 		return true;
 	}
 
@@ -473,7 +940,8 @@ bool CollisionDetection::AABBSphereIntersection(
 
 	if (distance < volumeB.GetRadius())
 	{
-		Vector3 collisionNormal = worldTransformA.GetOrientation() * localPoint.Normalised();
+		//The box ignores its orientation, so the normal can't be rotated by it either
+		Vector3 collisionNormal = localPoint.Normalised();
 		float penetration		= (volumeB.GetRadius() - distance);
 
 		Vector3 localA			= Vector3();
@@ -524,14 +992,393 @@ bool CollisionDetection::OBBSphereIntersection(
 bool CollisionDetection::OBBIntersection(
 	const OBBVolume& volumeA, const Transform& worldTransformA,
 	const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	
 
-	
-	return false;
+	SATAlgorithm::Box boxA(worldTransformA.GetPosition(), worldTransformA.GetOrientation(), volumeA.GetHalfDimensions());
+	SATAlgorithm::Box boxB(worldTransformB.GetPosition(), worldTransformB.GetOrientation(), volumeB.GetHalfDimensions());
+
+	return SATAlgorithm::BoxIntersection(boxA, boxB, collisionInfo);
+}
+
+//An AABB is just an OBB that ignores its transform's orientation
+bool CollisionDetection::AABBOBBIntersection(
+	const AABBVolume& volumeA, const Transform& worldTransformA,
+	const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+
+	SATAlgorithm::Box boxA(worldTransformA.GetPosition(), volumeA.GetHalfDimensions());
+	SATAlgorithm::Box boxB(worldTransformB.GetPosition(), worldTransformB.GetOrientation(), volumeB.GetHalfDimensions());
+
+	return SATAlgorithm::BoxIntersection(boxA, boxB, collisionInfo);
+}
+
+void CollisionDetection::CapsuleSegment(const CapsuleVolume& volume, const Transform& worldTransform, Vector3& start, Vector3& end) {
+	//The half height includes the round ends, so the segment stops a radius short of it
+	Vector3 up		= worldTransform.GetOrientation() * Vector3(0, 1, 0);
+	Vector3 offset	= up * std::max(0.0f, volume.GetHalfHeight() - volume.GetRadius());
+	start	= worldTransform.GetPosition() - offset;
+	end		= worldTransform.GetPosition() + offset;
+}
+
+float CollisionDetection::ClosestPointOnSegment(const Vector3& point, const Vector3& start, const Vector3& end) {
+	Vector3 segment = end - start;
+	float	length	= Vector3::Dot(segment, segment);
+	if (length == 0.0f) {
+		return 0.0f;
+	}
+	return Maths::Clamp(Vector3::Dot(point - start, segment) / length, 0.0f, 1.0f);
+}
+
+/*
+The closest points between two infinite lines are where the line between
+them is at right angles to both. Those points might be off the end of the
+segments though, in which case the one on segment a is clamped to the
+segment, then the one on b worked out again from that, and clamped in turn.
+*/
+void CollisionDetection::ClosestPointsOnSegments(const Vector3& startA, const Vector3& endA,
+	const Vector3& startB, const Vector3& endB, float& tA, float& tB) {
+	const float epsilon = 1e-6f;
+
+	Vector3 dirA	= endA - startA;
+	Vector3 dirB	= endB - startB;
+	Vector3 offset	= startA - startB;
+
+	float lengthA	= Vector3::Dot(dirA, dirA);
+	float lengthB	= Vector3::Dot(dirB, dirB);
+	float f			= Vector3::Dot(dirB, offset);
+
+	if (lengthA <= epsilon && lengthB <= epsilon) {
+		tA = 0.0f;
+		tB = 0.0f;
+		return;
+	}
+	if (lengthA <= epsilon) {
+		tA = 0.0f;
+		tB = Maths::Clamp(f / lengthB, 0.0f, 1.0f);
+		return;
+	}
+	float c = Vector3::Dot(dirA, offset);
+	if (lengthB <= epsilon) {
+		tB = 0.0f;
+		tA = Maths::Clamp(-c / lengthA, 0.0f, 1.0f);
+		return;
+	}
+	float b		= Vector3::Dot(dirA, dirB);
+	float denom = (lengthA * lengthB) - (b * b);
+
+	//Parallel segments have a whole line of closest points, so any will do
+	tA = (denom > epsilon * lengthA * lengthB) ? Maths::Clamp(((b * f) - (c * lengthB)) / denom, 0.0f, 1.0f) : 0.0f;
+	tB = ((b * tA) + f) / lengthB;
+
+	if (tB < 0.0f) {
+		tB = 0.0f;
+		tA = Maths::Clamp(-c / lengthA, 0.0f, 1.0f);
+	}
+	else if (tB > 1.0f) {
+		tB = 1.0f;
+		tA = Maths::Clamp((b - c) / lengthA, 0.0f, 1.0f);
+	}
+}
+
+bool CollisionDetection::AddSegmentContact(const Vector3& onA, float radiusA, const Vector3& positionA,
+	const Vector3& onB, float radiusB, const Vector3& positionB, const Vector3& axisA, CollisionInfo& collisionInfo) {
+	float	radii		= radiusA + radiusB;
+	Vector3 delta		= onB - onA;
+	float	distance	= delta.Length();
+
+	if (distance >= radii) {
+		return false;
+	}
+	Vector3 normal;
+	if (distance > 0.0f) {
+		normal = delta / distance;
+	}
+	else {
+		//Right on top of each other, so push them apart sideways from a's segment
+		normal = Vector3::Cross(axisA, Vector3(1, 0, 0));
+		if (normal.LengthSquared() < 1e-6f) {
+			normal = Vector3::Cross(axisA, Vector3(0, 0, 1));
+		}
+		if (normal.LengthSquared() < 1e-6f) {
+			normal = Vector3(0, 1, 0);
+		}
+		normal.Normalise();
+	}
+	collisionInfo.AddContactPoint((onA + normal * radiusA) - positionA, (onB - normal * radiusB) - positionB, normal, radii - distance);
+	return true;
 }
 
+//Capsule / Sphere Collision
 bool CollisionDetection::SphereCapsuleIntersection(
 	const CapsuleVolume& volumeA, const Transform& worldTransformA,
 	const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	return false;
+	Vector3 start, end;
+	CapsuleSegment(volumeA, worldTransformA, start, end);
+
+	Vector3 spherePos	= worldTransformB.GetPosition();
+	Vector3 closest		= start + (end - start) * ClosestPointOnSegment(spherePos, start, end);
+
+	return AddSegmentContact(closest, volumeA.GetRadius(), worldTransformA.GetPosition(),
+		spherePos, volumeB.GetRadius(), spherePos, end - start, collisionInfo);
+}
+
+/*
+Two capsules lying side by side would only touch at one point along their
+length, and would roll around on it, so if they're close to parallel, each
+end of the stretch where they overlap gets a contact point instead.
+*/
+bool CollisionDetection::CapsuleIntersection(
+	const CapsuleVolume& volumeA, const Transform& worldTransformA,
+	const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	Vector3 startA, endA, startB, endB;
+	CapsuleSegment(volumeA, worldTransformA, startA, endA);
+	CapsuleSegment(volumeB, worldTransformB, startB, endB);
+
+	float	radiusA		= volumeA.GetRadius();
+	float	radiusB		= volumeB.GetRadius();
+	Vector3 positionA	= worldTransformA.GetPosition();
+	Vector3 positionB	= worldTransformB.GetPosition();
+	Vector3 axisA		= endA - startA;
+	Vector3 axisB		= endB - startB;
+
+	float lengthA = axisA.Length();
+	float lengthB = axisB.Length();
+	if (lengthA > 0.0f && lengthB > 0.0f && std::abs(Vector3::Dot(axisA, axisB)) > 0.99f * lengthA * lengthB) {
+		float from	= ClosestPointOnSegment(startB, startA, endA);
+		float to	= ClosestPointOnSegment(endB, startA, endA);
+		if (from > to) {
+			std::swap(from, to);
+		}
+		if ((to - from) * lengthA > 0.01f) {
+			float ends[2] = { from, to };
+			bool hit = false;
+			for (int i = 0; i < 2; ++i) {
+				Vector3 onA = startA + axisA * ends[i];
+				Vector3 onB = startB + axisB * ClosestPointOnSegment(onA, startB, endB);
+				hit |= AddSegmentContact(onA, radiusA, positionA, onB, radiusB, positionB, axisA, collisionInfo);
+			}
+			return hit;
+		}
+	}
+
+	float tA, tB;
+	ClosestPointsOnSegments(startA, endA, startB, endB, tA, tB);
+	return AddSegmentContact(startA + axisA * tA, radiusA, positionA, startB + axisB * tB, radiusB, positionB, axisA, collisionInfo);
+}
+
+bool CollisionDetection::AABBCapsuleIntersection(
+	const AABBVolume& volumeA, const Transform& worldTransformA,
+	const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	return BoxCapsuleIntersection(worldTransformA.GetPosition(), Quaternion(), volumeA.GetHalfDimensions(), volumeB, worldTransformB, collisionInfo);
+}
+
+bool CollisionDetection::OBBCapsuleIntersection(
+	const OBBVolume& volumeA, const Transform& worldTransformA,
+	const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	return BoxCapsuleIntersection(worldTransformA.GetPosition(), worldTransformA.GetOrientation(), volumeA.GetHalfDimensions(), volumeB, worldTransformB, collisionInfo);
+}
+
+bool CollisionDetection::MeshSphereIntersection(
+	const MeshVolume& volumeA, const Transform& worldTransformA,
+	const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	return MeshCollision::SphereIntersection(volumeA, worldTransformA, volumeB, worldTransformB, collisionInfo);
+}
+
+bool CollisionDetection::MeshCapsuleIntersection(
+	const MeshVolume& volumeA, const Transform& worldTransformA,
+	const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	return MeshCollision::CapsuleIntersection(volumeA, worldTransformA, volumeB, worldTransformB, collisionInfo);
+}
+
+bool CollisionDetection::MeshAABBIntersection(
+	const MeshVolume& volumeA, const Transform& worldTransformA,
+	const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	SATAlgorithm::Box box(worldTransformB.GetPosition(), volumeB.GetHalfDimensions());
+	return MeshCollision::BoxIntersection(volumeA, worldTransformA, box, collisionInfo);
+}
+
+bool CollisionDetection::MeshOBBIntersection(
+	const MeshVolume& volumeA, const Transform& worldTransformA,
+	const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	SATAlgorithm::Box box(worldTransformB.GetPosition(), worldTransformB.GetOrientation(), volumeB.GetHalfDimensions());
+	return MeshCollision::BoxIntersection(volumeA, worldTransformA, box, collisionInfo);
+}
+
+/*
+Done in the box's local space, where it's just an AABB around the origin.
+
+If the segment down the capsule stays outside the box, the point on it
+closest to the box is either one of its ends, or somewhere facing one of
+the box's 12 edges - so those are all tried, and the closest one is
+treated as a sphere.
+
+A capsule lying flat on a face would rock on a single contact, so then
+the stretch of it that's over the face gets a contact at each end instead.
+*/
+bool CollisionDetection::BoxCapsuleIntersection(const Vector3& boxPosition, const Quaternion& boxOrientation, const Vector3& halfSize,
+	const CapsuleVolume& capsule, const Transform& capsuleTransform, CollisionInfo& collisionInfo) {
+	Vector3 worldStart, worldEnd;
+	CapsuleSegment(capsule, capsuleTransform, worldStart, worldEnd);
+
+	Quaternion	invOrientation	= boxOrientation.Conjugate();
+	Vector3		start			= invOrientation * (worldStart - boxPosition);
+	Vector3		end				= invOrientation * (worldEnd - boxPosition);
+	Vector3		segment			= end - start;
+	float		radius			= capsule.GetRadius();
+
+	float tEnter	= 0.0f;
+	float tExit		= 1.0f;
+	for (int i = 0; i < 3; ++i) {
+		if (std::abs(segment[i]) < 1e-6f) {
+			if (std::abs(start[i]) > halfSize[i]) {
+				tEnter = FLT_MAX;
+			}
+			continue;
+		}
+		float t0 = (-halfSize[i] - start[i]) / segment[i];
+		float t1 = ( halfSize[i] - start[i]) / segment[i];
+		tEnter	= std::max(tEnter, std::min(t0, t1));
+		tExit	= std::min(tExit, std::max(t0, t1));
+	}
+
+	Vector3 normal;
+	float	penetration;
+	Vector3 point;
+	Vector3 onBox;
+	int		faceAxis = -1;
+
+	if (tEnter <= tExit) {
+		/*
+		The segment goes through the box, so there's no closest point to go
+		on. Instead, it's treated like a very thin box - the 3 face normals
+		of the box, and the 3 directions at right angles to both the segment
+		and one of the box's edges, are tried as in the separating axis
+		test, and it's pushed out along whichever it overlaps least on.
+		*/
+		Vector3 centre		= (start + end) * 0.5f;
+		Vector3 halfSegment = segment * 0.5f;
+
+		Vector3 axes[6];
+		int		axisCount = 0;
+		for (int i = 0; i < 3; ++i) {
+			axes[axisCount] = Vector3();
+			axes[axisCount++][i] = 1.0f;
+		}
+		for (int i = 0; i < 3; ++i) {
+			Vector3 edge;
+			edge[i] = 1.0f;
+			Vector3 axis = Vector3::Cross(segment, edge);
+			if (axis.LengthSquared() > 1e-6f * Vector3::Dot(segment, segment)) {
+				axes[axisCount++] = axis.Normalised();
+			}
+		}
+
+		penetration = FLT_MAX;
+		for (int i = 0; i < axisCount; ++i) {
+			const Vector3& axis = axes[i];
+			float boxRadius		= (halfSize.x * std::abs(axis.x)) + (halfSize.y * std::abs(axis.y)) + (halfSize.z * std::abs(axis.z));
+			float capsuleRadius = std::abs(Vector3::Dot(halfSegment, axis)) + radius;
+			float distance		= Vector3::Dot(centre, axis);
+			float overlap		= boxRadius + capsuleRadius - std::abs(distance);
+			//Only move off the face normals if it's clearly better, to keep flat contacts stable
+			if (overlap < penetration - (i < 3 ? 0.0f : 0.001f)) {
+				penetration = overlap;
+				normal		= distance >= 0.0f ? axis : -axis;
+				faceAxis	= i < 3 ? i : -1;
+			}
+		}
+		//The end of the segment that's deepest in
+		float toStart	= Vector3::Dot(start, normal);
+		float toEnd		= Vector3::Dot(end, normal);
+		point	= std::abs(toStart - toEnd) < 1e-4f ? centre : (toStart < toEnd ? start : end);
+		onBox	= point + normal * (penetration - radius);
+	}
+	else {
+		//The closest point on the segment is at one of its ends, or facing one of the box edges
+		float t				= 0.0f;
+		float bestDistance	= FLT_MAX;
+		auto TryPoint = [&](float candidate) {
+			Vector3 p = start + segment * candidate;
+			float distance = (p - Maths::Clamp(p, -halfSize, halfSize)).LengthSquared();
+			if (distance < bestDistance) {
+				bestDistance	= distance;
+				t				= candidate;
+			}
+		};
+		TryPoint(0.0f);
+		TryPoint(1.0f);
+		for (int axis = 0; axis < 3; ++axis) {
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+			for (int corner = 0; corner < 4; ++corner) {
+				Vector3 edgeStart;
+				edgeStart[u]	= (corner & 1) ? halfSize[u] : -halfSize[u];
+				edgeStart[v]	= (corner & 2) ? halfSize[v] : -halfSize[v];
+				edgeStart[axis] = -halfSize[axis];
+				Vector3 edgeEnd = edgeStart;
+				edgeEnd[axis]	= halfSize[axis];
+
+				float onSegment, onEdge;
+				ClosestPointsOnSegments(start, end, edgeStart, edgeEnd, onSegment, onEdge);
+				TryPoint(onSegment);
+			}
+		}
+
+		point	= start + segment * t;
+		onBox	= Maths::Clamp(point, -halfSize, halfSize);
+
+		Vector3 delta	= point - onBox;
+		float distance	= delta.Length();
+		if (distance >= radius || distance == 0.0f) {
+			return false;
+		}
+		normal		= delta / distance;
+		penetration = radius - distance;
+		for (int i = 0; i < 3; ++i) {
+			if (std::abs(normal[i]) > 0.999f) {
+				faceAxis = i;
+			}
+		}
+	}
+
+	Vector3 worldNormal		= boxOrientation * normal;
+	Vector3 capsulePosition = capsuleTransform.GetPosition();
+	auto AddContact = [&](const Vector3& boxPoint, const Vector3& segmentPoint, float depth) {
+		Vector3 onCapsule = boxOrientation * (segmentPoint - normal * radius) + boxPosition;
+		collisionInfo.AddContactPoint(boxOrientation * boxPoint, onCapsule - capsulePosition, worldNormal, depth);
+	};
+
+	float segmentLength = segment.Length();
+	if (faceAxis >= 0 && segmentLength > 0.0f && std::abs(Vector3::Dot(segment, normal)) < 0.05f * segmentLength) {
+		int u = (faceAxis + 1) % 3;
+		int v = (faceAxis + 2) % 3;
+		float from	= 0.0f;
+		float to	= 1.0f;
+		int faceAxes[2] = { u, v };
+		for (int axis : faceAxes) {
+			if (std::abs(segment[axis]) < 1e-6f) {
+				continue;
+			}
+			float t0 = (-halfSize[axis] - start[axis]) / segment[axis];
+			float t1 = ( halfSize[axis] - start[axis]) / segment[axis];
+			from	= std::max(from, std::min(t0, t1));
+			to		= std::min(to, std::max(t0, t1));
+		}
+		if ((to - from) * segmentLength > 0.01f) {
+			int		first	= collisionInfo.pointCount;
+			float	ends[2] = { from, to };
+			for (int i = 0; i < 2; ++i) {
+				Vector3 p		= start + segment * ends[i];
+				float	depth	= radius - ((p[faceAxis] * normal[faceAxis]) - halfSize[faceAxis]);
+				if (depth > 0.0f) {
+					Vector3 boxPoint	= p;
+					boxPoint[faceAxis]	= normal[faceAxis] * halfSize[faceAxis];
+					AddContact(boxPoint, p, depth);
+				}
+			}
+			if (collisionInfo.pointCount > first) {
+				return true;
+			}
+		}
+	}
+	AddContact(onBox, point, penetration);
+	return true;
 }
\ No newline at end of file
@@ -10,8 +10,16 @@
 #include "OBBVolume.h"
 #include "SphereVolume.h"
 #include "CapsuleVolume.h"
+#include "MeshVolume.h"
+#include "CompoundVolume.h"
 #include "Ray.h"
 
+namespace NCL {
+	namespace CSC8503 {
+		struct SimplexCache;
+	}
+}
+
 using NCL::Camera;
 using namespace NCL::Maths;
 using namespace NCL::CSC8503;
@@ -24,30 +32,42 @@ namespace NCL {
 			Vector3 localB;
 			Vector3 normal;
 			float	penetration;
+
+			/*
+			The impulses the solver ended up applying at this point. They're
+			carried over to the matching point next frame, so the solver can
+			start from where it left off, rather than from nothing.
+			*/
+			float	normalImpulse;
+			Vector3	frictionImpulse;
 		};
+
+		static const int MaxContactPoints = 4;
+
+		/*
+		A contact manifold - every point where a pair of objects touch. Flat
+		faces resting on each other need several points to stay flat, as a
+		single point in the middle lets them rock back and forth.
+		*/
 		struct CollisionInfo {
 			GameObject* a;
 			GameObject* b;		
-			mutable int framesLeft;
+			int framesLeft;
 
-			ContactPoint point;
+			ContactPoint	points[MaxContactPoints];
+			int				pointCount = 0;
 
 			void AddContactPoint(const Vector3& localA, const Vector3& localB, const Vector3& normal, float p) {
-				point.localA		= localA;
-				point.localB		= localB;
-				point.normal		= normal;
-				point.penetration	= p;
-			}
-
-			//Advanced collision detection / resolution
-			bool operator < (const CollisionInfo& other) const {
-				size_t otherHash = (size_t)other.a->GetWorldID() + ((size_t)other.b->GetWorldID() << 32);
-				size_t thisHash  = (size_t)a->GetWorldID()		 + ((size_t)b-> GetWorldID() << 32);
-
-				if (thisHash < otherHash) {
-					return true;
+				if (pointCount == MaxContactPoints) {
+					return;
 				}
-				return false;
+				ContactPoint& point = points[pointCount++];
+				point.localA			= localA;
+				point.localB			= localB;
+				point.normal			= normal;
+				point.penetration		= p;
+				point.normalImpulse		= 0.0f;
+				point.frictionImpulse	= Vector3();
 			}
 
 			bool operator ==(const CollisionInfo& other) const {
@@ -58,15 +78,104 @@ namespace NCL {
 			}
 		};
 
+		/*
+		Adds up to MaxContactPoints of the given points to the manifold. If
+		there's too many, the deepest is kept, then the one furthest from it,
+		then the one furthest from the line between those two, and lastly the
+		one furthest from the middle of the first three, to cover as much of
+		the area the objects touch over as possible.
+		*/
+		static void AddReducedContacts(const ContactPoint* points, int count, CollisionInfo& collisionInfo);
+
+		/*
+		A capsule is every point within its radius of a line segment, so its
+		tests mostly come down to finding the closest point on that segment
+		to whatever it's being tested against, and then treating that point
+		as a sphere.
+		*/
 		static bool SphereCapsuleIntersection(
 			const CapsuleVolume& volumeA, const Transform& worldTransformA,
 			const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
 
+		static bool CapsuleIntersection(const CapsuleVolume& volumeA, const Transform& worldTransformA,
+										const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		static bool AABBCapsuleIntersection(const AABBVolume& volumeA, const Transform& worldTransformA,
+											const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		static bool OBBCapsuleIntersection(	const OBBVolume& volumeA, const Transform& worldTransformA,
+											const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		/*
+		A mesh is always the first volume, so the normals point away from it.
+		They're all done in MeshCollision, with the mesh's BVH doing the
+		broadphase for the triangles inside it.
+		*/
+		static bool MeshSphereIntersection(	const MeshVolume& volumeA, const Transform& worldTransformA,
+											const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		static bool MeshCapsuleIntersection(const MeshVolume& volumeA, const Transform& worldTransformA,
+											const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		static bool MeshAABBIntersection(	const MeshVolume& volumeA, const Transform& worldTransformA,
+											const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		static bool MeshOBBIntersection(	const MeshVolume& volumeA, const Transform& worldTransformA,
+											const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		/*
+		Each child of the compound that's near the other volume is tested
+		against it with whatever test that pair of types would normally use,
+		and the contacts from all of them are moved to be relative to the
+		compound's position, and cut down to a single manifold. The other
+		volume can be anything, including another compound.
+		*/
+		static bool CompoundIntersection(	const CompoundVolume& volumeA, const Transform& worldTransformA,
+											const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		//The world space box around a volume
+		static void VolumeBounds(const CollisionVolume& volume, const Transform& worldTransform, Vector3& outMin, Vector3& outMax);
+
+		/*
+		How far a volume can move without any part of it passing over where
+		it just was - half of its thinnest width. Anything moving further
+		than this in a step could jump straight through a thin wall.
+		*/
+		static float InnerRadius(const CollisionVolume& volume);
+
+		//Tests a pair of volumes with whatever test their types use, without needing GameObjects for them
+		static bool VolumeIntersection(	const CollisionVolume& volumeA, const Transform& worldTransformA,
+										const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
+		//Just whether a pair of volumes overlap, which can be a lot quicker than finding their contacts
+		static bool VolumeOverlap(		const CollisionVolume& volumeA, const Transform& worldTransformA,
+										const CollisionVolume& volumeB, const Transform& worldTransformB);
+
+		/*
+		Moves volume A along motion, and finds how far along it (as a fraction,
+		up to maxFraction) A first touches B. It steps along no further than
+		A's inner radius at a time, so it can't skip over B, and the first step
+		that touches is narrowed down by bisection. If they already touch at
+		the start, the fraction is 0. On a hit, collisionInfo holds the contact
+		where they touch, with A moved there.
+		*/
+		static bool SweepIntersection(	const CollisionVolume& volumeA, const Transform& worldTransformA, const Vector3& motion,
+										const CollisionVolume& volumeB, const Transform& worldTransformB, float maxFraction,
+										float& outFraction, CollisionInfo& collisionInfo);
+
+		//The ends of the line segment down the middle of a capsule, in world space
+		static void CapsuleSegment(const CapsuleVolume& volume, const Transform& worldTransform, Vector3& start, Vector3& end);
+
+		//How far along the segment (from 0 at start to 1 at end) the closest point to the given point is
+		static float ClosestPointOnSegment(const Vector3& point, const Vector3& start, const Vector3& end);
+
+		//How far along each segment the closest pair of points between them are
+		static void ClosestPointsOnSegments(const Vector3& startA, const Vector3& endA,
+											const Vector3& startB, const Vector3& endB, float& tA, float& tB);
+
 		//TODO ADD THIS PROPERLY
 		static bool RayBoxIntersection(const Ray&r, const Vector3& boxPos, const Vector3& boxSize, RayCollision& collision);
 
-		static Ray BuildRayFromMouse(const Camera& c);
-
 		static bool RayIntersection(const Ray&r, GameObject& object, RayCollision &collisions);
 
 
@@ -74,13 +183,70 @@ namespace NCL {
 		static bool RayOBBIntersection(const Ray&r, const Transform& worldTransform, const OBBVolume&	volume, RayCollision& collision);
 		static bool RaySphereIntersection(const Ray&r, const Transform& worldTransform, const SphereVolume& volume, RayCollision& collision);
 		static bool RayCapsuleIntersection(const Ray& r, const Transform& worldTransform, const CapsuleVolume& volume, RayCollision& collision);
+		static bool RayMeshIntersection(const Ray& r, const Transform& worldTransform, const MeshVolume& volume, RayCollision& collision);
+		static bool RayCompoundIntersection(const Ray& r, const Transform& worldTransform, const CompoundVolume& volume, RayCollision& collision);
 
 
 		static bool RayPlaneIntersection(const Ray&r, const Plane&p, RayCollision& collisions);
 
 		static bool	AABBTest(const Vector3& posA, const Vector3& posB, const Vector3& halfSizeA, const Vector3& halfSizeB);
 
-		static bool ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
+		/*
+		Pairs without a test of their own go through GJK, which can carry
+		some work over from one frame to the next in the pair's cache.
+		*/
+		static bool ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo, SimplexCache* cache = nullptr);
+
+		//Every pair test has this shape, with the contact normals pointing from a to b
+		typedef bool (*PairTest)(const CollisionVolume& volumeA, const Transform& worldTransformA,
+								 const CollisionVolume& volumeB, const Transform& worldTransformB,
+								 CollisionInfo& collisionInfo, SimplexCache* cache);
+
+		static const int VolumeTypeCount = 6;
+
+		//VolumeType is a bit per type, so this turns it into something that can index an array
+		static constexpr int VolumeTypeIndex(VolumeType type) {
+			switch (type) {
+				case VolumeType::AABB:		return 0;
+				case VolumeType::OBB:		return 1;
+				case VolumeType::Sphere:	return 2;
+				case VolumeType::Mesh:		return 3;
+				case VolumeType::Capsule:	return 4;
+				case VolumeType::Compound:	return 5;
+				default:					return -1;
+			}
+		}
+
+		//One number for each ordered pair of types, or -1 if either volume has no type
+		static int PairType(const CollisionVolume& volumeA, const CollisionVolume& volumeB) {
+			int a = VolumeTypeIndex(volumeA.type);
+			int b = VolumeTypeIndex(volumeB.type);
+			if (a < 0 || b < 0) {
+				return -1;
+			}
+			return (a * VolumeTypeCount) + b;
+		}
+
+		//The test for a pair type, or nullptr if those types can't collide
+		static PairTest GetPairTest(int pairType);
+
+		struct PairQuery {
+			GameObject*		a;
+			GameObject*		b;
+			SimplexCache*	cache;
+			int				pairType;
+		};
+
+		/*
+		Tests a whole array of pairs, writing a CollisionInfo into results for
+		each one that hits, and returning how many did. The pairs should be
+		sorted by pairType, so that every pair of the same types is tested
+		together. Results must have room for count entries.
+		*/
+		static int BatchIntersection(const PairQuery* pairs, int count, CollisionInfo* results);
+
+		//Does ObjectIntersection send this pair to GJK?
+		static bool UsesGJK(const CollisionVolume& volumeA, const CollisionVolume& volumeB);
 
 		static bool AABBIntersection(	const AABBVolume& volumeA, const Transform& worldTransformA,
 										const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
@@ -97,13 +263,30 @@ namespace NCL {
 		static bool OBBIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
 									const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
 
-		static Vector3 Unproject(const Vector3& screenPos, const Camera& cam);
-
-		static Vector3		UnprojectScreenPosition(Vector3 position, float aspect, float fov, const Camera &c);
-		static Matrix4		GenerateInverseProjection(float aspect, float fov, float nearPlane, float farPlane);
-		static Matrix4		GenerateInverseView(const Camera &c);
+		static bool AABBOBBIntersection(const AABBVolume& volumeA, const Transform& worldTransformA,
+										const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
 
 	protected:
+		/*
+		Runs of sphere and AABB pairs go through these instead, which copy
+		the pairs into batches for the SIMD kernels in CollisionKernels,
+		and only build contacts for the pairs the kernels say touch.
+		*/
+		static int SphereBatchIntersection(const PairQuery* pairs, int count, CollisionInfo* results);
+		static int AABBBatchIntersection(const PairQuery* pairs, int count, CollisionInfo* results);
+		//sphereFirst is for runs where each pair's a is the sphere, and b the AABB
+		static int AABBSphereBatchIntersection(const PairQuery* pairs, int count, CollisionInfo* results, bool sphereFirst);
+
+		//How many contacts CompoundIntersection gathers from the children, before cutting them down
+		static const int MaxCompoundContacts = 32;
+
+		//AABBs and OBBs share this, with AABBs passing in no rotation
+		static bool BoxCapsuleIntersection(const Vector3& boxPosition, const Quaternion& boxOrientation, const Vector3& halfSize,
+			const CapsuleVolume& capsule, const Transform& capsuleTransform, CollisionInfo& collisionInfo);
+
+		//Adds a contact between a point on a capsule's segment and a point on another segment (or a sphere's centre)
+		static bool AddSegmentContact(const Vector3& onA, float radiusA, const Vector3& positionA,
+			const Vector3& onB, float radiusB, const Vector3& positionB, const Vector3& axisA, CollisionInfo& collisionInfo);
 	
 	private:
 		CollisionDetection()	{}
@@ -0,0 +1,217 @@
+#include "CollisionKernels.h"
+
+#ifdef NCL_COLLISION_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+GCC and Clang only let a function use instructions the whole file is
+compiled for, unless it's marked as wanting them. Marking just these
+functions keeps the rest of the program runnable on CPUs without AVX.
+MSVC lets any function use them, so doesn't need telling.
+*/
+#if defined(__GNUC__) || defined(__clang__)
+#define NCL_TARGET_SSE __attribute__((target("sse2")))
+#define NCL_TARGET_AVX __attribute__((target("avx")))
+#else
+#define NCL_TARGET_SSE
+#define NCL_TARGET_AVX
+#endif
+
+/*
+The lanes work through exactly the same sums, in the same order, as
+CollisionDetection's tests for a single pair do, so a pair gets the same
+contact whichever path tested it.
+*/
+#ifdef NCL_COLLISION_KERNELS_X86
+NCL_TARGET_SSE int CollisionKernels::SpheresSSE(const PairBatch& pairs, ContactBatch& contacts) {
+	const __m128 zero	= _mm_setzero_ps();
+	const __m128 one	= _mm_set1_ps(1.0f);
+	int mask = 0;
+
+	for (int i = 0; i < BatchSize; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_load_ps(&pairs.positionB[0][i]), _mm_load_ps(&pairs.positionA[0][i]));
+		__m128 dy = _mm_sub_ps(_mm_load_ps(&pairs.positionB[1][i]), _mm_load_ps(&pairs.positionA[1][i]));
+		__m128 dz = _mm_sub_ps(_mm_load_ps(&pairs.positionB[2][i]), _mm_load_ps(&pairs.positionA[2][i]));
+
+		__m128 radii	= _mm_add_ps(_mm_load_ps(&pairs.sizeA[0][i]), _mm_load_ps(&pairs.sizeB[0][i]));
+		__m128 length	= _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+		//Pairs right on top of each other keep their (zero) delta as the normal
+		__m128 nonZero	= _mm_cmpneq_ps(length, zero);
+		__m128 inverse	= _mm_div_ps(one, length);
+
+		_mm_store_ps(&contacts.normal[0][i], _mm_or_ps(_mm_and_ps(nonZero, _mm_mul_ps(dx, inverse)), _mm_andnot_ps(nonZero, dx)));
+		_mm_store_ps(&contacts.normal[1][i], _mm_or_ps(_mm_and_ps(nonZero, _mm_mul_ps(dy, inverse)), _mm_andnot_ps(nonZero, dy)));
+		_mm_store_ps(&contacts.normal[2][i], _mm_or_ps(_mm_and_ps(nonZero, _mm_mul_ps(dz, inverse)), _mm_andnot_ps(nonZero, dz)));
+		_mm_store_ps(&contacts.penetration[i], _mm_sub_ps(radii, length));
+
+		mask |= _mm_movemask_ps(_mm_cmplt_ps(length, radii)) << i;
+	}
+	return mask;
+}
+
+NCL_TARGET_AVX int CollisionKernels::SpheresAVX(const PairBatch& pairs, ContactBatch& contacts) {
+	const __m256 zero	= _mm256_setzero_ps();
+	const __m256 one	= _mm256_set1_ps(1.0f);
+
+	__m256 dx = _mm256_sub_ps(_mm256_load_ps(pairs.positionB[0]), _mm256_load_ps(pairs.positionA[0]));
+	__m256 dy = _mm256_sub_ps(_mm256_load_ps(pairs.positionB[1]), _mm256_load_ps(pairs.positionA[1]));
+	__m256 dz = _mm256_sub_ps(_mm256_load_ps(pairs.positionB[2]), _mm256_load_ps(pairs.positionA[2]));
+
+	__m256 radii	= _mm256_add_ps(_mm256_load_ps(pairs.sizeA[0]), _mm256_load_ps(pairs.sizeB[0]));
+	__m256 length	= _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+
+	__m256 nonZero	= _mm256_cmp_ps(length, zero, _CMP_NEQ_UQ);
+	__m256 inverse	= _mm256_div_ps(one, length);
+
+	_mm256_store_ps(contacts.normal[0], _mm256_blendv_ps(dx, _mm256_mul_ps(dx, inverse), nonZero));
+	_mm256_store_ps(contacts.normal[1], _mm256_blendv_ps(dy, _mm256_mul_ps(dy, inverse), nonZero));
+	_mm256_store_ps(contacts.normal[2], _mm256_blendv_ps(dz, _mm256_mul_ps(dz, inverse), nonZero));
+	_mm256_store_ps(contacts.penetration, _mm256_sub_ps(radii, length));
+
+	return _mm256_movemask_ps(_mm256_cmp_ps(length, radii, _CMP_LT_OQ));
+}
+
+NCL_TARGET_SSE int CollisionKernels::AABBSpheresSSE(const PairBatch& pairs, ContactBatch& contacts) {
+	const __m128 zero	= _mm_setzero_ps();
+	const __m128 one	= _mm_set1_ps(1.0f);
+	const __m128 sign	= _mm_set1_ps(-0.0f);
+	int mask = 0;
+
+	for (int i = 0; i < BatchSize; i += 4) {
+		__m128 local[3];
+		for (int axis = 0; axis < 3; ++axis) {
+			__m128 delta	= _mm_sub_ps(_mm_load_ps(&pairs.positionB[axis][i]), _mm_load_ps(&pairs.positionA[axis][i]));
+			__m128 size		= _mm_load_ps(&pairs.sizeA[axis][i]);
+			//The closest point on the box to the sphere's centre
+			__m128 closest	= _mm_min_ps(_mm_max_ps(delta, _mm_xor_ps(size, sign)), size);
+			local[axis]		= _mm_sub_ps(delta, closest);
+		}
+		__m128 radius	= _mm_load_ps(&pairs.sizeB[0][i]);
+		__m128 distance	= _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(local[0], local[0]), _mm_mul_ps(local[1], local[1])), _mm_mul_ps(local[2], local[2])));
+
+		__m128 nonZero	= _mm_cmpneq_ps(distance, zero);
+		__m128 inverse	= _mm_div_ps(one, distance);
+
+		for (int axis = 0; axis < 3; ++axis) {
+			_mm_store_ps(&contacts.normal[axis][i],
+				_mm_or_ps(_mm_and_ps(nonZero, _mm_mul_ps(local[axis], inverse)), _mm_andnot_ps(nonZero, local[axis])));
+		}
+		_mm_store_ps(&contacts.penetration[i], _mm_sub_ps(radius, distance));
+
+		mask |= _mm_movemask_ps(_mm_cmplt_ps(distance, radius)) << i;
+	}
+	return mask;
+}
+
+NCL_TARGET_AVX int CollisionKernels::AABBSpheresAVX(const PairBatch& pairs, ContactBatch& contacts) {
+	const __m256 zero	= _mm256_setzero_ps();
+	const __m256 one	= _mm256_set1_ps(1.0f);
+	const __m256 sign	= _mm256_set1_ps(-0.0f);
+
+	__m256 local[3];
+	for (int axis = 0; axis < 3; ++axis) {
+		__m256 delta	= _mm256_sub_ps(_mm256_load_ps(pairs.positionB[axis]), _mm256_load_ps(pairs.positionA[axis]));
+		__m256 size		= _mm256_load_ps(pairs.sizeA[axis]);
+		__m256 closest	= _mm256_min_ps(_mm256_max_ps(delta, _mm256_xor_ps(size, sign)), size);
+		local[axis]		= _mm256_sub_ps(delta, closest);
+	}
+	__m256 radius	= _mm256_load_ps(pairs.sizeB[0]);
+	__m256 distance	= _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(local[0], local[0]), _mm256_mul_ps(local[1], local[1])), _mm256_mul_ps(local[2], local[2])));
+
+	__m256 nonZero	= _mm256_cmp_ps(distance, zero, _CMP_NEQ_UQ);
+	__m256 inverse	= _mm256_div_ps(one, distance);
+
+	for (int axis = 0; axis < 3; ++axis) {
+		_mm256_store_ps(contacts.normal[axis], _mm256_blendv_ps(local[axis], _mm256_mul_ps(local[axis], inverse), nonZero));
+	}
+	_mm256_store_ps(contacts.penetration, _mm256_sub_ps(radius, distance));
+
+	return _mm256_movemask_ps(_mm256_cmp_ps(distance, radius, _CMP_LT_OQ));
+}
+
+NCL_TARGET_SSE int CollisionKernels::AABBsSSE(const PairBatch& pairs) {
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	int mask = 0;
+
+	for (int i = 0; i < BatchSize; i += 4) {
+		__m128 overlap = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int axis = 0; axis < 3; ++axis) {
+			__m128 delta	= _mm_sub_ps(_mm_load_ps(&pairs.positionB[axis][i]), _mm_load_ps(&pairs.positionA[axis][i]));
+			__m128 total	= _mm_add_ps(_mm_load_ps(&pairs.sizeA[axis][i]), _mm_load_ps(&pairs.sizeB[axis][i]));
+			overlap			= _mm_and_ps(overlap, _mm_cmplt_ps(_mm_andnot_ps(sign, delta), total));
+		}
+		mask |= _mm_movemask_ps(overlap) << i;
+	}
+	return mask;
+}
+
+NCL_TARGET_AVX int CollisionKernels::AABBsAVX(const PairBatch& pairs) {
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+
+	__m256 overlap = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	for (int axis = 0; axis < 3; ++axis) {
+		__m256 delta	= _mm256_sub_ps(_mm256_load_ps(pairs.positionB[axis]), _mm256_load_ps(pairs.positionA[axis]));
+		__m256 total	= _mm256_add_ps(_mm256_load_ps(pairs.sizeA[axis]), _mm256_load_ps(pairs.sizeB[axis]));
+		overlap			= _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_andnot_ps(sign, delta), total, _CMP_LT_OQ));
+	}
+	return _mm256_movemask_ps(overlap);
+}
+
+#else
+//Nothing to run these on, and DetectPath never picks them, so they test nothing
+int CollisionKernels::SpheresSSE(const PairBatch& pairs, ContactBatch& contacts)		{ return 0; }
+int CollisionKernels::SpheresAVX(const PairBatch& pairs, ContactBatch& contacts)		{ return 0; }
+int CollisionKernels::AABBSpheresSSE(const PairBatch& pairs, ContactBatch& contacts)	{ return 0; }
+int CollisionKernels::AABBSpheresAVX(const PairBatch& pairs, ContactBatch& contacts)	{ return 0; }
+int CollisionKernels::AABBsSSE(const PairBatch& pairs)	{ return 0; }
+int CollisionKernels::AABBsAVX(const PairBatch& pairs)	{ return 0; }
+#endif
+
+CollisionKernels::Path CollisionKernels::DetectPath() {
+#ifdef NCL_COLLISION_KERNELS_X86
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	bool sse2		= (info[3] & (1 << 26)) != 0;
+	bool osxsave	= (info[2] & (1 << 27)) != 0;
+	bool avx		= (info[2] & (1 << 28)) != 0;
+	//The CPU having AVX isn't enough, the OS has to save the wider registers too
+	if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+		return Path::AVX;
+	}
+	return sse2 ? Path::SSE : Path::Scalar;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx")) {
+		return Path::AVX;
+	}
+	return __builtin_cpu_supports("sse2") ? Path::SSE : Path::Scalar;
+#endif
+#else
+	return Path::Scalar;
+#endif
+}
+
+namespace {
+	CollisionKernels::Path& ActivePath() {
+		static CollisionKernels::Path path = CollisionKernels::DetectPath();
+		return path;
+	}
+}
+
+CollisionKernels::Path CollisionKernels::GetPath() {
+	return ActivePath();
+}
+
+void CollisionKernels::SetPath(Path path) {
+	Path best = DetectPath();
+	ActivePath() = ((int)path > (int)best) ? best : path;
+}
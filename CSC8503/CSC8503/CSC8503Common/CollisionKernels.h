@@ -0,0 +1,70 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NCL_COLLISION_KERNELS_X86 1
+#endif
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Sphere and AABB tests that check a whole batch of pairs at once,
+		using SSE (4 pairs per instruction) or AVX (8 pairs per instruction).
+
+		The CPU can only do that if the numbers for each pair sit next to
+		each other in memory - every pair's x position in one array, then
+		every y, and so on - so CollisionDetection copies each batch of pairs
+		out of their objects into a PairBatch first. The kernels then give
+		back a bitmask of which pairs touch, so that only those need any more
+		work doing on them.
+
+		Not every CPU has AVX (and non-x86 ones have neither), so which
+		kernels get used is worked out when the program starts. The Scalar
+		path skips the kernels entirely, and tests each pair on its own.
+
+		This file is kept free of anything with inline functions, such as
+		the maths classes, so nothing gets compiled for AVX that a CPU
+		without it might end up running.
+		*/
+		namespace CollisionKernels {
+			enum class Path {
+				Scalar,
+				SSE,
+				AVX
+			};
+
+			//The AVX kernels do 8 pairs at a time, and the SSE ones do 2 lots of 4
+			const int BatchSize = 8;
+
+			struct PairBatch {
+				alignas(32) float positionA[3][BatchSize];
+				alignas(32) float positionB[3][BatchSize];
+				alignas(32) float sizeA[3][BatchSize];	//Box half sizes, or a sphere's radius in sizeA[0]
+				alignas(32) float sizeB[3][BatchSize];
+			};
+
+			//The contact normal (pointing from a to b) and penetration of each pair
+			struct ContactBatch {
+				alignas(32) float normal[3][BatchSize];
+				alignas(32) float penetration[BatchSize];
+			};
+
+			//Each kernel returns a mask with a bit set for every pair that touches
+			int SpheresSSE(const PairBatch& pairs, ContactBatch& contacts);
+			int SpheresAVX(const PairBatch& pairs, ContactBatch& contacts);
+
+			int AABBSpheresSSE(const PairBatch& pairs, ContactBatch& contacts);
+			int AABBSpheresAVX(const PairBatch& pairs, ContactBatch& contacts);
+
+			//Box pairs only get their overlap tested, as the manifold needs building one at a time
+			int AABBsSSE(const PairBatch& pairs);
+			int AABBsAVX(const PairBatch& pairs);
+
+			//The best path this CPU can run
+			Path	DetectPath();
+
+			Path	GetPath();
+			//Choosing a path this CPU can't run falls back to the best one it can
+			void	SetPath(Path path);
+		}
+	}
+}
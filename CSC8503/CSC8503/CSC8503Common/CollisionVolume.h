@@ -16,7 +16,7 @@ namespace NCL {
 		CollisionVolume() {
 			type = VolumeType::Invalid;
 		}
-		~CollisionVolume() {}
+		virtual ~CollisionVolume() {}
 
 		VolumeType type;
 	};
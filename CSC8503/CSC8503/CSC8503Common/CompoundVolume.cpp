@@ -0,0 +1,220 @@
+#include "CompoundVolume.h"
+#include "SphereVolume.h"
+#include "OBBVolume.h"
+#include "CapsuleVolume.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace NCL;
+using namespace Maths;
+
+namespace {
+	const float Pi = 3.14159265358979f;
+}
+
+CompoundVolume::CompoundVolume() {
+	type = VolumeType::Compound;
+}
+
+CompoundVolume::~CompoundVolume() {
+	for (Child& c : children) {
+		delete c.volume;
+	}
+}
+
+void CompoundVolume::AddSphere(const Vector3& position, float radius) {
+	AddChild((CollisionVolume*)new SphereVolume(radius), position, Quaternion());
+}
+
+void CompoundVolume::AddBox(const Vector3& position, const Vector3& halfSize, const Quaternion& orientation) {
+	AddChild((CollisionVolume*)new OBBVolume(halfSize), position, orientation);
+}
+
+void CompoundVolume::AddCapsule(const Vector3& position, float halfHeight, float radius, const Quaternion& orientation) {
+	AddChild((CollisionVolume*)new CapsuleVolume(halfHeight, radius), position, orientation);
+}
+
+void CompoundVolume::AddChild(CollisionVolume* volume, const Vector3& position, const Quaternion& orientation) {
+	Child c;
+	c.volume		= volume;
+	c.position		= position;
+	c.orientation	= orientation;
+	UpdateChildBounds(c);
+	children.emplace_back(c);
+}
+
+void CompoundVolume::UpdateChildBounds(Child& c) {
+	Vector3 extent;
+	if (c.volume->type == VolumeType::Sphere) {
+		float r = ((SphereVolume&)*c.volume).GetRadius();
+		extent	= Vector3(r, r, r);
+	}
+	else if (c.volume->type == VolumeType::OBB) {
+		extent = Matrix3(c.orientation).Absolute() * ((OBBVolume&)*c.volume).GetHalfDimensions();
+	}
+	else if (c.volume->type == VolumeType::Capsule) {
+		const CapsuleVolume& capsule = (CapsuleVolume&)*c.volume;
+		float	r		= capsule.GetRadius();
+		Vector3 segment = c.orientation * Vector3(0, std::max(0.0f, capsule.GetHalfHeight() - r), 0);
+		extent = Vector3(std::abs(segment.x), std::abs(segment.y), std::abs(segment.z)) + Vector3(r, r, r);
+	}
+	c.min = c.position - extent;
+	c.max = c.position + extent;
+}
+
+float CompoundVolume::ChildSize(const Child& c) {
+	if (c.volume->type == VolumeType::Sphere) {
+		float r = ((SphereVolume&)*c.volume).GetRadius();
+		return (4.0f / 3.0f) * Pi * r * r * r;
+	}
+	if (c.volume->type == VolumeType::OBB) {
+		Vector3 h = ((OBBVolume&)*c.volume).GetHalfDimensions();
+		return 8.0f * h.x * h.y * h.z;
+	}
+	if (c.volume->type == VolumeType::Capsule) {
+		const CapsuleVolume& capsule = (CapsuleVolume&)*c.volume;
+		float r			= capsule.GetRadius();
+		float length	= 2.0f * std::max(0.0f, capsule.GetHalfHeight() - r);
+		return (Pi * r * r * length) + ((4.0f / 3.0f) * Pi * r * r * r);
+	}
+	return 0.0f;
+}
+
+Vector3 CompoundVolume::ChildInertia(const Child& c, float mass) {
+	if (c.volume->type == VolumeType::Sphere) {
+		float r = ((SphereVolume&)*c.volume).GetRadius();
+		float i = 0.4f * mass * r * r;
+		return Vector3(i, i, i);
+	}
+	if (c.volume->type == VolumeType::OBB) {
+		Vector3 h	= ((OBBVolume&)*c.volume).GetHalfDimensions();
+		Vector3 h2	= h * h;
+		return Vector3(h2.y + h2.z, h2.x + h2.z, h2.x + h2.y) * (mass / 3.0f);
+	}
+	if (c.volume->type == VolumeType::Capsule) {
+		/*
+		A cylinder, plus the two halves of a sphere moved out to its ends.
+		The mass is split between them by how much space each takes up.
+		*/
+		const CapsuleVolume& capsule = (CapsuleVolume&)*c.volume;
+		float r				= capsule.GetRadius();
+		float length		= 2.0f * std::max(0.0f, capsule.GetHalfHeight() - r);
+		float cylinderSize	= Pi * r * r * length;
+		float sphereSize	= (4.0f / 3.0f) * Pi * r * r * r;
+		float cylinderMass	= mass * cylinderSize / (cylinderSize + sphereSize);
+		float sphereMass	= mass - cylinderMass;
+
+		float along		= (0.5f * cylinderMass * r * r) + (0.4f * sphereMass * r * r);
+		float across	= (cylinderMass * ((length * length / 12.0f) + (r * r / 4.0f))) +
+						  (sphereMass * ((0.4f * r * r) + (length * length / 4.0f) + (0.375f * length * r)));
+		return Vector3(across, along, across);
+	}
+	return Vector3();
+}
+
+Vector3 CompoundVolume::GetCentreOfMass() const {
+	Vector3 centre;
+	float	total = 0.0f;
+	for (const Child& c : children) {
+		float size = ChildSize(c);
+		centre += c.position * size;
+		total  += size;
+	}
+	return total > 0.0f ? centre / total : Vector3();
+}
+
+Vector3 CompoundVolume::Recentre() {
+	Vector3 centre = GetCentreOfMass();
+	for (Child& c : children) {
+		c.position -= centre;
+		UpdateChildBounds(c);
+	}
+	if (!nodes.empty()) {
+		Build();
+	}
+	return centre;
+}
+
+/*
+Each child's inertia is turned from its own space into the compound's,
+and then moved out to where it sits with the parallel axis theorem.
+*/
+Matrix3 CompoundVolume::GetInertia(float mass) const {
+	float total = 0.0f;
+	for (const Child& c : children) {
+		total += ChildSize(c);
+	}
+	Matrix3 inertia;
+	inertia.ToZero();
+	if (total <= 0.0f) {
+		return inertia;
+	}
+	for (const Child& c : children) {
+		float	childMass	= mass * ChildSize(c) / total;
+		Matrix3 rotation	= Matrix3(c.orientation);
+		Matrix3 local		= rotation * Matrix3::Scale(ChildInertia(c, childMass)) * rotation.Transposed();
+
+		const Vector3& p	= c.position;
+		float distance		= Vector3::Dot(p, p);
+		for (int row = 0; row < 3; ++row) {
+			for (int col = 0; col < 3; ++col) {
+				float shift = (row == col ? distance : 0.0f) - (p[row] * p[col]);
+				inertia.array[(row * 3) + col] += local.array[(row * 3) + col] + (childMass * shift);
+			}
+		}
+	}
+	return inertia;
+}
+
+void CompoundVolume::Build() {
+	nodes.clear();
+	if (children.empty()) {
+		return;
+	}
+	nodes.reserve(children.size() * 2);
+	nodes.emplace_back();
+	BuildNode(0, 0, (int)children.size(), 0);
+}
+
+/*
+There's only ever a handful of children, so rather than the surface area
+heuristic MeshVolume uses, each node is just split in half along its
+longest axis.
+*/
+void CompoundVolume::BuildNode(int index, int start, int end, int depth) {
+	Vector3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = start; i < end; ++i) {
+		boundsMin = Vector3(std::min(boundsMin.x, children[i].min.x), std::min(boundsMin.y, children[i].min.y), std::min(boundsMin.z, children[i].min.z));
+		boundsMax = Vector3(std::max(boundsMax.x, children[i].max.x), std::max(boundsMax.y, children[i].max.y), std::max(boundsMax.z, children[i].max.z));
+	}
+	nodes[index].min	= boundsMin;
+	nodes[index].max	= boundsMax;
+	nodes[index].start	= start;
+	nodes[index].count	= end - start;
+
+	if (end - start <= MaxLeafChildren || depth >= MaxDepth) {
+		return;
+	}
+	Vector3 size = boundsMax - boundsMin;
+	int		axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+	int		mid	 = (start + end) / 2;
+
+	std::nth_element(children.begin() + start, children.begin() + mid, children.begin() + end,
+		[axis](const Child& a, const Child& b) {
+			return (a.min[axis] + a.max[axis]) < (b.min[axis] + b.max[axis]);
+		});
+
+	int left = (int)nodes.size();
+	nodes.emplace_back();
+	BuildNode(left, start, mid, depth + 1);
+
+	int right = (int)nodes.size();
+	nodes.emplace_back();
+	BuildNode(right, mid, end, depth + 1);
+
+	nodes[index].start = right;
+	nodes[index].count = 0;
+}
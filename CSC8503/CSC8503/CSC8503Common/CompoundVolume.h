@@ -0,0 +1,140 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "../../Common/Vector3.h"
+#include "../../Common/Matrix3.h"
+#include "../../Common/Quaternion.h"
+#include <vector>
+
+namespace NCL {
+	/*
+	A rigid object made of several simpler volumes - spheres, boxes and
+	capsules - each with its own position and orientation relative to the
+	object. It's a single body as far as the physics is concerned, so a
+	table made of a top and four legs costs one body in the solver, rather
+	than five held together with constraints.
+
+	The children are sorted into a small AABB tree when the volume is
+	built, laid out the same way as MeshVolume's, so only the children
+	near whatever the object is being tested against are looked at.
+	*/
+	class CompoundVolume : CollisionVolume
+	{
+	public:
+		CompoundVolume();
+		~CompoundVolume();
+
+		//The compound owns the volumes these create, and deletes them along with itself
+		void AddSphere(const Maths::Vector3& position, float radius);
+		void AddBox(const Maths::Vector3& position, const Maths::Vector3& halfSize, const Maths::Quaternion& orientation = Maths::Quaternion());
+		void AddCapsule(const Maths::Vector3& position, float halfHeight, float radius, const Maths::Quaternion& orientation = Maths::Quaternion());
+
+		/*
+		The physics treats an object's position as its centre of mass, so
+		this moves the children so that their combined centre of mass (all
+		of them being the same density) is on the origin. It returns how far
+		the centre was from the origin, so the object can be moved by that
+		much to stay where it was.
+		*/
+		Maths::Vector3 Recentre();
+
+		//Builds the tree, after all the children are added
+		void Build();
+
+		int GetChildCount() const {
+			return (int)children.size();
+		}
+
+		//Boxes are always OBBVolumes, as they turn with the object
+		const CollisionVolume& GetChildVolume(int index) const {
+			return *children[index].volume;
+		}
+
+		Maths::Vector3 GetChildPosition(int index) const {
+			return children[index].position;
+		}
+
+		Maths::Quaternion GetChildOrientation(int index) const {
+			return children[index].orientation;
+		}
+
+		void GetBounds(Maths::Vector3& outMin, Maths::Vector3& outMax) const {
+			outMin = nodes.empty() ? Maths::Vector3() : nodes[0].min;
+			outMax = nodes.empty() ? Maths::Vector3() : nodes[0].max;
+		}
+
+		//Calls func with the index of every child whose bounds overlap the given box
+		template<class F>
+		void QueryBox(const Maths::Vector3& boxMin, const Maths::Vector3& boxMax, F func) const {
+			if (nodes.empty()) {
+				return;
+			}
+			int stack[MaxDepth + 1];
+			int top = 0;
+			stack[top++] = 0;
+			while (top > 0) {
+				int			index	= stack[--top];
+				const Node& node	= nodes[index];
+				if (node.min.x > boxMax.x || node.max.x < boxMin.x ||
+					node.min.y > boxMax.y || node.max.y < boxMin.y ||
+					node.min.z > boxMax.z || node.max.z < boxMin.z) {
+					continue;
+				}
+				if (node.count > 0) {
+					for (int i = node.start; i < node.start + node.count; ++i) {
+						const Child& c = children[i];
+						if (c.min.x > boxMax.x || c.max.x < boxMin.x ||
+							c.min.y > boxMax.y || c.max.y < boxMin.y ||
+							c.min.z > boxMax.z || c.max.z < boxMin.z) {
+							continue;
+						}
+						func(i);
+					}
+				}
+				else {
+					stack[top++] = node.start;
+					stack[top++] = index + 1;
+				}
+			}
+		}
+
+		/*
+		The inertia tensor about the origin, for the given total mass shared
+		out between the children by their volume. Unlike a single box or
+		sphere, this usually has products of inertia off the diagonal.
+		*/
+		Maths::Matrix3 GetInertia(float mass) const;
+
+		Maths::Vector3 GetCentreOfMass() const;
+
+	protected:
+		struct Child {
+			CollisionVolume*	volume;
+			Maths::Vector3		position;
+			Maths::Quaternion	orientation;
+			Maths::Vector3		min;
+			Maths::Vector3		max;
+		};
+
+		//Same layout as MeshVolume's nodes - a leaf has a count, others have their right child at start
+		struct Node {
+			Maths::Vector3 min;
+			Maths::Vector3 max;
+			int		start;
+			int		count;
+		};
+
+		static const int MaxLeafChildren	= 2;
+		static const int MaxDepth			= 32;
+
+		void AddChild(CollisionVolume* volume, const Maths::Vector3& position, const Maths::Quaternion& orientation);
+		void UpdateChildBounds(Child& child);
+		void BuildNode(int index, int start, int end, int depth);
+
+		//The volume of space a child takes up, and its inertia about its own centre, in its own space
+		static float			ChildSize(const Child& child);
+		static Maths::Vector3	ChildInertia(const Child& child, float mass);
+
+		std::vector<Child>	children;
+		std::vector<Node>	nodes;
+	};
+}
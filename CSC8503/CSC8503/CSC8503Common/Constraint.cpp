@@ -0,0 +1,59 @@
+#include "Constraint.h"
+#include "GameObject.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace NCL;
+using namespace CSC8503;
+
+Constraint::Constraint(GameObject* a, GameObject* b) {
+	objectA			= a;
+	objectB			= b;
+	biasFactor		= 0.2f;
+	lastRowCount	= 0;
+	for (int i = 0; i < MaxRows; ++i) {
+		lastImpulses[i] = 0.0f;
+	}
+}
+
+void Constraint::LinearRow(ConstraintRow& row, const Vector3& axis, const Vector3& relativeA, const Vector3& relativeB, float error, float dt) const {
+	row.linearA		= -axis;
+	row.angularA	= objectA->CanRotate() ? -Vector3::Cross(relativeA, axis) : Vector3();
+	row.linearB		= axis;
+	row.angularB	= objectB->CanRotate() ? Vector3::Cross(relativeB, axis) : Vector3();
+	FinishRow(row, error, dt);
+}
+
+void Constraint::AngularRow(ConstraintRow& row, const Vector3& axis, float error, float dt) const {
+	row.linearA		= Vector3();
+	row.angularA	= objectA->CanRotate() ? -axis : Vector3();
+	row.linearB		= Vector3();
+	row.angularB	= objectB->CanRotate() ? axis : Vector3();
+	FinishRow(row, error, dt);
+}
+
+void Constraint::FinishRow(ConstraintRow& row, float error, float dt) const {
+	PhysicsObject* physA = objectA->GetPhysicsObject();
+	PhysicsObject* physB = objectB->GetPhysicsObject();
+
+	row.physA = physA;
+	row.physB = physB;
+
+	float inverseMassA = physA->GetInverseMass();
+	float inverseMassB = physB->GetInverseMass();
+
+	row.moveA = row.linearA * inverseMassA;
+	row.moveB = row.linearB * inverseMassB;
+	row.turnA = inverseMassA > 0.0f ? physA->GetInertiaTensor() * row.angularA : Vector3();
+	row.turnB = inverseMassB > 0.0f ? physB->GetInertiaTensor() * row.angularB : Vector3();
+
+	float k =	Vector3::Dot(row.linearA, row.moveA) + Vector3::Dot(row.angularA, row.turnA) +
+				Vector3::Dot(row.linearB, row.moveB) + Vector3::Dot(row.angularB, row.turnB);
+
+	row.effectiveMass	= k > 0.0f ? 1.0f / k : 0.0f;
+	row.bias			= (biasFactor / dt) * error;
+	row.lowerImpulse	= -FLT_MAX;
+	row.upperImpulse	= FLT_MAX;
+	row.impulse			= 0.0f;
+}
@@ -1,13 +1,103 @@
 #pragma once
+#include "../../Common/Vector3.h"
 
 namespace NCL {
 	namespace CSC8503 {
+		class GameObject;
+		class PhysicsObject;
+
+		using Maths::Vector3;
+
+		/*
+		A single row of a constraint - one number, such as how far apart two
+		points are along an axis, or how far one object has turned away from
+		another about an axis, that the solver tries to keep at zero.
+
+		The Jacobian says how fast that number changes with each object's
+		linear and angular velocity. Everything the solver needs that doesn't
+		change between iterations is worked out once a step, when the row is
+		built, so each iteration is just a few dot products and a clamp.
+		*/
+		struct ConstraintRow {
+			PhysicsObject*	physA;
+			PhysicsObject*	physB;
+
+			Vector3 linearA;
+			Vector3 angularA;
+			Vector3 linearB;
+			Vector3 angularB;
+
+			//How much each object's velocities change per unit of impulse along the row
+			Vector3 moveA;
+			Vector3 turnA;
+			Vector3 moveB;
+			Vector3 turnB;
+
+			float effectiveMass;
+			float bias;			//Asks for a little extra speed, to fix any error that's built up
+			float lowerImpulse;	//Limits on the total impulse, so a rope can pull but never push
+			float upperImpulse;
+			float impulse;		//The total so far, which is carried over to warm start the next step
+		};
+
+		/*
+		Constraints link two objects, and are made up of rows. Once a step,
+		the physics system asks each constraint to build its rows for where
+		the objects are now, and then solves all of the rows together without
+		needing to call back into the constraint again.
+		*/
 		class Constraint	{
 		public:
-			Constraint() {}
+			static const int MaxRows = 6;
+
+			Constraint(GameObject* a, GameObject* b);
 			virtual ~Constraint() {}
 
-			virtual void UpdateConstraint(float dt) = 0;
+			/*
+			Fills in up to MaxRows rows, and returns how many it used. Some
+			constraints don't always need all of them - a rope that's gone
+			slack doesn't need any.
+			*/
+			virtual int BuildRows(ConstraintRow* rows, float dt) = 0;
+
+			/*
+			The objects a constraint links together. The physics system uses
+			these to work out which island the constraint belongs to, and which
+			other constraints it can be solved at the same time as.
+			*/
+			GameObject* GetObjectA() const {
+				return objectA;
+			}
+			GameObject* GetObjectB() const {
+				return objectB;
+			}
+
+			//How much of the error that builds up is fixed each step, from 0 to 1
+			void SetBiasFactor(float factor) {
+				biasFactor = factor;
+			}
+
+		protected:
+			friend class PhysicsSystem;
+
+			/*
+			Rows for keeping a point on each object (relative to the object's
+			position, in world space) at error apart along an axis, and for
+			keeping the objects from turning relative to each other about one.
+			*/
+			void LinearRow(ConstraintRow& row, const Vector3& axis, const Vector3& relativeA, const Vector3& relativeB, float error, float dt) const;
+			void AngularRow(ConstraintRow& row, const Vector3& axis, float error, float dt) const;
+
+			//Fills in everything else once the Jacobian is set
+			void FinishRow(ConstraintRow& row, float error, float dt) const;
+
+			GameObject*	objectA;
+			GameObject*	objectB;
+			float		biasFactor;
+
+			//What each row ended up pushing with last step
+			float	lastImpulses[MaxRows];
+			int		lastRowCount;
 		};
 	}
-}
\ No newline at end of file
+}
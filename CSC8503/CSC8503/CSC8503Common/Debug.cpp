@@ -2,7 +2,7 @@
 #include "../../Common/Matrix4.h"
 using namespace NCL;
 
-OGLRenderer* Debug::renderer = nullptr;
+DebugDrawer* Debug::renderer = nullptr;
 
 std::vector<Debug::DebugStringEntry>	Debug::stringEntries;
 std::vector<Debug::DebugLineEntry>		Debug::lineEntries;
@@ -56,17 +56,19 @@ void Debug::DrawAxisLines(const Matrix4& modelMatrix, float scaleBoost, float ti
 }
 
 
+//Without a renderer nothing is drawn, but lines still time out as normal
 void Debug::FlushRenderables(float dt) {
-	if (!renderer) {
-		return;
-	}
-	for (const auto& i : stringEntries) {
-		renderer->DrawString(i.data, i.position);
+	if (renderer) {
+		for (const auto& i : stringEntries) {
+			renderer->DrawDebugString(i.data, i.position, i.colour);
+		}
 	}
 	int trim = 0;
 	for (int i = 0; i < lineEntries.size(); ) {
 		DebugLineEntry* e = &lineEntries[i]; 
-		renderer->DrawLine(e->start, e->end, e->colour);
+		if (renderer) {
+			renderer->DrawDebugLine(e->start, e->end, e->colour);
+		}
 		e->time -= dt;
 		if (e->time < 0) {			
 			trim++;				
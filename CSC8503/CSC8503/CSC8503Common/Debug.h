@@ -1,9 +1,28 @@
 #pragma once
-#include "../../Plugins/OpenGLRendering/OGLRenderer.h"
+#include "../../Common/Vector2.h"
+#include "../../Common/Vector3.h"
+#include "../../Common/Vector4.h"
+#include "../../Common/Matrix4.h"
 #include <vector>
 #include <string>
 
 namespace NCL {
+	using namespace NCL::Maths;
+
+	/*
+	Whatever ends up drawing the debug lines and text - usually the game's
+	renderer. The Debug class just keeps hold of what it's been asked to
+	draw, so the code that uses it still runs without any renderer at all,
+	such as on a dedicated server.
+	*/
+	class DebugDrawer {
+	public:
+		virtual ~DebugDrawer() {}
+
+		virtual void DrawDebugString(const std::string& text, const Vector2& pos, const Vector4& colour) = 0;
+		virtual void DrawDebugLine(const Vector3& start, const Vector3& end, const Vector4& colour) = 0;
+	};
+
 	class Debug
 	{
 	public:
@@ -12,7 +31,7 @@ namespace NCL {
 
 		static void DrawAxisLines(const Matrix4 &modelMatrix, float scaleBoost = 1.0f, float time = 0.0f);
 
-		static void SetRenderer(OGLRenderer* r) {
+		static void SetRenderer(DebugDrawer* r) {
 			renderer = r;
 		}
 
@@ -50,7 +69,7 @@ namespace NCL {
 		static std::vector<DebugStringEntry>	stringEntries;
 		static std::vector<DebugLineEntry>	lineEntries;
 
-		static OGLRenderer* renderer;
+		static DebugDrawer* renderer;
 	};
 }
 
@@ -0,0 +1,42 @@
+#include "DistanceConstraint.h"
+#include "GameObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+DistanceConstraint::DistanceConstraint(GameObject* a, GameObject* b, const Vector3& localAnchorA, const Vector3& localAnchorB, float minDistance, float maxDistance)
+	: Constraint(a, b) {
+	anchorA				= localAnchorA;
+	anchorB				= localAnchorB;
+	this->minDistance	= minDistance;
+	this->maxDistance	= maxDistance;
+}
+
+int DistanceConstraint::BuildRows(ConstraintRow* rows, float dt) {
+	const Transform& transformA = objectA->GetTransform();
+	const Transform& transformB = objectB->GetTransform();
+
+	Vector3 relativeA	= transformA.GetOrientation() * anchorA;
+	Vector3 relativeB	= transformB.GetOrientation() * anchorB;
+	Vector3 offset		= (transformB.GetPosition() + relativeB) - (transformA.GetPosition() + relativeA);
+	float	length		= offset.Length();
+	Vector3 axis		= length > 0.0001f ? offset / length : Vector3(0, 1, 0);
+
+	if (minDistance == maxDistance) {
+		LinearRow(rows[0], axis, relativeA, relativeB, length - minDistance, dt);
+		return 1;
+	}
+	//A rope that's gone taut can only pull the ends together...
+	if (length > maxDistance) {
+		LinearRow(rows[0], axis, relativeA, relativeB, length - maxDistance, dt);
+		rows[0].upperImpulse = 0.0f;
+		return 1;
+	}
+	//...and a strut can only push them apart
+	if (length < minDistance) {
+		LinearRow(rows[0], axis, relativeA, relativeB, length - minDistance, dt);
+		rows[0].lowerImpulse = 0.0f;
+		return 1;
+	}
+	return 0;
+}
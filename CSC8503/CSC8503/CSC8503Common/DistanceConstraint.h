@@ -0,0 +1,28 @@
+#pragma once
+#include "Constraint.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Keeps a point on each object between a minimum and maximum distance
+		apart. With both the same it's a rigid rod, with only a maximum it's
+		a rope that can go slack, and with only a minimum it keeps things
+		from getting too close.
+
+		The anchors are given in each object's own space, so they turn with it.
+		*/
+		class DistanceConstraint : public Constraint {
+		public:
+			DistanceConstraint(GameObject* a, GameObject* b, const Vector3& localAnchorA, const Vector3& localAnchorB, float minDistance, float maxDistance);
+			~DistanceConstraint() {}
+
+			int BuildRows(ConstraintRow* rows, float dt) override;
+
+		protected:
+			Vector3 anchorA;
+			Vector3 anchorB;
+			float	minDistance;
+			float	maxDistance;
+		};
+	}
+}
@@ -0,0 +1,447 @@
+#include "GJK.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace NCL;
+using namespace Maths;
+using namespace CSC8503;
+
+const int	maxGJKIterations	= 64;
+const int	maxEPAIterations	= 64;
+//EPA stops once a new support point gets the polytope no closer to the surface than this
+const float	epaTolerance		= 1e-4f;
+
+//Directions shorter than this mean the origin is right on the simplex
+const float	directionEpsilon	= 1e-12f;
+//How far from a face of the final tetrahedron the origin can be and still count as on it
+const float	faceEpsilon			= 1e-5f;
+
+Vector3 GJK::Support(const CollisionVolume& volume, const Transform& worldTransform, const Vector3& direction) {
+	Vector3 position = worldTransform.GetPosition();
+
+	switch (volume.type) {
+		case VolumeType::AABB: {
+			Vector3 half = ((const AABBVolume&)volume).GetHalfDimensions();
+			return position + Vector3(
+				direction.x >= 0.0f ? half.x : -half.x,
+				direction.y >= 0.0f ? half.y : -half.y,
+				direction.z >= 0.0f ? half.z : -half.z);
+		}
+		case VolumeType::OBB: {
+			Vector3		half		= ((const OBBVolume&)volume).GetHalfDimensions();
+			Quaternion	orientation = worldTransform.GetOrientation();
+			Vector3		local		= orientation.Conjugate() * direction;
+			Vector3		corner(
+				local.x >= 0.0f ? half.x : -half.x,
+				local.y >= 0.0f ? half.y : -half.y,
+				local.z >= 0.0f ? half.z : -half.z);
+			return position + orientation * corner;
+		}
+		case VolumeType::Sphere: {
+			float radius = ((const SphereVolume&)volume).GetRadius();
+			float length = direction.Length();
+			if (length == 0.0f) {
+				return position + Vector3(radius, 0, 0);
+			}
+			return position + direction * (radius / length);
+		}
+		case VolumeType::Capsule: {
+			//A capsule is a sphere swept along its local y axis
+			const CapsuleVolume& capsule = (const CapsuleVolume&)volume;
+			float	radius		= capsule.GetRadius();
+			float	segmentHalf	= std::max(0.0f, capsule.GetHalfHeight() - radius);
+			Vector3 up			= worldTransform.GetOrientation() * Vector3(0, 1, 0);
+			Vector3 end			= position + up * (Vector3::Dot(direction, up) >= 0.0f ? segmentHalf : -segmentHalf);
+
+			float length = direction.Length();
+			if (length == 0.0f) {
+				return end;
+			}
+			return end + direction * (radius / length);
+		}
+		default:
+			return position;
+	}
+}
+
+bool GJK::IsConvex(const CollisionVolume& volume) {
+	return	volume.type == VolumeType::AABB		||
+			volume.type == VolumeType::OBB		||
+			volume.type == VolumeType::Sphere	||
+			volume.type == VolumeType::Capsule;
+}
+
+GJK::SupportPoint GJK::Shapes::GetSupport(const Vector3& direction) const {
+	SupportPoint p;
+	p.onA	= GJK::Support(volumeA, transformA, direction);
+	p.onB	= GJK::Support(volumeB, transformB, -direction);
+	p.point = p.onA - p.onB;
+	return p;
+}
+
+bool GJK::Intersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB,
+	CollisionDetection::CollisionInfo& collisionInfo, SimplexCache* cache) {
+
+	Shapes shapes = { volumeA, worldTransformA, volumeB, worldTransformB };
+
+	Simplex s;
+	if (!EnclosesOrigin(shapes, s, cache)) {
+		return false;
+	}
+	if (!ExpandPolytope(shapes, s, collisionInfo)) {
+		return false;
+	}
+	if (cache) {
+		//If they come apart, it'll most likely be along the way they're being pushed
+		cache->direction	= collisionInfo.points[collisionInfo.pointCount - 1].normal;
+		cache->hasDirection = true;
+	}
+	return true;
+}
+
+bool GJK::Overlap(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB) {
+
+	Shapes shapes = { volumeA, worldTransformA, volumeB, worldTransformB };
+
+	Simplex s;
+	return EnclosesOrigin(shapes, s, nullptr);
+}
+
+bool GJK::EnclosesOrigin(const Shapes& shapes, Simplex& s, SimplexCache* cache) {
+	Vector3 direction = shapes.transformA.GetPosition() - shapes.transformB.GetPosition();
+	if (cache && cache->hasDirection) {
+		direction = cache->direction;
+	}
+	if (direction.LengthSquared() < directionEpsilon) {
+		direction = Vector3(1, 0, 0);
+	}
+
+	s.points[0] = shapes.GetSupport(direction);
+	s.count		= 1;
+
+	//Nothing of the difference shape reaches past the origin, so this direction separates them
+	if (Vector3::Dot(s.points[0].point, direction) < 0.0f) {
+		if (cache) {
+			cache->direction	= direction;
+			cache->hasDirection = true;
+		}
+		return false;
+	}
+	direction = -s.points[0].point;
+
+	for (int i = 0; i < maxGJKIterations; ++i) {
+		if (direction.LengthSquared() < directionEpsilon) {
+			//Only just touching - there's nothing to push apart
+			return false;
+		}
+		SupportPoint p = shapes.GetSupport(direction);
+		if (Vector3::Dot(p.point, direction) < 0.0f) {
+			if (cache) {
+				cache->direction	= direction;
+				cache->hasDirection = true;
+			}
+			return false;
+		}
+		s.points[s.count++] = p;
+
+		if (UpdateSimplex(s, direction)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+Each of these looks at which part of the simplex is nearest the origin,
+throws away the points that aren't needed to describe it, and points the
+search direction from there towards the origin. The newest point is
+always the last one. Only the tetrahedron can hold the origin.
+*/
+bool GJK::UpdateSimplex(Simplex& s, Vector3& direction) {
+	switch (s.count) {
+		case 2: return UpdateLine(s, direction);
+		case 3: return UpdateTriangle(s, direction);
+		case 4: return UpdateTetrahedron(s, direction);
+	}
+	return false;
+}
+
+bool GJK::UpdateLine(Simplex& s, Vector3& direction) {
+	SupportPoint a = s.points[1];
+	SupportPoint b = s.points[0];
+
+	Vector3 ab = b.point - a.point;
+	Vector3 ao = -a.point;
+
+	if (Vector3::Dot(ab, ao) > 0.0f) {
+		direction = Vector3::Cross(Vector3::Cross(ab, ao), ab);
+		if (direction.LengthSquared() < directionEpsilon) {
+			//The origin is on the line, so any direction at right angles to it will do
+			direction = Vector3::Cross(ab, std::abs(ab.x) < 0.5f ? Vector3(1, 0, 0) : Vector3(0, 1, 0));
+		}
+	}
+	else {
+		s.points[0] = a;
+		s.count		= 1;
+		direction	= ao;
+	}
+	return false;
+}
+
+bool GJK::UpdateTriangle(Simplex& s, Vector3& direction) {
+	SupportPoint a = s.points[2];
+	SupportPoint b = s.points[1];
+	SupportPoint c = s.points[0];
+
+	Vector3 ab	= b.point - a.point;
+	Vector3 ac	= c.point - a.point;
+	Vector3 ao	= -a.point;
+	Vector3 abc = Vector3::Cross(ab, ac);
+
+	if (Vector3::Dot(Vector3::Cross(abc, ac), ao) > 0.0f) {
+		if (Vector3::Dot(ac, ao) > 0.0f) {
+			s.points[0] = c;
+			s.points[1] = a;
+			s.count		= 2;
+			direction	= Vector3::Cross(Vector3::Cross(ac, ao), ac);
+			return false;
+		}
+		s.points[0] = b;
+		s.points[1] = a;
+		s.count		= 2;
+		return UpdateLine(s, direction);
+	}
+	if (Vector3::Dot(Vector3::Cross(ab, abc), ao) > 0.0f) {
+		s.points[0] = b;
+		s.points[1] = a;
+		s.count		= 2;
+		return UpdateLine(s, direction);
+	}
+	//Above or below the triangle - keep the winding so the next point is added on its front
+	if (Vector3::Dot(abc, ao) > 0.0f) {
+		direction = abc;
+	}
+	else {
+		s.points[0] = b;
+		s.points[1] = c;
+		direction	= -abc;
+	}
+	return false;
+}
+
+bool GJK::UpdateTetrahedron(Simplex& s, Vector3& direction) {
+	SupportPoint a = s.points[3];
+	SupportPoint b = s.points[2];
+	SupportPoint c = s.points[1];
+	SupportPoint d = s.points[0];
+
+	Vector3 ab = b.point - a.point;
+	Vector3 ac = c.point - a.point;
+	Vector3 ad = d.point - a.point;
+	Vector3 ao = -a.point;
+
+	Vector3 abc = Vector3::Cross(ab, ac);
+	Vector3 acd = Vector3::Cross(ac, ad);
+	Vector3 adb = Vector3::Cross(ad, ab);
+
+	/*
+	The face opposite a was the last triangle, which the origin was already
+	in front of. An origin right on one of the other faces counts as inside,
+	as otherwise rounding can make GJK bounce between two tetrahedra forever.
+	*/
+	if (Vector3::Dot(abc, ao) > faceEpsilon * abc.Length()) {
+		s.points[0] = c; s.points[1] = b; s.points[2] = a;
+		s.count = 3;
+		return UpdateTriangle(s, direction);
+	}
+	if (Vector3::Dot(acd, ao) > faceEpsilon * acd.Length()) {
+		s.points[0] = d; s.points[1] = c; s.points[2] = a;
+		s.count = 3;
+		return UpdateTriangle(s, direction);
+	}
+	if (Vector3::Dot(adb, ao) > faceEpsilon * adb.Length()) {
+		s.points[0] = b; s.points[1] = d; s.points[2] = a;
+		s.count = 3;
+		return UpdateTriangle(s, direction);
+	}
+	return true;
+}
+
+/*
+EPA keeps a convex polytope of support points around the origin, and
+repeatedly pushes out its face nearest the origin with a new support
+point, until the face can't be pushed any further - at which point it's
+on the surface of the difference shape, and its distance from the origin
+is the penetration depth.
+
+Everything lives in fixed size arrays on the stack. Curved volumes could
+in theory need any number of points to describe exactly, so the search
+is capped, and takes the best face found so far if it runs out of room.
+*/
+const int maxEPAPoints	= maxEPAIterations + 4;
+const int maxEPAFaces	= maxEPAPoints * 2;
+
+struct EPAFace {
+	int		a, b, c;
+	Vector3 normal;
+	float	distance;
+};
+
+/*
+Faces are turned to point away from a point inside the polytope, rather
+than from the origin - the origin can end up right on a face, which would
+leave which way the face points down to rounding error.
+*/
+static bool MakeFace(const Vector3* points, int a, int b, int c, const Vector3& inside, EPAFace& face) {
+	Vector3 normal	= Vector3::Cross(points[b] - points[a], points[c] - points[a]);
+	float	length	= normal.Length();
+	if (length < 1e-8f) {
+		return false;
+	}
+	face.a		= a;
+	face.b		= b;
+	face.c		= c;
+	face.normal	= normal / length;
+
+	if (Vector3::Dot(face.normal, points[a] - inside) < 0.0f) {
+		face.b		= c;
+		face.c		= b;
+		face.normal	= -face.normal;
+	}
+	face.distance = Vector3::Dot(face.normal, points[a]);
+	return true;
+}
+
+bool GJK::ExpandPolytope(const Shapes& shapes, const Simplex& s, CollisionDetection::CollisionInfo& collisionInfo) {
+	SupportPoint	support[maxEPAPoints];
+	Vector3			points[maxEPAPoints];
+	EPAFace			faces[maxEPAFaces];
+	int				pointCount	= 0;
+	int				faceCount	= 0;
+
+	for (int i = 0; i < 4; ++i) {
+		support[pointCount]	= s.points[i];
+		points[pointCount]	= s.points[i].point;
+		pointCount++;
+	}
+	//Adding points only ever grows the polytope, so the middle of the tetrahedron stays inside it
+	Vector3 inside = (points[0] + points[1] + points[2] + points[3]) * 0.25f;
+
+	const int startFaces[4][3] = { {0, 1, 2}, {0, 3, 1}, {0, 2, 3}, {1, 3, 2} };
+	for (int i = 0; i < 4; ++i) {
+		if (MakeFace(points, startFaces[i][0], startFaces[i][1], startFaces[i][2], inside, faces[faceCount])) {
+			faceCount++;
+		}
+	}
+	if (faceCount < 4) {
+		return false; //The tetrahedron is flat, so the origin is only just on the surface
+	}
+
+	int closest = 0;
+	for (int iteration = 0; iteration < maxEPAIterations; ++iteration) {
+		closest = 0;
+		for (int i = 1; i < faceCount; ++i) {
+			if (faces[i].distance < faces[closest].distance) {
+				closest = i;
+			}
+		}
+		EPAFace		face	= faces[closest];
+		SupportPoint p		= shapes.GetSupport(face.normal);
+		float		reach	= Vector3::Dot(p.point, face.normal);
+
+		if (reach - face.distance < epaTolerance || pointCount == maxEPAPoints) {
+			break;
+		}
+
+		/*
+		Remove every face the new point can see, keeping track of the edges
+		around the hole that leaves. Edges shared by two removed faces are
+		seen twice and cancel out, leaving just the rim of the hole.
+		*/
+		int edges[maxEPAFaces * 3][2];
+		int edgeCount = 0;
+		for (int i = 0; i < faceCount; ) {
+			if (Vector3::Dot(faces[i].normal, p.point - points[faces[i].a]) > 0.0f) {
+				int faceEdges[3][2] = { {faces[i].a, faces[i].b}, {faces[i].b, faces[i].c}, {faces[i].c, faces[i].a} };
+				for (int e = 0; e < 3; ++e) {
+					bool shared = false;
+					for (int j = 0; j < edgeCount; ++j) {
+						if (edges[j][0] == faceEdges[e][1] && edges[j][1] == faceEdges[e][0]) {
+							edges[j][0] = edges[edgeCount - 1][0];
+							edges[j][1] = edges[edgeCount - 1][1];
+							edgeCount--;
+							shared = true;
+							break;
+						}
+					}
+					if (!shared) {
+						edges[edgeCount][0] = faceEdges[e][0];
+						edges[edgeCount][1] = faceEdges[e][1];
+						edgeCount++;
+					}
+				}
+				faces[i] = faces[--faceCount];
+			}
+			else {
+				++i;
+			}
+		}
+		if (faceCount + edgeCount > maxEPAFaces) {
+			break;
+		}
+
+		support[pointCount]	= p;
+		points[pointCount]	= p.point;
+		int newPoint		= pointCount++;
+
+		for (int e = 0; e < edgeCount; ++e) {
+			if (MakeFace(points, edges[e][0], edges[e][1], newPoint, inside, faces[faceCount])) {
+				faceCount++;
+			}
+		}
+		if (faceCount == 0) {
+			return false;
+		}
+	}
+
+	closest = 0;
+	for (int i = 1; i < faceCount; ++i) {
+		if (faces[i].distance < faces[closest].distance) {
+			closest = i;
+		}
+	}
+	const EPAFace& face = faces[closest];
+
+	/*
+	The nearest point on the face to the origin, as a mix of its corners,
+	gives the same mix of the points on a and b that made those corners.
+	*/
+	Vector3 p	= face.normal * face.distance;
+	Vector3 v0	= points[face.b] - points[face.a];
+	Vector3 v1	= points[face.c] - points[face.a];
+	Vector3 v2	= p - points[face.a];
+
+	float d00	= Vector3::Dot(v0, v0);
+	float d01	= Vector3::Dot(v0, v1);
+	float d11	= Vector3::Dot(v1, v1);
+	float d20	= Vector3::Dot(v2, v0);
+	float d21	= Vector3::Dot(v2, v1);
+	float denom = d00 * d11 - d01 * d01;
+
+	float v = 0.0f;
+	float w = 0.0f;
+	if (std::abs(denom) > 1e-12f) {
+		v = (d11 * d20 - d01 * d21) / denom;
+		w = (d00 * d21 - d01 * d20) / denom;
+	}
+	float u = 1.0f - v - w;
+
+	Vector3 onA = support[face.a].onA * u + support[face.b].onA * v + support[face.c].onA * w;
+	Vector3 onB = support[face.a].onB * u + support[face.b].onB * v + support[face.c].onB * w;
+
+	collisionInfo.AddContactPoint(onA - shapes.transformA.GetPosition(), onB - shapes.transformB.GetPosition(), face.normal, face.distance);
+	return true;
+}
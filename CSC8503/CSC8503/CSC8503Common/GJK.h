@@ -0,0 +1,85 @@
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A collision test that works for any pair of convex volumes, as long
+		as we can ask each one for its furthest point in a given direction
+		(its 'support' point).
+
+		GJK works on the shape you get by subtracting every point of b from
+		every point of a. The volumes overlap if and only if that shape holds
+		the origin, and GJK hunts for the origin by building up a simplex
+		(a point, line, triangle, then tetrahedron) of support points around
+		it. If they do overlap, EPA then grows the tetrahedron out towards
+		the surface of the shape, until it finds the face nearest the origin
+		- which gives the contact normal and penetration depth.
+
+		Bodies don't move much from one frame to the next, so the direction GJK
+		finished searching in last frame is usually a good place to start again.
+		For a pair that's apart, it's normally still an axis that separates them,
+		so GJK can stop after a single support point. Keeping one SimplexCache
+		per pair lets GJK pick up from there rather than starting from scratch.
+		*/
+		struct SimplexCache {
+			Vector3 direction;
+			bool	hasDirection	= false;
+			int		lastUsed		= 0;	//For the owner to throw away caches that are no longer needed
+		};
+
+		class GJK {
+		public:
+			//The furthest point of the volume, in world space, along the given direction
+			static Vector3 Support(const CollisionVolume& volume, const Transform& worldTransform, const Vector3& direction);
+
+			//Can the volume be used with GJK? Meshes and compounds aren't convex, so can't
+			static bool IsConvex(const CollisionVolume& volume);
+
+			//On a hit, the contact normal points from a towards b
+			static bool Intersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+									 const CollisionVolume& volumeB, const Transform& worldTransformB,
+									 CollisionDetection::CollisionInfo& collisionInfo, SimplexCache* cache = nullptr);
+
+			//Just whether they overlap, without working out how far or which way to push them apart
+			static bool Overlap(const CollisionVolume& volumeA, const Transform& worldTransformA,
+								const CollisionVolume& volumeB, const Transform& worldTransformB);
+
+		protected:
+			//A point on the difference shape, and the points on a and b it came from
+			struct SupportPoint {
+				Vector3 point;
+				Vector3 onA;
+				Vector3 onB;
+			};
+
+			struct Simplex {
+				SupportPoint	points[4];
+				int				count = 0;
+			};
+
+			struct Shapes {
+				const CollisionVolume&	volumeA;
+				const Transform&		transformA;
+				const CollisionVolume&	volumeB;
+				const Transform&		transformB;
+
+				SupportPoint GetSupport(const Vector3& direction) const;
+			};
+
+			//Runs GJK until the simplex holds the origin (returning true), or it finds they're apart
+			static bool EnclosesOrigin(const Shapes& shapes, Simplex& s, SimplexCache* cache);
+
+			static bool UpdateSimplex(Simplex& s, Vector3& direction);
+			static bool UpdateLine(Simplex& s, Vector3& direction);
+			static bool UpdateTriangle(Simplex& s, Vector3& direction);
+			static bool UpdateTetrahedron(Simplex& s, Vector3& direction);
+
+			static bool ExpandPolytope(const Shapes& shapes, const Simplex& s, CollisionDetection::CollisionInfo& collisionInfo);
+
+		private:
+			GJK()	{}
+			~GJK()	{}
+		};
+	}
+}
@@ -7,6 +7,9 @@ GameObject::GameObject(string objectName)	{
 	name			= objectName;
 	tag				= "Default";
 	worldID			= -1;
+	broadphaseProxy	= -1;
+	layer			= 0;
+	collisionMask	= 0xFFFFFFFF;
 	isActive		= true;
 	boundingVolume	= nullptr;
 	physicsObject	= nullptr;
@@ -44,9 +47,26 @@ void GameObject::UpdateBroadphaseAABB() {
 		Vector3 halfSizes = ((OBBVolume&)*boundingVolume).GetHalfDimensions();
 		broadphaseAABB = mat * halfSizes;
 	}
+	else if (boundingVolume->type == VolumeType::Capsule) {
+		const CapsuleVolume& capsule = (CapsuleVolume&)*boundingVolume;
+		float	r		= capsule.GetRadius();
+		Vector3 up		= transform.GetOrientation() * Vector3(0, 1, 0);
+		Vector3 segment = up * std::max(0.0f, capsule.GetHalfHeight() - r);
+		broadphaseAABB = Vector3(std::abs(segment.x), std::abs(segment.y), std::abs(segment.z)) + Vector3(r, r, r);
+	}
+	else if (boundingVolume->type == VolumeType::Mesh || boundingVolume->type == VolumeType::Compound) {
+		//The broadphase box is centred on the object, but these needn't be, so it has to reach the furthest side
+		Vector3 boundsMin, boundsMax;
+		CollisionDetection::VolumeBounds(*boundingVolume, transform, boundsMin, boundsMax);
+		Vector3 position = transform.GetPosition();
+		broadphaseAABB = Vector3(
+			std::max(position.x - boundsMin.x, boundsMax.x - position.x),
+			std::max(position.y - boundsMin.y, boundsMax.y - position.y),
+			std::max(position.z - boundsMin.z, boundsMax.z - position.z));
+	}
 }
 
-bool GameObject::OnTriggerEnter(vector<GameObject*> objs, string name)
+bool GameObject::OnTriggerEnter(const vector<GameObject*>& objs, const string& name)
 {
 	std::vector <GameObject*>::const_iterator first;
 	std::vector <GameObject*>::const_iterator last;
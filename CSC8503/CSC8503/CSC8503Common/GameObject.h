@@ -6,6 +6,7 @@
 #include "RenderObject.h"
 
 #include <vector>
+#include <assert.h>
 
 using std::vector;
 
@@ -41,6 +42,24 @@ namespace NCL {
 				return physicsObject;
 			}
 
+			/*
+			Whether the object can move this step - either it's awake and can
+			be pushed around, or it's something like a moving platform that has
+			a velocity of its own. Things that are asleep can't, or a pile of
+			them (or a weight hanging from a rope) would never get to sleep.
+			*/
+			bool CanMove() const {
+				return	physicsObject && (
+						(physicsObject->GetInverseMass() > 0.0f && !physicsObject->IsAsleep()) ||
+						physicsObject->GetLinearVelocity() != Vector3() ||
+						physicsObject->GetAngularVelocity() != Vector3());
+			}
+
+			//Axis aligned boxes can't turn, so nothing pushing or pulling on them should try to turn them
+			bool CanRotate() const {
+				return boundingVolume == nullptr || boundingVolume->type != VolumeType::AABB;
+			}
+
 			void SetRenderObject(RenderObject* newObject) {
 				renderObject = newObject;
 			}
@@ -57,6 +76,10 @@ namespace NCL {
 				//std::cout << "OnCollisionBegin event occured!\n";
 			}
 
+			//Called every frame after the first that the objects are still touching
+			virtual void OnCollisionPersist(GameObject* otherObject) {
+			}
+
 			virtual void OnCollisionEnd(GameObject* otherObject) {
 				//std::cout << "OnCollisionEnd event occured!\n";
 			}
@@ -73,17 +96,62 @@ namespace NCL {
 				return worldID;
 			}
 
+			void SetBroadphaseProxy(int newProxy) {
+				broadphaseProxy = newProxy;
+			}
+
+			int		GetBroadphaseProxy() const {
+				return broadphaseProxy;
+			}
+
+			/*
+			Which of the 32 layers the object is on. Raycasts and other queries
+			take a mask of the layers they should see. A layer outside 0 to 31
+			is rejected, and the object stays on the layer it was on.
+			*/
+			static const int LayerCount = 32;
+
+			void SetLayer(int newLayer) {
+				assert(newLayer >= 0 && newLayer < LayerCount);
+				if (newLayer < 0 || newLayer >= LayerCount) {
+					return;
+				}
+				layer = newLayer;
+			}
+
+			int GetLayer() const {
+				return layer;
+			}
+
+			unsigned int GetLayerBit() const {
+				return 1u << layer;
+			}
+
+			/*
+			Which layers the object's allowed to collide with. Both objects in
+			a pair have to allow the other's layer, as does the physics
+			system's table of which layers collide, or they pass straight
+			through each other without ever being tested.
+			*/
+			void SetCollisionMask(unsigned int mask) {
+				collisionMask = mask;
+			}
+
+			unsigned int GetCollisionMask() const {
+				return collisionMask;
+			}
+
 			void SetTag(string objectTag)
 			{
 				tag = objectTag;
 			}
 
-			string GetTag() const
+			const string& GetTag() const
 			{
 				return tag;
 			}
 
-			bool OnTriggerEnter(vector<GameObject*> objs, string name);
+			bool OnTriggerEnter(const vector<GameObject*>& objs, const string& name);
 
 			GameObject* GetTriggerObj()
 			{
@@ -103,6 +171,9 @@ namespace NCL {
 
 			bool	isActive;
 			int		worldID;
+			int		broadphaseProxy;
+			int		layer;
+			unsigned int collisionMask;
 			string	name;
 			string	tag;
 
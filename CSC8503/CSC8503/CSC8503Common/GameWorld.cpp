@@ -13,15 +13,31 @@ GameWorld::GameWorld()	{
 
 	shuffleConstraints	= false;
 	shuffleObjects		= false;
+	deterministic		= false;
 	worldIDCounter		= 0;
+	objectListVersion	= 0;
 }
 
 GameWorld::~GameWorld()	{
+	Clear();
 }
 
+/*
+Objects that leave the world without being deleted take their physics
+state back with them, so the world's body store only ever holds the
+objects that are in it.
+*/
 void GameWorld::Clear() {
+	for (auto& i : gameObjects) {
+		i->SetBroadphaseProxy(-1);
+		if (i->GetPhysicsObject()) {
+			i->GetPhysicsObject()->SetBodyStore(RigidBodyStore::Unattached());
+		}
+	}
 	gameObjects.clear();
 	constraints.clear();
+	broadphaseTree.Clear();
+	objectListVersion++;
 }
 
 void GameWorld::ClearAndErase() {
@@ -31,19 +47,45 @@ void GameWorld::ClearAndErase() {
 	for (auto& i : constraints) {
 		delete i;
 	}
+	gameObjects.clear();
 	Clear();
 }
 
+/*
+Objects are added to the broadphase tree as soon as they enter the world,
+using whatever transform they have at that point. The physics system then
+only moves those that can actually move, so static level geometry is never
+touched again after it has been loaded.
+*/
 void GameWorld::AddGameObject(GameObject* o) {
 	gameObjects.emplace_back(o);
 	o->SetWorldID(worldIDCounter++);
+	objectListVersion++;
+
+	if (o->GetPhysicsObject()) {
+		o->GetPhysicsObject()->SetBodyStore(bodyStore);
+	}
+
+	Vector3 halfSizes;
+	o->UpdateBroadphaseAABB();
+	if (o->GetBroadphaseAABB(halfSizes)) {
+		o->SetBroadphaseProxy(broadphaseTree.Insert(o, o->GetTransform().GetPosition(), halfSizes));
+	}
 }
 
 void GameWorld::RemoveGameObject(GameObject* o, bool andDelete) {
 	gameObjects.erase(std::remove(gameObjects.begin(), gameObjects.end(), o), gameObjects.end());
+	objectListVersion++;
+	if (o->GetBroadphaseProxy() != -1) {
+		broadphaseTree.Remove(o->GetBroadphaseProxy());
+		o->SetBroadphaseProxy(-1);
+	}
 	if (andDelete) {
 		delete o;
 	}
+	else if (o->GetPhysicsObject()) {
+		o->GetPhysicsObject()->SetBodyStore(RigidBodyStore::Unattached());
+	}
 }
 
 void GameWorld::GetObjectIterators(
@@ -61,47 +103,183 @@ void GameWorld::OperateOnContents(GameObjectFunc f) {
 }
 
 void GameWorld::UpdateWorld(float dt) {
-	if (shuffleObjects) {
+	if (shuffleObjects && !deterministic) {
 		std::random_shuffle(gameObjects.begin(), gameObjects.end());
 	}
 
-	if (shuffleConstraints) {
+	if (shuffleConstraints && !deterministic) {
 		std::random_shuffle(constraints.begin(), constraints.end());
 	}
 }
 
-bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObject) const {
-	//The simplest raycast just goes through each object and sees if there's a collision
+/*
+The tree only knows about fat boxes, so each object it gives back still
+has its own volume tested. Once something is hit, the tree only carries on
+looking for anything closer - or stops altogether if any hit will do.
+*/
+bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObject, unsigned int layerMask) const {
 	RayCollision collision;
+	collision.rayDistance = closestCollision.rayDistance;
 
-	for (auto& i : gameObjects) {
-		if (!i->GetBoundingVolume()) { //objects might not be collideable etc...
-			continue;
+	broadphaseTree.RayCast(r.GetPosition(), r.GetDirection(), collision.rayDistance, [&](GameObject* o, float maxDistance) {
+		if (!(o->GetLayerBit() & layerMask)) {
+			return maxDistance;
 		}
 		RayCollision thisCollision;
-		if (CollisionDetection::RayIntersection(r, *i, thisCollision)) {
-				
-			if (!closestObject) {	
-				closestCollision		= collision;
-				closestCollision.node = i;
-				return true;
-			}
-			else {
-				if (thisCollision.rayDistance < collision.rayDistance) {
-					thisCollision.node = i;
-					collision = thisCollision;
-				}
-			}
+		if (!CollisionDetection::RayIntersection(r, *o, thisCollision) || thisCollision.rayDistance > maxDistance) {
+			return maxDistance;
 		}
-	}
+		thisCollision.node	= o;
+		collision			= thisCollision;
+		return closestObject ? thisCollision.rayDistance : 0.0f;
+	});
 	if (collision.node) {
-		closestCollision		= collision;
-		closestCollision.node	= collision.node;
+		closestCollision = collision;
 		return true;
 	}
 	return false;
 }
 
+int GameWorld::RaycastBatch(const Ray* rays, int count, RayCollision* results, unsigned int layerMask) const {
+	const int packetSize = AABBTree<GameObject*>::PacketSize;
+
+	Vector3 origins[packetSize];
+	Vector3 directions[packetSize];
+	float	distances[packetSize];
+
+	int hitCount = 0;
+	for (int first = 0; first < count; first += packetSize) {
+		int packetCount = std::min(packetSize, count - first);
+		for (int i = 0; i < packetCount; ++i) {
+			origins[i]		= rays[first + i].GetPosition();
+			directions[i]	= rays[first + i].GetDirection();
+			distances[i]	= results[first + i].rayDistance;
+			results[first + i].node = nullptr;
+		}
+		broadphaseTree.RayCastPacket(origins, directions, distances, packetCount, [&](int ray, GameObject* o, float maxDistance) {
+			if (!(o->GetLayerBit() & layerMask)) {
+				return maxDistance;
+			}
+			RayCollision thisCollision;
+			if (!CollisionDetection::RayIntersection(rays[first + ray], *o, thisCollision) || thisCollision.rayDistance > maxDistance) {
+				return maxDistance;
+			}
+			thisCollision.node		= o;
+			results[first + ray]	= thisCollision;
+			return thisCollision.rayDistance;
+		});
+		for (int i = 0; i < packetCount; ++i) {
+			hitCount += results[first + i].node ? 1 : 0;
+		}
+	}
+	return hitCount;
+}
+
+
+static bool PassesFilter(const GameObject* o, const QueryFilter& filter) {
+	return	o != filter.ignore && o->GetBoundingVolume() &&
+			(o->GetLayerBit() & filter.layerMask) &&
+			(!filter.tag || o->GetTag() == *filter.tag) &&
+			(!filter.accept || filter.accept(o));
+}
+
+int GameWorld::OverlapSphere(const Vector3& position, float radius, GameObject** results, int maxResults, const QueryFilter& filter) const {
+	SphereVolume	volume(radius);
+	Transform		transform;
+	transform.SetPosition(position);
+	return OverlapVolume((const CollisionVolume&)volume, transform, results, maxResults, filter);
+}
+
+int GameWorld::OverlapBox(const Vector3& position, const Vector3& halfSize, const Quaternion& orientation, GameObject** results, int maxResults, const QueryFilter& filter) const {
+	OBBVolume	volume(halfSize);
+	Transform	transform;
+	transform.SetPosition(position).SetOrientation(orientation);
+	return OverlapVolume((const CollisionVolume&)volume, transform, results, maxResults, filter);
+}
+
+int GameWorld::OverlapVolume(const CollisionVolume& volume, const Transform& transform, GameObject** results, int maxResults, const QueryFilter& filter) const {
+	Vector3 boundsMin;
+	Vector3 boundsMax;
+	CollisionDetection::VolumeBounds(volume, transform, boundsMin, boundsMax);
+
+	int count = 0;
+	if (maxResults <= 0) {
+		return count;
+	}
+	broadphaseTree.Query((boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f, [&](GameObject* o) {
+		if (!PassesFilter(o, filter)) {
+			return true;
+		}
+		CollisionDetection::CollisionInfo info;
+		if (CollisionDetection::VolumeIntersection(volume, transform, *o->GetBoundingVolume(), o->GetTransform(), info)) {
+			results[count++] = o;
+		}
+		return count < maxResults;
+	});
+	return count;
+}
+
+int GameWorld::SweepSphere(const Vector3& start, float radius, const Vector3& direction, float distance, SweepHit* results, int maxResults, const QueryFilter& filter) const {
+	SphereVolume	volume(radius);
+	Transform		transform;
+	transform.SetPosition(start);
+	return SweepVolume((const CollisionVolume&)volume, transform, direction, distance, results, maxResults, filter);
+}
+
+int GameWorld::SweepCapsule(const Vector3& start, const Quaternion& orientation, float halfHeight, float radius,
+	const Vector3& direction, float distance, SweepHit* results, int maxResults, const QueryFilter& filter) const {
+	CapsuleVolume	volume(halfHeight, radius);
+	Transform		transform;
+	transform.SetPosition(start).SetOrientation(orientation);
+	return SweepVolume((const CollisionVolume&)volume, transform, direction, distance, results, maxResults, filter);
+}
+
+/*
+Once the results are full, the sweep only has to go as far as the
+furthest hit kept so far, as anything past it would be thrown away.
+*/
+int GameWorld::SweepVolume(const CollisionVolume& volume, const Transform& transform, const Vector3& direction, float distance,
+	SweepHit* results, int maxResults, const QueryFilter& filter) const {
+	Vector3 motion = direction * distance;
+
+	Vector3 startMin, startMax;
+	CollisionDetection::VolumeBounds(volume, transform, startMin, startMax);
+	Vector3 boundsMin(std::min(startMin.x, startMin.x + motion.x), std::min(startMin.y, startMin.y + motion.y), std::min(startMin.z, startMin.z + motion.z));
+	Vector3 boundsMax(std::max(startMax.x, startMax.x + motion.x), std::max(startMax.y, startMax.y + motion.y), std::max(startMax.z, startMax.z + motion.z));
+
+	int count = 0;
+	if (maxResults <= 0) {
+		return count;
+	}
+	broadphaseTree.Query((boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f, [&](GameObject* o) {
+		if (!PassesFilter(o, filter)) {
+			return true;
+		}
+		float maxFraction = (count == maxResults && distance > 0.0f) ? results[count - 1].distance / distance : 1.0f;
+
+		CollisionDetection::CollisionInfo info;
+		float fraction;
+		if (!CollisionDetection::SweepIntersection(volume, transform, motion, *o->GetBoundingVolume(), o->GetTransform(), maxFraction, fraction, info) ||
+			info.pointCount == 0) {
+			return true;
+		}
+		SweepHit hit;
+		hit.object		= o;
+		hit.distance	= fraction * distance;
+		hit.position	= transform.GetPosition() + (motion * fraction) + info.points[0].localA;
+		hit.normal		= -info.points[0].normal;
+
+		//Insertion sort - when there's no room left, the furthest hit makes way
+		int slot = count < maxResults ? count++ : count - 1;
+		while (slot > 0 && results[slot - 1].distance > hit.distance) {
+			results[slot] = results[slot - 1];
+			--slot;
+		}
+		results[slot] = hit;
+		return true;
+	});
+	return count;
+}
 
 /*
 Constraint Tutorial Stuff
@@ -1,8 +1,10 @@
 #pragma once
 #include <vector>
+#include <functional>
 #include "Ray.h"
 #include "CollisionDetection.h"
-#include "QuadTree.h"
+#include "AABBTree.h"
+#include "RigidBodyStore.h"
 namespace NCL {
 		class Camera;
 		using Maths::Ray;
@@ -13,6 +15,27 @@ namespace NCL {
 		typedef std::function<void(GameObject*)> GameObjectFunc;
 		typedef std::vector<GameObject*>::const_iterator GameObjectIterator;
 
+		/*
+		Narrows down what the world's queries find - only objects on one of
+		the layers in layerMask, with the given tag if there is one, and
+		never the ignored object (usually whatever is doing the query).
+		Anything else can be ruled out with accept, which is asked before an
+		object takes up one of the query's result slots.
+		*/
+		struct QueryFilter {
+			unsigned int		layerMask	= 0xFFFFFFFF;
+			const std::string*	tag			= nullptr;
+			const GameObject*	ignore		= nullptr;
+			std::function<bool(const GameObject*)> accept;
+		};
+
+		struct SweepHit {
+			GameObject*	object;
+			float		distance;	//How far the shape got before it touched
+			Vector3		position;	//Where it touched, in world space
+			Vector3		normal;		//Out of the object that was hit, back towards the shape
+		};
+
 		class GameWorld	{
 		public:
 			GameWorld();
@@ -39,7 +62,61 @@ namespace NCL {
 				shuffleObjects = state;
 			}
 
-			bool Raycast(Ray& r, RayCollision& closestCollision, bool closestObject = false) const;
+			//While set, the object and constraint lists are never shuffled, whatever the settings above say
+			void SetDeterministic(bool state) {
+				deterministic = state;
+			}
+
+			//Every object ever added has an ID below this
+			int GetWorldIDCount() const {
+				return worldIDCounter;
+			}
+
+			static const unsigned int AllLayers = 0xFFFFFFFF;
+
+			/*
+			Finds what the ray hits by walking the broadphase tree front to
+			back. With closestObject set it's the nearest hit, otherwise it's
+			the first one found, which is quicker when all that matters is
+			whether anything is in the way. The ray only goes as far as
+			closestCollision's rayDistance, which is unlimited by default.
+			*/
+			bool Raycast(Ray& r, RayCollision& closestCollision, bool closestObject = false, unsigned int layerMask = AllLayers) const;
+
+			/*
+			Traces a whole batch of rays at once, such as every AI's line of
+			sight checks for a frame, sharing each walk down the tree between
+			a packet of them. Each result's rayDistance is how far its ray goes
+			on the way in, and its node is left null if the ray hits nothing.
+			Returns how many of the rays hit something.
+			*/
+			int RaycastBatch(const Ray* rays, int count, RayCollision* results, unsigned int layerMask = AllLayers) const;
+
+			/*
+			Everything overlapping a shape, found through the broadphase tree.
+			The objects are written into results, which has room for maxResults
+			of them, and the number written is returned. Nothing is allocated,
+			so these are fine to call every frame.
+			*/
+			int OverlapSphere(const Vector3& position, float radius,
+				GameObject** results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
+			int OverlapBox(const Vector3& position, const Vector3& halfSize, const Quaternion& orientation,
+				GameObject** results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
+			int OverlapVolume(const CollisionVolume& volume, const Transform& transform,
+				GameObject** results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
+
+			/*
+			Everything a shape would hit if it were moved distance units along
+			direction (which should be normalised). The hits are written nearest
+			first, keeping the closest maxResults of them. Anything the shape is
+			already touching is hit at a distance of 0.
+			*/
+			int SweepSphere(const Vector3& start, float radius, const Vector3& direction, float distance,
+				SweepHit* results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
+			int SweepCapsule(const Vector3& start, const Quaternion& orientation, float halfHeight, float radius,
+				const Vector3& direction, float distance, SweepHit* results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
+			int SweepVolume(const CollisionVolume& volume, const Transform& transform, const Vector3& direction, float distance,
+				SweepHit* results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
 
 			virtual void UpdateWorld(float dt);
 
@@ -58,15 +135,34 @@ namespace NCL {
 				return gameObjects;
 			}
 
+			AABBTree<GameObject*>& GetBroadphaseTree() {
+				return broadphaseTree;
+			}
+
+			//Where the physics state of every object in the world is kept
+			RigidBodyStore& GetBodyStore() {
+				return bodyStore;
+			}
+
+			//Changes whenever objects are added or removed
+			int GetObjectListVersion() const {
+				return objectListVersion;
+			}
+
 		protected:
 			std::vector<GameObject*> gameObjects;
 			std::vector<Constraint*> constraints;
 
+			AABBTree<GameObject*>	broadphaseTree;
+			RigidBodyStore			bodyStore;
+
 			Camera* mainCamera;
 
 			bool	shuffleConstraints;
 			bool	shuffleObjects;
+			bool	deterministic;
 			int		worldIDCounter;
+			int		objectListVersion;
 		};
 	}
 }
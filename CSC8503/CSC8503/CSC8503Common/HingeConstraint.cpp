@@ -0,0 +1,57 @@
+#include "HingeConstraint.h"
+#include "GameObject.h"
+#include "../../Common/Maths.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+HingeConstraint::HingeConstraint(GameObject* a, GameObject* b, const Vector3& worldPivot, const Vector3& worldAxis)
+	: Constraint(a, b) {
+	const Transform& transformA = a->GetTransform();
+	const Transform& transformB = b->GetTransform();
+
+	Quaternion inverseA = transformA.GetOrientation().Conjugate();
+	Quaternion inverseB = transformB.GetOrientation().Conjugate();
+
+	anchorA = inverseA * (worldPivot - transformA.GetPosition());
+	anchorB = inverseB * (worldPivot - transformB.GetPosition());
+	axisA	= inverseA * worldAxis.Normalised();
+	axisB	= inverseB * worldAxis.Normalised();
+}
+
+/*
+The pivot is held together just like a ball and socket. To stop the objects
+turning any other way, each keeps its own copy of the hinge axis, and the
+two copies are kept pointing the same way. If they've drifted apart, their
+cross product is the (small) turn that would line them back up, and so its
+size along the two directions at right angles to the hinge is the error.
+*/
+int HingeConstraint::BuildRows(ConstraintRow* rows, float dt) {
+	const Transform& transformA = objectA->GetTransform();
+	const Transform& transformB = objectB->GetTransform();
+
+	Vector3 relativeA	= transformA.GetOrientation() * anchorA;
+	Vector3 relativeB	= transformB.GetOrientation() * anchorB;
+	Vector3 offset		= (transformB.GetPosition() + relativeB) - (transformA.GetPosition() + relativeA);
+
+	int count = 0;
+	for (int i = 0; i < 3; ++i) {
+		Vector3 axis;
+		axis[i] = 1.0f;
+		LinearRow(rows[count++], axis, relativeA, relativeB, offset[i], dt);
+	}
+	if (!objectA->CanRotate() && !objectB->CanRotate()) {
+		return count;
+	}
+	Vector3 hingeA	= transformA.GetOrientation() * axisA;
+	Vector3 hingeB	= transformB.GetOrientation() * axisB;
+	Vector3 error	= Vector3::Cross(hingeA, hingeB);
+
+	Vector3 tangentA;
+	Vector3 tangentB;
+	Maths::Perpendiculars(hingeA, tangentA, tangentB);
+
+	AngularRow(rows[count++], tangentA, Vector3::Dot(error, tangentA), dt);
+	AngularRow(rows[count++], tangentB, Vector3::Dot(error, tangentB), dt);
+	return count;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Constraint.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Pins the two objects together at a point like a ball and socket, but
+		only lets them turn relative to each other about a single axis, like
+		a door on its hinges.
+		*/
+		class HingeConstraint : public Constraint {
+		public:
+			HingeConstraint(GameObject* a, GameObject* b, const Vector3& worldPivot, const Vector3& worldAxis);
+			~HingeConstraint() {}
+
+			int BuildRows(ConstraintRow* rows, float dt) override;
+
+		protected:
+			Vector3 anchorA;
+			Vector3 anchorB;
+			Vector3 axisA;
+			Vector3 axisB;
+		};
+	}
+}
@@ -0,0 +1,148 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+using namespace NCL;
+using namespace CSC8503;
+
+JobSystem::JobSystem(int workerThreads) {
+	currentFunc		= nullptr;
+	jobsRemaining	= 0;
+	generation		= 0;
+	quitting		= false;
+
+	if (workerThreads < 0) {
+		workerThreads = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+	}
+	StartWorkers(workerThreads);
+}
+
+JobSystem::~JobSystem() {
+	StopWorkers();
+}
+
+void JobSystem::SetWorkerThreads(int count) {
+	StopWorkers();
+	StartWorkers(count);
+}
+
+void JobSystem::StartWorkers(int count) {
+	quitting = false;
+	queues.clear();
+	for (int i = 0; i < count + 1; ++i) {
+		queues.emplace_back(new WorkQueue());
+	}
+	//Queue 0 always belongs to whichever thread calls ParallelFor
+	for (int i = 0; i < count; ++i) {
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+	}
+}
+
+void JobSystem::StopWorkers() {
+	{
+		std::lock_guard<std::mutex> l(wakeLock);
+		quitting = true;
+	}
+	wakeSignal.notify_all();
+	for (std::thread& t : workers) {
+		t.join();
+	}
+	workers.clear();
+}
+
+/*
+Jobs are handed out as contiguous blocks, one per thread, so that
+neighbouring jobs (which often touch neighbouring data) tend to stay on the
+same thread. Stealing then evens things out if the blocks are uneven.
+*/
+void JobSystem::ParallelFor(int jobCount, const JobFunc& func) {
+	if (jobCount <= 0) {
+		return;
+	}
+	if (workers.empty() || jobCount == 1) {
+		for (int i = 0; i < jobCount; ++i) {
+			func(i);
+		}
+		return;
+	}
+	currentFunc		= &func;
+	jobsRemaining	= jobCount;
+
+	int threadCount = (int)queues.size();
+	for (int t = 0; t < threadCount; ++t) {
+		WorkQueue& q = *queues[t];
+		std::lock_guard<std::mutex> l(q.lock);
+		q.jobs.clear();
+		q.head = 0;
+		int start	= (int)(((long long)jobCount * t) / threadCount);
+		int end		= (int)(((long long)jobCount * (t + 1)) / threadCount);
+		//Owners pop from the back, so push in reverse to run the block in order
+		for (int i = end - 1; i >= start; --i) {
+			q.jobs.emplace_back(i);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> l(wakeLock);
+		generation++;
+	}
+	wakeSignal.notify_all();
+
+	while (jobsRemaining.load() > 0) {
+		if (!RunOneJob(0)) {
+			std::this_thread::yield();
+		}
+	}
+	currentFunc = nullptr;
+}
+
+void JobSystem::WorkerLoop(int queueIndex) {
+	int seenGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> l(wakeLock);
+			wakeSignal.wait(l, [&] { return quitting || generation != seenGeneration; });
+			if (quitting) {
+				return;
+			}
+			seenGeneration = generation;
+		}
+		while (jobsRemaining.load() > 0) {
+			if (!RunOneJob(queueIndex)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+}
+
+bool JobSystem::RunOneJob(int queueIndex) {
+	int job = -1;
+	if (!PopJob(*queues[queueIndex], false, job)) {
+		int threadCount = (int)queues.size();
+		for (int i = 1; i < threadCount; ++i) {
+			if (PopJob(*queues[(queueIndex + i) % threadCount], true, job)) {
+				break;
+			}
+		}
+	}
+	if (job < 0) {
+		return false;
+	}
+	(*currentFunc)(job);
+	jobsRemaining--;
+	return true;
+}
+
+bool JobSystem::PopJob(WorkQueue& q, bool fromFront, int& outJob) {
+	std::lock_guard<std::mutex> l(q.lock);
+	if (q.head >= (int)q.jobs.size()) {
+		return false;
+	}
+	if (fromFront) {
+		outJob = q.jobs[q.head++];
+	}
+	else {
+		outJob = q.jobs.back();
+		q.jobs.pop_back();
+	}
+	return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A small work stealing thread pool. Each thread (including the one
+		that calls ParallelFor) owns a queue of job indices. A thread takes
+		work from the back of its own queue, and when that runs dry, steals
+		from the front of someone else's, so a few long jobs can't leave the
+		other threads sitting idle.
+
+		ParallelFor doesn't return until every job has finished, and the
+		calling thread helps out rather than just waiting.
+		*/
+		class JobSystem {
+		public:
+			typedef std::function<void(int)> JobFunc;
+
+			//A negative count uses one worker per hardware thread, minus the caller
+			JobSystem(int workerThreads = -1);
+			~JobSystem();
+
+			void SetWorkerThreads(int count);
+
+			int GetThreadCount() const {
+				return (int)workers.size() + 1;
+			}
+
+			void ParallelFor(int jobCount, const JobFunc& func);
+
+		protected:
+			struct WorkQueue {
+				std::mutex			lock;
+				std::vector<int>	jobs;
+				int					head = 0;
+			};
+
+			void StartWorkers(int count);
+			void StopWorkers();
+
+			void WorkerLoop(int queueIndex);
+			bool RunOneJob(int queueIndex);
+			bool PopJob(WorkQueue& q, bool fromFront, int& outJob);
+
+			std::vector<std::thread>				workers;
+			std::vector<std::unique_ptr<WorkQueue>>	queues;
+
+			const JobFunc*		currentFunc;
+			std::atomic<int>	jobsRemaining;
+
+			std::mutex				wakeLock;
+			std::condition_variable	wakeSignal;
+			int						generation;
+			bool					quitting;
+		};
+	}
+}
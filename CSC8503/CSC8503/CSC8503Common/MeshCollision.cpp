@@ -0,0 +1,419 @@
+#include "MeshCollision.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace NCL;
+using namespace CSC8503;
+
+//From Real-Time Collision Detection, by working out which region around the triangle p is in
+Vector3 MeshCollision::ClosestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c) {
+	Vector3 ab = b - a;
+	Vector3 ac = c - a;
+	Vector3 ap = p - a;
+
+	float d1 = Vector3::Dot(ab, ap);
+	float d2 = Vector3::Dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		return a;
+	}
+
+	Vector3 bp = p - b;
+	float d3 = Vector3::Dot(ab, bp);
+	float d4 = Vector3::Dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) {
+		return b;
+	}
+
+	float vc = (d1 * d4) - (d3 * d2);
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		return a + ab * (d1 / (d1 - d3));
+	}
+
+	Vector3 cp = p - c;
+	float d5 = Vector3::Dot(ab, cp);
+	float d6 = Vector3::Dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) {
+		return c;
+	}
+
+	float vb = (d5 * d2) - (d1 * d6);
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		return a + ac * (d2 / (d2 - d6));
+	}
+
+	float va = (d3 * d6) - (d5 * d4);
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + (ab * (vb * denom)) + (ac * (vc * denom));
+}
+
+//Is p inside the triangle, when looked at straight down its normal?
+bool MeshCollision::PointInTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c) {
+	Vector3 normal = Vector3::Cross(b - a, c - a);
+	return	Vector3::Dot(Vector3::Cross(b - a, p - a), normal) >= 0.0f &&
+			Vector3::Dot(Vector3::Cross(c - b, p - b), normal) >= 0.0f &&
+			Vector3::Dot(Vector3::Cross(a - c, p - c), normal) >= 0.0f;
+}
+
+void MeshCollision::ContactList::Add(const Vector3& onMesh, const Vector3& onShape, const Vector3& normal, float penetration) {
+	const float mergeDistance = 0.01f;
+
+	for (int i = 0; i < count; ++i) {
+		if ((contacts[i].onShape - onShape).LengthSquared() < mergeDistance * mergeDistance) {
+			if (penetration > contacts[i].penetration) {
+				contacts[i] = { onMesh, onShape, normal, penetration };
+			}
+			return;
+		}
+	}
+	if (count < MaxGatheredContacts) {
+		contacts[count++] = { onMesh, onShape, normal, penetration };
+		return;
+	}
+	int shallowest = 0;
+	for (int i = 1; i < count; ++i) {
+		if (contacts[i].penetration < contacts[shallowest].penetration) {
+			shallowest = i;
+		}
+	}
+	if (penetration > contacts[shallowest].penetration) {
+		contacts[shallowest] = { onMesh, onShape, normal, penetration };
+	}
+}
+
+bool MeshCollision::WriteContacts(const ContactList& list, const Transform& meshTransform, const Vector3& shapePosition,
+	CollisionDetection::CollisionInfo& collisionInfo) {
+	if (list.count == 0) {
+		return false;
+	}
+	Quaternion	orientation = meshTransform.GetOrientation();
+	Vector3		position	= meshTransform.GetPosition();
+
+	CollisionDetection::ContactPoint points[MaxGatheredContacts];
+	for (int i = 0; i < list.count; ++i) {
+		const Contact& c		= list.contacts[i];
+		points[i].localA		= orientation * c.onMesh;
+		points[i].localB		= ((orientation * c.onShape) + position) - shapePosition;
+		points[i].normal		= orientation * c.normal;
+		points[i].penetration	= c.penetration;
+	}
+	CollisionDetection::AddReducedContacts(points, list.count, collisionInfo);
+	return true;
+}
+
+bool MeshCollision::SphereIntersection(const MeshVolume& mesh, const Transform& meshTransform,
+	const SphereVolume& sphere, const Transform& sphereTransform, CollisionDetection::CollisionInfo& collisionInfo) {
+	Quaternion	invOrientation	= meshTransform.GetOrientation().Conjugate();
+	Vector3		spherePos		= sphereTransform.GetPosition();
+	Vector3		centre			= invOrientation * (spherePos - meshTransform.GetPosition());
+	float		radius			= sphere.GetRadius();
+	Vector3		extent(radius, radius, radius);
+
+	ContactList list;
+	mesh.QueryBox(centre - extent, centre + extent, [&](int triangle) {
+		Vector3 a, b, c;
+		mesh.GetTriangle(triangle, a, b, c);
+
+		Vector3 closest		= ClosestPointOnTriangle(centre, a, b, c);
+		Vector3 delta		= centre - closest;
+		float	distance	= delta.LengthSquared();
+		if (distance >= radius * radius) {
+			return;
+		}
+		distance = std::sqrt(distance);
+
+		//A centre right on the triangle gets pushed out of its front
+		Vector3 normal = distance > 1e-6f ? delta / distance : Vector3::Cross(b - a, c - a).Normalised();
+		list.Add(closest, centre - normal * radius, normal, radius - distance);
+	});
+	return WriteContacts(list, meshTransform, spherePos, collisionInfo);
+}
+
+/*
+If the capsule's segment goes through a triangle, the end that's gone
+through is pushed back out of its front. Otherwise, the closest points
+between the segment and the triangle are either at one of the segment's
+ends, or between the segment and one of the triangle's edges. A capsule
+lying on a triangle also gets a contact under each end, so it stays flat.
+*/
+bool MeshCollision::CapsuleIntersection(const MeshVolume& mesh, const Transform& meshTransform,
+	const CapsuleVolume& capsule, const Transform& capsuleTransform, CollisionDetection::CollisionInfo& collisionInfo) {
+	Vector3 worldStart, worldEnd;
+	CollisionDetection::CapsuleSegment(capsule, capsuleTransform, worldStart, worldEnd);
+
+	Quaternion	invOrientation	= meshTransform.GetOrientation().Conjugate();
+	Vector3		meshPos			= meshTransform.GetPosition();
+	Vector3		start			= invOrientation * (worldStart - meshPos);
+	Vector3		end				= invOrientation * (worldEnd - meshPos);
+	Vector3		segment			= end - start;
+	float		segmentLength	= segment.Length();
+	float		radius			= capsule.GetRadius();
+
+	Vector3 boundsMin(std::min(start.x, end.x) - radius, std::min(start.y, end.y) - radius, std::min(start.z, end.z) - radius);
+	Vector3 boundsMax(std::max(start.x, end.x) + radius, std::max(start.y, end.y) + radius, std::max(start.z, end.z) + radius);
+
+	ContactList list;
+	mesh.QueryBox(boundsMin, boundsMax, [&](int triangle) {
+		Vector3 tri[3];
+		mesh.GetTriangle(triangle, tri[0], tri[1], tri[2]);
+
+		Vector3 faceNormal	= Vector3::Cross(tri[1] - tri[0], tri[2] - tri[0]);
+		float	faceLength	= faceNormal.Length();
+		if (faceLength < 1e-8f) {
+			return;
+		}
+		faceNormal = faceNormal / faceLength;
+
+		float startDistance = Vector3::Dot(start - tri[0], faceNormal);
+		float endDistance	= Vector3::Dot(end - tri[0], faceNormal);
+
+		if ((startDistance < 0.0f) != (endDistance < 0.0f)) {
+			Vector3 crossing = start + segment * (startDistance / (startDistance - endDistance));
+			if (PointInTriangle(crossing, tri[0], tri[1], tri[2])) {
+				Vector3 normal	= (startDistance + endDistance >= 0.0f) ? faceNormal : -faceNormal;
+				float	depth	= std::min(startDistance, endDistance);
+				Vector3 deepest = (startDistance < endDistance) ? start : end;
+				if (normal != faceNormal) {
+					depth	= -std::max(startDistance, endDistance);
+					deepest = (startDistance > endDistance) ? start : end;
+				}
+				list.Add(deepest - normal * depth, deepest - normal * radius, normal, radius - depth);
+				return;
+			}
+		}
+
+		float	bestDistance = FLT_MAX;
+		Vector3 onSegment;
+		Vector3 onTriangle;
+		Vector3 ends[2] = { start, end };
+		for (const Vector3& e : ends) {
+			Vector3 closest		= ClosestPointOnTriangle(e, tri[0], tri[1], tri[2]);
+			float	distance	= (e - closest).LengthSquared();
+			if (distance < bestDistance) {
+				bestDistance	= distance;
+				onSegment		= e;
+				onTriangle		= closest;
+			}
+		}
+		for (int i = 0; i < 3; ++i) {
+			float tSegment, tEdge;
+			const Vector3& edgeStart	= tri[i];
+			const Vector3& edgeEnd		= tri[(i + 1) % 3];
+			CollisionDetection::ClosestPointsOnSegments(start, end, edgeStart, edgeEnd, tSegment, tEdge);
+			Vector3 p		= start + segment * tSegment;
+			Vector3 q		= edgeStart + (edgeEnd - edgeStart) * tEdge;
+			float distance	= (p - q).LengthSquared();
+			if (distance < bestDistance) {
+				bestDistance	= distance;
+				onSegment		= p;
+				onTriangle		= q;
+			}
+		}
+		if (bestDistance >= radius * radius) {
+			return;
+		}
+		float	distance	= std::sqrt(bestDistance);
+		Vector3 normal		= distance > 1e-6f ? (onSegment - onTriangle) / distance :
+							  ((startDistance + endDistance >= 0.0f) ? faceNormal : -faceNormal);
+		list.Add(onTriangle, onSegment - normal * radius, normal, radius - distance);
+
+		if (std::abs(Vector3::Dot(normal, faceNormal)) > 0.999f && segmentLength > 0.0f &&
+			std::abs(Vector3::Dot(segment, faceNormal)) < 0.05f * segmentLength) {
+			for (const Vector3& e : ends) {
+				float height = Vector3::Dot(e - tri[0], normal);
+				if (height >= 0.0f && height < radius && PointInTriangle(e, tri[0], tri[1], tri[2])) {
+					list.Add(e - normal * height, e - normal * radius, normal, radius - height);
+				}
+			}
+		}
+	});
+	return WriteContacts(list, meshTransform, capsuleTransform.GetPosition(), collisionInfo);
+}
+
+bool MeshCollision::BoxIntersection(const MeshVolume& mesh, const Transform& meshTransform,
+	const SATAlgorithm::Box& box, CollisionDetection::CollisionInfo& collisionInfo) {
+	Quaternion	invOrientation	= meshTransform.GetOrientation().Conjugate();
+	Vector3		centre			= invOrientation * (box.position - meshTransform.GetPosition());
+	Vector3		axes[3];
+	Vector3		extent;
+	for (int i = 0; i < 3; ++i) {
+		axes[i] = invOrientation * box.axes[i];
+		extent	= extent + Vector3(std::abs(axes[i].x), std::abs(axes[i].y), std::abs(axes[i].z)) * box.halfSize[i];
+	}
+
+	//The box's space and the mesh's space, back and forth
+	auto ToBox = [&](const Vector3& p) {
+		Vector3 offset = p - centre;
+		return Vector3(Vector3::Dot(offset, axes[0]), Vector3::Dot(offset, axes[1]), Vector3::Dot(offset, axes[2]));
+	};
+	auto ToMesh = [&](const Vector3& p) {
+		return centre + (axes[0] * p.x) + (axes[1] * p.y) + (axes[2] * p.z);
+	};
+
+	ContactList list;
+	mesh.QueryBox(centre - extent, centre + extent, [&](int triangle) {
+		Vector3 tri[3];
+		mesh.GetTriangle(triangle, tri[0], tri[1], tri[2]);
+		for (int i = 0; i < 3; ++i) {
+			tri[i] = ToBox(tri[i]);
+		}
+		Contact contacts[8];
+		int		contactCount = 0;
+		if (!TriangleBox(tri, box.halfSize, contacts, contactCount)) {
+			return;
+		}
+		for (int i = 0; i < contactCount; ++i) {
+			const Contact& c	= contacts[i];
+			Vector3 normal		= (axes[0] * c.normal.x) + (axes[1] * c.normal.y) + (axes[2] * c.normal.z);
+			list.Add(ToMesh(c.onMesh), ToMesh(c.onShape), normal, c.penetration);
+		}
+	});
+	return WriteContacts(list, meshTransform, box.position, collisionInfo);
+}
+
+/*
+The separating axis test again, this time for a triangle against a box
+sitting on the origin. There's 13 axes to try - the triangle's normal,
+the box's 3 face normals, and each box axis crossed with each triangle
+edge. Like SATAlgorithm, the face normals are preferred unless an edge
+pair is clearly better, and the triangle's normal most of all, as that's
+what anything resting on a mesh should be pushed out along.
+*/
+bool MeshCollision::TriangleBox(const Vector3* tri, const Vector3& halfSize, Contact* contacts, int& contactCount) {
+	Vector3 edges[3]	= { tri[1] - tri[0], tri[2] - tri[1], tri[0] - tri[2] };
+	Vector3 faceNormal	= Vector3::Cross(edges[0], edges[1]);
+	float	faceLength	= faceNormal.Length();
+	if (faceLength < 1e-8f) {
+		return false;
+	}
+	faceNormal = faceNormal / faceLength;
+
+	float	bestOverlap = FLT_MAX;
+	Vector3 bestNormal;
+	int		bestAxis	= -1;
+
+	auto TestAxis = [&](const Vector3& axis, int id) {
+		float boxRadius = (halfSize.x * std::abs(axis.x)) + (halfSize.y * std::abs(axis.y)) + (halfSize.z * std::abs(axis.z));
+		float p0		= Vector3::Dot(tri[0], axis);
+		float p1		= Vector3::Dot(tri[1], axis);
+		float p2		= Vector3::Dot(tri[2], axis);
+		float triMin	= std::min(p0, std::min(p1, p2));
+		float triMax	= std::max(p0, std::max(p1, p2));
+		if (triMin > boxRadius || triMax < -boxRadius) {
+			return false;
+		}
+		//How far the box has to move along or against the axis to get clear of the triangle
+		float along		= triMax + boxRadius;
+		float against	= boxRadius - triMin;
+		float overlap	= std::min(along, against);
+		if (bestAxis < 0 || overlap < (bestOverlap * 0.95f) - 0.01f) {
+			bestOverlap = overlap;
+			bestNormal	= along < against ? axis : -axis;
+			bestAxis	= id;
+		}
+		return true;
+	};
+
+	if (!TestAxis(faceNormal, 0)) {
+		return false;
+	}
+	for (int i = 0; i < 3; ++i) {
+		Vector3 axis;
+		axis[i] = 1.0f;
+		if (!TestAxis(axis, 1 + i)) {
+			return false;
+		}
+	}
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			Vector3 boxAxis;
+			boxAxis[i] = 1.0f;
+			Vector3 axis	= Vector3::Cross(boxAxis, edges[j]);
+			float length	= axis.Length();
+			if (length < 1e-6f) {
+				continue;
+			}
+			if (!TestAxis(axis / length, 4 + (i * 3) + j)) {
+				return false;
+			}
+		}
+	}
+
+	const Vector3& n = bestNormal;
+	contactCount = 0;
+
+	if (bestAxis == 0) {
+		//Every corner of the box that's through the triangle's face
+		for (int i = 0; i < 8; ++i) {
+			Vector3 corner(
+				(i & 1) ? halfSize.x : -halfSize.x,
+				(i & 2) ? halfSize.y : -halfSize.y,
+				(i & 4) ? halfSize.z : -halfSize.z);
+			float height = Vector3::Dot(corner - tri[0], n);
+			if (height < 0.0f && PointInTriangle(corner, tri[0], tri[1], tri[2])) {
+				contacts[contactCount++] = { corner - n * height, corner, n, -height };
+			}
+		}
+	}
+	else if (bestAxis < 4) {
+		//Every corner of the triangle that's inside the box, measured from the face it's closest to
+		int axis = bestAxis - 1;
+		for (int i = 0; i < 3; ++i) {
+			float depth = Vector3::Dot(tri[i], n) + halfSize[axis];
+			if (depth <= 0.0f || depth > 2.0f * halfSize[axis] ||
+				std::abs(tri[i][(axis + 1) % 3]) > halfSize[(axis + 1) % 3] ||
+				std::abs(tri[i][(axis + 2) % 3]) > halfSize[(axis + 2) % 3]) {
+				continue;
+			}
+			contacts[contactCount++] = { tri[i], tri[i] - n * depth, n, depth };
+		}
+	}
+	else {
+		//The box edge nearest the triangle, against the triangle edge that made the axis
+		int boxAxis = (bestAxis - 4) / 3;
+		int triEdge = (bestAxis - 4) % 3;
+
+		Vector3 edgeStart;
+		for (int k = 0; k < 3; ++k) {
+			edgeStart[k] = n[k] > 0.0f ? -halfSize[k] : halfSize[k];
+		}
+		edgeStart[boxAxis] = -halfSize[boxAxis];
+		Vector3 edgeEnd = edgeStart;
+		edgeEnd[boxAxis] = halfSize[boxAxis];
+
+		float tBox, tTri;
+		CollisionDetection::ClosestPointsOnSegments(edgeStart, edgeEnd, tri[triEdge], tri[(triEdge + 1) % 3], tBox, tTri);
+		Vector3 onBox = edgeStart + (edgeEnd - edgeStart) * tBox;
+		contacts[contactCount++] = { onBox + n * bestOverlap, onBox, n, bestOverlap };
+	}
+
+	if (contactCount == 0) {
+		//The corner of the box that's furthest in
+		Vector3 corner;
+		for (int k = 0; k < 3; ++k) {
+			corner[k] = n[k] > 0.0f ? -halfSize[k] : halfSize[k];
+		}
+		contacts[contactCount++] = { corner + n * bestOverlap, corner, n, bestOverlap };
+	}
+	return true;
+}
+
+bool MeshCollision::RayIntersection(const Ray& r, const Transform& meshTransform, const MeshVolume& mesh, RayCollision& collision) {
+	Quaternion	invOrientation	= meshTransform.GetOrientation().Conjugate();
+	Vector3		origin			= invOrientation * (r.GetPosition() - meshTransform.GetPosition());
+	Vector3		direction		= invOrientation * r.GetDirection();
+
+	float	distance;
+	int		triangle;
+	if (!mesh.Raycast(origin, direction, FLT_MAX, distance, triangle)) {
+		return false;
+	}
+	collision.collidedAt	= r.GetPosition() + (r.GetDirection() * distance);
+	collision.rayDistance	= distance;
+	return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "CollisionDetection.h"
+#include "SATAlgorithm.h"
+#include "MeshVolume.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Collisions between a static triangle mesh and the other volumes. The
+		other volume is moved into the mesh's local space, the mesh's BVH is
+		asked for the triangles near its bounds, and each of those is tested
+		on its own - a sphere or capsule against the closest point on the
+		triangle, and a box with the separating axis test.
+
+		Something resting on a mesh is often touching several triangles at
+		once, so the contacts from all of them are gathered up, any that
+		land in the same place (such as on an edge two triangles share) are
+		merged, and the best 4 are kept for the manifold.
+		*/
+		class MeshCollision {
+		public:
+			//On a hit, the contact normals point from the mesh towards the other volume
+			static bool SphereIntersection(const MeshVolume& mesh, const Transform& meshTransform,
+				const SphereVolume& sphere, const Transform& sphereTransform, CollisionDetection::CollisionInfo& collisionInfo);
+
+			static bool CapsuleIntersection(const MeshVolume& mesh, const Transform& meshTransform,
+				const CapsuleVolume& capsule, const Transform& capsuleTransform, CollisionDetection::CollisionInfo& collisionInfo);
+
+			static bool BoxIntersection(const MeshVolume& mesh, const Transform& meshTransform,
+				const SATAlgorithm::Box& box, CollisionDetection::CollisionInfo& collisionInfo);
+
+			static bool RayIntersection(const Ray& r, const Transform& meshTransform, const MeshVolume& mesh, RayCollision& collision);
+
+			//The closest point on the triangle abc to p
+			static Vector3 ClosestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c);
+
+		protected:
+			//Everything in here is in the mesh's local space
+			struct Contact {
+				Vector3 onMesh;
+				Vector3 onShape;
+				Vector3 normal;
+				float	penetration;
+			};
+
+			static const int MaxGatheredContacts = 32;
+
+			struct ContactList {
+				Contact contacts[MaxGatheredContacts];
+				int		count = 0;
+
+				void Add(const Vector3& onMesh, const Vector3& onShape, const Vector3& normal, float penetration);
+			};
+
+			static bool PointInTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c);
+
+			//The box is centred on the origin here, with the triangle moved into its space
+			static bool TriangleBox(const Vector3* triangle, const Vector3& halfSize, Contact* contacts, int& contactCount);
+
+			//Moves the gathered contacts into world space, keeping at most MaxContactPoints of them
+			static bool WriteContacts(const ContactList& list, const Transform& meshTransform, const Vector3& shapePosition,
+				CollisionDetection::CollisionInfo& collisionInfo);
+
+		private:
+			MeshCollision()		{}
+			~MeshCollision()	{}
+		};
+	}
+}
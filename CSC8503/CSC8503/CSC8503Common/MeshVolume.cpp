@@ -0,0 +1,372 @@
+#include "MeshVolume.h"
+#include "../../Common/MeshGeometry.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace NCL;
+using namespace Maths;
+
+MeshVolume::MeshVolume() {
+	type = VolumeType::Mesh;
+}
+
+MeshVolume::MeshVolume(const MeshGeometry& mesh) : MeshVolume() {
+	const std::vector<Vector3>&			positions	= mesh.GetPositionData();
+	const std::vector<unsigned int>&	indices		= mesh.GetIndexData();
+
+	auto Vertex = [&](unsigned int i) {
+		return positions[indices.empty() ? i : indices[i]];
+	};
+	unsigned int count = indices.empty() ? (unsigned int)positions.size() : (unsigned int)indices.size();
+
+	if (mesh.GetPrimitiveType() == GeometryPrimitive::Triangles) {
+		for (unsigned int i = 0; i + 2 < count; i += 3) {
+			AddTriangle(Vertex(i), Vertex(i + 1), Vertex(i + 2));
+		}
+	}
+	else if (mesh.GetPrimitiveType() == GeometryPrimitive::TriangleStrip) {
+		//Every other triangle in a strip is wound the other way round
+		for (unsigned int i = 2; i < count; ++i) {
+			if (i % 2) {
+				AddTriangle(Vertex(i - 1), Vertex(i - 2), Vertex(i));
+			}
+			else {
+				AddTriangle(Vertex(i - 2), Vertex(i - 1), Vertex(i));
+			}
+		}
+	}
+	Build();
+}
+
+MeshVolume::MeshVolume(const std::vector<Vector3>& positions, const std::vector<unsigned int>& indices) : MeshVolume() {
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		AddTriangle(positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]]);
+	}
+	Build();
+}
+
+MeshVolume::~MeshVolume() {
+}
+
+void MeshVolume::AddTriangle(const Vector3& a, const Vector3& b, const Vector3& c) {
+	Triangle t;
+	t.points[0] = a;
+	t.points[1] = b;
+	t.points[2] = c;
+	triangles.emplace_back(t);
+}
+
+void MeshVolume::AddBox(const Vector3& position, const Vector3& halfSize, const Quaternion& orientation) {
+	Vector3 corners[8];
+	for (int i = 0; i < 8; ++i) {
+		Vector3 local(
+			(i & 1) ? halfSize.x : -halfSize.x,
+			(i & 2) ? halfSize.y : -halfSize.y,
+			(i & 4) ? halfSize.z : -halfSize.z);
+		corners[i] = position + orientation * local;
+	}
+
+	for (int axis = 0; axis < 3; ++axis) {
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+		for (int side = 0; side < 2; ++side) {
+			int base = side << axis;
+			Vector3 quad[4] = {
+				corners[base],
+				corners[base | (1 << u)],
+				corners[base | (1 << u) | (1 << v)],
+				corners[base | (1 << v)]
+			};
+			//Wind the face so that it faces out of the box
+			Vector3 outwards = quad[0] - position;
+			if (Vector3::Dot(Vector3::Cross(quad[1] - quad[0], quad[2] - quad[0]), outwards) < 0.0f) {
+				std::swap(quad[1], quad[3]);
+			}
+			/*
+			The diagonal always starts at the smallest corner, so that two boxes
+			sharing a face split it the same way, and the halves match up.
+			*/
+			int first = 0;
+			for (int i = 1; i < 4; ++i) {
+				const Vector3& a = quad[i];
+				const Vector3& b = quad[first];
+				if (a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)))) {
+					first = i;
+				}
+			}
+			AddTriangle(quad[first], quad[(first + 1) % 4], quad[(first + 2) % 4]);
+			AddTriangle(quad[first], quad[(first + 2) % 4], quad[(first + 3) % 4]);
+		}
+	}
+}
+
+void MeshVolume::RemoveInternalFaces() {
+	const float snap = 1e-4f;
+
+	//Each triangle's corners, snapped to a grid and sorted, so matching faces give the same key
+	struct Key {
+		long long	values[9];
+		int			triangle;
+
+		bool operator<(const Key& other) const {
+			return std::lexicographical_compare(values, values + 9, other.values, other.values + 9);
+		}
+		bool operator==(const Key& other) const {
+			return std::equal(values, values + 9, other.values);
+		}
+	};
+
+	std::vector<Key> keys(triangles.size());
+	for (size_t t = 0; t < triangles.size(); ++t) {
+		long long corners[3][3];
+		for (int p = 0; p < 3; ++p) {
+			for (int i = 0; i < 3; ++i) {
+				corners[p][i] = (long long)std::floor(triangles[t].points[p][i] / snap + 0.5f);
+			}
+		}
+		int order[3] = { 0, 1, 2 };
+		std::sort(order, order + 3, [&](int a, int b) {
+			return std::lexicographical_compare(corners[a], corners[a] + 3, corners[b], corners[b] + 3);
+		});
+		for (int p = 0; p < 3; ++p) {
+			for (int i = 0; i < 3; ++i) {
+				keys[t].values[p * 3 + i] = corners[order[p]][i];
+			}
+		}
+		keys[t].triangle = (int)t;
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<bool> removed(triangles.size(), false);
+	for (size_t i = 0; i + 1 < keys.size(); ++i) {
+		if (!(keys[i] == keys[i + 1])) {
+			continue;
+		}
+		const Triangle& a = triangles[keys[i].triangle];
+		const Triangle& b = triangles[keys[i + 1].triangle];
+		Vector3 normalA = Vector3::Cross(a.points[1] - a.points[0], a.points[2] - a.points[0]);
+		Vector3 normalB = Vector3::Cross(b.points[1] - b.points[0], b.points[2] - b.points[0]);
+		if (Vector3::Dot(normalA, normalB) < 0.0f) {
+			removed[keys[i].triangle]		= true;
+			removed[keys[i + 1].triangle]	= true;
+			++i;
+		}
+	}
+
+	size_t kept = 0;
+	for (size_t t = 0; t < triangles.size(); ++t) {
+		if (!removed[t]) {
+			triangles[kept++] = triangles[t];
+		}
+	}
+	triangles.resize(kept);
+}
+
+void MeshVolume::Build() {
+	RemoveInternalFaces();
+
+	nodes.clear();
+	if (triangles.empty()) {
+		return;
+	}
+	std::vector<Vector3> centres(triangles.size());
+	for (size_t i = 0; i < triangles.size(); ++i) {
+		centres[i] = (triangles[i].points[0] + triangles[i].points[1] + triangles[i].points[2]) / 3.0f;
+	}
+	nodes.reserve(triangles.size() * 2);
+	nodes.emplace_back();
+	BuildNode(0, 0, (int)triangles.size(), 0, centres);
+}
+
+namespace {
+	struct Bounds {
+		Vector3 min = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3 max = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		void Grow(const Vector3& p) {
+			min = Vector3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+			max = Vector3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+		}
+		void Grow(const Bounds& b) {
+			Grow(b.min);
+			Grow(b.max);
+		}
+		float Area() const {
+			Vector3 size = max - min;
+			return 2.0f * ((size.x * size.y) + (size.y * size.z) + (size.z * size.x));
+		}
+	};
+}
+
+void MeshVolume::BuildNode(int index, int start, int end, int depth, std::vector<Vector3>& centres) {
+	Bounds bounds;
+	Bounds centreBounds;
+	for (int i = start; i < end; ++i) {
+		for (int p = 0; p < 3; ++p) {
+			bounds.Grow(triangles[i].points[p]);
+		}
+		centreBounds.Grow(centres[i]);
+	}
+	nodes[index].min	= bounds.min;
+	nodes[index].max	= bounds.max;
+	nodes[index].start	= start;
+	nodes[index].count	= end - start;
+
+	int count = end - start;
+	if (count <= MaxLeafTriangles || depth >= MaxDepth) {
+		return;
+	}
+
+	/*
+	Rather than trying a split between every pair of triangles, they're
+	dropped into a few evenly spaced bins along each axis, and only the
+	splits between bins are tried, which is nearly as good and much quicker.
+	*/
+	float	bestCost	= FLT_MAX;
+	int		bestAxis	= -1;
+	int		bestSplit	= 0;
+	for (int axis = 0; axis < 3; ++axis) {
+		float extent = centreBounds.max[axis] - centreBounds.min[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+		Bounds	binBounds[SplitBins];
+		int		binCounts[SplitBins] = { 0 };
+		for (int i = start; i < end; ++i) {
+			int bin = std::min(SplitBins - 1, (int)(((centres[i][axis] - centreBounds.min[axis]) / extent) * SplitBins));
+			binCounts[bin]++;
+			for (int p = 0; p < 3; ++p) {
+				binBounds[bin].Grow(triangles[i].points[p]);
+			}
+		}
+
+		float	rightAreas[SplitBins];
+		int		rightCounts[SplitBins];
+		Bounds	right;
+		int		rightCount = 0;
+		for (int bin = SplitBins - 1; bin > 0; --bin) {
+			if (binCounts[bin] > 0) {
+				right.Grow(binBounds[bin]);
+				rightCount += binCounts[bin];
+			}
+			rightAreas[bin]		= rightCount > 0 ? right.Area() : 0.0f;
+			rightCounts[bin]	= rightCount;
+		}
+
+		Bounds	left;
+		int		leftCount = 0;
+		for (int bin = 0; bin < SplitBins - 1; ++bin) {
+			if (binCounts[bin] > 0) {
+				left.Grow(binBounds[bin]);
+				leftCount += binCounts[bin];
+			}
+			if (leftCount == 0 || rightCounts[bin + 1] == 0) {
+				continue;
+			}
+			float cost = (left.Area() * leftCount) + (rightAreas[bin + 1] * rightCounts[bin + 1]);
+			if (cost < bestCost) {
+				bestCost	= cost;
+				bestAxis	= axis;
+				bestSplit	= bin + 1;
+			}
+		}
+	}
+
+	//Nowhere to split, as every triangle is in the same place
+	if (bestAxis < 0) {
+		return;
+	}
+
+	float extent	= centreBounds.max[bestAxis] - centreBounds.min[bestAxis];
+	int mid			= start;
+	for (int i = start; i < end; ++i) {
+		int bin = std::min(SplitBins - 1, (int)(((centres[i][bestAxis] - centreBounds.min[bestAxis]) / extent) * SplitBins));
+		if (bin < bestSplit) {
+			std::swap(triangles[i], triangles[mid]);
+			std::swap(centres[i], centres[mid]);
+			mid++;
+		}
+	}
+
+	int left = (int)nodes.size();
+	nodes.emplace_back();
+	BuildNode(left, start, mid, depth + 1, centres);
+
+	int right = (int)nodes.size();
+	nodes.emplace_back();
+	BuildNode(right, mid, end, depth + 1, centres);
+
+	nodes[index].start = right;
+	nodes[index].count = 0;
+}
+
+bool MeshVolume::Raycast(const Vector3& origin, const Vector3& direction, float maxDistance, float& outDistance, int& outTriangle) const {
+	if (nodes.empty()) {
+		return false;
+	}
+	Vector3 invDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	float	bestDistance	= maxDistance;
+	int		bestTriangle	= -1;
+
+	int stack[MaxDepth + 1];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		int			index	= stack[--top];
+		const Node& node	= nodes[index];
+
+		//Slab test against the node's box, skipping it if it's past the nearest hit so far
+		float tMin = 0.0f;
+		float tMax = bestDistance;
+		for (int i = 0; i < 3; ++i) {
+			float t0 = (node.min[i] - origin[i]) * invDirection[i];
+			float t1 = (node.max[i] - origin[i]) * invDirection[i];
+			tMin = std::max(tMin, std::min(t0, t1));
+			tMax = std::min(tMax, std::max(t0, t1));
+		}
+		if (tMin > tMax) {
+			continue;
+		}
+
+		if (node.count == 0) {
+			stack[top++] = node.start;
+			stack[top++] = index + 1;
+			continue;
+		}
+		for (int i = node.start; i < node.start + node.count; ++i) {
+			const Triangle& tri = triangles[i];
+			Vector3 edgeA	= tri.points[1] - tri.points[0];
+			Vector3 edgeB	= tri.points[2] - tri.points[0];
+			Vector3 p		= Vector3::Cross(direction, edgeB);
+			float det		= Vector3::Dot(edgeA, p);
+			if (std::abs(det) < 1e-12f) {
+				continue;
+			}
+			float	invDet	= 1.0f / det;
+			Vector3 offset	= origin - tri.points[0];
+			float	u		= Vector3::Dot(offset, p) * invDet;
+			if (u < 0.0f || u > 1.0f) {
+				continue;
+			}
+			Vector3 q	= Vector3::Cross(offset, edgeA);
+			float	v	= Vector3::Dot(direction, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f) {
+				continue;
+			}
+			float t = Vector3::Dot(edgeB, q) * invDet;
+			if (t >= 0.0f && t < bestDistance) {
+				bestDistance = t;
+				bestTriangle = i;
+			}
+		}
+	}
+	if (bestTriangle < 0) {
+		return false;
+	}
+	outDistance = bestDistance;
+	outTriangle = bestTriangle;
+	return true;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "../../Common/Vector3.h"
+#include "../../Common/Quaternion.h"
+#include <vector>
+
+namespace NCL {
+	class MeshGeometry;
+
+	/*
+	A volume made of triangles, for static level geometry. Unlike the other
+	volumes it doesn't have to be convex, so a whole level can be a single
+	object, rather than thousands of boxes that each need their own place
+	in the broadphase.
+
+	Testing every triangle would be far too slow, so they're sorted into a
+	bounding volume hierarchy when the mesh is built. Each split is chosen
+	with the surface area heuristic - the chance of a query reaching a
+	child is roughly proportional to its surface area, so the split that
+	gives the cheapest children, weighted by their areas, is picked. The
+	nodes are kept in one flat array, in depth first order, so each node's
+	left child is always the node right after it.
+
+	Everything here is in the mesh's local space - CollisionDetection and
+	MeshCollision move queries into it using the object's transform.
+	*/
+	class MeshVolume : CollisionVolume
+	{
+	public:
+		//An empty mesh, to be filled in with AddTriangle and AddBox, and then built
+		MeshVolume();
+		//Takes the triangles of a mesh made of triangle lists or strips
+		MeshVolume(const MeshGeometry& mesh);
+		MeshVolume(const std::vector<Maths::Vector3>& positions, const std::vector<unsigned int>& indices);
+		~MeshVolume();
+
+		void AddTriangle(const Maths::Vector3& a, const Maths::Vector3& b, const Maths::Vector3& c);
+		void AddBox(const Maths::Vector3& position, const Maths::Vector3& halfSize, const Maths::Quaternion& orientation = Maths::Quaternion());
+
+		/*
+		Builds the hierarchy, after all the triangles are added. Any faces
+		that are exactly on top of each other but facing opposite ways, such
+		as the sides of two neighbouring boxes, are inside the level and can
+		never be touched, so they are thrown away first. Left in, they'd
+		catch the edges of objects sliding across the seam between them.
+		*/
+		void Build();
+
+		int GetTriangleCount() const {
+			return (int)triangles.size();
+		}
+
+		void GetTriangle(int index, Maths::Vector3& a, Maths::Vector3& b, Maths::Vector3& c) const {
+			a = triangles[index].points[0];
+			b = triangles[index].points[1];
+			c = triangles[index].points[2];
+		}
+
+		void GetBounds(Maths::Vector3& outMin, Maths::Vector3& outMax) const {
+			outMin = nodes.empty() ? Maths::Vector3() : nodes[0].min;
+			outMax = nodes.empty() ? Maths::Vector3() : nodes[0].max;
+		}
+
+		/*
+		Calls func with the index of every triangle in a leaf whose bounds
+		overlap the given box. Triangles near the box can come back too, so
+		it's up to func to do the exact test.
+		*/
+		template<class F>
+		void QueryBox(const Maths::Vector3& boxMin, const Maths::Vector3& boxMax, F func) const {
+			if (nodes.empty()) {
+				return;
+			}
+			int stack[MaxDepth + 1];
+			int top = 0;
+			stack[top++] = 0;
+			while (top > 0) {
+				int			index	= stack[--top];
+				const Node& node	= nodes[index];
+				if (node.min.x > boxMax.x || node.max.x < boxMin.x ||
+					node.min.y > boxMax.y || node.max.y < boxMin.y ||
+					node.min.z > boxMax.z || node.max.z < boxMin.z) {
+					continue;
+				}
+				if (node.count > 0) {
+					for (int i = node.start; i < node.start + node.count; ++i) {
+						func(i);
+					}
+				}
+				else {
+					stack[top++] = node.start;
+					stack[top++] = index + 1;
+				}
+			}
+		}
+
+		//Finds the nearest triangle along the ray, if any are hit before maxDistance
+		bool Raycast(const Maths::Vector3& origin, const Maths::Vector3& direction, float maxDistance, float& outDistance, int& outTriangle) const;
+
+	protected:
+		struct Triangle {
+			Maths::Vector3 points[3];
+		};
+
+		/*
+		A leaf has a count, and holds the triangles from start onwards. Other
+		nodes have a count of 0, with their left child straight after them in
+		the array, and their right child at start.
+		*/
+		struct Node {
+			Maths::Vector3 min;
+			Maths::Vector3 max;
+			int		start;
+			int		count;
+		};
+
+		static const int MaxLeafTriangles	= 4;
+		static const int MaxDepth			= 48;
+		static const int SplitBins			= 12;
+
+		void RemoveInternalFaces();
+		void BuildNode(int index, int start, int end, int depth, std::vector<Maths::Vector3>& centres);
+
+		std::vector<Triangle>	triangles;
+		std::vector<Node>		nodes;
+	};
+}
@@ -21,8 +21,8 @@ NavigationGrid::NavigationGrid()	{
 	allNodes	= nullptr;
 }
 
-NavigationGrid::NavigationGrid(const std::string&filename) : NavigationGrid() {
-	std::ifstream infile(Assets::DATADIR + filename);
+NavigationGrid::NavigationGrid(const std::string&filename, const std::string& directory) : NavigationGrid() {
+	std::ifstream infile(directory + filename);
 
 	infile >> nodeSize;
 	infile >> gridWidth;
@@ -1,5 +1,6 @@
 #pragma once
 #include "NavigationMap.h"
+#include "../../Common/Assets.h"
 #include <string>
 namespace NCL {
 	namespace CSC8503 {
@@ -30,7 +31,7 @@ namespace NCL {
 		class NavigationGrid : public NavigationMap	{
 		public:
 			NavigationGrid();
-			NavigationGrid(const std::string&filename);
+			NavigationGrid(const std::string&filename, const std::string& directory = Assets::DATADIR);
 			~NavigationGrid();
 
 			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) override;
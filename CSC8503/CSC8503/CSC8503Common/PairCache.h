@@ -0,0 +1,193 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <assert.h>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A hash map from a pair of objects to some data about them, used to
+		keep track of which pairs are touching. The entries are kept packed
+		together in one array, so walking over every pair is just a loop,
+		and a separate open addressed table of indices is used to look a
+		pair up. Removing an entry moves the last one into its place.
+
+		Neither array ever shrinks, so once the cache has grown to fit the
+		busiest frame, adding and removing pairs doesn't allocate anything.
+		Indices are only stable until the next Insert or Remove.
+		*/
+		template<class T>
+		class PairCache {
+		public:
+			typedef uint64_t PairKey;
+
+			//The same for (a, b) and (b, a), and unique for any two 32 bit IDs
+			static PairKey MakeKey(int idA, int idB) {
+				uint32_t low	= (uint32_t)std::min(idA, idB);
+				uint32_t high	= (uint32_t)std::max(idA, idB);
+				return ((PairKey)high << 32) | low;
+			}
+
+			PairCache() {
+				count = 0;
+			}
+			~PairCache() {
+			}
+
+			void Clear() {
+				std::fill(slots.begin(), slots.end(), -1);
+				count = 0;
+			}
+
+			int GetCount() const {
+				return count;
+			}
+
+			T& Get(int index) {
+				return entries[index].value;
+			}
+
+			const T& Get(int index) const {
+				return entries[index].value;
+			}
+
+			PairKey GetKey(int index) const {
+				return entries[index].key;
+			}
+
+			//Returns -1 if the pair isn't in the cache
+			int Find(PairKey key) const {
+				if (slots.empty()) {
+					return -1;
+				}
+				size_t mask = slots.size() - 1;
+				for (size_t s = Hash(key) & mask; slots[s] != -1; s = (s + 1) & mask) {
+					if (entries[slots[s]].key == key) {
+						return slots[s];
+					}
+				}
+				return -1;
+			}
+
+			/*
+			Returns the index of the pair's entry, adding a default constructed
+			one if it wasn't there already.
+			*/
+			int Insert(PairKey key, bool& added) {
+				int index = Find(key);
+				if (index != -1) {
+					added = false;
+					return index;
+				}
+				if ((count + 1) * 2 > (int)slots.size()) {
+					Grow();
+				}
+				index = count++;
+				if (index == (int)entries.size()) {
+					entries.emplace_back();
+				}
+				entries[index].key		= key;
+				entries[index].value	= T();
+
+				size_t mask = slots.size() - 1;
+				size_t s	= Hash(key) & mask;
+				while (slots[s] != -1) {
+					s = (s + 1) & mask;
+				}
+				slots[s]	= index;
+				added		= true;
+				return index;
+			}
+
+			void Remove(int index) {
+				RemoveSlot(FindSlot(entries[index].key));
+
+				int last = count - 1;
+				if (index != last) {
+					//Move the last entry down, and point its slot at where it now lives
+					slots[FindSlot(entries[last].key)] = index;
+					std::swap(entries[index], entries[last]);
+				}
+				count--;
+			}
+
+			/*
+			Puts the entries in order of their keys. Which order pairs were
+			added in can depend on things like the shape of the broadphase
+			tree, so this gives an order that only depends on which pairs
+			are in the cache.
+			*/
+			void SortByKey() {
+				std::sort(entries.begin(), entries.begin() + count, [](const Entry& a, const Entry& b) {
+					return a.key < b.key;
+				});
+				Rehash(slots.size());
+			}
+
+		protected:
+			struct Entry {
+				PairKey key;
+				T		value;
+			};
+
+			static size_t Hash(PairKey key) {
+				key *= 0x9E3779B97F4A7C15ull;
+				return (size_t)(key >> 32) ^ (size_t)key;
+			}
+
+			size_t FindSlot(PairKey key) const {
+				size_t mask = slots.size() - 1;
+				size_t s	= Hash(key) & mask;
+				while (entries[slots[s]].key != key) {
+					s = (s + 1) & mask;
+				}
+				return s;
+			}
+
+			/*
+			Rather than leaving a 'deleted' marker behind, which would slowly
+			fill the table up, the entries after the hole are shuffled back
+			into it if they would have wanted to be there.
+			*/
+			void RemoveSlot(size_t hole) {
+				size_t mask = slots.size() - 1;
+				size_t s	= hole;
+				while (true) {
+					s = (s + 1) & mask;
+					if (slots[s] == -1) {
+						break;
+					}
+					size_t home = Hash(entries[slots[s]].key) & mask;
+					//Can the entry at s move back to the hole without passing its home slot?
+					if (((s - home) & mask) >= ((s - hole) & mask)) {
+						slots[hole] = slots[s];
+						hole		= s;
+					}
+				}
+				slots[hole] = -1;
+			}
+
+			void Grow() {
+				Rehash(std::max((size_t)64, slots.size() * 2));
+			}
+
+			void Rehash(size_t newSize) {
+				slots.assign(newSize, -1);
+
+				size_t mask = newSize - 1;
+				for (int i = 0; i < count; ++i) {
+					size_t s = Hash(entries[i].key) & mask;
+					while (slots[s] != -1) {
+						s = (s + 1) & mask;
+					}
+					slots[s] = i;
+				}
+			}
+
+			std::vector<Entry>	entries;
+			std::vector<int>	slots;
+			int					count;
+		};
+	}
+}
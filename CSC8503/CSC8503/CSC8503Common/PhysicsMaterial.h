@@ -0,0 +1,43 @@
+#pragma once
+
+namespace NCL {
+	namespace CSC8503 {
+		//How many materials the physics system's table can hold
+		static const int MaxPhysicsMaterials = 32;
+
+		/*
+		How two materials' values are combined when they touch. If the two
+		materials want different ways, whichever is later in this list wins,
+		so something made to always bounce (Maximum) still bounces off a
+		material that just uses the default.
+		*/
+		enum class MaterialCombine {
+			Average,
+			Minimum,
+			Multiply,
+			Maximum
+		};
+
+		/*
+		What a body is made of, as far as its contacts are concerned. Bodies
+		don't keep their own copy - they just keep which entry in the physics
+		system's material table they use, so thousands of bodies can share a
+		handful of materials.
+		*/
+		struct PhysicsMaterial {
+			float restitution		= 0.8f;	//How much of the speed it hits something with it bounces back off with
+			float staticFriction	= 0.8f;	//How hard it can be pushed sideways before it starts to slide...
+			float dynamicFriction	= 0.8f;	//...and how much it's held back once it's sliding
+
+			MaterialCombine restitutionCombine	= MaterialCombine::Multiply;
+			MaterialCombine frictionCombine		= MaterialCombine::Average;
+
+			/*
+			Soft contacts are pushed apart directly and given a single bounce
+			at their deepest point, rather than going through the solver. Only
+			one of the pair has to be soft.
+			*/
+			bool softContacts = false;
+		};
+	}
+}
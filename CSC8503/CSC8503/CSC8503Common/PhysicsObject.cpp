@@ -1,6 +1,9 @@
 #include "PhysicsObject.h"
 #include "PhysicsSystem.h"
 #include "../CSC8503Common/Transform.h"
+#include "CompoundVolume.h"
+
+#include <cmath>
 using namespace NCL;
 using namespace CSC8503;
 
@@ -8,46 +11,162 @@ PhysicsObject::PhysicsObject(Transform* parentTransform, const CollisionVolume*
 	transform	= parentTransform;
 	volume		= parentVolume;
 
-	inverseMass = 1.0f;
-	elasticity	= 0.8f;
-	friction	= 0.8f;
+	bodyStore	= &RigidBodyStore::Unattached();
+	bodyIndex	= bodyStore->AddBody(this, transform);
+
+	SetInverseMass(1.0f);
+	material	= 0;
 
-	isTrigger	= false;
+	isTrigger		= false;
+	isContinuous	= false;
+	solverIndex		= -1;
 }
 
 PhysicsObject::~PhysicsObject()	{
+	bodyStore->RemoveBody(bodyIndex);
+}
 
+void PhysicsObject::SetBodyStore(RigidBodyStore& store) {
+	if (&store == bodyStore) {
+		return;
+	}
+	bodyIndex = store.TakeBody(*bodyStore, bodyIndex);
+	bodyStore = &store;
 }
 
-void PhysicsObject::ApplyAngularImpulse(const Vector3& force) {
-	if (force.Length() > 0) {
-		bool a = true;
+void PhysicsObject::Sleep() {
+	bodyStore->GetField(RigidBodyStore::Asleep)[bodyIndex] = 1.0f;
+	SetLinearVelocity(Vector3());
+	SetAngularVelocity(Vector3());
+}
+
+void PhysicsObject::Wake() {
+	if (!IsAsleep()) {
+		return;
 	}
-	angularVelocity += inverseInteriaTensor * force;
+	bodyStore->GetField(RigidBodyStore::Asleep)[bodyIndex]		= 0.0f;
+	bodyStore->GetField(RigidBodyStore::SleepTimer)[bodyIndex]	= 0.0f;
+}
+
+void PhysicsObject::ApplyAngularImpulse(const Vector3& force) {
+	Wake();
+	Vector3 angularVelocity = GetAngularVelocity();
+	angularVelocity += GetInertiaTensor() * force;
+	SetAngularVelocity(angularVelocity);
 }
 
 void PhysicsObject::ApplyLinearImpulse(const Vector3& force) {
-	linearVelocity += force * inverseMass;
+	Wake();
+	Vector3 linearVelocity = GetLinearVelocity();
+	linearVelocity += force * GetInverseMass();
+	SetLinearVelocity(linearVelocity);
 }
 
 void PhysicsObject::AddForce(const Vector3& addedForce) {
-	force += addedForce;
+	Wake();
+	bodyStore->SetVector(RigidBodyStore::ForceX, bodyIndex, GetForce() + addedForce);
 }
 
 void PhysicsObject::AddForceAtPosition(const Vector3& addedForce, const Vector3& position) {
+	Wake();
 	Vector3 localPos = position - transform->GetPosition();
 
-	force  += addedForce;
-	torque += Vector3::Cross(localPos, addedForce);
+	bodyStore->SetVector(RigidBodyStore::ForceX, bodyIndex, GetForce() + addedForce);
+	bodyStore->SetVector(RigidBodyStore::TorqueX, bodyIndex, GetTorque() + Vector3::Cross(localPos, addedForce));
 }
 
 void PhysicsObject::AddTorque(const Vector3& addedTorque) {
-	torque += addedTorque;
+	Wake();
+	bodyStore->SetVector(RigidBodyStore::TorqueX, bodyIndex, GetTorque() + addedTorque);
 }
 
 void PhysicsObject::ClearForces() {
-	force				= Vector3();
-	torque				= Vector3();
+	bodyStore->SetVector(RigidBodyStore::ForceX, bodyIndex, Vector3());
+	bodyStore->SetVector(RigidBodyStore::TorqueX, bodyIndex, Vector3());
+}
+
+namespace {
+	void SetInertiaFrame(RigidBodyStore& store, int index, const Quaternion& q) {
+		store.GetField(RigidBodyStore::InertiaFrameX)[index] = q.x;
+		store.GetField(RigidBodyStore::InertiaFrameY)[index] = q.y;
+		store.GetField(RigidBodyStore::InertiaFrameZ)[index] = q.z;
+		store.GetField(RigidBodyStore::InertiaFrameW)[index] = q.w;
+	}
+
+	/*
+	Jacobi's method - each pass rotates away one of the values off the
+	diagonal, which only disturbs the others a little, so a few sweeps over
+	all three leaves the eigenvalues down the diagonal, and the rotations
+	multiplied together as the eigenvectors.
+	*/
+	void Diagonalise(const Matrix3& m, Vector3& outValues, float outVectors[3][3]) {
+		float a[3][3];
+		for (int r = 0; r < 3; ++r) {
+			for (int c = 0; c < 3; ++c) {
+				a[r][c]				= m.array[(c * 3) + r];
+				outVectors[r][c]	= (r == c) ? 1.0f : 0.0f;
+			}
+		}
+		const int pairs[3][2] = { {0, 1}, {0, 2}, {1, 2} };
+		for (int sweep = 0; sweep < 16; ++sweep) {
+			float off	= (a[0][1] * a[0][1]) + (a[0][2] * a[0][2]) + (a[1][2] * a[1][2]);
+			float diag	= (a[0][0] * a[0][0]) + (a[1][1] * a[1][1]) + (a[2][2] * a[2][2]);
+			if (off <= 1e-12f * diag) {
+				break;
+			}
+			for (const auto& pair : pairs) {
+				int p = pair[0];
+				int q = pair[1];
+				if (a[p][q] == 0.0f) {
+					continue;
+				}
+				float theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+				float t		= (theta >= 0.0f ? 1.0f : -1.0f) / (std::abs(theta) + std::sqrt((theta * theta) + 1.0f));
+				float c		= 1.0f / std::sqrt((t * t) + 1.0f);
+				float s		= t * c;
+				for (int k = 0; k < 3; ++k) {
+					float kp = a[k][p], kq = a[k][q];
+					a[k][p] = (c * kp) - (s * kq);
+					a[k][q] = (s * kp) + (c * kq);
+				}
+				for (int k = 0; k < 3; ++k) {
+					float pk = a[p][k], qk = a[q][k];
+					a[p][k] = (c * pk) - (s * qk);
+					a[q][k] = (s * pk) + (c * qk);
+				}
+				for (int k = 0; k < 3; ++k) {
+					float kp = outVectors[k][p], kq = outVectors[k][q];
+					outVectors[k][p] = (c * kp) - (s * kq);
+					outVectors[k][q] = (s * kp) + (c * kq);
+				}
+			}
+		}
+		outValues = Vector3(a[0][0], a[1][1], a[2][2]);
+	}
+
+	//Quaternion(Matrix3) falls apart for half turns, so this picks whichever part is largest to divide by
+	Quaternion RotationToQuaternion(const float m[3][3]) {
+		float trace = m[0][0] + m[1][1] + m[2][2];
+		Quaternion q;
+		if (trace > 0.0f) {
+			float s = 2.0f * std::sqrt(1.0f + trace);
+			q = Quaternion((m[2][1] - m[1][2]) / s, (m[0][2] - m[2][0]) / s, (m[1][0] - m[0][1]) / s, 0.25f * s);
+		}
+		else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+			float s = 2.0f * std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]);
+			q = Quaternion(0.25f * s, (m[0][1] + m[1][0]) / s, (m[0][2] + m[2][0]) / s, (m[2][1] - m[1][2]) / s);
+		}
+		else if (m[1][1] > m[2][2]) {
+			float s = 2.0f * std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]);
+			q = Quaternion((m[0][1] + m[1][0]) / s, 0.25f * s, (m[1][2] + m[2][1]) / s, (m[0][2] - m[2][0]) / s);
+		}
+		else {
+			float s = 2.0f * std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]);
+			q = Quaternion((m[0][2] + m[2][0]) / s, (m[1][2] + m[2][1]) / s, 0.25f * s, (m[1][0] - m[0][1]) / s);
+		}
+		q.Normalise();
+		return q;
+	}
 }
 
 void PhysicsObject::InitCubeInertia() {
@@ -57,23 +176,69 @@ void PhysicsObject::InitCubeInertia() {
 
 	Vector3 dimsSqr		= fullWidth * fullWidth;
 
+	float inverseMass = GetInverseMass();
+	Vector3 inverseInertia;
 	inverseInertia.x = (12.0f * inverseMass) / (dimsSqr.y + dimsSqr.z);
 	inverseInertia.y = (12.0f * inverseMass) / (dimsSqr.x + dimsSqr.z);
 	inverseInertia.z = (12.0f * inverseMass) / (dimsSqr.x + dimsSqr.y);
+
+	bodyStore->SetVector(RigidBodyStore::InverseInertiaX, bodyIndex, inverseInertia);
+	SetInertiaFrame(*bodyStore, bodyIndex, Quaternion());
 }
 
 void PhysicsObject::InitSphereInertia() {
 	float radius	= transform->GetScale().GetMaxElement();
-	float i			= 2.5f * inverseMass / (radius*radius);
+	float i			= 2.5f * GetInverseMass() / (radius*radius);
+
+	bodyStore->SetVector(RigidBodyStore::InverseInertiaX, bodyIndex, Vector3(i, i, i));
+	SetInertiaFrame(*bodyStore, bodyIndex, Quaternion());
+}
+
+void PhysicsObject::InitCompoundInertia() {
+	float inverseMass = GetInverseMass();
+	if (!volume || volume->type != VolumeType::Compound || inverseMass <= 0.0f) {
+		bodyStore->SetVector(RigidBodyStore::InverseInertiaX, bodyIndex, Vector3());
+		SetInertiaFrame(*bodyStore, bodyIndex, Quaternion());
+		return;
+	}
+	Matrix3 inertia = ((const CompoundVolume&)*volume).GetInertia(1.0f / inverseMass);
+
+	Vector3 moments;
+	float	axes[3][3];
+	Diagonalise(inertia, moments, axes);
+
+	//The axes have to make a rotation, rather than a reflection
+	float determinant =
+		axes[0][0] * ((axes[1][1] * axes[2][2]) - (axes[1][2] * axes[2][1])) -
+		axes[0][1] * ((axes[1][0] * axes[2][2]) - (axes[1][2] * axes[2][0])) +
+		axes[0][2] * ((axes[1][0] * axes[2][1]) - (axes[1][1] * axes[2][0]));
+	if (determinant < 0.0f) {
+		for (int r = 0; r < 3; ++r) {
+			axes[r][2] = -axes[r][2];
+		}
+	}
+	Vector3 inverseInertia(
+		moments.x > 0.0f ? 1.0f / moments.x : 0.0f,
+		moments.y > 0.0f ? 1.0f / moments.y : 0.0f,
+		moments.z > 0.0f ? 1.0f / moments.z : 0.0f);
 
-	inverseInertia	= Vector3(i, i, i);
+	bodyStore->SetVector(RigidBodyStore::InverseInertiaX, bodyIndex, inverseInertia);
+	SetInertiaFrame(*bodyStore, bodyIndex, RotationToQuaternion(axes));
 }
 
 void PhysicsObject::UpdateInertiaTensor() {
-	Quaternion q = transform->GetOrientation();
+	const float* frame[4] = {
+		bodyStore->GetField(RigidBodyStore::InertiaFrameX), bodyStore->GetField(RigidBodyStore::InertiaFrameY),
+		bodyStore->GetField(RigidBodyStore::InertiaFrameZ), bodyStore->GetField(RigidBodyStore::InertiaFrameW)
+	};
+	Quaternion q = transform->GetOrientation() * Quaternion(frame[0][bodyIndex], frame[1][bodyIndex], frame[2][bodyIndex], frame[3][bodyIndex]);
 	
 	Matrix3 invOrientation	= Matrix3(q.Conjugate());
 	Matrix3 orientation		= Matrix3(q);
 
-	inverseInteriaTensor = orientation * Matrix3::Scale(inverseInertia) *invOrientation;
+	Matrix3 inverseInteriaTensor = orientation * Matrix3::Scale(bodyStore->GetVector(RigidBodyStore::InverseInertiaX, bodyIndex)) *invOrientation;
+
+	for (int i = 0; i < 9; ++i) {
+		bodyStore->GetField((RigidBodyStore::Field)(RigidBodyStore::InverseTensor0 + i))[bodyIndex] = inverseInteriaTensor.array[i];
+	}
 }
@@ -1,6 +1,10 @@
 #pragma once
 #include "../../Common/Vector3.h"
 #include "../../Common/Matrix3.h"
+#include "RigidBodyStore.h"
+#include "PhysicsMaterial.h"
+
+#include <assert.h>
 
 using namespace NCL::Maths;
 
@@ -10,33 +14,38 @@ namespace NCL {
 	namespace CSC8503 {
 		class Transform;
 
+		/*
+		The motion state of a PhysicsObject (its velocities, mass, forces and
+		so on) is kept in a RigidBodyStore, so the object itself just knows
+		where to find it.
+		*/
 		class PhysicsObject	{
 		public:
 			PhysicsObject(Transform* parentTransform, const CollisionVolume* parentVolume);
 			~PhysicsObject();
 
 			Vector3 GetLinearVelocity() const {
-				return linearVelocity;
+				return bodyStore->GetVector(RigidBodyStore::LinearVelocityX, bodyIndex);
 			}
 
 			Vector3 GetAngularVelocity() const {
-				return angularVelocity;
+				return bodyStore->GetVector(RigidBodyStore::AngularVelocityX, bodyIndex);
 			}
 
 			Vector3 GetTorque() const {
-				return torque;
+				return bodyStore->GetVector(RigidBodyStore::TorqueX, bodyIndex);
 			}
 
 			Vector3 GetForce() const {
-				return force;
+				return bodyStore->GetVector(RigidBodyStore::ForceX, bodyIndex);
 			}
 
 			void SetInverseMass(float invMass) {
-				inverseMass = invMass;
+				bodyStore->GetField(RigidBodyStore::InverseMass)[bodyIndex] = invMass;
 			}
 
 			float GetInverseMass() const {
-				return inverseMass;
+				return bodyStore->GetField(RigidBodyStore::InverseMass)[bodyIndex];
 			}
 
 			void ApplyAngularImpulse(const Vector3& force);
@@ -52,30 +61,46 @@ namespace NCL {
 			void ClearForces();
 
 			void SetLinearVelocity(const Vector3& v) {
-				linearVelocity = v;
+				bodyStore->SetVector(RigidBodyStore::LinearVelocityX, bodyIndex, v);
 			}
 
 			void SetAngularVelocity(const Vector3& v) {
-				angularVelocity = v;
+				bodyStore->SetVector(RigidBodyStore::AngularVelocityX, bodyIndex, v);
 			}
 
 			void InitCubeInertia();
 			void InitSphereInertia();
+			/*
+			For objects with a CompoundVolume. Its inertia tensor is worked out
+			for the current mass, and turned to face along its principal axes,
+			where it has no products of inertia, so that it can be stored like
+			the others as just 3 numbers, along with which way those axes face.
+			*/
+			void InitCompoundInertia();
 
 			void UpdateInertiaTensor();
 
 			Matrix3 GetInertiaTensor() const {
-				return inverseInteriaTensor;
+				return bodyStore->GetInverseTensor(bodyIndex);
 			}
 
-			void SetElasticity(float e)
-			{
-				elasticity = e;
+			/*
+			Which of the physics system's materials this object is made of. An
+			index outside the table (such as the -1 AddMaterial gives back when
+			the table's full) is rejected, and the object keeps the material it
+			had. An index that's in the table but hasn't been added yet acts
+			like material 0 until it is.
+			*/
+			void SetMaterial(int index) {
+				assert(index >= 0 && index < MaxPhysicsMaterials);
+				if (index < 0 || index >= MaxPhysicsMaterials) {
+					return;
+				}
+				material = (unsigned char)index;
 			}
 
-			void SetFirction(float f)
-			{
-				friction = f;
+			int GetMaterial() const {
+				return material;
 			}
 
 			bool GetTrigger()
@@ -88,24 +113,65 @@ namespace NCL {
 				isTrigger = state;
 			}
 
+			/*
+			Fast, small objects (such as bullets) can move right through thin
+			ones in a single step. With this set, any step where the object
+			moves further than its own thickness is checked along the whole
+			path, and it's stopped where it first hits something.
+			*/
+			void SetContinuous(bool state) {
+				isContinuous = state;
+			}
+
+			bool IsContinuous() const {
+				return isContinuous;
+			}
+
+			//Where this object sits in the world's object list, for the island solver
+			void SetSolverIndex(int index) {
+				solverIndex = index;
+			}
+
+			int GetSolverIndex() const {
+				return solverIndex;
+			}
+
+			bool IsAsleep() const {
+				return bodyStore->GetField(RigidBodyStore::Asleep)[bodyIndex] != 0.0f;
+			}
+
+			float GetSleepTimer() const {
+				return bodyStore->GetField(RigidBodyStore::SleepTimer)[bodyIndex];
+			}
+
+			//Sleeping objects are left out of the simulation until something disturbs them
+			void Sleep();
+			void Wake();
+
+			//Moves this object's state over into another store, such as a GameWorld's
+			void SetBodyStore(RigidBodyStore& store);
+
+			RigidBodyStore& GetBodyStore() const {
+				return *bodyStore;
+			}
+
+			int GetBodyIndex() const {
+				return bodyIndex;
+			}
+
 		protected:
+			friend class RigidBodyStore;
+
 			const CollisionVolume* volume;
 			Transform*		transform;
 
-			float inverseMass;
-			float elasticity;
-			float friction;
-			bool  isTrigger;
-
-			//linear stuff
-			Vector3 linearVelocity;
-			Vector3 force;
+			RigidBodyStore*	bodyStore;
+			int				bodyIndex;
 
-			//angular stuff
-			Vector3 angularVelocity;
-			Vector3 torque;
-			Vector3 inverseInertia;
-			Matrix3 inverseInteriaTensor;
+			unsigned char material;
+			bool  isTrigger;
+			bool  isContinuous;
+			int   solverIndex;
 		};
 	}
 }
@@ -3,12 +3,16 @@
 #include "GameObject.h"
 #include "CollisionDetection.h"
 #include "../../Common/Quaternion.h"
+#include "../../Common/GameTimer.h"
+#include "../../Common/Maths.h"
 
 #include "Constraint.h"
 
 #include "Debug.h"
 
 #include <functional>
+#include <algorithm>
+#include <cmath>
 using namespace NCL;
 using namespace CSC8503;
 
@@ -19,12 +23,21 @@ and the forces that are added to objects to change those positions
 
 */
 
-PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g)	{
+PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g), ropes(g)	{
 	applyGravity	= false;
-	useBroadPhase	= false;	
+	useBroadPhase	= true;
 	dTOffset		= 0.0f;
 	globalDamping	= 0.995f;
 	SetGravity(Vector3(0.0f, -9.8f, 0.0f));
+
+	narrowPhaseFrame = 0;
+
+	materialPairs.resize(MaxMaterials * MaxMaterials);
+	AddMaterial(PhysicsMaterial());
+
+	for (int i = 0; i < GameObject::LayerCount; ++i) {
+		layerCollisions[i] = 0xFFFFFFFF;
+	}
 }
 
 PhysicsSystem::~PhysicsSystem()	{
@@ -45,125 +58,378 @@ any collisions they are in.
 
 */
 void PhysicsSystem::Clear() {
-	allCollisions.clear();
+	allCollisions.Clear();
+	simplexCaches.Clear();
+	stepContacts.clear();
+	stepContactIsSoft.clear();
+	ropes.Clear();
 }
 
-/*
+void PhysicsSystem::SetLayerCollision(int layerA, int layerB, bool state) {
+	assert(layerA >= 0 && layerA < GameObject::LayerCount && layerB >= 0 && layerB < GameObject::LayerCount);
+	if (layerA < 0 || layerA >= GameObject::LayerCount || layerB < 0 || layerB >= GameObject::LayerCount) {
+		return;
+	}
+	if (state) {
+		layerCollisions[layerA] |= (1u << layerB);
+		layerCollisions[layerB] |= (1u << layerA);
+	}
+	else {
+		layerCollisions[layerA] &= ~(1u << layerB);
+		layerCollisions[layerB] &= ~(1u << layerA);
+	}
+}
 
-This is the core of the physics engine update
+static float CombineMaterials(float a, float b, MaterialCombine mode) {
+	switch (mode) {
+		case MaterialCombine::Minimum:	return std::min(a, b);
+		case MaterialCombine::Multiply:	return a * b;
+		case MaterialCombine::Maximum:	return std::max(a, b);
+		default:						return (a + b) * 0.5f;
+	}
+}
 
-*/
-int constraintIterationCount = 10;
+int PhysicsSystem::AddMaterial(const PhysicsMaterial& material) {
+	if ((int)materials.size() == MaxMaterials) {
+		return -1;
+	}
+	materials.emplace_back(material);
+	UpdateMaterialPairs();
+	return (int)materials.size() - 1;
+}
 
-//This is the fixed timestep we'd LIKE to have
-const int   idealHZ = 120;
-const float idealDT = 1.0f / idealHZ;
+void PhysicsSystem::SetMaterial(int index, const PhysicsMaterial& material) {
+	assert(index >= 0 && index < GetMaterialCount());
+	if (index < 0 || index >= GetMaterialCount()) {
+		return;
+	}
+	materials[index] = material;
+	UpdateMaterialPairs();
+}
+
+/*
+The whole table is worked out again whenever a material changes - it's
+small, and materials hardly ever change. Slots that haven't been added yet
+are filled in as material 0, so an object pointed at one is still safe.
+*/
+void PhysicsSystem::UpdateMaterialPairs() {
+	for (int i = 0; i < MaxMaterials; ++i) {
+		const PhysicsMaterial& a = materials[i < GetMaterialCount() ? i : 0];
+		for (int j = 0; j < MaxMaterials; ++j) {
+			const PhysicsMaterial& b = materials[j < GetMaterialCount() ? j : 0];
+
+			MaterialPair& pair = materialPairs[(i * MaxMaterials) + j];
+			pair.restitution		= CombineMaterials(a.restitution, b.restitution, std::max(a.restitutionCombine, b.restitutionCombine));
+			pair.staticFriction		= CombineMaterials(a.staticFriction, b.staticFriction, std::max(a.frictionCombine, b.frictionCombine));
+			pair.dynamicFriction	= CombineMaterials(a.dynamicFriction, b.dynamicFriction, std::max(a.frictionCombine, b.frictionCombine));
+			pair.softContacts		= a.softContacts || b.softContacts;
+		}
+	}
+}
 
 /*
-This is the fixed update we actually have...
-If physics takes too long it starts to kill the framerate, it'll drop the 
-iteration count down until the FPS stabilises, even if that ends up
-being at a low rate. 
+Saved states start with this, so that restoring from something that isn't
+one fails straight away rather than part of the way through.
 */
-int realHZ		= idealHZ;
-float realDT	= idealDT;
+static const uint32_t StateMagic = 0x50485953;
 
-void PhysicsSystem::Update(float dt) {	
-	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::B)) {
-		useBroadPhase = !useBroadPhase;
-		std::cout << "Setting broadphase to " << useBroadPhase << std::endl;
+void PhysicsSystem::SaveState(StateBuffer& buffer) const {
+	RigidBodyStore& bodies = gameWorld.GetBodyStore();
+
+	std::vector<Constraint*>::const_iterator firstConstraint;
+	std::vector<Constraint*>::const_iterator lastConstraint;
+	gameWorld.GetConstraintIterators(firstConstraint, lastConstraint);
+
+	const int bodyCount			= bodies.GetBodyCount();
+	const int constraintCount	= (int)(lastConstraint - firstConstraint);
+
+	buffer.Clear();
+	buffer.Write(StateMagic);
+	buffer.Write(bodyCount);
+	buffer.Write(constraintCount);
+	buffer.Write(dTOffset);
+	buffer.Write(narrowPhaseFrame);
+
+	//The body store's arrays go in whole, one after another
+	for (int f = 0; f < RigidBodyStore::FieldCount; ++f) {
+		buffer.WriteBytes(bodies.GetField((RigidBodyStore::Field)f), bodyCount * sizeof(float));
 	}
-	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::I)) {
-		constraintIterationCount--;
-		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
+	//...but the Transforms are what really own where everything is
+	for (int i = 0; i < bodyCount; ++i) {
+		Vector3		p = bodies.GetTransform(i)->GetPosition();
+		Quaternion	q = bodies.GetTransform(i)->GetOrientation();
+		float values[7] = { p.x, p.y, p.z, q.x, q.y, q.z, q.w };
+		buffer.WriteBytes(values, sizeof(values));
 	}
-	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::O)) {
-		constraintIterationCount++;
-		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
+
+	for (auto i = firstConstraint; i != lastConstraint; ++i) {
+		buffer.Write((*i)->lastRowCount);
+		buffer.WriteBytes((*i)->lastImpulses, (*i)->lastRowCount * sizeof(float));
 	}
 
-	dTOffset += dt; //We accumulate time delta here - there might be remainders from previous frame!
+	//Pairs are stored by world ID, and go back into the caches in the same order
+	buffer.Write(allCollisions.GetCount());
+	for (int i = 0; i < allCollisions.GetCount(); ++i) {
+		const CollisionDetection::CollisionInfo& c = allCollisions.Get(i);
+		buffer.Write(allCollisions.GetKey(i));
+		buffer.Write(c.a->GetWorldID());
+		buffer.Write(c.framesLeft);
+		buffer.Write(c.pointCount);
+		buffer.WriteBytes(c.points, c.pointCount * sizeof(CollisionDetection::ContactPoint));
+	}
 
-	GameTimer t;
-	t.GetTimeDeltaSeconds();
+	buffer.Write(simplexCaches.GetCount());
+	for (int i = 0; i < simplexCaches.GetCount(); ++i) {
+		const SimplexCache& cache = simplexCaches.Get(i);
+		buffer.Write(simplexCaches.GetKey(i));
+		buffer.Write(cache.direction);
+		buffer.Write(cache.hasDirection);
+		buffer.Write(cache.lastUsed);
+	}
 
-	if (useBroadPhase) {
-		UpdateObjectAABBs();
+	ropes.SaveState(buffer);
+}
+
+bool PhysicsSystem::RestoreState(StateBuffer& buffer) {
+	RigidBodyStore& bodies = gameWorld.GetBodyStore();
+
+	std::vector<Constraint*>::const_iterator firstConstraint;
+	std::vector<Constraint*>::const_iterator lastConstraint;
+	gameWorld.GetConstraintIterators(firstConstraint, lastConstraint);
+
+	uint32_t	magic			= 0;
+	int			bodyCount		= 0;
+	int			constraintCount	= 0;
+
+	buffer.Rewind();
+	if (!buffer.Read(magic) || magic != StateMagic ||
+		!buffer.Read(bodyCount) || bodyCount != bodies.GetBodyCount() ||
+		!buffer.Read(constraintCount) || constraintCount != (int)(lastConstraint - firstConstraint) ||
+		!buffer.Read(dTOffset) || !buffer.Read(narrowPhaseFrame)) {
+		return false;
 	}
 
-	while(dTOffset >= realDT) {
-		IntegrateAccel(realDT); //Update accelerations from external forces
-		if (useBroadPhase) {
-			BroadPhase();
-			NarrowPhase();
+	for (int f = 0; f < RigidBodyStore::FieldCount; ++f) {
+		if (!buffer.ReadBytes(bodies.GetField((RigidBodyStore::Field)f), bodyCount * sizeof(float))) {
+			return false;
 		}
-		else {
-			BasicCollisionDetection();
+	}
+	for (int i = 0; i < bodyCount; ++i) {
+		float values[7];
+		if (!buffer.ReadBytes(values, sizeof(values))) {
+			return false;
 		}
+		bodies.GetTransform(i)->SetPosition(Vector3(values[0], values[1], values[2]));
+		bodies.GetTransform(i)->SetOrientation(Quaternion(values[3], values[4], values[5], values[6]));
+	}
+	bodies.ReadTransforms(0, bodyCount);
 
-		//This is our simple iterative solver - 
-		//we just run things multiple times, slowly moving things forward
-		//and then rechecking that the constraints have been met		
-		float constraintDt = realDT /  (float)constraintIterationCount;
-		for (int i = 0; i < constraintIterationCount; ++i) {
-			UpdateConstraints(constraintDt);	
+	for (auto i = firstConstraint; i != lastConstraint; ++i) {
+		int rowCount = 0;
+		if (!buffer.Read(rowCount) || rowCount < 0 || rowCount > Constraint::MaxRows ||
+			!buffer.ReadBytes((*i)->lastImpulses, rowCount * sizeof(float))) {
+			return false;
 		}
-		IntegrateVelocity(realDT); //update positions from new velocity changes
+		(*i)->lastRowCount = rowCount;
+	}
 
-		dTOffset -= realDT;
+	/*
+	Anything that's been moved back might now be somewhere the broadphase
+	tree doesn't think it is - and if it's asleep, it wouldn't be moved
+	in the tree again until it woke up.
+	*/
+	AABBTree<GameObject*>& tree = gameWorld.GetBroadphaseTree();
+
+	stateObjects.assign(gameWorld.GetWorldIDCount(), nullptr);
+	gameWorld.OperateOnContents([&](GameObject* o) {
+		stateObjects[o->GetWorldID()] = o;
+		if (o->GetBroadphaseProxy() != -1) {
+			Vector3 halfSizes;
+			o->UpdateBroadphaseAABB();
+			o->GetBroadphaseAABB(halfSizes);
+			tree.Move(o->GetBroadphaseProxy(), o->GetTransform().GetPosition(), halfSizes);
+		}
+	});
+	auto findObject = [&](uint32_t id) -> GameObject* {
+		return id < stateObjects.size() ? stateObjects[id] : nullptr;
+	};
+
+	allCollisions.Clear();
+	stepContacts.clear();
+	stepContactIsSoft.clear();
+
+	int collisionCount = 0;
+	if (!buffer.Read(collisionCount)) {
+		return false;
+	}
+	for (int i = 0; i < collisionCount; ++i) {
+		uint64_t	key			= 0;
+		int		aID			= 0;
+		int		framesLeft	= 0;
+		int		pointCount	= 0;
+		if (!buffer.Read(key) || !buffer.Read(aID) || !buffer.Read(framesLeft) || !buffer.Read(pointCount) ||
+			pointCount < 0 || pointCount > CollisionDetection::MaxContactPoints) {
+			return false;
+		}
+		uint32_t	low		= (uint32_t)(key & 0xFFFFFFFF);
+		uint32_t	high	= (uint32_t)(key >> 32);
+		GameObject* a		= findObject(aID);
+		GameObject* b		= findObject((uint32_t)aID == low ? high : low);
+		if (!a || !b) {
+			return false;
+		}
+		bool added = false;
+		CollisionDetection::CollisionInfo& entry = allCollisions.Get(allCollisions.Insert(key, added));
+		entry.a				= a;
+		entry.b				= b;
+		entry.framesLeft	= framesLeft;
+		entry.pointCount	= pointCount;
+		if (!buffer.ReadBytes(entry.points, pointCount * sizeof(CollisionDetection::ContactPoint))) {
+			return false;
+		}
 	}
 
-	ClearForces();	//Once we've finished with the forces, reset them to zero
+	simplexCaches.Clear();
 
-	UpdateCollisionList(); //Remove any old collisions
+	int cacheCount = 0;
+	if (!buffer.Read(cacheCount)) {
+		return false;
+	}
+	for (int i = 0; i < cacheCount; ++i) {
+		uint64_t		key = 0;
+		SimplexCache	saved;
+		if (!buffer.Read(key) || !buffer.Read(saved.direction) || !buffer.Read(saved.hasDirection) || !buffer.Read(saved.lastUsed)) {
+			return false;
+		}
+		bool added = false;
+		simplexCaches.Get(simplexCaches.Insert(key, added)) = saved;
+	}
 
-	t.Tick();
-	float updateTime = t.GetTimeDeltaSeconds();
+	return ropes.RestoreState(buffer);
+}
+
+/*
+
+This is the core of the physics engine update
+
+The physics always moves forward in steps of the same length, no matter
+how long each frame takes, so it behaves the same on every machine. Any
+time left over that isn't enough for a whole step is carried over to the
+next frame, and objects are drawn that fraction of the way between their
+last two steps, so they still move smoothly.
+
+If physics takes too long, each frame has even more steps to catch up
+on, which take even longer... To stop that 'spiral of death', there's a
+limit on how many steps a single update can take. Once it's reached,
+the rest of the time is thrown away, and the game slows down instead.
+
+*/
+void PhysicsSystem::Update(float dt) {	
+	dTOffset += dt; //We accumulate time delta here - there might be remainders from previous frame!
+
+	GameTimer t;
+	t.GetTimeDeltaSeconds();
+
+	int substeps = std::min((int)(dTOffset / fixedDeltaTime), maxSubsteps);
+	for (int i = 0; i < substeps; ++i) {
+		//Only the last step matters for drawing between steps
+		if (useInterpolation && i == substeps - 1) {
+			SavePreviousTransforms();
+		}
+		FixedStep(fixedDeltaTime);
+		dTOffset -= fixedDeltaTime;
+	}
 
 	//Uh oh, physics is taking too long...
-	if (updateTime > realDT) {
-		realHZ /= 2;
-		realDT *= 2;
-		//std::cout << "Dropping iteration count due to long physics time...(now " << realHZ << ")\n";
+	stats.droppedTime = 0.0f;
+	if (dTOffset >= fixedDeltaTime) {
+		float remainder = fmod(dTOffset, fixedDeltaTime);
+		stats.droppedTime		= dTOffset - remainder;
+		stats.totalDroppedTime	+= stats.droppedTime;
+		stats.droppedUpdates++;
+		dTOffset = remainder;
 	}
-	else if(dt*2 < realDT) { //we have plenty of room to increase iteration count!
-		int temp = realHZ;
-		realHZ *= 2;
-		realDT /= 2;
 
-		if (realHZ > idealHZ) {
-			realHZ = idealHZ;
-			realDT = idealDT;
-		}
-		if (temp != realHZ) {
-			//std::cout << "Raising iteration count due to short physics time...(now " << realHZ << ")\n";
-		}
+	/*
+	At high frame rates plenty of frames don't get a step at all, and those
+	have to leave any forces added for the next one, and not count towards
+	how many frames a contact has gone without being found.
+	*/
+	if (substeps > 0) {
+		ClearForces();	//Once we've finished with the forces, reset them to zero
+
+		UpdateCollisionList(); //Remove any old collisions
+	}
+
+	stats.substeps		= substeps;
+	stats.interpolation	= dTOffset / fixedDeltaTime;
+	if (useInterpolation) {
+		InterpolateTransforms(stats.interpolation);
 	}
+
+	t.Tick();
+	stats.updateTime = t.GetTimeDeltaSeconds();
+}
+
+//A single fixed length step of the simulation
+void PhysicsSystem::FixedStep(float dt) {
+	IntegrateAccel(dt); //Update accelerations from external forces
+	stepContacts.clear();
+	stepContactIsSoft.clear();
+	if (useBroadPhase) {
+		BroadPhase();
+		NarrowPhase();
+		TriggerPhase();
+	}
+	else {
+		UpdateBroadphaseTree();
+		BasicCollisionDetection();
+	}
+
+	BuildIslands();
+	SolveIslands(dt); //resolve this step's contacts...
+	SolveConstraints(dt); //...then the constraints
+	ropes.Step(dt, applyGravity ? gravity : Vector3()); //ropes pull on what they're tied to before it moves
+	FindSweptBodies(dt);
+	IntegrateVelocity(dt); //update positions from new velocity changes
+	SweepBodies(dt);
+	UpdateSleeping();
 }
 
 /*
 Later on we're going to need to keep track of collisions
-across multiple frames, so we store them in a set.
+across multiple frames, so we store them in a pair cache.
 
 The first time they are added, we tell the objects they are colliding.
-The frame they are to be removed, we tell them they're no longer colliding.
+Every frame after that where they're still touching, we tell them that
+too, and the frame they are to be removed, we tell them they're no longer
+colliding.
 
 From this simple mechanism, we we build up gameplay interactions inside the
 OnCollisionBegin / OnCollisionEnd functions (removing health when hit by a 
 rocket launcher, gaining a point when the player hits the gold coin, and so on).
 */
 void PhysicsSystem::UpdateCollisionList() {
-	for (std::set<CollisionDetection::CollisionInfo>::iterator i = allCollisions.begin(); i != allCollisions.end(); ) {
-
-		if ((*i).framesLeft == numCollisionFrames) {
-			i->a->OnCollisionBegin(i->b);
-			i->b->OnCollisionBegin(i->a);
+	for (int i = 0; i < allCollisions.GetCount(); ) {
+		CollisionDetection::CollisionInfo& c = allCollisions.Get(i);
+		//Sleeping objects aren't tested against each other, but they're still touching
+		if (c.framesLeft < numCollisionFrames && !c.a->CanMove() && !c.b->CanMove()) {
+			++i;
+			continue;
+		}
+		if (c.framesLeft == numCollisionFrames) {
+			c.a->OnCollisionBegin(c.b);
+			c.b->OnCollisionBegin(c.a);
+		}
+		else if (c.framesLeft == numCollisionFrames - 1) { //Touched again this frame
+			c.a->OnCollisionPersist(c.b);
+			c.b->OnCollisionPersist(c.a);
 		}
-		(*i).framesLeft = (*i).framesLeft - 1;
-		if ((*i).framesLeft < 0) {
-			i->a->OnCollisionEnd(i->b);
-			i->b->OnCollisionEnd(i->a);
-			i = allCollisions.erase(i);
+		c.framesLeft = c.framesLeft - 1;
+		if (c.framesLeft < 0) {
+			c.a->OnCollisionEnd(c.b);
+			c.b->OnCollisionEnd(c.a);
+			allCollisions.Remove(i); //The last pair is moved into i, so don't step past it
 		}
 		else {
 			++i;
@@ -203,28 +469,80 @@ void PhysicsSystem::BasicCollisionDetection() {
 			if ((*j)->GetPhysicsObject() == nullptr)
 				continue;
 
-			CollisionDetection::CollisionInfo info;
-			if (CollisionDetection::ObjectIntersection(*i, *j, info))
+			if (!(*i)->CanMove() && !(*j)->CanMove())
+				continue;
+
+			if (!ShouldCollide(*i, *j))
+				continue;
+
+			if ((*i)->GetPhysicsObject()->GetTrigger() || (*j)->GetPhysicsObject()->GetTrigger())
 			{
-				if ((*i)->GetPhysicsObject()->GetTrigger() || (*j)->GetPhysicsObject()->GetTrigger())
+				if ((*i)->GetBoundingVolume() && (*j)->GetBoundingVolume() &&
+					CollisionDetection::VolumeOverlap(*(*i)->GetBoundingVolume(), (*i)->GetTransform(), *(*j)->GetBoundingVolume(), (*j)->GetTransform()))
 				{
-					continue;
+					AddTriggerOverlap(*i, *j);
 				}
-				if ((*i)->GetTag() == "Prop" || (*j)->GetTag() == "Prop")
-				{
-					PenaltyResolveCollision(*info.a, *info.b, info.point);
-				}
-				else
-				{
-					//std::cout << "Collision between " << (*i)->GetName() << " and " << (*j)->GetName() << std::endl;
-					ImpulseResolveCollision(*info.a, *info.b, info.point);
+				continue;
+			}
+
+			CollisionDetection::CollisionInfo info;
+			if (CollisionDetection::ObjectIntersection(*i, *j, info))
+			{
+				AddCollision(info);
+			}
+		}
+	}
+}
+
+/*
+Both the basic and the broadphase collision detection methods end up here
+once a pair has been found to be truly colliding. Triggers are only ever
+detected, never resolved. Everything else is kept as a contact for the
+island solver to resolve, once every contact for this step has been found.
+
+If the pair were already touching, their manifold is updated in place.
+Any new point close to one of last step's points is assumed to be the
+same point, and takes over the impulses the solver found for it, so the
+solver can 'warm start' from them. Resting contacts then hardly need any
+iterations at all, as the answer barely changes from step to step.
+*/
+void PhysicsSystem::AddCollision(CollisionDetection::CollisionInfo& info) {
+	PhysicsObject* physA = info.a->GetPhysicsObject();
+	PhysicsObject* physB = info.b->GetPhysicsObject();
+
+	if (physA->GetTrigger() || physB->GetTrigger())
+	{
+		return;
+	}
+	//Something awake has run into something asleep, so wake it up
+	physA->Wake();
+	physB->Wake();
+
+	bool added = false;
+	int index = allCollisions.Insert(PairCache<CollisionDetection::CollisionInfo>::MakeKey(info.a->GetWorldID(), info.b->GetWorldID()), added);
+	CollisionDetection::CollisionInfo& entry = allCollisions.Get(index);
+
+	//The impulses only carry over if the pair are the same way around as last time
+	if (!added && entry.a == info.a) {
+		const float matchDistance = 0.1f;
+		for (int i = 0; i < info.pointCount; ++i) {
+			CollisionDetection::ContactPoint& p = info.points[i];
+			for (int j = 0; j < entry.pointCount; ++j) {
+				if ((entry.points[j].localA - p.localA).LengthSquared() < matchDistance * matchDistance) {
+					p.normalImpulse		= entry.points[j].normalImpulse;
+					p.frictionImpulse	= entry.points[j].frictionImpulse;
+					break;
 				}
-				info.framesLeft = numCollisionFrames;
-				allCollisions.insert(info);
-				
 			}
 		}
 	}
+	//Still touching, so keep it alive (but leave new pairs to begin as normal)
+	int framesLeft = (added || entry.framesLeft == numCollisionFrames) ? numCollisionFrames : numCollisionFrames - 1;
+
+	entry				= info;
+	entry.framesLeft	= framesLeft;
+	stepContacts.emplace_back(index);
+	stepContactIsSoft.emplace_back(GetMaterialPair(physA, physB).softContacts);
 }
 
 /*
@@ -232,51 +550,163 @@ void PhysicsSystem::BasicCollisionDetection() {
 In tutorial 5, we start determining the correct response to a collision,
 so that objects separate back out. 
 
+Rather than resolving each contact once, we use a sequential impulse
+solver - every contact point in an island is visited several times over,
+each time pushing the objects just enough to stop that one point from
+closing (and from sliding, up to the limit that friction allows). The
+impulse accumulated at each point is clamped, rather than each individual
+push, so later iterations can take back some of what earlier ones did.
+
+Overlaps are pushed apart by a small extra separating speed (the 'bias'),
+instead of moving the objects directly, so that stacks don't fight each
+other's position corrections. A little overlap ('slop') is allowed, so
+that resting contacts stay touching from one step to the next.
+
 */
-void PhysicsSystem::ImpulseResolveCollision(GameObject& a, GameObject& b, CollisionDetection::ContactPoint& p) const {
-	PhysicsObject* physA	= a.GetPhysicsObject();
-	PhysicsObject* physB	= b.GetPhysicsObject();
+static const float baumgarte			= 0.2f;
+static const float penetrationSlop		= 0.01f;
+static const float restitutionSpeed		= 1.0f;	//Slower impacts don't bounce
+
+static void ApplyContactImpulse(PhysicsObject* physA, PhysicsObject* physB, const Vector3& relativeA, const Vector3& relativeB, const Vector3& impulse) {
+	//Immovable objects can be shared between islands solving at the same time, so they're never written to
+	if (physA->GetInverseMass() > 0)
+	{
+		physA->ApplyLinearImpulse(-impulse);
+		physA->ApplyAngularImpulse(Vector3::Cross(relativeA, -impulse));
+	}
+	if (physB->GetInverseMass() > 0)
+	{
+		physB->ApplyLinearImpulse(impulse);
+		physB->ApplyAngularImpulse(Vector3::Cross(relativeB, impulse));
+	}
+}
+
+//Rows already know how much each object's velocities change for each unit of impulse
+static void ApplyConstraintImpulse(const ConstraintRow& row, float impulse) {
+	if (row.physA->GetInverseMass() > 0) {
+		row.physA->SetLinearVelocity(row.physA->GetLinearVelocity() + (row.moveA * impulse));
+		row.physA->SetAngularVelocity(row.physA->GetAngularVelocity() + (row.turnA * impulse));
+	}
+	if (row.physB->GetInverseMass() > 0) {
+		row.physB->SetLinearVelocity(row.physB->GetLinearVelocity() + (row.moveB * impulse));
+		row.physB->SetAngularVelocity(row.physB->GetAngularVelocity() + (row.turnB * impulse));
+	}
+}
+
+static Vector3 ContactVelocity(PhysicsObject* physA, PhysicsObject* physB, const Vector3& relativeA, const Vector3& relativeB) {
+	Vector3 fullVelocityA = physA->GetLinearVelocity() + Vector3::Cross(physA->GetAngularVelocity(), relativeA);
+	Vector3 fullVelocityB = physB->GetLinearVelocity() + Vector3::Cross(physB->GetAngularVelocity(), relativeB);
+
+	return fullVelocityB - fullVelocityA;
+}
+
+static Vector3 LeverArm(const GameObject* o, const Vector3& offset) {
+	return o->CanRotate() ? offset : Vector3();
+}
 
-	Transform& transformA	= a.GetTransform();
-	Transform& transformB	= b.GetTransform();
+static float EffectiveMass(float totalMass, const Matrix3& inertiaA, const Matrix3& inertiaB, const Vector3& relativeA, const Vector3& relativeB, const Vector3& axis) {
+	Vector3 angularA = Vector3::Cross(inertiaA * Vector3::Cross(relativeA, axis), relativeA);
+	Vector3 angularB = Vector3::Cross(inertiaB * Vector3::Cross(relativeB, axis), relativeB);
+
+	float k = totalMass + Vector3::Dot(angularA + angularB, axis);
+	return k > 0.0f ? 1.0f / k : 0.0f;
+}
+
+void PhysicsSystem::PrepareContact(CollisionDetection::CollisionInfo& c, SolverPoint* points, float dt) const {
+	PhysicsObject* physA	= c.a->GetPhysicsObject();
+	PhysicsObject* physB	= c.b->GetPhysicsObject();
 
 	float totalMass			= physA->GetInverseMass() + physB->GetInverseMass();
+	Matrix3 inertiaA		= physA->GetInertiaTensor();
+	Matrix3 inertiaB		= physB->GetInertiaTensor();
 
-	if (totalMass == 0)
-		return;
+	const MaterialPair& material = GetMaterialPair(physA, physB);
 
-	//Separate them out using projection
-	transformA.SetPosition(transformA.GetPosition() - (p.normal * p.penetration * (physA->GetInverseMass() / totalMass)));
-	transformB.SetPosition(transformB.GetPosition() + (p.normal * p.penetration * (physB->GetInverseMass() / totalMass)));
+	for (int i = 0; i < c.pointCount; ++i) {
+		CollisionDetection::ContactPoint& p = c.points[i];
+		SolverPoint& s = points[i];
 
-	Vector3 relativeA		= p.localA;
-	Vector3 relativeB		= p.localB;
+		Vector3 relativeA = LeverArm(c.a, p.localA);
+		Vector3 relativeB = LeverArm(c.b, p.localB);
 
-	Vector3 angVelocityA	= Vector3::Cross(physA->GetAngularVelocity(), relativeA);
-	Vector3 angVelocityB	= Vector3::Cross(physB->GetAngularVelocity(), relativeB);
+		//Any pair of directions across the normal will do for friction
+		Vector3 n = p.normal;
+		Maths::Perpendiculars(n, s.tangentA, s.tangentB);
 
-	Vector3 fullVelocityA	= physA->GetLinearVelocity() + angVelocityA;
-	Vector3 fullVelocityB	= physB->GetLinearVelocity() + angVelocityB;
+		s.normalMass	= EffectiveMass(totalMass, inertiaA, inertiaB, relativeA, relativeB, n);
+		s.tangentMassA	= EffectiveMass(totalMass, inertiaA, inertiaB, relativeA, relativeB, s.tangentA);
+		s.tangentMassB	= EffectiveMass(totalMass, inertiaA, inertiaB, relativeA, relativeB, s.tangentB);
+		s.staticFriction	= material.staticFriction;
+		s.dynamicFriction	= material.dynamicFriction;
 
-	Vector3 contactVelocity = fullVelocityB - fullVelocityA;
+		float closingSpeed = Vector3::Dot(ContactVelocity(physA, physB, relativeA, relativeB), n);
 
-	float impulseForce		= Vector3::Dot(contactVelocity, p.normal);
-	
-	//Work out the effect of inertia
-	Vector3 inertiaA		= Vector3::Cross(physA->GetInertiaTensor() * Vector3::Cross(relativeA, p.normal), relativeA);
-	Vector3 inertiaB		= Vector3::Cross(physB->GetInertiaTensor() * Vector3::Cross(relativeB, p.normal), relativeB);
+		s.bias = (baumgarte / dt) * std::max(p.penetration - penetrationSlop, 0.0f);
+		if (closingSpeed < -restitutionSpeed) {
+			s.bias = std::max(s.bias, -material.restitution * closingSpeed);
+		}
+
+		//The normal may have turned a little since last step, so only keep the friction across it
+		p.frictionImpulse = p.frictionImpulse - (n * Vector3::Dot(p.frictionImpulse, n));
+	}
+}
 
-	float angularEffect		= Vector3::Dot(inertiaA + inertiaB, p.normal);
-	float cRestitution		= 0.66f;	//Disperse some kinectic energy
+/*
+Warm starting has to wait until every contact in the island has been
+prepared, or the bounce of one contact would be worked out from velocities
+that already include the pushes from its neighbours.
+*/
+void PhysicsSystem::WarmStartContact(const CollisionDetection::CollisionInfo& c) const {
+	PhysicsObject* physA = c.a->GetPhysicsObject();
+	PhysicsObject* physB = c.b->GetPhysicsObject();
 
-	float j					= (-(1.0f + cRestitution) * impulseForce) / (totalMass + angularEffect);
-	Vector3 fullImpulse		= p.normal * j;
+	for (int i = 0; i < c.pointCount; ++i) {
+		const CollisionDetection::ContactPoint& p = c.points[i];
 
-	physA->ApplyLinearImpulse(-fullImpulse);
-	physB->ApplyLinearImpulse(fullImpulse);
-	physA->ApplyAngularImpulse(Vector3::Cross(relativeA, -fullImpulse));
-	physB->ApplyAngularImpulse(Vector3::Cross(relativeB, fullImpulse));
+		ApplyContactImpulse(physA, physB, LeverArm(c.a, p.localA), LeverArm(c.b, p.localB), (p.normal * p.normalImpulse) + p.frictionImpulse);
+	}
 }
+
+void PhysicsSystem::SolveContact(CollisionDetection::CollisionInfo& c, SolverPoint* points) const {
+	PhysicsObject* physA = c.a->GetPhysicsObject();
+	PhysicsObject* physB = c.b->GetPhysicsObject();
+
+	for (int i = 0; i < c.pointCount; ++i) {
+		CollisionDetection::ContactPoint& p = c.points[i];
+		SolverPoint& s = points[i];
+
+		Vector3 relativeA = LeverArm(c.a, p.localA);
+		Vector3 relativeB = LeverArm(c.b, p.localB);
+
+		//Stop the point closing...
+		float normalSpeed	= Vector3::Dot(ContactVelocity(physA, physB, relativeA, relativeB), p.normal);
+		float oldImpulse	= p.normalImpulse;
+		p.normalImpulse		= std::max(oldImpulse + (s.bias - normalSpeed) * s.normalMass, 0.0f);
+
+		ApplyContactImpulse(physA, physB, relativeA, relativeB, p.normal * (p.normalImpulse - oldImpulse));
+
+		/*
+		...then stop it sliding, as far as the normal impulse lets friction do
+		so. Once it would take more than static friction to hold the point
+		still, it's sliding, and only dynamic friction holds it back.
+		*/
+		Vector3 slideVelocity	= ContactVelocity(physA, physB, relativeA, relativeB);
+		Vector3 oldFriction		= p.frictionImpulse;
+		Vector3 newFriction		= oldFriction
+			- (s.tangentA * (Vector3::Dot(slideVelocity, s.tangentA) * s.tangentMassA))
+			- (s.tangentB * (Vector3::Dot(slideVelocity, s.tangentB) * s.tangentMassB));
+
+		float maxFriction = s.staticFriction * p.normalImpulse;
+		float length = newFriction.Length();
+		if (length > maxFriction) {
+			newFriction = newFriction * ((s.dynamicFriction * p.normalImpulse) / length);
+		}
+		p.frictionImpulse = newFriction;
+
+		ApplyContactImpulse(physA, physB, relativeA, relativeB, newFriction - oldFriction);
+	}
+}
+
 void PhysicsSystem::PenaltyResolveCollision(GameObject& a, GameObject& b, CollisionDetection::ContactPoint& p) const {
 	PhysicsObject* physA = a.GetPhysicsObject();
 	PhysicsObject* physB = b.GetPhysicsObject();
@@ -293,8 +723,10 @@ void PhysicsSystem::PenaltyResolveCollision(GameObject& a, GameObject& b, Collis
 		return;
 
 	//Separate them out using projection
-	transformA.SetPosition(transformA.GetPosition() - (p.normal * p.penetration * (inverseMassA / totalMass)));
-	transformB.SetPosition(transformB.GetPosition() + (p.normal * p.penetration * (inverseMassB / totalMass)));
+	if (inverseMassA > 0)
+		transformA.SetPosition(transformA.GetPosition() - (p.normal * p.penetration * (inverseMassA / totalMass)));
+	if (inverseMassB > 0)
+		transformB.SetPosition(transformB.GetPosition() + (p.normal * p.penetration * (inverseMassB / totalMass)));
 
 	Vector3 relativeA = p.localA;
 	Vector3 relativeB = p.localB;
@@ -314,15 +746,21 @@ void PhysicsSystem::PenaltyResolveCollision(GameObject& a, GameObject& b, Collis
 	Vector3 inertiaB = Vector3::Cross(physB->GetInertiaTensor() * Vector3::Cross(relativeB, p.normal), relativeB);
 
 	float angularEffect = Vector3::Dot(inertiaA + inertiaB, p.normal);
-	float cRestitution = 0.66f;	//Disperse some kinectic energy
+	float cRestitution = GetMaterialPair(physA, physB).restitution;
 
 	float j = (-(1.0f + cRestitution) * penaltyForce) / (totalMass + angularEffect);
 	Vector3 fullImpulse = p.normal * j;
 
-	physA->ApplyLinearImpulse(-fullImpulse);
-	physB->ApplyLinearImpulse(fullImpulse);
-	physA->ApplyAngularImpulse(Vector3::Cross(relativeA, -fullImpulse));
-	physB->ApplyAngularImpulse(Vector3::Cross(relativeB, fullImpulse));
+	if (inverseMassA > 0)
+	{
+		physA->ApplyLinearImpulse(-fullImpulse);
+		physA->ApplyAngularImpulse(Vector3::Cross(relativeA, -fullImpulse));
+	}
+	if (inverseMassB > 0)
+	{
+		physB->ApplyLinearImpulse(fullImpulse);
+		physB->ApplyAngularImpulse(Vector3::Cross(relativeB, fullImpulse));
+	}
 }
 
 /*
@@ -332,11 +770,69 @@ and a narrowphase collision detection method. In the broad phase, we
 split the world up using an acceleration structure, so that we can only
 compare the collisions that we absolutely need to. 
 
+The GameWorld keeps every object in a persistent AABB tree, so here we
+only have to update the objects that can move - and even then, the tree
+only does any real work if they've left their 'fat' bounding box. Then
+each moving object asks the tree what it overlaps. Static geometry never
+does a query of its own, it's only ever found by something else, and the
+same goes for anything that's asleep.
+
 */
 
 void PhysicsSystem::BroadPhase() {
-	broadphaseCollisions.clear();
-	QuadTree <GameObject*> tree(Vector2(1024, 1024), 7, 6);
+	broadphaseCollisions.Clear();
+	triggerPairs.Clear();
+
+	if (broadPhaseType == BroadPhaseType::SortAndSweep) {
+		SweepBroadPhase();
+	}
+	else {
+		TreeBroadPhase();
+	}
+
+	//Otherwise the pairs come out in whatever order the tree or sorted lists happen to be in
+	if (deterministic) {
+		broadphaseCollisions.SortByKey();
+		triggerPairs.SortByKey();
+	}
+}
+
+void PhysicsSystem::AddBroadphasePair(GameObject* a, GameObject* b) {
+	//Two immovable objects can never need resolving against each other
+	if (a->GetPhysicsObject()->GetInverseMass() == 0.0f &&
+		b->GetPhysicsObject()->GetInverseMass() == 0.0f)
+		return;
+
+	//...and neither can two objects that are asleep, or asleep on the floor
+	if (!a->CanMove() && !b->CanMove())
+		return;
+
+	//Layers are checked here, before the narrowphase does any real work on them
+	if (!ShouldCollide(a, b))
+		return;
+
+	PairCache<CollisionDetection::CollisionInfo>& pairs =
+		(a->GetPhysicsObject()->GetTrigger() || b->GetPhysicsObject()->GetTrigger()) ? triggerPairs : broadphaseCollisions;
+
+	bool added = false;
+	int index = pairs.Insert(PairCache<CollisionDetection::CollisionInfo>::MakeKey(a->GetWorldID(), b->GetWorldID()), added);
+	if (added) {
+		CollisionDetection::CollisionInfo& info = pairs.Get(index);
+		bool aFirst = a->GetWorldID() < b->GetWorldID();
+		info.a = aFirst ? a : b;
+		info.b = aFirst ? b : a;
+	}
+}
+
+/*
+Whichever broadphase is in use, the tree is kept up to date with everything
+that moves, as the world's raycasts (and the continuous collision checks)
+go through it.
+*/
+void PhysicsSystem::UpdateBroadphaseTree() {
+	broadphaseMovers.clear();
+
+	AABBTree<GameObject*>& tree = gameWorld.GetBroadphaseTree();
 
 	std::vector <GameObject*>::const_iterator first;
 	std::vector <GameObject*>::const_iterator last;
@@ -344,26 +840,56 @@ void PhysicsSystem::BroadPhase() {
 	gameWorld.GetObjectIterators(first, last);
 	for (auto i = first; i != last; ++i)
 	{
-		Vector3 halfSizes;
-		if (!(*i)->GetBroadphaseAABB(halfSizes))
+		if ((*i)->GetBroadphaseProxy() == -1 || (*i)->GetPhysicsObject() == nullptr || !(*i)->CanMove())
 			continue;
 
-		Vector3 pos = (*i)->GetTransform().GetPosition();
-		tree.Insert(*i, pos, halfSizes);
+		Vector3 halfSizes;
+		(*i)->UpdateBroadphaseAABB();
+		(*i)->GetBroadphaseAABB(halfSizes);
+		tree.Move((*i)->GetBroadphaseProxy(), (*i)->GetTransform().GetPosition(), halfSizes);
+
+		broadphaseMovers.emplace_back(*i);
 	}
-	tree.OperateOnContents([&](std::list <QuadTreeEntry <GameObject*>>& data)
-		{
-			CollisionDetection::CollisionInfo info;
-			for (auto i = data.begin(); i != data.end(); ++i)
+}
+
+void PhysicsSystem::TreeBroadPhase() {
+	UpdateBroadphaseTree();
+
+	AABBTree<GameObject*>& tree = gameWorld.GetBroadphaseTree();
+
+	for (GameObject* o : broadphaseMovers)
+	{
+		tree.QueryPairs(o->GetBroadphaseProxy(), [&](GameObject* self, GameObject* other)
 			{
-				for (auto j = std::next(i); j != data.end(); ++j)
-				{
-					info.a = min((*i).object, (*j).object);
-					info.b = max((*i).object, (*j).object);
-					broadphaseCollisions.insert(info);
-				}
-			}
-		});
+				//If both can move, both will find each other, so only keep one of them
+				if (other->CanMove() && other->GetWorldID() < self->GetWorldID())
+					return;
+
+				//The tree stores fattened boxes, so check the real bounds really touch
+				Vector3 selfSize;
+				Vector3 otherSize;
+				self->GetBroadphaseAABB(selfSize);
+				other->GetBroadphaseAABB(otherSize);
+				if (!CollisionDetection::AABBTest(self->GetTransform().GetPosition(), other->GetTransform().GetPosition(), selfSize, otherSize))
+					return;
+
+				AddBroadphasePair(self, other);
+			});
+	}
+}
+
+/*
+The alternative to the tree - rather than a hierarchy, every object is
+kept in lists sorted along an axis, and pairs are found by sweeping along
+them. This is very quick when objects keep roughly the same order from
+one step to the next, such as in long corridors.
+*/
+void PhysicsSystem::SweepBroadPhase() {
+	UpdateBroadphaseTree();
+	sweepAndPrune.Update(gameWorld);
+	sweepAndPrune.FindPairs([&](GameObject* a, GameObject* b) {
+		AddBroadphasePair(a, b);
+	});
 }
 
 /*
@@ -372,15 +898,120 @@ The broadphase will now only give us likely collisions, so we can now go through
 and work out if they are truly colliding, and if so, add them into the main collision list
 */
 void PhysicsSystem::NarrowPhase() {
-	std::vector <GameObject*>::const_iterator first;
-	std::vector <GameObject*>::const_iterator last;
+	narrowPhaseFrame++;
+
+	/*
+	The pairs are grouped by the types of their volumes, so that each test
+	runs over all of its pairs in one go. A counting sort keeps them in
+	broadphase order within each group, so the order contacts are added
+	in only ever depends on the broadphase.
+	*/
+	const int pairTypeCount = CollisionDetection::VolumeTypeCount * CollisionDetection::VolumeTypeCount;
+	int typeOffsets[pairTypeCount + 1] = { 0 };
+
+	int pairCount = broadphaseCollisions.GetCount();
+	narrowPhaseTypes.resize(pairCount);
+	narrowPhaseCaches.resize(pairCount);
+	for (int i = 0; i < pairCount; ++i)
+	{
+		const CollisionDetection::CollisionInfo& pair = broadphaseCollisions.Get(i);
+		const CollisionVolume* volA = pair.a->GetBoundingVolume();
+		const CollisionVolume* volB = pair.b->GetBoundingVolume();
 
-	gameWorld.GetObjectIterators(first, last);
-	for (auto i = first; i != last; ++i)
+		int type = (volA && volB) ? CollisionDetection::PairType(*volA, *volB) : -1;
+		if (type >= 0 && !CollisionDetection::GetPairTest(type))
+		{
+			type = -1;
+		}
+		narrowPhaseTypes[i] = type;
+		if (type >= 0)
+		{
+			typeOffsets[type + 1]++;
+		}
+
+		//Adding to the cache can move its entries, so only indices are kept until it's done
+		narrowPhaseCaches[i] = -1;
+		if (type >= 0 && CollisionDetection::UsesGJK(*volA, *volB))
+		{
+			bool added = false;
+			narrowPhaseCaches[i] = simplexCaches.Insert(broadphaseCollisions.GetKey(i), added);
+			simplexCaches.Get(narrowPhaseCaches[i]).lastUsed = narrowPhaseFrame;
+		}
+	}
+	for (int i = 0; i < pairTypeCount; ++i)
 	{
-		(*i)->UpdateBroadphaseAABB();
+		typeOffsets[i + 1] += typeOffsets[i];
+	}
+	int testCount = typeOffsets[pairTypeCount];
+
+	narrowPhasePairs.resize(testCount);
+	narrowPhaseResults.resize(testCount);
+	for (int i = 0; i < pairCount; ++i)
+	{
+		int type = narrowPhaseTypes[i];
+		if (type < 0)
+		{
+			continue;
+		}
+		CollisionDetection::PairQuery& query = narrowPhasePairs[typeOffsets[type]++];
+		query.a			= broadphaseCollisions.Get(i).a;
+		query.b			= broadphaseCollisions.Get(i).b;
+		query.pairType	= type;
+		query.cache		= narrowPhaseCaches[i] >= 0 ? &simplexCaches.Get(narrowPhaseCaches[i]) : nullptr;
+	}
+
+	int hits = CollisionDetection::BatchIntersection(narrowPhasePairs.data(), testCount, narrowPhaseResults.data());
+	for (int i = 0; i < hits; ++i)
+	{
+		AddCollision(narrowPhaseResults[i]);
+	}
+
+	//Forget about pairs the broadphase has stopped finding
+	for (int i = 0; i < simplexCaches.GetCount(); )
+	{
+		if (simplexCaches.Get(i).lastUsed != narrowPhaseFrame)
+		{
+			simplexCaches.Remove(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+/*
+Pairs with a trigger in them never need pushing apart, so rather than
+going through the narrowphase for contact points, they're only tested for
+whether they overlap at all. Overlapping pairs still go into the collision
+list, with no contact points, so both objects are told when they start and
+stop overlapping, but they're never given to the solver.
+*/
+void PhysicsSystem::TriggerPhase() {
+	for (int i = 0; i < triggerPairs.GetCount(); ++i)
+	{
+		const CollisionDetection::CollisionInfo& pair = triggerPairs.Get(i);
+		const CollisionVolume* volA = pair.a->GetBoundingVolume();
+		const CollisionVolume* volB = pair.b->GetBoundingVolume();
+
+		if (volA && volB && CollisionDetection::VolumeOverlap(*volA, pair.a->GetTransform(), *volB, pair.b->GetTransform()))
+		{
+			AddTriggerOverlap(pair.a, pair.b);
+		}
 	}
+}
+
+void PhysicsSystem::AddTriggerOverlap(GameObject* a, GameObject* b) {
+	bool added = false;
+	int index = allCollisions.Insert(PairCache<CollisionDetection::CollisionInfo>::MakeKey(a->GetWorldID(), b->GetWorldID()), added);
+	CollisionDetection::CollisionInfo& entry = allCollisions.Get(index);
 
+	int framesLeft = (added || entry.framesLeft == numCollisionFrames) ? numCollisionFrames : numCollisionFrames - 1;
+
+	entry.a				= a;
+	entry.b				= b;
+	entry.framesLeft	= framesLeft;
+	entry.pointCount	= 0;
 }
 
 /*
@@ -391,39 +1022,138 @@ without worrying about repeated forces accumulating etc.
 This function will update both linear and angular acceleration,
 based on any forces that have been accumulated in the objects during
 the course of the previous game frame.
+
+Both integration functions work straight on the world's RigidBodyStore,
+rather than through each PhysicsObject. Each value is in an array of its
+own, so every loop below is just arithmetic over contiguous floats, which
+the compiler can turn into vector instructions. The bodies are split into
+batches, and the batches shared out across the job system.
 */
-void PhysicsSystem::IntegrateAccel(float dt) {
-	std::vector <GameObject*>::const_iterator first;
-	std::vector <GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
+static const int integrationBatchSize = 256;
 
-	for (auto i = first; i != last; ++i)
-	{
-		PhysicsObject* object = (*i)->GetPhysicsObject();
-		if (object == nullptr)
-			continue;
+void PhysicsSystem::SavePreviousTransforms() {
+	RigidBodyStore& bodies = gameWorld.GetBodyStore();
 
-		float inverseMass	= object->GetInverseMass();
-		Vector3 linearVel	= object->GetLinearVelocity();
-		Vector3 force		= object->GetForce();
-		Vector3 accel		= force * inverseMass;
+	const int bodyCount		= bodies.GetBodyCount();
+	const int batchCount	= (bodyCount + integrationBatchSize - 1) / integrationBatchSize;
 
-		if (applyGravity && inverseMass > 0)
-			accel += gravity;
+	jobSystem.ParallelFor(batchCount, [&](int batch) {
+		int start	= batch * integrationBatchSize;
+		int end		= (start + integrationBatchSize < bodyCount) ? start + integrationBatchSize : bodyCount;
+		bodies.SavePreviousTransforms(start, end);
+	});
+	ropes.SavePreviousPositions();
+}
 
-		linearVel += accel * dt;
-		object->SetLinearVelocity(linearVel);
+void PhysicsSystem::InterpolateTransforms(float alpha) {
+	RigidBodyStore& bodies = gameWorld.GetBodyStore();
 
-		//Angular Stuff
-		Vector3 torque = object->GetTorque();
-		Vector3 angVel = object->GetAngularVelocity();
+	const int bodyCount		= bodies.GetBodyCount();
+	const int batchCount	= (bodyCount + integrationBatchSize - 1) / integrationBatchSize;
 
-		object->UpdateInertiaTensor();
+	jobSystem.ParallelFor(batchCount, [&](int batch) {
+		int start	= batch * integrationBatchSize;
+		int end		= (start + integrationBatchSize < bodyCount) ? start + integrationBatchSize : bodyCount;
+		bodies.InterpolateTransforms(start, end, alpha);
+	});
+	ropes.InterpolatePositions(alpha);
+}
 
-		Vector3 angAccel = object->GetInertiaTensor() * torque;
-		angVel += angAccel * dt;
-		object->SetAngularVelocity(angVel);
-	}
+void PhysicsSystem::IntegrateAccel(float dt) {
+	RigidBodyStore& bodies = gameWorld.GetBodyStore();
+
+	const int bodyCount		= bodies.GetBodyCount();
+	const int batchCount	= (bodyCount + integrationBatchSize - 1) / integrationBatchSize;
+
+	const Vector3 g = applyGravity ? gravity : Vector3();
+
+	jobSystem.ParallelFor(batchCount, [&](int batch) {
+		int start	= batch * integrationBatchSize;
+		int end		= (start + integrationBatchSize < bodyCount) ? start + integrationBatchSize : bodyCount;
+
+		bodies.ReadOrientations(start, end);
+
+		const float* __restrict invMass	= bodies.GetField(RigidBodyStore::InverseMass);
+		const float* __restrict forceX	= bodies.GetField(RigidBodyStore::ForceX);
+		const float* __restrict forceY	= bodies.GetField(RigidBodyStore::ForceY);
+		const float* __restrict forceZ	= bodies.GetField(RigidBodyStore::ForceZ);
+		float* __restrict velX			= bodies.GetField(RigidBodyStore::LinearVelocityX);
+		float* __restrict velY			= bodies.GetField(RigidBodyStore::LinearVelocityY);
+		float* __restrict velZ			= bodies.GetField(RigidBodyStore::LinearVelocityZ);
+		const float* __restrict asleep	= bodies.GetField(RigidBodyStore::Asleep);
+
+		for (int i = start; i < end; ++i) {
+			//Only things that can move feel gravity, and sleeping objects don't feel anything
+			float gravityScale	= (invMass[i] > 0.0f) ? 1.0f : 0.0f;
+			float awakeDt		= (1.0f - asleep[i]) * dt;
+			velX[i] += (forceX[i] * invMass[i] + g.x * gravityScale) * awakeDt;
+			velY[i] += (forceY[i] * invMass[i] + g.y * gravityScale) * awakeDt;
+			velZ[i] += (forceZ[i] * invMass[i] + g.z * gravityScale) * awakeDt;
+		}
+
+		//Angular Stuff
+		const float* __restrict qx		= bodies.GetField(RigidBodyStore::OrientationX);
+		const float* __restrict qy		= bodies.GetField(RigidBodyStore::OrientationY);
+		const float* __restrict qz		= bodies.GetField(RigidBodyStore::OrientationZ);
+		const float* __restrict qw		= bodies.GetField(RigidBodyStore::OrientationW);
+		const float* __restrict inertX	= bodies.GetField(RigidBodyStore::InverseInertiaX);
+		const float* __restrict inertY	= bodies.GetField(RigidBodyStore::InverseInertiaY);
+		const float* __restrict inertZ	= bodies.GetField(RigidBodyStore::InverseInertiaZ);
+		const float* __restrict frameX	= bodies.GetField(RigidBodyStore::InertiaFrameX);
+		const float* __restrict frameY	= bodies.GetField(RigidBodyStore::InertiaFrameY);
+		const float* __restrict frameZ	= bodies.GetField(RigidBodyStore::InertiaFrameZ);
+		const float* __restrict frameW	= bodies.GetField(RigidBodyStore::InertiaFrameW);
+		const float* __restrict torqueX	= bodies.GetField(RigidBodyStore::TorqueX);
+		const float* __restrict torqueY	= bodies.GetField(RigidBodyStore::TorqueY);
+		const float* __restrict torqueZ	= bodies.GetField(RigidBodyStore::TorqueZ);
+		float* __restrict t0			= bodies.GetField(RigidBodyStore::InverseTensor0);
+		float* __restrict t1			= bodies.GetField(RigidBodyStore::InverseTensor1);
+		float* __restrict t2			= bodies.GetField(RigidBodyStore::InverseTensor2);
+		float* __restrict t3			= bodies.GetField(RigidBodyStore::InverseTensor3);
+		float* __restrict t4			= bodies.GetField(RigidBodyStore::InverseTensor4);
+		float* __restrict t5			= bodies.GetField(RigidBodyStore::InverseTensor5);
+		float* __restrict t6			= bodies.GetField(RigidBodyStore::InverseTensor6);
+		float* __restrict t7			= bodies.GetField(RigidBodyStore::InverseTensor7);
+		float* __restrict t8			= bodies.GetField(RigidBodyStore::InverseTensor8);
+		float* __restrict angX			= bodies.GetField(RigidBodyStore::AngularVelocityX);
+		float* __restrict angY			= bodies.GetField(RigidBodyStore::AngularVelocityY);
+		float* __restrict angZ			= bodies.GetField(RigidBodyStore::AngularVelocityZ);
+
+		for (int i = start; i < end; ++i) {
+			//The body's orientation, followed by its inertia frame, as in Quaternion::operator*
+			float x = (qx[i] * frameW[i]) + (qw[i] * frameX[i]) + (qy[i] * frameZ[i]) - (qz[i] * frameY[i]);
+			float y = (qy[i] * frameW[i]) + (qw[i] * frameY[i]) + (qz[i] * frameX[i]) - (qx[i] * frameZ[i]);
+			float z = (qz[i] * frameW[i]) + (qw[i] * frameZ[i]) + (qx[i] * frameY[i]) - (qy[i] * frameX[i]);
+			float w = (qw[i] * frameW[i]) - (qx[i] * frameX[i]) - (qy[i] * frameY[i]) - (qz[i] * frameZ[i]);
+
+			//The same rotation matrix as Matrix3(Quaternion), one row at a time
+			float xx = x * x, yy = y * y, zz = z * z;
+			float xy = x * y, xz = x * z, yz = y * z;
+			float xw = x * w, yw = y * w, zw = z * w;
+
+			float r00 = 1 - 2 * yy - 2 * zz, r01 = 2 * xy - 2 * zw, r02 = 2 * xz + 2 * yw;
+			float r10 = 2 * xy + 2 * zw, r11 = 1 - 2 * xx - 2 * zz, r12 = 2 * yz - 2 * xw;
+			float r20 = 2 * xz - 2 * yw, r21 = 2 * yz + 2 * xw, r22 = 1 - 2 * xx - 2 * yy;
+
+			//R * Scale(inverseInertia) * R^T, which is symmetric
+			float sx = inertX[i], sy = inertY[i], sz = inertZ[i];
+			float i00 = r00 * r00 * sx + r01 * r01 * sy + r02 * r02 * sz;
+			float i11 = r10 * r10 * sx + r11 * r11 * sy + r12 * r12 * sz;
+			float i22 = r20 * r20 * sx + r21 * r21 * sy + r22 * r22 * sz;
+			float i01 = r00 * r10 * sx + r01 * r11 * sy + r02 * r12 * sz;
+			float i02 = r00 * r20 * sx + r01 * r21 * sy + r02 * r22 * sz;
+			float i12 = r10 * r20 * sx + r11 * r21 * sy + r12 * r22 * sz;
+
+			t0[i] = i00; t3[i] = i01; t6[i] = i02;
+			t1[i] = i01; t4[i] = i11; t7[i] = i12;
+			t2[i] = i02; t5[i] = i12; t8[i] = i22;
+
+			float awakeDt = (1.0f - asleep[i]) * dt;
+			angX[i] += (i00 * torqueX[i] + i01 * torqueY[i] + i02 * torqueZ[i]) * awakeDt;
+			angY[i] += (i01 * torqueX[i] + i11 * torqueY[i] + i12 * torqueZ[i]) * awakeDt;
+			angZ[i] += (i02 * torqueX[i] + i12 * torqueY[i] + i22 * torqueZ[i]) * awakeDt;
+		}
+	});
 }
 /*
 This function integrates linear and angular velocity into
@@ -432,41 +1162,199 @@ throughout a physics update, to slowly move the objects through
 the world, looking for collisions.
 */
 void PhysicsSystem::IntegrateVelocity(float dt) {
+	RigidBodyStore& bodies = gameWorld.GetBodyStore();
+
+	const int bodyCount		= bodies.GetBodyCount();
+	const int batchCount	= (bodyCount + integrationBatchSize - 1) / integrationBatchSize;
+
+	const float frameLinearDamping	= 1.0f - (0.1f * dt);
+	const float frameAngularDamping	= 1.0f - (0.4f * dt);
+	const float halfDt				= dt * 0.5f;
+	const float linearSleepSq		= sleepLinearThreshold * sleepLinearThreshold;
+	const float angularSleepSq		= sleepAngularThreshold * sleepAngularThreshold;
+
+	jobSystem.ParallelFor(batchCount, [&](int batch) {
+		int start	= batch * integrationBatchSize;
+		int end		= (start + integrationBatchSize < bodyCount) ? start + integrationBatchSize : bodyCount;
+
+		//Collision resolution may have moved things since the last step
+		bodies.ReadTransforms(start, end);
+
+		float* __restrict posX	= bodies.GetField(RigidBodyStore::PositionX);
+		float* __restrict posY	= bodies.GetField(RigidBodyStore::PositionY);
+		float* __restrict posZ	= bodies.GetField(RigidBodyStore::PositionZ);
+		float* __restrict velX	= bodies.GetField(RigidBodyStore::LinearVelocityX);
+		float* __restrict velY	= bodies.GetField(RigidBodyStore::LinearVelocityY);
+		float* __restrict velZ	= bodies.GetField(RigidBodyStore::LinearVelocityZ);
+
+		//Position Stuff
+		for (int i = start; i < end; ++i) {
+			posX[i] += velX[i] * dt;
+			posY[i] += velY[i] * dt;
+			posZ[i] += velZ[i] * dt;
+			//Linear Damping
+			velX[i] *= frameLinearDamping;
+			velY[i] *= frameLinearDamping;
+			velZ[i] *= frameLinearDamping;
+		}
+
+		float* __restrict qx	= bodies.GetField(RigidBodyStore::OrientationX);
+		float* __restrict qy	= bodies.GetField(RigidBodyStore::OrientationY);
+		float* __restrict qz	= bodies.GetField(RigidBodyStore::OrientationZ);
+		float* __restrict qw	= bodies.GetField(RigidBodyStore::OrientationW);
+		float* __restrict angX	= bodies.GetField(RigidBodyStore::AngularVelocityX);
+		float* __restrict angY	= bodies.GetField(RigidBodyStore::AngularVelocityY);
+		float* __restrict angZ	= bodies.GetField(RigidBodyStore::AngularVelocityZ);
+
+		//Orientation Stuff - orientation + (Quaternion(angVel * dt * 0.5f, 0.0f) * orientation)
+		for (int i = start; i < end; ++i) {
+			float ax = angX[i] * halfDt;
+			float ay = angY[i] * halfDt;
+			float az = angZ[i] * halfDt;
+
+			float x = qx[i] + (ax * qw[i]) + (ay * qz[i]) - (az * qy[i]);
+			float y = qy[i] + (ay * qw[i]) + (az * qx[i]) - (ax * qz[i]);
+			float z = qz[i] + (az * qw[i]) + (ax * qy[i]) - (ay * qx[i]);
+			float w = qw[i] - (ax * qx[i]) - (ay * qy[i]) - (az * qz[i]);
+
+			float invLength = 1.0f / sqrt(x * x + y * y + z * z + w * w);
+			qx[i] = x * invLength;
+			qy[i] = y * invLength;
+			qz[i] = z * invLength;
+			qw[i] = w * invLength;
+
+			//Damp the angular velocity too
+			angX[i] *= frameAngularDamping;
+			angY[i] *= frameAngularDamping;
+			angZ[i] *= frameAngularDamping;
+		}
+
+		//Keep track of how long each object has been slow enough to sleep
+		float* __restrict sleepTimer = bodies.GetField(RigidBodyStore::SleepTimer);
+		for (int i = start; i < end; ++i) {
+			float linearSq	= velX[i] * velX[i] + velY[i] * velY[i] + velZ[i] * velZ[i];
+			float angularSq	= angX[i] * angX[i] + angY[i] * angY[i] + angZ[i] * angZ[i];
+			float resting	= (linearSq < linearSleepSq && angularSq < angularSleepSq) ? 1.0f : 0.0f;
+			sleepTimer[i] = (sleepTimer[i] + dt) * resting;
+		}
+
+		bodies.WriteTransforms(start, end);
+	});
+}
+
+/*
+Only a handful of objects ever have continuous collision detection turned
+on, and only the steps where they're really moving quickly are checked.
+*/
+void PhysicsSystem::FindSweptBodies(float dt) {
+	sweptBodies.clear();
+
 	std::vector <GameObject*>::const_iterator first;
 	std::vector <GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
-	float frameLinearDamping = 1.0f - (0.1f * dt);
 
-	for (auto i = first; i != last; ++i)
-	{
-		PhysicsObject* object = (*i)->GetPhysicsObject();
-		if (object == nullptr)
+	gameWorld.GetObjectIterators(first, last);
+	for (auto i = first; i != last; ++i) {
+		PhysicsObject* phys = (*i)->GetPhysicsObject();
+		if (!phys || !phys->IsContinuous() || phys->GetTrigger() || phys->IsAsleep() ||
+			phys->GetInverseMass() == 0.0f || !(*i)->GetBoundingVolume()) {
 			continue;
+		}
+		float radius = CollisionDetection::InnerRadius(*(*i)->GetBoundingVolume());
+		float motion = phys->GetLinearVelocity().Length() * dt;
+		if (radius > 0.0f && motion > radius) {
+			sweptBodies.push_back({ *i, (*i)->GetTransform().GetPosition() });
+		}
+	}
+}
 
-		Transform& transform = (*i)->GetTransform();
-		//Position Stuff
-		Vector3 position	= transform.GetPosition();
-		Vector3 linearVel	= object->GetLinearVelocity();
-		position += linearVel * dt;
-		transform.SetPosition(position);
-		//Linear Damping
-		linearVel			= linearVel * frameLinearDamping;
-		object->SetLinearVelocity(linearVel);
+/*
+Each object is moved back to where it first hit something, that contact is
+solved on its own to change its velocity, and it's then moved on with its
+new velocity for whatever was left of the step - which is checked again,
+as a bullet hitting a wall at an angle might skim off into another. If it
+keeps on hitting things, it's left where the last hit was.
+*/
+static const int maxImpactsPerStep = 4;
+
+void PhysicsSystem::SweepBodies(float dt) {
+	for (const SweptBody& swept : sweptBodies) {
+		GameObject*		object		= swept.object;
+		PhysicsObject*	phys		= object->GetPhysicsObject();
+		Transform&		transform	= object->GetTransform();
+
+		Vector3 start		= swept.start;
+		float	timeLeft	= dt;
+		for (int i = 0; i < maxImpactsPerStep; ++i) {
+			Vector3		end = transform.GetPosition();
+			float		toi = 1.0f;
+			GameObject* hit = nullptr;
+			if (!FindTimeOfImpact(object, start, end, toi, hit)) {
+				break;
+			}
+			start = start + ((end - start) * toi);
+			transform.SetPosition(start);
+			ResolveImpact(object, hit, dt);
 
-		//Orientation Stuff
-		Quaternion orientation = transform.GetOrientation();
-		Vector3 angVel = object->GetAngularVelocity();
+			timeLeft *= 1.0f - toi;
+			if (i + 1 < maxImpactsPerStep) {
+				transform.SetPosition(start + (phys->GetLinearVelocity() * timeLeft));
+			}
+		}
+	}
+}
+
+/*
+Only the object's position is swept - it's tested at the orientation it
+finishes the step with, and anything else that's moving is tested where
+it finished the step too. Objects it's already touching at the start are
+left to the normal contacts.
+*/
+bool PhysicsSystem::FindTimeOfImpact(GameObject* object, const Vector3& start, const Vector3& end, float& toi, GameObject*& hit) {
+	Transform swept = object->GetTransform();
+	swept.SetPosition(start);
+
+	Vector3 path = end - start;
+
+	Vector3 halfSize;
+	object->UpdateBroadphaseAABB();
+	object->GetBroadphaseAABB(halfSize);
+	halfSize += Vector3(std::abs(path.x), std::abs(path.y), std::abs(path.z)) * 0.5f;
+
+	toi = 1.0f;
+	hit = nullptr;
+	gameWorld.GetBroadphaseTree().Query(start + (path * 0.5f), halfSize, [&](GameObject* other) {
+		if (other == object || !other->GetPhysicsObject() || other->GetPhysicsObject()->GetTrigger() || !other->GetBoundingVolume() || !ShouldCollide(object, other)) {
+			return true;
+		}
+		CollisionDetection::CollisionInfo info;
+		float fraction;
+		if (CollisionDetection::SweepIntersection(*object->GetBoundingVolume(), swept, path, *other->GetBoundingVolume(), other->GetTransform(), toi, fraction, info) &&
+			fraction > 0.0f) {
+			toi = fraction;
+			hit = other;
+		}
+		return true;
+	});
+	return hit != nullptr;
+}
 
-		orientation = orientation + (Quaternion(angVel * dt * 0.5f, 0.0f) * orientation);
-		orientation.Normalise();
+//The pair are kept the same way around as the broadphase has them, so the manifold can carry on next step
+void PhysicsSystem::ResolveImpact(GameObject* object, GameObject* hit, float dt) {
+	bool objectFirst = object->GetWorldID() < hit->GetWorldID();
 
-		transform.SetOrientation(orientation);
+	CollisionDetection::CollisionInfo info;
+	if (!CollisionDetection::ObjectIntersection(objectFirst ? object : hit, objectFirst ? hit : object, info)) {
+		return;
+	}
+	info.a->GetPhysicsObject()->Wake();
+	info.b->GetPhysicsObject()->Wake();
 
-		//Damp the angular velocity too
-		float frameAngularDamping = 1.0f - (0.4f * dt);
-		angVel = angVel * frameAngularDamping;
-		object->SetAngularVelocity(angVel);
+	SolverPoint points[CollisionDetection::MaxContactPoints];
+	PrepareContact(info, points, dt);
+	for (int i = 0; i < solverIterations; ++i) {
+		SolveContact(info, points);
 	}
+	AddCollision(info);
 }
 
 /*
@@ -475,11 +1363,15 @@ clear out any accumulated forces, ready to receive new
 ones in the next 'game' frame.
 */
 void PhysicsSystem::ClearForces() {
-	gameWorld.OperateOnContents(
-		[](GameObject* o) {
-			o->GetPhysicsObject()->ClearForces();
-		}
-	);
+	RigidBodyStore& bodies = gameWorld.GetBodyStore();
+
+	const RigidBodyStore::Field cleared[] = {
+		RigidBodyStore::ForceX, RigidBodyStore::ForceY, RigidBodyStore::ForceZ,
+		RigidBodyStore::TorqueX, RigidBodyStore::TorqueY, RigidBodyStore::TorqueZ
+	};
+	for (RigidBodyStore::Field f : cleared) {
+		std::fill(bodies.GetField(f), bodies.GetField(f) + bodies.GetBodyCount(), 0.0f);
+	}
 }
 
 
@@ -489,13 +1381,425 @@ As part of the final physics tutorials, we add in the ability
 to constrain objects based on some extra calculation, allowing
 us to model springs and ropes etc. 
 
+Rather than solving every contact and constraint in one long list, they're
+split up into islands - groups of objects that are linked to each other,
+either by touching or through a constraint. This uses union-find over the
+objects' positions in the world's object list. Only objects that can be
+pushed around join islands; something immovable like the floor can touch
+every pile in the level without gluing them all into one big island.
+
+Islands are numbered in the order their first contact or constraint turns
+up, and keep everything in its original order, so the result of a step is
+the same no matter how many threads end up solving it.
+
 */
-void PhysicsSystem::UpdateConstraints(float dt) {
-	std::vector<Constraint*>::const_iterator first;
-	std::vector<Constraint*>::const_iterator last;
-	gameWorld.GetConstraintIterators(first, last);
+int PhysicsSystem::FindIslandRoot(int body) {
+	while (islandParent[body] != body) {
+		islandParent[body]	= islandParent[islandParent[body]];
+		body				= islandParent[body];
+	}
+	return body;
+}
 
-	for (auto i = first; i != last; ++i) {
-		(*i)->UpdateConstraint(dt);
+void PhysicsSystem::UniteIslands(GameObject* a, GameObject* b) {
+	if (!a || !b || a->GetPhysicsObject()->GetInverseMass() == 0.0f || b->GetPhysicsObject()->GetInverseMass() == 0.0f)
+		return;
+
+	int rootA = FindIslandRoot(a->GetPhysicsObject()->GetSolverIndex());
+	int rootB = FindIslandRoot(b->GetPhysicsObject()->GetSolverIndex());
+
+	if (rootA < rootB)
+		islandParent[rootB] = rootA;
+	else if (rootB < rootA)
+		islandParent[rootA] = rootB;
+}
+
+//Returns which island a contact or constraint between a and b belongs to, or -1 if neither can move
+int PhysicsSystem::GetIsland(GameObject* a, GameObject* b) {
+	GameObject* mover = nullptr;
+	if (a && a->GetPhysicsObject()->GetInverseMass() > 0.0f)
+		mover = a;
+	else if (b && b->GetPhysicsObject()->GetInverseMass() > 0.0f)
+		mover = b;
+
+	//Islands wake and sleep as a whole, so one sleeping object means the whole island is asleep
+	if (!mover || mover->GetPhysicsObject()->IsAsleep())
+		return -1;
+
+	int root = FindIslandRoot(mover->GetPhysicsObject()->GetSolverIndex());
+	if (islandIDs[root] == -1) {
+		islandIDs[root] = (int)islands.size();
+		islands.push_back({ 0, 0 });
+	}
+	return islandIDs[root];
+}
+
+void PhysicsSystem::BuildIslands() {
+	std::vector <GameObject*>::const_iterator first;
+	std::vector <GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+
+	std::vector<Constraint*>::const_iterator firstConstraint;
+	std::vector<Constraint*>::const_iterator lastConstraint;
+	gameWorld.GetConstraintIterators(firstConstraint, lastConstraint);
+
+	const int objectCount		= (int)(last - first);
+	const int constraintCount	= (int)(lastConstraint - firstConstraint);
+	const int contactCount		= (int)stepContacts.size();
+
+	islandParent.resize(objectCount);
+	for (int i = 0; i < objectCount; ++i) {
+		islandParent[i] = i;
+		if (first[i]->GetPhysicsObject()) {
+			first[i]->GetPhysicsObject()->SetSolverIndex(i);
+		}
+	}
+
+	for (int c : stepContacts) {
+		UniteIslands(allCollisions.Get(c).a, allCollisions.Get(c).b);
+	}
+	for (auto i = firstConstraint; i != lastConstraint; ++i) {
+		UniteIslands((*i)->GetObjectA(), (*i)->GetObjectB());
+	}
+	WakeIslands();
+
+	islands.clear();
+	islandIDs.assign(objectCount, -1);
+
+	//Each contact point gets its own slot of scratch space for the solver
+	contactIslands.resize(contactCount);
+	contactPointOffsets.resize(contactCount);
+	int pointCount = 0;
+	for (int i = 0; i < contactCount; ++i) {
+		contactPointOffsets[i] = pointCount;
+		pointCount += allCollisions.Get(stepContacts[i]).pointCount;
 	}
-}
\ No newline at end of file
+	solverPoints.resize(pointCount);
+
+	for (int i = 0; i < contactCount; ++i) {
+		const CollisionDetection::CollisionInfo& c = allCollisions.Get(stepContacts[i]);
+		int island = GetIsland(c.a, c.b);
+		contactIslands[i] = island;
+		if (island != -1)
+			islands[island].contactCount++;
+	}
+	//Constraints are solved separately, but a sleeping island's constraints are skipped
+	constraintIslands.resize(constraintCount);
+	for (int i = 0; i < constraintCount; ++i) {
+		constraintIslands[i] = GetIsland(firstConstraint[i]->GetObjectA(), firstConstraint[i]->GetObjectB());
+	}
+
+	//Give each island its own run of the contact list...
+	int contactOffset = 0;
+	for (Island& island : islands) {
+		island.firstContact	= contactOffset;
+		contactOffset		+= island.contactCount;
+		island.contactCount	= 0;
+	}
+	//...then fill them in, keeping everything in the order it was found
+	islandContacts.resize(contactOffset);
+	for (int i = 0; i < contactCount; ++i) {
+		if (contactIslands[i] == -1)
+			continue;
+		Island& island = islands[contactIslands[i]];
+		islandContacts[island.firstContact + island.contactCount++] = i;
+	}
+}
+
+/*
+Objects sleep and wake an island at a time. If anything in an island is
+awake (say, because something has just bumped into it, or pulled on a
+constraint attached to it), then everything in that island wakes up. And
+an island only goes to sleep once every object in it has been resting for
+long enough - otherwise a box would fall asleep while the one it's stacked
+on top of is still wobbling about.
+*/
+void PhysicsSystem::WakeIslands() {
+	std::vector <GameObject*>::const_iterator first;
+	std::vector <GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+	const int objectCount = (int)(last - first);
+
+	islandFlags.assign(objectCount, 0);
+	for (int i = 0; i < objectCount; ++i) {
+		PhysicsObject* phys = first[i]->GetPhysicsObject();
+		if (phys && phys->GetInverseMass() > 0.0f && !phys->IsAsleep()) {
+			islandFlags[FindIslandRoot(i)] = 1;
+		}
+	}
+	for (int i = 0; i < objectCount; ++i) {
+		PhysicsObject* phys = first[i]->GetPhysicsObject();
+		if (phys && islandFlags[FindIslandRoot(i)]) {
+			phys->Wake();
+		}
+	}
+}
+
+void PhysicsSystem::UpdateSleeping() {
+	std::vector <GameObject*>::const_iterator first;
+	std::vector <GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+	const int objectCount = (int)(last - first);
+
+	//Flags any island with something in it that isn't ready to sleep yet
+	islandFlags.assign(objectCount, 0);
+	for (int i = 0; i < objectCount; ++i) {
+		PhysicsObject* phys = first[i]->GetPhysicsObject();
+		if (!phys || phys->GetInverseMass() == 0.0f || phys->IsAsleep()) {
+			continue;
+		}
+		if (!allowSleeping || phys->GetSleepTimer() < sleepTime) {
+			islandFlags[FindIslandRoot(i)] = 1;
+		}
+	}
+
+	awakeBodies		= 0;
+	sleepingBodies	= 0;
+	for (int i = 0; i < objectCount; ++i) {
+		PhysicsObject* phys = first[i]->GetPhysicsObject();
+		if (!phys || phys->GetInverseMass() == 0.0f) {
+			continue;
+		}
+		if (!allowSleeping) {
+			phys->Wake();
+		}
+		else if (!phys->IsAsleep() && !islandFlags[FindIslandRoot(i)]) {
+			phys->Sleep();
+		}
+		if (phys->IsAsleep())
+			sleepingBodies++;
+		else
+			awakeBodies++;
+	}
+}
+
+/*
+Lots of tiny islands (a single box sat on the floor, say) aren't worth a
+job each, so neighbouring islands are batched together until each batch
+has a reasonable amount of work in it.
+*/
+static const int islandBatchWork = 256;
+
+void PhysicsSystem::SolveIslands(float dt) {
+	islandBatches.clear();
+
+	int work = 0;
+	for (int i = 0; i < (int)islands.size(); ++i) {
+		if (work == 0) {
+			islandBatches.emplace_back(i);
+		}
+		work += (islands[i].contactCount * solverIterations) + 1;
+		if (work >= islandBatchWork) {
+			work = 0;
+		}
+	}
+	islandBatches.emplace_back((int)islands.size());
+
+	jobSystem.ParallelFor((int)islandBatches.size() - 1, [&](int batch) {
+		for (int i = islandBatches[batch]; i < islandBatches[batch + 1]; ++i) {
+			SolveIsland(islands[i], dt);
+		}
+	});
+}
+
+void PhysicsSystem::SolveIsland(const Island& island, float dt) {
+	const int* contacts = &islandContacts[island.firstContact];
+
+	//Soft contacts use the penalty response instead, once, at their deepest point
+	for (int i = 0; i < island.contactCount; ++i) {
+		CollisionDetection::CollisionInfo& c = allCollisions.Get(stepContacts[contacts[i]]);
+		if (stepContactIsSoft[contacts[i]]) {
+			int deepest = 0;
+			for (int j = 1; j < c.pointCount; ++j) {
+				if (c.points[j].penetration > c.points[deepest].penetration) {
+					deepest = j;
+				}
+			}
+			PenaltyResolveCollision(*c.a, *c.b, c.points[deepest]);
+		}
+		else {
+			PrepareContact(c, &solverPoints[contactPointOffsets[contacts[i]]], dt);
+		}
+	}
+	for (int i = 0; i < island.contactCount; ++i) {
+		if (!stepContactIsSoft[contacts[i]]) {
+			WarmStartContact(allCollisions.Get(stepContacts[contacts[i]]));
+		}
+	}
+	for (int j = 0; j < solverIterations; ++j) {
+		for (int i = 0; i < island.contactCount; ++i) {
+			if (!stepContactIsSoft[contacts[i]]) {
+				SolveContact(allCollisions.Get(stepContacts[contacts[i]]), &solverPoints[contactPointOffsets[contacts[i]]]);
+			}
+		}
+	}
+}
+
+/*
+Constraints are solved the same way as contacts - each row pushes the two
+objects just hard enough to stop its error growing (plus a little more, to
+fix what's built up already), and the solver goes over every row a few
+times, so that rows that share an object can settle on what they all need.
+
+Rather than going an island at a time, where a long chain or a ragdoll
+would end up stuck on one thread, every constraint is given a colour, such
+that no two constraints of the same colour share an object that can move.
+Every constraint in a colour can then be solved at once, in batches, with
+the colours taking turns. Constraints that don't fit into any colour go in
+an extra one that's always solved on the calling thread.
+
+Nothing in a colour affects anything else in it, so the order a colour's
+batches run in makes no difference, and the result is the same however
+many threads there are.
+*/
+void PhysicsSystem::SolveConstraints(float dt) {
+	ColourConstraints();
+
+	const int constraintCount = (int)stepConstraints.size();
+	if (constraintCount == 0) {
+		return;
+	}
+	constraintRowCounts.resize(constraintCount);
+	constraintRows.resize(constraintCount * Constraint::MaxRows);
+
+	//Each constraint builds its rows, and carries on pushing as hard as it was last step
+	const int batchCount = (constraintCount + ConstraintBatchSize - 1) / ConstraintBatchSize;
+	jobSystem.ParallelFor(batchCount, [&](int batch) {
+		int last = std::min(constraintCount, (batch + 1) * ConstraintBatchSize);
+		for (int i = batch * ConstraintBatchSize; i < last; ++i) {
+			Constraint*		c		= stepConstraints[i];
+			ConstraintRow*	rows	= &constraintRows[i * Constraint::MaxRows];
+			int				count	= c->BuildRows(rows, dt);
+			constraintRowCounts[i]	= count;
+			if (count == c->lastRowCount) {
+				for (int j = 0; j < count; ++j) {
+					rows[j].impulse = std::min(std::max(c->lastImpulses[j], rows[j].lowerImpulse), rows[j].upperImpulse);
+				}
+			}
+		}
+	});
+	//Warm starting writes to the objects, so it has to go a colour at a time like everything else
+	for (int i = 0; i < constraintCount; ++i) {
+		const ConstraintRow* rows = &constraintRows[i * Constraint::MaxRows];
+		for (int j = 0; j < constraintRowCounts[i]; ++j) {
+			ApplyConstraintImpulse(rows[j], rows[j].impulse);
+		}
+	}
+
+	const int colourCount = (int)colourOffsets.size() - 1;
+	for (int j = 0; j < constraintIterationCount; ++j) {
+		for (int colour = 0; colour < colourCount; ++colour) {
+			int first	= colourOffsets[colour];
+			int last	= colourOffsets[colour + 1];
+			int batches	= (last - first + ConstraintBatchSize - 1) / ConstraintBatchSize;
+
+			if (batches <= 1 || colour == MaxConstraintColours) {
+				SolveConstraintRange(first, last);
+				continue;
+			}
+			jobSystem.ParallelFor(batches, [&](int batch) {
+				int start = first + (batch * ConstraintBatchSize);
+				SolveConstraintRange(start, std::min(last, start + ConstraintBatchSize));
+			});
+		}
+	}
+
+	for (int i = 0; i < constraintCount; ++i) {
+		Constraint*				c		= stepConstraints[i];
+		const ConstraintRow*	rows	= &constraintRows[i * Constraint::MaxRows];
+		c->lastRowCount = constraintRowCounts[i];
+		for (int j = 0; j < constraintRowCounts[i]; ++j) {
+			c->lastImpulses[j] = rows[j].impulse;
+		}
+	}
+}
+
+/*
+Colours are handed out greedily, in the order the constraints were added
+to the world, with each object keeping a mask of the colours that already
+touch it. Objects that can't move don't count, so a whole row of lamps
+hanging off the same ceiling can still all be solved at once. The awake
+constraints are then sorted by colour, keeping them in order within each.
+*/
+void PhysicsSystem::ColourConstraints() {
+	std::vector <GameObject*>::const_iterator first;
+	std::vector <GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+
+	std::vector<Constraint*>::const_iterator firstConstraint;
+	std::vector<Constraint*>::const_iterator lastConstraint;
+	gameWorld.GetConstraintIterators(firstConstraint, lastConstraint);
+
+	const int constraintCount = (int)(lastConstraint - firstConstraint);
+
+	bodyColours.assign(last - first, 0);
+	constraintColours.resize(constraintCount);
+	colourOffsets.assign(MaxConstraintColours + 2, 0);
+
+	for (int i = 0; i < constraintCount; ++i) {
+		if (constraintIslands[i] == -1) {
+			constraintColours[i] = -1;
+			continue;
+		}
+		PhysicsObject* physA = firstConstraint[i]->GetObjectA()->GetPhysicsObject();
+		PhysicsObject* physB = firstConstraint[i]->GetObjectB()->GetPhysicsObject();
+		bool movesA = physA->GetInverseMass() > 0.0f;
+		bool movesB = physB->GetInverseMass() > 0.0f;
+
+		uint64_t used = (movesA ? bodyColours[physA->GetSolverIndex()] : 0) | (movesB ? bodyColours[physB->GetSolverIndex()] : 0);
+		int colour = 0;
+		while (colour < MaxConstraintColours && (used & ((uint64_t)1 << colour))) {
+			colour++;
+		}
+		if (colour < MaxConstraintColours) {
+			if (movesA)
+				bodyColours[physA->GetSolverIndex()] |= (uint64_t)1 << colour;
+			if (movesB)
+				bodyColours[physB->GetSolverIndex()] |= (uint64_t)1 << colour;
+		}
+		constraintColours[i] = colour;
+		colourOffsets[colour + 1]++;
+	}
+
+	for (int colour = 0; colour <= MaxConstraintColours; ++colour) {
+		colourOffsets[colour + 1] += colourOffsets[colour];
+	}
+	//Each colour's offset is moved along as it's filled in, which leaves it where the next colour starts...
+	stepConstraints.resize(colourOffsets[MaxConstraintColours + 1]);
+	for (int i = 0; i < constraintCount; ++i) {
+		int colour = constraintColours[i];
+		if (colour != -1) {
+			stepConstraints[colourOffsets[colour]++] = firstConstraint[i];
+		}
+	}
+	//...so they're all moved back along one
+	for (int colour = MaxConstraintColours; colour > 0; --colour) {
+		colourOffsets[colour] = colourOffsets[colour - 1];
+	}
+	colourOffsets[0] = 0;
+
+	//Only as many colours as were actually used are kept
+	int colourCount = MaxConstraintColours + 1;
+	while (colourCount > 0 && colourOffsets[colourCount] == colourOffsets[colourCount - 1]) {
+		colourCount--;
+	}
+	colourOffsets.resize(colourCount + 1);
+}
+
+void PhysicsSystem::SolveConstraintRange(int first, int last) {
+	for (int i = first; i < last; ++i) {
+		ConstraintRow* rows = &constraintRows[i * Constraint::MaxRows];
+		for (int j = 0; j < constraintRowCounts[i]; ++j) {
+			ConstraintRow& row = rows[j];
+
+			float velocity =	Vector3::Dot(row.linearA, row.physA->GetLinearVelocity()) + Vector3::Dot(row.angularA, row.physA->GetAngularVelocity()) +
+								Vector3::Dot(row.linearB, row.physB->GetLinearVelocity()) + Vector3::Dot(row.angularB, row.physB->GetAngularVelocity());
+
+			float lambda	= -(velocity + row.bias) * row.effectiveMass;
+			float old		= row.impulse;
+			row.impulse		= std::min(std::max(old + lambda, row.lowerImpulse), row.upperImpulse);
+
+			ApplyConstraintImpulse(row, row.impulse - old);
+		}
+	}
+}
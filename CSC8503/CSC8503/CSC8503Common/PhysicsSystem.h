@@ -1,9 +1,37 @@
 #pragma once
 #include "../CSC8503Common/GameWorld.h"
-#include <set>
+#include "SweepAndPrune.h"
+#include "JobSystem.h"
+#include "PairCache.h"
+#include "GJK.h"
+#include "Constraint.h"
+#include "RopeSystem.h"
+#include "PhysicsMaterial.h"
+#include "StateBuffer.h"
+
+#include <cstdint>
 
 namespace NCL {
 	namespace CSC8503 {
+		enum class BroadPhaseType {
+			DynamicTree,
+			SortAndSweep
+		};
+
+		/*
+		How the last few calls to PhysicsSystem::Update went. If the physics
+		falls too far behind, time is thrown away rather than simulated, so
+		the game slows down instead of grinding to a halt.
+		*/
+		struct PhysicsStats {
+			int		substeps			= 0;	//Fixed steps taken in the last update
+			float	updateTime			= 0.0f;	//How long the last update took, in seconds
+			float	interpolation		= 0.0f;	//How far between the last two steps objects are drawn
+			float	droppedTime			= 0.0f;	//Time thrown away in the last update...
+			float	totalDroppedTime	= 0.0f;	//...and in every update so far
+			int		droppedUpdates		= 0;	//How many updates have had to throw time away
+		};
+
 		class PhysicsSystem	{
 		public:
 			PhysicsSystem(GameWorld& g);
@@ -22,22 +50,287 @@ namespace NCL {
 			}
 
 			void SetGravity(const Vector3& g);
+
+			void UseBroadPhase(bool state) {
+				useBroadPhase = state;
+			}
+
+			bool UsingBroadPhase() const {
+				return useBroadPhase;
+			}
+
+			void SetBroadPhaseType(BroadPhaseType type) {
+				broadPhaseType = type;
+			}
+
+			BroadPhaseType GetBroadPhaseType() const {
+				return broadPhaseType;
+			}
+
+			//Sort and sweep can keep its lists sorted along 1 or all 3 axes
+			void SetSweepAxisCount(int count) {
+				sweepAndPrune.SetAxisCount(count);
+			}
+
+			//Extra threads to solve islands on, alongside the calling thread
+			void SetWorkerThreads(int count) {
+				jobSystem.SetWorkerThreads(count);
+			}
+
+			int GetIslandCount() const {
+				return (int)islands.size();
+			}
+
+			void UseSleeping(bool state) {
+				allowSleeping = state;
+			}
+
+			/*
+			Objects moving slower than these speeds (in units and radians per
+			second) for long enough are put to sleep, along with the rest of
+			their island.
+			*/
+			void SetSleepThresholds(float linear, float angular, float time) {
+				sleepLinearThreshold	= linear;
+				sleepAngularThreshold	= angular;
+				sleepTime				= time;
+			}
+
+			int GetAwakeBodyCount() const {
+				return awakeBodies;
+			}
+
+			int GetSleepingBodyCount() const {
+				return sleepingBodies;
+			}
+
+			//How many passes the contact solver makes over each island per step
+			void SetSolverIterations(int count) {
+				solverIterations = count;
+			}
+
+			void SetConstraintIterations(int count) {
+				constraintIterationCount = count;
+			}
+
+			int GetConstraintIterations() const {
+				return constraintIterationCount;
+			}
+
+			static const int MaxMaterials = MaxPhysicsMaterials;
+
+			/*
+			Adds a material to the table, and returns the index for objects to
+			use it with, or -1 if the table's full. Every object starts off
+			using material 0, which is just a default PhysicsMaterial.
+			*/
+			int AddMaterial(const PhysicsMaterial& material);
+
+			//Only materials that have already been added can be changed - any other index is rejected
+			void SetMaterial(int index, const PhysicsMaterial& material);
+
+			const PhysicsMaterial& GetMaterial(int index) const {
+				return materials[index];
+			}
+
+			int GetMaterialCount() const {
+				return (int)materials.size();
+			}
+
+			//Ropes and chains are stepped along with everything else, after the constraints
+			RopeSystem& GetRopes() {
+				return ropes;
+			}
+
+			//The physics always steps at this rate, however fast the game is running
+			void SetFixedRate(int hz) {
+				fixedDeltaTime = 1.0f / hz;
+			}
+
+			float GetFixedDeltaTime() const {
+				return fixedDeltaTime;
+			}
+
+			//The most steps a single update can take before it starts dropping time
+			void SetMaxSubsteps(int count) {
+				maxSubsteps = count;
+			}
+
+			void UseInterpolation(bool state) {
+				useInterpolation = state;
+			}
+
+			const PhysicsStats& GetStats() const {
+				return stats;
+			}
+
+			/*
+			Whether objects on two layers collide with each other. Every layer
+			collides with every other to begin with. Pairs that don't are
+			thrown away as soon as the broadphase finds them.
+			*/
+			void SetLayerCollision(int layerA, int layerB, bool state);
+
+			bool GetLayerCollision(int layerA, int layerB) const {
+				return (layerCollisions[layerA] & (1u << layerB)) != 0;
+			}
+
+			/*
+			In deterministic mode, the same starting state and the same inputs
+			always give exactly the same steps, whatever has happened before -
+			nothing is shuffled, and the order pairs are found in no longer
+			depends on the history of the broadphase. Combined with SaveState
+			and RestoreState, a game can roll back a few steps and simulate
+			them again with different inputs, and get the same answer as a
+			machine that never had to.
+			*/
+			void UseDeterministicMode(bool state) {
+				deterministic = state;
+				gameWorld.SetDeterministic(state);
+			}
+
+			bool IsDeterministic() const {
+				return deterministic;
+			}
+
+			/*
+			Saves everything that carries over from one step to the next -
+			each body's movement and whether it's asleep, where everything is,
+			what's touching and the impulses the solver will warm start from,
+			what the constraints and ropes are doing, and any time left over
+			that hasn't been stepped yet.
+
+			It's only the state - restoring it needs the same objects,
+			constraints and ropes to be in the world as when it was saved, and
+			returns false (having possibly restored some of it) if they aren't.
+			*/
+			void SaveState(StateBuffer& buffer) const;
+			bool RestoreState(StateBuffer& buffer);
+
 		protected:
+			void FixedStep(float dt);
+
 			void BasicCollisionDetection();
 			void BroadPhase();
+			void UpdateBroadphaseTree();
+			void TreeBroadPhase();
+			void SweepBroadPhase();
 			void NarrowPhase();
 
+			void AddBroadphasePair(GameObject* a, GameObject* b);
+
+			void AddCollision(CollisionDetection::CollisionInfo& info);
+
+			//Triggers are only tested for whether they overlap, and never get any contact points
+			void TriggerPhase();
+			void AddTriggerOverlap(GameObject* a, GameObject* b);
+
+			//Do the objects' layers and masks let them collide?
+			bool ShouldCollide(const GameObject* a, const GameObject* b) const {
+				return	(layerCollisions[a->GetLayer()] & b->GetLayerBit()) &&
+						(a->GetCollisionMask() & b->GetLayerBit()) &&
+						(b->GetCollisionMask() & a->GetLayerBit());
+			}
+
 			void ClearForces();
 
 			void IntegrateAccel(float dt);
 			void IntegrateVelocity(float dt);
 
-			void UpdateConstraints(float dt);
+			/*
+			Continuous collision detection, for objects that have asked for it.
+			Before their positions are moved on, the ones moving further than
+			their own thickness are picked out, and afterwards the path each
+			took is searched for the first thing it would have hit.
+			*/
+			struct SweptBody {
+				GameObject*	object;
+				Vector3		start;
+			};
+
+			void FindSweptBodies(float dt);
+			void SweepBodies(float dt);
+			bool FindTimeOfImpact(GameObject* object, const Vector3& start, const Vector3& end, float& toi, GameObject*& hit);
+			void ResolveImpact(GameObject* object, GameObject* hit, float dt);
+
+			void SavePreviousTransforms();
+			void InterpolateTransforms(float alpha);
+
+			/*
+			Objects that touch, or are joined by a constraint, form an island.
+			Nothing in one island can affect another during a step, so each
+			island can be solved on its own thread.
+			*/
+			struct Island {
+				int firstContact;
+				int contactCount;
+			};
+
+			void BuildIslands();
+			void SolveIslands(float dt);
+			void SolveIsland(const Island& island, float dt);
+
+			/*
+			Constraints are solved afterwards, all together rather than an
+			island at a time. They're split into colours, where no two
+			constraints of the same colour share an object that can move, so
+			every constraint in a colour can be solved at the same time.
+			*/
+			static const int MaxConstraintColours	= 64;
+			static const int ConstraintBatchSize	= 32;
+
+			void SolveConstraints(float dt);
+			void ColourConstraints();
+			void SolveConstraintRange(int first, int last);
+
+			/*
+			The parts of a contact point that don't change while the solver
+			iterates over it - the effective mass along the normal and the two
+			friction directions, and how fast the point should be separating.
+			*/
+			struct SolverPoint {
+				Vector3 tangentA;
+				Vector3 tangentB;
+				float	normalMass;
+				float	tangentMassA;
+				float	tangentMassB;
+				float	bias;
+				float	staticFriction;
+				float	dynamicFriction;
+			};
+
+			/*
+			Two materials combined, ready for when they touch. Every pair of
+			materials is worked out whenever the table changes, so a contact
+			just looks its pair up by the two indices.
+			*/
+			struct MaterialPair {
+				float	restitution;
+				float	staticFriction;
+				float	dynamicFriction;
+				bool	softContacts;
+			};
+
+			const MaterialPair& GetMaterialPair(const PhysicsObject* a, const PhysicsObject* b) const {
+				return materialPairs[(a->GetMaterial() * MaxMaterials) + b->GetMaterial()];
+			}
+
+			void UpdateMaterialPairs();
+
+			void PrepareContact(CollisionDetection::CollisionInfo& c, SolverPoint* points, float dt) const;
+			void WarmStartContact(const CollisionDetection::CollisionInfo& c) const;
+			void SolveContact(CollisionDetection::CollisionInfo& c, SolverPoint* points) const;
+
+			int  FindIslandRoot(int body);
+			void UniteIslands(GameObject* a, GameObject* b);
+			int  GetIsland(GameObject* a, GameObject* b);
+
+			void WakeIslands();
+			void UpdateSleeping();
 
 			void UpdateCollisionList();
 			void UpdateObjectAABBs();
 
-			void ImpulseResolveCollision(GameObject& a , GameObject&b, CollisionDetection::ContactPoint& p) const;
 			void PenaltyResolveCollision(GameObject& a, GameObject& b, CollisionDetection::ContactPoint& p) const;
 
 			GameWorld& gameWorld;
@@ -47,11 +340,77 @@ namespace NCL {
 			float	dTOffset;
 			float	globalDamping;
 
-			std::set<CollisionDetection::CollisionInfo> allCollisions;
-			std::set<CollisionDetection::CollisionInfo> broadphaseCollisions;
+			//Every pair that's touching, and the pairs the broadphase thinks might be (with triggers kept apart)
+			PairCache<CollisionDetection::CollisionInfo>	allCollisions;
+			PairCache<CollisionDetection::CollisionInfo>	broadphaseCollisions;
+			PairCache<CollisionDetection::CollisionInfo>	triggerPairs;
+			std::vector<GameObject*>						broadphaseMovers;
+			std::vector<SweptBody>							sweptBodies;
+
+			//The broadphase pairs sorted by volume types, and what the narrowphase made of them
+			std::vector<int>									narrowPhaseTypes;
+			std::vector<int>									narrowPhaseCaches;
+			std::vector<CollisionDetection::PairQuery>			narrowPhasePairs;
+			std::vector<CollisionDetection::CollisionInfo>		narrowPhaseResults;
+
+			//What GJK found last time for each pair that goes through it
+			PairCache<SimplexCache>	simplexCaches;
+			int						narrowPhaseFrame;
+
+			//Indices into allCollisions, so the solver can update each manifold in place
+			std::vector<int>										stepContacts;
+			std::vector<char>										stepContactIsSoft;
+			std::vector<int>										contactPointOffsets;
+			std::vector<SolverPoint>								solverPoints;
+
+			std::vector<int>			islandParent;
+			std::vector<int>			islandIDs;
+			std::vector<int>			contactIslands;
+			std::vector<int>			constraintIslands;
+			std::vector<int>			islandContacts;
+			std::vector<Island>			islands;
+			std::vector<int>			islandBatches;
+			std::vector<char>			islandFlags;
+
+			//This step's awake constraints, sorted by colour, with room for each one's rows
+			std::vector<Constraint*>	stepConstraints;
+			std::vector<int>			constraintColours;
+			std::vector<int>			colourOffsets;
+			std::vector<uint64_t>		bodyColours;
+			std::vector<int>			constraintRowCounts;
+			std::vector<ConstraintRow>	constraintRows;
+
+			RopeSystem		ropes;
+
+			JobSystem		jobSystem;
+
+			SweepAndPrune	sweepAndPrune;
+			BroadPhaseType	broadPhaseType = BroadPhaseType::DynamicTree;
+
+			bool	allowSleeping			= true;
+			float	sleepLinearThreshold	= 0.15f;
+			float	sleepAngularThreshold	= 0.15f;
+			float	sleepTime				= 0.5f;
+			int		awakeBodies				= 0;
+			int		sleepingBodies			= 0;
+
+			float			fixedDeltaTime		= 1.0f / 120.0f;
+			int				maxSubsteps			= 8;
+			bool			useInterpolation	= true;
+			PhysicsStats	stats;
+
+			unsigned int	layerCollisions[GameObject::LayerCount];	//Each layer's mask of the layers it collides with
+
+			std::vector<PhysicsMaterial>	materials;
+			std::vector<MaterialPair>		materialPairs;	//MaxMaterials by MaxMaterials
+
+			bool						deterministic = false;
+			std::vector<GameObject*>	stateObjects;	//Objects by world ID, while restoring
 
-			bool useBroadPhase		= true;
-			int numCollisionFrames	= 5;
+			bool useBroadPhase				= true;
+			int numCollisionFrames			= 5;
+			int solverIterations			= 8;
+			int constraintIterationCount	= 10;
 		};
 	}
 }
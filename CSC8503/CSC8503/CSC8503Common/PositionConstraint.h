@@ -1,5 +1,5 @@
 #pragma once
-#include "Constraint.h"
+#include "DistanceConstraint.h"
 
 namespace NCL
 {
@@ -7,23 +7,15 @@ namespace NCL
 	{
 		class GameObject;
 
-		class PositionConstraint : public Constraint
+		//Keeps the centres of two objects a fixed distance apart
+		class PositionConstraint : public DistanceConstraint
 		{
 		public:
 			PositionConstraint(GameObject* a, GameObject* b, float d)
+				: DistanceConstraint(a, b, Vector3(), Vector3(), d, d)
 			{
-				objectA = a;
-				objectB = b;
-				distance = d;
 			}
 			~PositionConstraint() {}
-
-			void UpdateConstraint(float dt) override;
-
-		protected:
-			GameObject* objectA;
-			GameObject* objectB;
-			float distance;
 		};
 	}
-}
\ No newline at end of file
+}
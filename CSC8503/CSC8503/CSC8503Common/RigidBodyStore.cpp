@@ -0,0 +1,125 @@
+#include "RigidBodyStore.h"
+#include "PhysicsObject.h"
+#include "Transform.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+RigidBodyStore::RigidBodyStore() {
+}
+
+RigidBodyStore::~RigidBodyStore() {
+}
+
+RigidBodyStore& RigidBodyStore::Unattached() {
+	static RigidBodyStore store;
+	return store;
+}
+
+int RigidBodyStore::AddBody(PhysicsObject* owner, Transform* transform) {
+	int index = (int)owners.size();
+	for (int i = 0; i < FieldCount; ++i) {
+		fields[i].emplace_back(0.0f);
+	}
+	fields[OrientationW][index]			= 1.0f;
+	fields[PreviousOrientationW][index]	= 1.0f;
+	fields[InertiaFrameW][index]		= 1.0f;
+
+	owners.emplace_back(owner);
+	transforms.emplace_back(transform);
+	return index;
+}
+
+void RigidBodyStore::RemoveBody(int index) {
+	int last = (int)owners.size() - 1;
+	if (index != last) {
+		for (int i = 0; i < FieldCount; ++i) {
+			fields[i][index] = fields[i][last];
+		}
+		owners[index]		= owners[last];
+		transforms[index]	= transforms[last];
+		owners[index]->bodyIndex = index;
+	}
+	for (int i = 0; i < FieldCount; ++i) {
+		fields[i].pop_back();
+	}
+	owners.pop_back();
+	transforms.pop_back();
+}
+
+int RigidBodyStore::TakeBody(RigidBodyStore& from, int index) {
+	int newIndex = AddBody(from.owners[index], from.transforms[index]);
+	for (int i = 0; i < FieldCount; ++i) {
+		fields[i][newIndex] = from.fields[i][index];
+	}
+	from.RemoveBody(index);
+	return newIndex;
+}
+
+Matrix3 RigidBodyStore::GetInverseTensor(int index) const {
+	Matrix3 m;
+	for (int i = 0; i < 9; ++i) {
+		m.array[i] = fields[InverseTensor0 + i][index];
+	}
+	return m;
+}
+
+void RigidBodyStore::ReadTransforms(int start, int end) {
+	for (int i = start; i < end; ++i) {
+		Vector3 p = transforms[i]->GetPosition();
+		fields[PositionX][i] = p.x;
+		fields[PositionY][i] = p.y;
+		fields[PositionZ][i] = p.z;
+	}
+	ReadOrientations(start, end);
+}
+
+void RigidBodyStore::ReadOrientations(int start, int end) {
+	for (int i = start; i < end; ++i) {
+		Quaternion q = transforms[i]->GetOrientation();
+		fields[OrientationX][i] = q.x;
+		fields[OrientationY][i] = q.y;
+		fields[OrientationZ][i] = q.z;
+		fields[OrientationW][i] = q.w;
+	}
+}
+
+void RigidBodyStore::WriteTransforms(int start, int end) {
+	for (int i = start; i < end; ++i) {
+		if (fields[Asleep][i] != 0.0f) {
+			continue;
+		}
+		transforms[i]->SetPosition(Vector3(fields[PositionX][i], fields[PositionY][i], fields[PositionZ][i]));
+		transforms[i]->SetOrientation(Quaternion(fields[OrientationX][i], fields[OrientationY][i], fields[OrientationZ][i], fields[OrientationW][i]));
+	}
+}
+
+void RigidBodyStore::SavePreviousTransforms(int start, int end) {
+	for (int i = start; i < end; ++i) {
+		Vector3		p = transforms[i]->GetPosition();
+		Quaternion	q = transforms[i]->GetOrientation();
+		fields[PreviousPositionX][i]	= p.x;
+		fields[PreviousPositionY][i]	= p.y;
+		fields[PreviousPositionZ][i]	= p.z;
+		fields[PreviousOrientationX][i] = q.x;
+		fields[PreviousOrientationY][i] = q.y;
+		fields[PreviousOrientationZ][i] = q.z;
+		fields[PreviousOrientationW][i] = q.w;
+	}
+}
+
+void RigidBodyStore::InterpolateTransforms(int start, int end, float alpha) {
+	for (int i = start; i < end; ++i) {
+		Vector3		from(fields[PreviousPositionX][i], fields[PreviousPositionY][i], fields[PreviousPositionZ][i]);
+		Quaternion	fromOr(fields[PreviousOrientationX][i], fields[PreviousOrientationY][i], fields[PreviousOrientationZ][i], fields[PreviousOrientationW][i]);
+
+		Vector3		to		= transforms[i]->GetPosition();
+		Quaternion	toOr	= transforms[i]->GetOrientation();
+
+		//The steps are short, so a normalised lerp is close enough to a slerp
+		Quaternion renderOr = Quaternion::Lerp(fromOr, toOr, alpha);
+		renderOr.Normalise();
+
+		transforms[i]->SetRenderState(from + ((to - from) * alpha), renderOr);
+	}
+}
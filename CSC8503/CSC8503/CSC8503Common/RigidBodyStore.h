@@ -0,0 +1,117 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include "../../Common/Matrix3.h"
+#include "../../Common/Quaternion.h"
+#include <vector>
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		class PhysicsObject;
+		class Transform;
+
+		/*
+		Packed storage for the state of a set of rigid bodies. Rather than each
+		PhysicsObject holding its own velocities, forces and so on, every value
+		lives in an array of its own, with one entry per body, so that the
+		integration loops can walk straight through memory, and the compiler
+		can turn them into vector instructions.
+
+		A PhysicsObject is just a handle - a store and an index into it. Each
+		GameWorld has its own store, and bodies that haven't been added to a
+		world yet sit in a shared 'unattached' store. Removing a body moves the
+		last body into its place, so the arrays never have any gaps in them.
+
+		Positions and orientations are a working copy of the Transforms, which
+		are still the real owners of them for the rest of the engine. The
+		integration loops read them in, do their sums, and write them back.
+		*/
+		class RigidBodyStore {
+		public:
+			enum Field {
+				LinearVelocityX, LinearVelocityY, LinearVelocityZ,
+				AngularVelocityX, AngularVelocityY, AngularVelocityZ,
+				ForceX, ForceY, ForceZ,
+				TorqueX, TorqueY, TorqueZ,
+				InverseMass,
+				InverseInertiaX, InverseInertiaY, InverseInertiaZ,
+				//Which way the inertia's principal axes face relative to the body - no rotation, unless it's a compound
+				InertiaFrameX, InertiaFrameY, InertiaFrameZ, InertiaFrameW,
+				//The world space inverse inertia tensor, laid out like Matrix3::array
+				InverseTensor0, InverseTensor1, InverseTensor2,
+				InverseTensor3, InverseTensor4, InverseTensor5,
+				InverseTensor6, InverseTensor7, InverseTensor8,
+				PositionX, PositionY, PositionZ,
+				OrientationX, OrientationY, OrientationZ, OrientationW,
+				//Where the body was before the last step, for drawing between steps
+				PreviousPositionX, PreviousPositionY, PreviousPositionZ,
+				PreviousOrientationX, PreviousOrientationY, PreviousOrientationZ, PreviousOrientationW,
+				//How long the body has been moving slowly enough to sleep
+				SleepTimer,
+				//1 while asleep, 0 while awake - a float so it can mask the integration loops
+				Asleep,
+				FieldCount
+			};
+
+			RigidBodyStore();
+			~RigidBodyStore();
+
+			//Bodies that aren't in any world yet
+			static RigidBodyStore& Unattached();
+
+			int  AddBody(PhysicsObject* owner, Transform* transform);
+			void RemoveBody(int index);
+
+			//Moves a body out of another store into this one, returning its new index
+			int  TakeBody(RigidBodyStore& from, int index);
+
+			int GetBodyCount() const {
+				return (int)owners.size();
+			}
+
+			float* GetField(Field f) {
+				return fields[f].data();
+			}
+
+			const float* GetField(Field f) const {
+				return fields[f].data();
+			}
+
+			PhysicsObject* GetOwner(int index) const {
+				return owners[index];
+			}
+
+			Transform* GetTransform(int index) const {
+				return transforms[index];
+			}
+
+			Vector3 GetVector(Field x, int index) const {
+				return Vector3(fields[x][index], fields[x + 1][index], fields[x + 2][index]);
+			}
+
+			void SetVector(Field x, int index, const Vector3& v) {
+				fields[x][index]		= v.x;
+				fields[x + 1][index]	= v.y;
+				fields[x + 2][index]	= v.z;
+			}
+
+			Matrix3 GetInverseTensor(int index) const;
+
+			//Copies position and orientation in from the transforms of bodies [start, end)
+			void ReadTransforms(int start, int end);
+			void ReadOrientations(int start, int end);
+			//...and back out again
+			void WriteTransforms(int start, int end);
+
+			//Remembers where bodies [start, end) are before a step...
+			void SavePreviousTransforms(int start, int end);
+			//...so they can be drawn the given fraction of the way from there to where they are now
+			void InterpolateTransforms(int start, int end, float alpha);
+
+		protected:
+			std::vector<float>			fields[FieldCount];
+			std::vector<PhysicsObject*>	owners;
+			std::vector<Transform*>		transforms;
+		};
+	}
+}
@@ -0,0 +1,357 @@
+#include "RopeSystem.h"
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+#include "CollisionDetection.h"
+#include "SphereVolume.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace NCL;
+using namespace CSC8503;
+
+RopeSystem::RopeSystem(GameWorld& g) : gameWorld(g) {
+	substeps	= 8;
+	damping		= 0.1f;
+	friction	= 0.5f;
+}
+
+RopeSystem::~RopeSystem() {
+}
+
+void RopeSystem::Clear() {
+	ropes.clear();
+	attachments.clear();
+	corrections.clear();
+	positions.clear();
+	previousPositions.clear();
+	velocities.clear();
+	inverseMasses.clear();
+	stepPositions.clear();
+	renderPositions.clear();
+	colliders.clear();
+}
+
+int RopeSystem::AddRope(const Vector3& start, const Vector3& end, int segmentCount, float length, float inverseParticleMass) {
+	segmentCount = std::max(segmentCount, 1);
+
+	Rope r;
+	r.first			= (int)positions.size();
+	r.count			= segmentCount + 1;
+	r.segmentLength	= length / segmentCount;
+	r.compliance	= 0.0f;
+	r.radius		= 0.5f;
+	r.firstCollider	= 0;
+	r.colliderCount	= 0;
+
+	for (int i = 0; i < r.count; ++i) {
+		Vector3 p = start + ((end - start) * ((float)i / segmentCount));
+		positions.emplace_back(p);
+		previousPositions.emplace_back(p);
+		stepPositions.emplace_back(p);
+		renderPositions.emplace_back(p);
+		velocities.emplace_back(Vector3());
+		inverseMasses.emplace_back(inverseParticleMass);
+	}
+	ropes.emplace_back(r);
+	return (int)ropes.size() - 1;
+}
+
+void RopeSystem::Attach(int rope, int particle, GameObject* object, const Vector3& localOffset) {
+	Attachment a;
+	a.particle		= ropes[rope].first + particle;
+	a.rope			= rope;
+	a.object		= object;
+	a.localOffset	= localOffset;
+	a.body			= -1;
+	attachments.emplace_back(a);
+}
+
+void RopeSystem::Pin(int rope, int particle) {
+	inverseMasses[ropes[rope].first + particle] = 0.0f;
+}
+
+void RopeSystem::SetCompliance(int rope, float compliance) {
+	ropes[rope].compliance = compliance;
+}
+
+void RopeSystem::SetRadius(int rope, float radius) {
+	ropes[rope].radius = radius;
+}
+
+void RopeSystem::Step(float dt, const Vector3& gravity) {
+	if (ropes.empty()) {
+		return;
+	}
+	FindColliders(dt);
+	BeginCorrections();
+
+	const int	particleCount	= (int)positions.size();
+	const float	substepDt		= dt / substeps;
+	const float	keep			= std::max(0.0f, 1.0f - (damping * substepDt));
+
+	for (int s = 0; s < substeps; ++s) {
+		for (int i = 0; i < particleCount; ++i) {
+			previousPositions[i] = positions[i];
+			if (inverseMasses[i] > 0.0f) {
+				velocities[i]	+= gravity * substepDt;
+				positions[i]	+= velocities[i] * substepDt;
+			}
+		}
+		SolveAttachments((s + 1) * substepDt);
+		for (const Rope& r : ropes) {
+			SolveSegments(r, substepDt);
+			SolveCollisions(r);
+		}
+		for (int i = 0; i < particleCount; ++i) {
+			velocities[i] = (positions[i] - previousPositions[i]) * (keep / substepDt);
+		}
+	}
+	ApplyCorrections(dt);
+	std::copy(positions.begin(), positions.end(), renderPositions.begin());
+}
+
+/*
+Rather than asking the world what each particle is touching every substep,
+each rope asks once a step for every static object near enough that it
+might touch it, and the particles are then only tested against those.
+*/
+void RopeSystem::FindColliders(float dt) {
+	colliders.clear();
+
+	GameObject* found[MaxRopeColliders];
+	for (int r = 0; r < (int)ropes.size(); ++r) {
+		Rope& rope = ropes[r];
+
+		Vector3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (int i = rope.first; i < rope.first + rope.count; ++i) {
+			Vector3 move	= velocities[i] * dt;
+			Vector3 reach	= Vector3(std::abs(move.x), std::abs(move.y), std::abs(move.z)) + Vector3(rope.radius, rope.radius, rope.radius);
+			Vector3 low		= positions[i] - reach;
+			Vector3 high	= positions[i] + reach;
+			boundsMin = Vector3(std::min(boundsMin.x, low.x), std::min(boundsMin.y, low.y), std::min(boundsMin.z, low.z));
+			boundsMax = Vector3(std::max(boundsMax.x, high.x), std::max(boundsMax.y, high.y), std::max(boundsMax.z, high.z));
+		}
+		/*
+		Only static objects the rope isn't tied to are wanted, and they're
+		picked out inside the query, so moving bodies and triggers crowding
+		the rope can't take up the slots a wall behind them needs.
+		*/
+		QueryFilter filter;
+		filter.accept = [&](const GameObject* o) {
+			PhysicsObject* phys = o->GetPhysicsObject();
+			if (!phys || phys->GetInverseMass() > 0.0f || phys->GetTrigger()) {
+				return false;
+			}
+			//Whatever the rope's tied to would just pull the end straight back in
+			for (const Attachment& a : attachments) {
+				if (a.rope == r && a.object == o) {
+					return false;
+				}
+			}
+			return true;
+		};
+		int count = gameWorld.OverlapBox((boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f, Quaternion(), found, MaxRopeColliders, filter);
+
+		rope.firstCollider = (int)colliders.size();
+		for (int i = 0; i < count; ++i) {
+			Collider c;
+			c.object = found[i];
+			CollisionDetection::VolumeBounds(*found[i]->GetBoundingVolume(), found[i]->GetTransform(), c.min, c.max);
+			colliders.emplace_back(c);
+		}
+		rope.colliderCount = (int)colliders.size() - rope.firstCollider;
+	}
+}
+
+//Every object with a rope tied to it gets one correction, however many ropes there are
+void RopeSystem::BeginCorrections() {
+	corrections.clear();
+	for (Attachment& a : attachments) {
+		a.body = -1;
+		for (int i = 0; i < (int)corrections.size() && a.body < 0; ++i) {
+			if (corrections[i].object == a.object) {
+				a.body = i;
+			}
+		}
+		if (a.body < 0) {
+			a.body = (int)corrections.size();
+			corrections.push_back({ a.object, Vector3(), Vector3() });
+		}
+	}
+}
+
+/*
+An attached particle is pulled onto its point on the object. If the object
+can be pushed around too, they're both moved, by however much each can be -
+a light particle moves a long way towards a heavy object, and a heavy object
+barely moves at all. Something like a moving platform just drags the
+particle along with it.
+
+The object itself isn't moved until the rest of the physics finishes the
+step, so its point is moved along by its velocity to where it'll be by the
+end of each substep, and by however far the ropes have pushed it so far.
+*/
+void RopeSystem::SolveAttachments(float elapsed) {
+	for (const Attachment& a : attachments) {
+		PhysicsObject*		phys		= a.object->GetPhysicsObject();
+		const Transform&	transform	= a.object->GetTransform();
+		Correction&			correction	= corrections[a.body];
+
+		Vector3 relative	= transform.GetOrientation() * a.localOffset;
+		Vector3 target		= transform.GetPosition() + relative;
+		bool	moves		= a.object->CanMove();
+		bool	rotates		= moves && a.object->CanRotate();
+		bool	pushable	= moves && phys->GetInverseMass() > 0.0f;
+		if (moves) {
+			Vector3 pointVelocity	= phys->GetLinearVelocity() + (rotates ? Vector3::Cross(phys->GetAngularVelocity(), relative) : Vector3());
+			Vector3 pushed			= (correction.linear * phys->GetInverseMass()) + Vector3::Cross(phys->GetInertiaTensor() * correction.angular, relative);
+			target += (pointVelocity * elapsed) + pushed;
+		}
+
+		Vector3 offset		= positions[a.particle] - target;
+		float	distance	= offset.Length();
+		if (distance < 0.0001f) {
+			continue;
+		}
+		Vector3 normal			= offset / distance;
+		float	particleWeight	= inverseMasses[a.particle];
+		float	bodyWeight		= 0.0f;
+		Vector3 arm;
+		if (pushable) {
+			arm			= rotates ? Vector3::Cross(relative, normal) : Vector3();
+			bodyWeight	= phys->GetInverseMass() + Vector3::Dot(arm, phys->GetInertiaTensor() * arm);
+		}
+		if (particleWeight + bodyWeight <= 0.0f) {
+			continue;
+		}
+		float lambda = -distance / (particleWeight + bodyWeight);
+
+		positions[a.particle] += normal * (particleWeight * lambda);
+		if (pushable) {
+			Vector3 impulse = normal * -lambda;
+			correction.linear += impulse;
+			if (rotates) {
+				correction.angular += Vector3::Cross(relative, impulse);
+			}
+		}
+	}
+}
+
+/*
+Each object is given the impulse that moves it as far as the ropes pushed
+it, over the whole step it's about to be moved along for.
+*/
+void RopeSystem::ApplyCorrections(float dt) {
+	for (const Correction& c : corrections) {
+		PhysicsObject* phys = c.object->GetPhysicsObject();
+		if (!phys || (c.linear == Vector3() && c.angular == Vector3())) {
+			continue;
+		}
+		phys->ApplyLinearImpulse(c.linear / dt);
+		phys->ApplyAngularImpulse(c.angular / dt);
+	}
+}
+
+/*
+Each segment that's been stretched is pulled back to its length, with the
+two particles moved by however much each can be. The compliance softens
+this - it's scaled by the substep length, so the rope is as stretchy
+however many substeps there are.
+*/
+void RopeSystem::SolveSegments(const Rope& rope, float substepDt) {
+	const float softness = rope.compliance / (substepDt * substepDt);
+
+	for (int i = rope.first; i < rope.first + rope.count - 1; ++i) {
+		float weight = inverseMasses[i] + inverseMasses[i + 1];
+		if (weight <= 0.0f) {
+			continue;
+		}
+		Vector3 offset	= positions[i + 1] - positions[i];
+		float	squared	= Vector3::Dot(offset, offset);
+		if (squared <= rope.segmentLength * rope.segmentLength) {
+			continue;
+		}
+		float	distance	= std::sqrt(squared);
+		Vector3 normal		= offset / distance;
+		float	lambda	= -(distance - rope.segmentLength) / (weight + softness);
+
+		positions[i]		-= normal * (inverseMasses[i] * lambda);
+		positions[i + 1]	+= normal * (inverseMasses[i + 1] * lambda);
+	}
+}
+
+/*
+Particles that have gone into something static are pushed straight back
+out, and lose some of how far they slid along its surface this substep.
+Most particles aren't anywhere near anything, so they're checked against
+each object's box before going through the full collision test.
+*/
+void RopeSystem::SolveCollisions(const Rope& rope) {
+	if (rope.colliderCount == 0) {
+		return;
+	}
+	SphereVolume	particle(rope.radius);
+	Transform		transform;
+	for (int i = rope.first; i < rope.first + rope.count; ++i) {
+		if (inverseMasses[i] == 0.0f) {
+			continue;
+		}
+		for (int c = rope.firstCollider; c < rope.firstCollider + rope.colliderCount; ++c) {
+			const Collider&	collider	= colliders[c];
+			const Vector3&	p			= positions[i];
+			if (p.x + rope.radius < collider.min.x || p.x - rope.radius > collider.max.x ||
+				p.y + rope.radius < collider.min.y || p.y - rope.radius > collider.max.y ||
+				p.z + rope.radius < collider.min.z || p.z - rope.radius > collider.max.z) {
+				continue;
+			}
+			transform.SetPosition(p);
+
+			CollisionDetection::CollisionInfo info;
+			if (!CollisionDetection::VolumeIntersection((const CollisionVolume&)particle, transform,
+				*collider.object->GetBoundingVolume(), collider.object->GetTransform(), info)) {
+				continue;
+			}
+			const CollisionDetection::ContactPoint& contact = info.points[0];
+			positions[i] -= contact.normal * contact.penetration;
+
+			Vector3 moved	= positions[i] - previousPositions[i];
+			Vector3 slide	= moved - (contact.normal * Vector3::Dot(moved, contact.normal));
+			positions[i]	-= slide * friction;
+		}
+	}
+}
+
+void RopeSystem::SavePreviousPositions() {
+	std::copy(positions.begin(), positions.end(), stepPositions.begin());
+}
+
+void RopeSystem::InterpolatePositions(float alpha) {
+	for (int i = 0; i < (int)positions.size(); ++i) {
+		renderPositions[i] = stepPositions[i] + ((positions[i] - stepPositions[i]) * alpha);
+	}
+}
+
+void RopeSystem::SaveState(StateBuffer& buffer) const {
+	int particleCount = (int)positions.size();
+	buffer.Write(particleCount);
+	buffer.WriteBytes(positions.data(), particleCount * sizeof(Vector3));
+	buffer.WriteBytes(velocities.data(), particleCount * sizeof(Vector3));
+}
+
+bool RopeSystem::RestoreState(StateBuffer& buffer) {
+	int particleCount = 0;
+	if (!buffer.Read(particleCount) || particleCount != (int)positions.size()) {
+		return false;
+	}
+	if (!buffer.ReadBytes(positions.data(), particleCount * sizeof(Vector3)) ||
+		!buffer.ReadBytes(velocities.data(), particleCount * sizeof(Vector3))) {
+		return false;
+	}
+	std::copy(positions.begin(), positions.end(), stepPositions.begin());
+	std::copy(positions.begin(), positions.end(), renderPositions.begin());
+	return true;
+}
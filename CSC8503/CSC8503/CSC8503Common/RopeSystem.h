@@ -0,0 +1,159 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include "StateBuffer.h"
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+		class GameWorld;
+
+		using Maths::Vector3;
+
+		/*
+		Ropes and chains, made of particles rather than rigid bodies. A
+		particle is just a position, a velocity and a mass - it has no
+		collision volume, render object or entry in the contact solver - so
+		a rope costs a tiny fraction of a chain of boxes held together with
+		constraints.
+
+		They're simulated with extended position based dynamics (XPBD). Each
+		step is cut into several smaller substeps, and each substep moves
+		the particles under gravity, then moves them straight back into
+		place so that neighbours are the right distance apart, and out of
+		anything static they've gone into. Their new velocity is however far
+		that left them having moved. Short substeps with one pass each keep
+		long ropes stiff far more cheaply than lots of passes over one step.
+
+		Every rope's particles sit next to each other in the same arrays, so
+		stepping a rope just walks along them in order. Segments only ever
+		pull their ends together, so a rope can go slack and bunch up.
+
+		Ropes only affect rigid bodies where they're attached to them. The
+		rope pulls on the body there, and the body drags the rope's particle
+		along with it. Ropes collide with static objects, but nothing moving
+		collides with a rope.
+		*/
+		class RopeSystem {
+		public:
+			RopeSystem(GameWorld& g);
+			~RopeSystem();
+
+			void Clear();
+
+			/*
+			Adds a rope of segmentCount segments, laid out in a straight line
+			from start to end, that's length long when pulled straight. It
+			doesn't have to start out pulled straight. Returns the rope's index.
+			*/
+			int AddRope(const Vector3& start, const Vector3& end, int segmentCount, float length, float inverseParticleMass);
+
+			/*
+			Ties one of a rope's particles to a point on an object, given in the
+			object's own space. Tying it to something that can't move holds it
+			in place, otherwise the rope and object pull on each other.
+			*/
+			void Attach(int rope, int particle, GameObject* object, const Vector3& localOffset = Vector3());
+
+			//Holds a particle where it is, without it being tied to anything
+			void Pin(int rope, int particle);
+
+			//How stretchy the rope is - 0 doesn't stretch at all, larger numbers are springier
+			void SetCompliance(int rope, float compliance);
+
+			//How thick the rope is, when colliding with the world
+			void SetRadius(int rope, float radius);
+
+			void SetSubsteps(int count) {
+				substeps = count;
+			}
+
+			int GetRopeCount() const {
+				return (int)ropes.size();
+			}
+
+			int GetParticleCount(int rope) const {
+				return ropes[rope].count;
+			}
+
+			//Where a rope's particles should be drawn
+			const Vector3* GetRenderPositions(int rope) const {
+				return &renderPositions[ropes[rope].first];
+			}
+
+			void Step(float dt, const Vector3& gravity);
+
+			void SavePreviousPositions();
+			void InterpolatePositions(float alpha);
+
+			//Only the particles' positions and velocities - the ropes themselves have to be the same
+			void SaveState(StateBuffer& buffer) const;
+			bool RestoreState(StateBuffer& buffer);
+
+		protected:
+			struct Rope {
+				int		first;
+				int		count;
+				float	segmentLength;
+				float	compliance;
+				float	radius;
+				int		firstCollider;
+				int		colliderCount;
+			};
+
+			struct Attachment {
+				int			particle;
+				int			rope;
+				GameObject* object;
+				Vector3		localOffset;
+				int			body;	//Which of the step's corrections the object's share goes into
+			};
+
+			/*
+			How far the ropes have pushed an object so far this step, as the
+			impulse that would move it that far. It's only given to the object
+			once all the substeps are done, as the object only moves once.
+			*/
+			struct Correction {
+				GameObject*	object;
+				Vector3		linear;
+				Vector3		angular;
+			};
+
+			void FindColliders(float dt);
+			void BeginCorrections();
+			void SolveAttachments(float elapsed);
+			void ApplyCorrections(float dt);
+			void SolveSegments(const Rope& rope, float substepDt);
+			void SolveCollisions(const Rope& rope);
+
+			static const int MaxRopeColliders = 16;
+
+			GameWorld& gameWorld;
+
+			std::vector<Rope>		ropes;
+			std::vector<Attachment>	attachments;
+			std::vector<Correction>	corrections;
+
+			std::vector<Vector3>	positions;
+			std::vector<Vector3>	previousPositions;	//Where each particle was at the start of the substep
+			std::vector<Vector3>	velocities;
+			std::vector<float>		inverseMasses;
+
+			std::vector<Vector3>	stepPositions;		//Where each particle was at the start of the last step, for drawing
+			std::vector<Vector3>	renderPositions;
+
+			//The static objects near each rope this step, and the boxes around them
+			struct Collider {
+				GameObject*	object;
+				Vector3		min;
+				Vector3		max;
+			};
+			std::vector<Collider> colliders;
+
+			int		substeps;
+			float	damping;
+			float	friction;
+		};
+	}
+}
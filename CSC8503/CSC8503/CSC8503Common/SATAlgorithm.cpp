@@ -1,187 +1,356 @@
 #include "SATAlgorithm.h"
-#include "Debug.h"
-using namespace NCL;
-#include "Transform.h"
 
+#include <cfloat>
+#include <cmath>
+
+using namespace NCL;
 using namespace Maths;
 using namespace CSC8503;
 
-SATAlgorithm::SATAlgorithm()
-{
+/*
+Axes closer to parallel than this are treated as parallel, and their cross
+product isn't tested - it's too short to give a meaningful direction, and
+the face axes already cover that case.
+*/
+const float parallelEpsilon	= 1e-5f;
+
+/*
+Edge axes are only used if they're noticeably better than the best face
+axis. Otherwise the two tend to swap back and forth from frame to frame
+when a box is resting flat, and face contacts are far more stable.
+*/
+const float edgeRelativeTolerance	= 0.95f;
+const float edgeAbsoluteTolerance	= 0.01f;
+
+SATAlgorithm::Box::Box(const Vector3& position, const Quaternion& orientation, const Vector3& halfSize) {
+	Matrix3 m		= Matrix3(orientation);
+	this->position	= position;
+	this->halfSize	= halfSize;
+	for (int i = 0; i < 3; ++i) {
+		axes[i] = m.GetColumn(i);
+	}
 }
 
-
-SATAlgorithm::~SATAlgorithm()
-{
+SATAlgorithm::Box::Box(const Vector3& position, const Vector3& halfSize) {
+	this->position	= position;
+	this->halfSize	= halfSize;
+	axes[0] = Vector3(1, 0, 0);
+	axes[1] = Vector3(0, 1, 0);
+	axes[2] = Vector3(0, 0, 1);
 }
 
-bool SATAlgorithm::BoundingBoxSAT(const NCL::OBBVolume& volumeA, const Transform& worldTransformA,
-	const NCL::OBBVolume& volumeB, const Transform& worldTransformB, CollisionDetection::CollisionInfo& collisionInfo
-) {
-	Vector3 aBoxSize = volumeA.GetHalfDimensions();// * 0.5f;
-	Vector3 bBoxSize = volumeB.GetHalfDimensions();// * 0.5f;
-
-	Matrix3 aInvOrientation = Matrix3(worldTransformA.GetOrientation().Conjugate());
-
-	Vector3 bRelativePos = aInvOrientation * (worldTransformB.GetPosition() - worldTransformA.GetPosition());
-
-	Matrix3 relativeOrientation = aInvOrientation * Matrix3(worldTransformB.GetOrientation());
-	Matrix3 absoluteRelative = relativeOrientation.Absolute();
-
-	//Vector3 bBoxExpanded = absoluteRelative * bBoxSize; //need to see how to use this better
-
-	Vector3 realRelativeSize = relativeOrientation * bBoxSize;
-
-	//box a can now be thought of as being axis aligned to b
-
-	bool isParallel = false;
-
-	for (int i = 0; i < 9; ++i) {
-		if (absoluteRelative.array[i] > 0.999f) {
-			isParallel = true;
-			break;
+bool SATAlgorithm::BoxIntersection(const Box& boxA, const Box& boxB, CollisionDetection::CollisionInfo& collisionInfo) {
+	const Vector3& ha = boxA.halfSize;
+	const Vector3& hb = boxB.halfSize;
+
+	/*
+	Everything is worked out in box a's space, where its axes are just x, y
+	and z. R[i][j] is how much b's axis j points along a's axis i, and is
+	worked out once, along with its absolute value, as every one of the 15
+	tests uses them.
+	*/
+	float R[3][3];
+	float absR[3][3];
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			R[i][j]		= Vector3::Dot(boxA.axes[i], boxB.axes[j]);
+			absR[i][j]	= std::abs(R[i][j]) + parallelEpsilon;
 		}
 	}
 
-	float bestOnA = -FLT_MAX;
-	float bestOnB = -FLT_MAX;
-	float bestOnEdge = -FLT_MAX;
-
-	int bestAAxis = 0;
-	int bestBAxis = 0;
-
-	bool noCollide = false;
-
-	//Test A axes
+	Vector3 delta = boxB.position - boxA.position;
+	float t[3];
 	for (int i = 0; i < 3; ++i) {
-		float s = abs(bRelativePos[i]) - (aBoxSize[i] + Vector3::Dot(absoluteRelative.GetRow(i), bBoxSize));
+		t[i] = Vector3::Dot(delta, boxA.axes[i]);
+	}
 
+	//The separations are negative while overlapping - the biggest is the shallowest overlap
+	float	bestA		= -FLT_MAX;
+	int		bestAxisA	= 0;
+	for (int i = 0; i < 3; ++i) {
+		float rb = hb[0] * absR[i][0] + hb[1] * absR[i][1] + hb[2] * absR[i][2];
+		float s	 = std::abs(t[i]) - (ha[i] + rb);
 		if (s > 0.0f) {
-			noCollide = true;
-			//definately not colliding, there's a separation on this axis
+			return false;
 		}
+		if (s > bestA) {
+			bestA		= s;
+			bestAxisA	= i;
+		}
+	}
 
-		if (s > bestOnA) {
-			bestOnA = s;
-			bestAAxis = i;
+	float	bestB		= -FLT_MAX;
+	int		bestAxisB	= 0;
+	for (int j = 0; j < 3; ++j) {
+		float ra = ha[0] * absR[0][j] + ha[1] * absR[1][j] + ha[2] * absR[2][j];
+		float tb = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+		float s	 = std::abs(tb) - (ra + hb[j]);
+		if (s > 0.0f) {
+			return false;
+		}
+		if (s > bestB) {
+			bestB		= s;
+			bestAxisB	= j;
 		}
 	}
 
-	//Now test B Axes
+	float	bestEdge	= -FLT_MAX;
+	int		edgeA		= -1;
+	int		edgeB		= -1;
 	for (int i = 0; i < 3; ++i) {
+		int i1 = (i + 1) % 3;
+		int i2 = (i + 2) % 3;
+		for (int j = 0; j < 3; ++j) {
+			int j1 = (j + 1) % 3;
+			int j2 = (j + 2) % 3;
+
+			//The axis is a's axis i crossed with b's axis j, so its length is the sine of the angle between them
+			float length = sqrt(std::max(0.0f, 1.0f - R[i][j] * R[i][j]));
+			if (length < 1e-4f) {
+				continue;
+			}
+			float tl = t[i2] * R[i1][j] - t[i1] * R[i2][j];
+			float ra = ha[i1] * absR[i2][j] + ha[i2] * absR[i1][j];
+			float rb = hb[j1] * absR[i][j2] + hb[j2] * absR[i][j1];
+			float s	 = std::abs(tl) - (ra + rb);
+			if (s > 0.0f) {
+				return false;
+			}
+			s /= length;
+			if (s > bestEdge) {
+				bestEdge	= s;
+				edgeA		= i;
+				edgeB		= j;
+			}
+		}
+	}
 
-		float s = abs(Vector3::Dot(bRelativePos, relativeOrientation.GetColumn(i))) - (bBoxSize[i] + Vector3::Dot(absoluteRelative.GetColumn(i), aBoxSize));
+	float bestFace = std::max(bestA, bestB);
 
-		if (s > 0.0f) {
-			noCollide = true;
-			//definately not colliding, there's a separation on this axis
+	if (edgeA != -1 && bestEdge > edgeRelativeTolerance * bestFace + edgeAbsoluteTolerance) {
+		Vector3 normal = Vector3::Cross(boxA.axes[edgeA], boxB.axes[edgeB]).Normalised();
+		if (Vector3::Dot(normal, delta) < 0.0f) {
+			normal = -normal;
 		}
+		EdgeContact(boxA, edgeA, boxB, edgeB, normal, -bestEdge, collisionInfo);
+	}
+	//Prefer a's faces slightly, for the same reason as above
+	else if (bestB > edgeRelativeTolerance * bestA + edgeAbsoluteTolerance) {
+		float side = Vector3::Dot(delta, boxB.axes[bestAxisB]) > 0.0f ? -1.0f : 1.0f;
+		FaceContact(boxB, bestAxisB, side, boxA, false, collisionInfo);
+	}
+	else {
+		float side = t[bestAxisA] < 0.0f ? -1.0f : 1.0f;
+		FaceContact(boxA, bestAxisA, side, boxB, true, collisionInfo);
+	}
+	return collisionInfo.pointCount > 0;
+}
 
-		if (s > bestOnB) {
-			bestOnB = s;
-			bestBAxis = i;
+/*
+The reference face is the face of one box along the best axis, facing the
+other box. The incident face is the face of the other box that points
+most directly back at it. The incident face is clipped to the 4 sides of
+the reference face, and every corner left that's below the reference face
+becomes a contact point.
+
+The clipping ping-pongs between two fixed size buffers on the stack, so
+no memory is allocated however many pairs are tested.
+*/
+void SATAlgorithm::FaceContact(const Box& reference, int axis, float sign, const Box& incident,
+	bool referenceIsA, CollisionDetection::CollisionInfo& collisionInfo) {
+	Vector3 refNormal	= reference.axes[axis] * sign;
+	Vector3 refCentre	= reference.position + refNormal * reference.halfSize[axis];
+
+	int		incidentAxis	= 0;
+	float	mostFacing		= -1.0f;
+	for (int i = 0; i < 3; ++i) {
+		float d = std::abs(Vector3::Dot(refNormal, incident.axes[i]));
+		if (d > mostFacing) {
+			mostFacing		= d;
+			incidentAxis	= i;
 		}
 	}
+	float	incidentSign	= Vector3::Dot(refNormal, incident.axes[incidentAxis]) > 0.0f ? -1.0f : 1.0f;
+	Vector3	incidentCentre	= incident.position + incident.axes[incidentAxis] * (incident.halfSize[incidentAxis] * incidentSign);
+
+	int		u	= (incidentAxis + 1) % 3;
+	int		v	= (incidentAxis + 2) % 3;
+	Vector3 eu	= incident.axes[u] * incident.halfSize[u];
+	Vector3 ev	= incident.axes[v] * incident.halfSize[v];
+
+	ClipPoints buffers[2];
+	buffers[0].points[0] = incidentCentre + eu + ev;
+	buffers[0].points[1] = incidentCentre - eu + ev;
+	buffers[0].points[2] = incidentCentre - eu - ev;
+	buffers[0].points[3] = incidentCentre + eu - ev;
+	buffers[0].count	 = 4;
+
+	int current = 0;
+	for (int i = 1; i < 3; ++i) {
+		int		side		= (axis + i) % 3;
+		Vector3 sideNormal	= reference.axes[side];
+		float	offset		= Vector3::Dot(sideNormal, reference.position);
+		float	extent		= reference.halfSize[side];
+
+		ClipToPlane(buffers[current], sideNormal, offset + extent, buffers[1 - current]);
+		current = 1 - current;
+		ClipToPlane(buffers[current], -sideNormal, -offset + extent, buffers[1 - current]);
+		current = 1 - current;
+	}
 
-	//Now we have to also check the edges
-
-	Vector3 bestEdgeAxis;
-	if (!isParallel) {
-		for (int a = 0; a < 3; ++a) {
-			Vector3 aDir = absoluteRelative.GetColumn(a);
-			for (int b = 0; b < 3; ++b) {
-				Vector3 bDir = relativeOrientation.GetColumn(b);
-
-				Vector3 l = Vector3::Cross(aDir, bDir);
+	const ClipPoints& clipped = buffers[current];
+
+	Vector3 onIncident[MaxClipPoints];
+	float	depths[MaxClipPoints];
+	int		count = 0;
+	for (int i = 0; i < clipped.count; ++i) {
+		float separation = Vector3::Dot(refNormal, clipped.points[i] - refCentre);
+		if (separation <= 0.0f) {
+			onIncident[count]	= clipped.points[i];
+			depths[count]		= -separation;
+			count++;
+		}
+	}
 
-				if (l.Length() == 0.0f) {
-					continue;
-				}
+	int chosen[CollisionDetection::MaxContactPoints];
+	int chosenCount = ReduceContacts(onIncident, depths, count, refNormal, chosen);
 
-				float tl = Vector3::Dot(bRelativePos, l);
-				float al = Vector3::Dot(aBoxSize, l);
-				float bl = Vector3::Dot(realRelativeSize, l);
+	//The contact normal always points from a to b
+	Vector3 normal = referenceIsA ? refNormal : -refNormal;
 
-				float s = abs(tl) - (abs(al) + abs(bl));
+	for (int i = 0; i < chosenCount; ++i) {
+		Vector3 pointIncident	= onIncident[chosen[i]];
+		Vector3 pointReference	= pointIncident + refNormal * depths[chosen[i]];
 
-				if (s > 0.0f) {
-					noCollide = true;//definately not colliding, there's a separation on this axis
-				}
-				if (s > bestOnEdge) {
-					bestOnEdge = s;
-					//bestAAxis	= a;
-					//bestBAxis	= b;
-					bestEdgeAxis = l;
-				}
-			}
+		if (referenceIsA) {
+			collisionInfo.AddContactPoint(pointReference - reference.position, pointIncident - incident.position, normal, depths[chosen[i]]);
+		}
+		else {
+			collisionInfo.AddContactPoint(pointIncident - incident.position, pointReference - reference.position, normal, depths[chosen[i]]);
 		}
 	}
+}
 
-	Vector3 aNorm = Vector3(worldTransformA.GetMatrix().GetColumn(bestAAxis));
-	Vector3 otherA = aInvOrientation.GetColumn(bestAAxis);
-
-	Vector3 bNorm = Vector3(worldTransformB.GetMatrix().GetColumn(bestBAxis));
-	Vector3 edgeNorm = bestEdgeAxis;
-
-	Debug::DrawLine(worldTransformA.GetPosition(), worldTransformA.GetPosition() + (aNorm  * bestOnA * 0.5f), Vector4(1, 0, 0, 1));
-	Debug::DrawLine(worldTransformA.GetPosition(), worldTransformA.GetPosition() + (otherA  * bestOnA * 0.5f), Vector4(0.5, 0, 0, 1));
+/*
+The edges that touch are the ones furthest along the normal on a, and
+furthest against it on b. The contact is at the closest points between
+them, kept within the ends of each edge.
+*/
+void SATAlgorithm::EdgeContact(const Box& a, int axisA, const Box& b, int axisB,
+	const Vector3& normal, float penetration, CollisionDetection::CollisionInfo& collisionInfo) {
+	Vector3 edgeA = a.position;
+	Vector3 edgeB = b.position;
+	for (int i = 0; i < 3; ++i) {
+		if (i != axisA) {
+			edgeA += a.axes[i] * (Vector3::Dot(normal, a.axes[i]) > 0.0f ? a.halfSize[i] : -a.halfSize[i]);
+		}
+		if (i != axisB) {
+			edgeB += b.axes[i] * (Vector3::Dot(normal, b.axes[i]) > 0.0f ? -b.halfSize[i] : b.halfSize[i]);
+		}
+	}
+	Vector3 dirA = a.axes[axisA];
+	Vector3 dirB = b.axes[axisB];
 
-	Debug::DrawLine(worldTransformB.GetPosition(), worldTransformB.GetPosition() + (bNorm  * bestOnB * 0.5f), Vector4(1, 1, 0, 1));
+	Vector3 r		= edgeA - edgeB;
+	float	d		= Vector3::Dot(dirA, dirB);
+	float	c		= Vector3::Dot(dirA, r);
+	float	f		= Vector3::Dot(dirB, r);
+	float	denom	= 1.0f - d * d;
 
+	float s = denom > parallelEpsilon ? (d * f - c) / denom : 0.0f;
+	s = std::min(std::max(s, -a.halfSize[axisA]), a.halfSize[axisA]);
 
-	//float bestFace = max(bestOnA, bestOnB);
+	float tb = d * s + f;
+	tb = std::min(std::max(tb, -b.halfSize[axisB]), b.halfSize[axisB]);
 
-	//if (bestOnEdge > bestFace) {
-	//	Vector3 norm = bestEdgeAxis;
-	//	Debug::DrawLine(worldTransformA.GetWorldPosition(), worldTransformA.GetWorldPosition() + (norm  * 15.0f), Vector4(1, 0, 0, 1));
-	//}
-	//else {
-	//	if (bestOnA > bestOnB) {
-	//		Vector3 norm = worldTransformA.GetWorldMatrix().GetColumn(bestAAxis).ToVector3();
-	//		Debug::DrawLine(worldTransformA.GetWorldPosition(), worldTransformA.GetWorldPosition() + (norm  * 15.0f), Vector4(1, 0, 0, 1));
-	//	}
-	//	else {
-	//		Vector3 bNorm = worldTransformB.GetWorldMatrix().GetColumn(bestBAxis).ToVector3();
-	//		Debug::DrawLine(worldTransformB.GetWorldPosition(), worldTransformB.GetWorldPosition() + (bNorm  * 15.0f), Vector4(1, 0, 0, 1));
-	//	}
-	//}
+	Vector3 pointA = edgeA + dirA * s;
+	Vector3 pointB = edgeB + dirB * tb;
 
-	////Vector3 aNorm = worldTransformA.GetWorldMatrix().GetColumn(bestAAxis).ToVector3();
-	////
-	////Vector3 edgeNorm = bestEdgeAxis;
+	collisionInfo.AddContactPoint(pointA - a.position, pointB - b.position, normal, penetration);
+}
 
-	////Vector3 lolTest = Vector3::Cross(aNorm, bNorm);
-	//Vector3 bNorm = worldTransformB.GetWorldMatrix().GetColumn(bestBAxis).ToVector3();
-	////Debug::DrawLine(worldTransformA.GetWorldPosition(), worldTransformA.GetWorldPosition() + (aNorm  * 15.0f), Vector4(1, 0, 0, 1));
-	//Debug::DrawLine(worldTransformB.GetWorldPosition(), worldTransformB.GetWorldPosition() + (bNorm  * 15.0f), Vector4(1, 1, 0, 1));
+//Keeps the parts of the polygon where Dot(planeNormal, p) <= planeDistance
+void SATAlgorithm::ClipToPlane(const ClipPoints& in, const Vector3& planeNormal, float planeDistance, ClipPoints& out) {
+	out.count = 0;
+	if (in.count == 0) {
+		return;
+	}
+	Vector3 start		= in.points[in.count - 1];
+	float	startDist	= Vector3::Dot(planeNormal, start) - planeDistance;
 
-	////Debug::DrawLine(worldTransformA.GetWorldPosition(), worldTransformA.GetWorldPosition() + (lolTest  * 15.0f), Vector4(0.2, 0.1, 0.8, 1));
+	for (int i = 0; i < in.count; ++i) {
+		Vector3 end		= in.points[i];
+		float	endDist	= Vector3::Dot(planeNormal, end) - planeDistance;
 
-	//////Debug::DrawLine(worldTransformA.GetWorldPosition(), worldTransformA.GetWorldPosition() + (edgeNorm  * 15.0f), Vector4(0, 1, 1, 1));
+		if ((startDist <= 0.0f) != (endDist <= 0.0f) && out.count < MaxClipPoints) {
+			float along = startDist / (startDist - endDist);
+			out.points[out.count++] = start + (end - start) * along;
+		}
+		if (endDist <= 0.0f && out.count < MaxClipPoints) {
+			out.points[out.count++] = end;
+		}
+		start		= end;
+		startDist	= endDist;
+	}
+}
 
+/*
+A clipped face can have up to 8 corners, but a manifold only holds 4. The
+deepest point is always kept, then the point furthest from it, and then
+the points either side of the line between them that make the biggest
+triangles, which keeps as much of the contact area covered as possible.
+*/
+int SATAlgorithm::ReduceContacts(const Vector3* points, const float* depths, int count, const Vector3& normal, int* chosen) {
+	const int maxPoints = CollisionDetection::MaxContactPoints;
+	if (count <= maxPoints) {
+		for (int i = 0; i < count; ++i) {
+			chosen[i] = i;
+		}
+		return count;
+	}
 
-	if (noCollide) {
-		return false;
+	int deepest = 0;
+	for (int i = 1; i < count; ++i) {
+		if (depths[i] > depths[deepest]) {
+			deepest = i;
+		}
 	}
 
-	float bestFace = max(bestOnA, bestOnB);
+	int		furthest	= -1;
+	float	bestDist	= -1.0f;
+	for (int i = 0; i < count; ++i) {
+		float d = (points[i] - points[deepest]).LengthSquared();
+		if (i != deepest && d > bestDist) {
+			bestDist = d;
+			furthest = i;
+		}
+	}
 
-	//if (noCollide) {
-	//	std::cout << "SAT NO COLLIDE?" << std::endl;
-	//}
+	int		positive	= -1;
+	int		negative	= -1;
+	float	mostPos		= 0.0f;
+	float	mostNeg		= 0.0f;
+	Vector3 edge		= points[furthest] - points[deepest];
+	for (int i = 0; i < count; ++i) {
+		float area = Vector3::Dot(Vector3::Cross(edge, points[i] - points[deepest]), normal);
+		if (area > mostPos) {
+			mostPos		= area;
+			positive	= i;
+		}
+		if (area < mostNeg) {
+			mostNeg		= area;
+			negative	= i;
+		}
+	}
 
-	if (bestOnEdge > bestFace) {
-		std::cout << "SAT EDGE COLLISION " << bestOnEdge << std::endl;
+	int chosenCount = 0;
+	chosen[chosenCount++] = deepest;
+	chosen[chosenCount++] = furthest;
+	if (positive != -1) {
+		chosen[chosenCount++] = positive;
 	}
-	else {
-		std::cout << "SAT FACE COLLISION " << bestFace << std::endl;
+	if (negative != -1) {
+		chosen[chosenCount++] = negative;
 	}
-	return true;
+	return chosenCount;
 }
-
-void SATAlgorithm::OBBSupport(Vector3& min, Vector3& max, const Vector3& objectPos, const Vector3& axis) {
-	Vector3 tangents[2];
-
-	//tangents[0] = 
-
-}
\ No newline at end of file
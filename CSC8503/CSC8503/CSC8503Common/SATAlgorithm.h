@@ -0,0 +1,58 @@
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Box / box collisions using the separating axis test. Two boxes are
+		apart if there's any axis they can be squashed flat onto where their
+		shadows don't overlap, and for boxes there's only 15 axes that ever
+		need trying - the 3 face normals of each box, and the 9 directions at
+		right angles to one edge of each box.
+
+		If none of them separate the boxes, the axis they overlap least along
+		says how to push them apart. If it's a face normal, the face of the
+		other box that's most facing it is cut down to the outline of the
+		first box's face, giving up to 4 contact points. If it's an edge pair,
+		the boxes touch at a single point between the two edges.
+		*/
+		class SATAlgorithm {
+		public:
+			struct Box {
+				Vector3 position;
+				Vector3 axes[3];	//World space directions of the box's local x, y and z
+				Vector3 halfSize;
+
+				Box(const Vector3& position, const Quaternion& orientation, const Vector3& halfSize);
+				//An axis aligned box
+				Box(const Vector3& position, const Vector3& halfSize);
+			};
+
+			//On a hit, the contact normal points from box a towards box b
+			static bool BoxIntersection(const Box& a, const Box& b, CollisionDetection::CollisionInfo& collisionInfo);
+
+		protected:
+			//Enough room for a 4 sided face clipped by 4 planes
+			static const int MaxClipPoints = 8;
+
+			struct ClipPoints {
+				Vector3 points[MaxClipPoints];
+				int		count;
+			};
+
+			static void FaceContact(const Box& reference, int axis, float sign, const Box& incident,
+				bool referenceIsA, CollisionDetection::CollisionInfo& collisionInfo);
+
+			static void EdgeContact(const Box& a, int axisA, const Box& b, int axisB,
+				const Vector3& normal, float penetration, CollisionDetection::CollisionInfo& collisionInfo);
+
+			static void ClipToPlane(const ClipPoints& in, const Vector3& planeNormal, float planeDistance, ClipPoints& out);
+
+			static int ReduceContacts(const Vector3* points, const float* depths, int count, const Vector3& normal, int* chosen);
+
+		private:
+			SATAlgorithm()	{}
+			~SATAlgorithm()	{}
+		};
+	}
+}
@@ -0,0 +1,73 @@
+#include "SliderConstraint.h"
+#include "GameObject.h"
+#include "../../Common/Maths.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+SliderConstraint::SliderConstraint(GameObject* a, GameObject* b, const Vector3& worldAxis)
+	: Constraint(a, b) {
+	const Transform& transformA = a->GetTransform();
+	const Transform& transformB = b->GetTransform();
+
+	Quaternion inverseA = transformA.GetOrientation().Conjugate();
+
+	offset		= inverseA * (transformB.GetPosition() - transformA.GetPosition());
+	axis		= inverseA * worldAxis.Normalised();
+	rotation	= inverseA * transformB.GetOrientation();
+	lowerLimit	= 0.0f;
+	upperLimit	= 0.0f;
+	hasLimits	= false;
+}
+
+/*
+b's centre is kept on the line through where it started, in the two
+directions at right angles to the axis. Rather than tracking a point on each
+object, the point on a is just wherever b's centre is right now.
+
+Turning is locked in all 3 directions. The error is the rotation between
+where b should be facing and where it is, which for small turns is twice
+the vector part of the quaternion.
+*/
+int SliderConstraint::BuildRows(ConstraintRow* rows, float dt) {
+	const Transform& transformA = objectA->GetTransform();
+	const Transform& transformB = objectB->GetTransform();
+
+	Quaternion	orientationA	= transformA.GetOrientation();
+	Vector3		slideAxis		= orientationA * axis;
+	Vector3		relativeA		= transformB.GetPosition() - transformA.GetPosition();
+	Vector3		error			= relativeA - (orientationA * offset);
+
+	Vector3 tangentA;
+	Vector3 tangentB;
+	Maths::Perpendiculars(slideAxis, tangentA, tangentB);
+
+	int count = 0;
+	LinearRow(rows[count++], tangentA, relativeA, Vector3(), Vector3::Dot(error, tangentA), dt);
+	LinearRow(rows[count++], tangentB, relativeA, Vector3(), Vector3::Dot(error, tangentB), dt);
+
+	if (objectA->CanRotate() || objectB->CanRotate()) {
+		Quaternion turn = transformB.GetOrientation() * (orientationA * rotation).Conjugate();
+		if (turn.w < 0.0f) {
+			turn = -turn;
+		}
+		for (int i = 0; i < 3; ++i) {
+			Vector3 direction;
+			direction[i] = 1.0f;
+			AngularRow(rows[count++], direction, 2.0f * turn.array[i], dt);
+		}
+	}
+
+	if (hasLimits) {
+		float slide = Vector3::Dot(error, slideAxis);
+		if (slide < lowerLimit) {
+			LinearRow(rows[count], slideAxis, relativeA, Vector3(), slide - lowerLimit, dt);
+			rows[count++].lowerImpulse = 0.0f;
+		}
+		else if (slide > upperLimit) {
+			LinearRow(rows[count], slideAxis, relativeA, Vector3(), slide - upperLimit, dt);
+			rows[count++].upperImpulse = 0.0f;
+		}
+	}
+	return count;
+}
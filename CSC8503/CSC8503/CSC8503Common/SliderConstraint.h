@@ -0,0 +1,37 @@
+#pragma once
+#include "Constraint.h"
+#include "../../Common/Quaternion.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		using Maths::Quaternion;
+
+		/*
+		Lets object b slide along an axis fixed to object a, but not move off
+		it or turn relative to a, like a drawer. The slide can optionally be
+		limited, measured from where b started.
+		*/
+		class SliderConstraint : public Constraint {
+		public:
+			SliderConstraint(GameObject* a, GameObject* b, const Vector3& worldAxis);
+			~SliderConstraint() {}
+
+			void SetLimits(float lower, float upper) {
+				lowerLimit	= lower;
+				upperLimit	= upper;
+				hasLimits	= true;
+			}
+
+			int BuildRows(ConstraintRow* rows, float dt) override;
+
+		protected:
+			Vector3		offset;		//Where b started, in a's space
+			Vector3		axis;		//In a's space
+			Quaternion	rotation;	//How b started out turned relative to a
+
+			float	lowerLimit;
+			float	upperLimit;
+			bool	hasLimits;
+		};
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <vector>
+#include <cstring>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A growable block of bytes that plain values and arrays are copied
+		into one after another, and read back out of in the same order.
+		Clearing it keeps its memory, so once it's grown big enough, saving
+		into it again doesn't allocate anything.
+
+		There's no padding, versioning or byte swapping - it's meant for
+		keeping state around on the same machine, not for files or sending
+		over the network.
+		*/
+		class StateBuffer {
+		public:
+			StateBuffer() {
+				readPosition = 0;
+			}
+
+			void Clear() {
+				data.clear();
+				readPosition = 0;
+			}
+
+			//Goes back to reading from the start
+			void Rewind() {
+				readPosition = 0;
+			}
+
+			size_t GetSize() const {
+				return data.size();
+			}
+
+			const char* GetData() const {
+				return data.data();
+			}
+
+			void SetData(const char* bytes, size_t size) {
+				data.assign(bytes, bytes + size);
+				readPosition = 0;
+			}
+
+			void WriteBytes(const void* bytes, size_t size) {
+				size_t start = data.size();
+				data.resize(start + size);
+				if (size > 0) {
+					memcpy(&data[start], bytes, size);
+				}
+			}
+
+			//Returns false, and reads nothing, if there aren't enough bytes left
+			bool ReadBytes(void* bytes, size_t size) {
+				if (readPosition + size > data.size()) {
+					return false;
+				}
+				if (size > 0) {
+					memcpy(bytes, &data[readPosition], size);
+				}
+				readPosition += size;
+				return true;
+			}
+
+			template<class T>
+			void Write(const T& value) {
+				WriteBytes(&value, sizeof(T));
+			}
+
+			template<class T>
+			bool Read(T& value) {
+				return ReadBytes(&value, sizeof(T));
+			}
+
+		protected:
+			std::vector<char>	data;
+			size_t				readPosition;
+		};
+	}
+}
@@ -0,0 +1,186 @@
+#include "SweepAndPrune.h"
+#include "GameWorld.h"
+#include "GameObject.h"
+
+#include <algorithm>
+
+using namespace NCL;
+using namespace CSC8503;
+
+SweepAndPrune::SweepAndPrune(int axisCount, int sweepAxis) {
+	this->axisCount	= axisCount;
+	fixedAxis		= sweepAxis;
+	this->sweepAxis	= sweepAxis;
+	worldVersion	= -1;
+}
+
+SweepAndPrune::~SweepAndPrune() {
+}
+
+void SweepAndPrune::SetAxisCount(int count) {
+	axisCount = count;
+	sweepAxis = fixedAxis;
+	Clear();
+}
+
+void SweepAndPrune::Clear() {
+	for (int i = 0; i < 3; ++i) {
+		bodies[i].clear();
+		for (int j = 0; j < 3; ++j) {
+			mins[i][j].clear();
+			maxs[i][j].clear();
+		}
+	}
+	worldVersion = -1;
+}
+
+void SweepAndPrune::Update(GameWorld& world) {
+	if (world.GetObjectListVersion() != worldVersion) {
+		Rebuild(world);
+		return;
+	}
+	for (int i = 0; i < 3; ++i) {
+		if (axisCount == 1 && i != fixedAxis) {
+			continue;
+		}
+		Refresh(i);
+		InsertionSort(i, i);
+	}
+	sweepAxis = (axisCount == 1) ? fixedAxis : ChooseSweepAxis();
+}
+
+/*
+If objects have been added or removed, the orders are built again from
+scratch, using a full sort rather than the insertion sort, which would be
+quadratic on an unsorted list.
+*/
+void SweepAndPrune::Rebuild(GameWorld& world) {
+	std::vector<GameObject*> objects;
+
+	world.OperateOnContents([&](GameObject* o) {
+		if (o->GetBoundingVolume() && o->GetPhysicsObject()) {
+			objects.emplace_back(o);
+		}
+	});
+
+	for (int i = 0; i < 3; ++i) {
+		bodies[i].clear();
+		if (axisCount == 1 && i != fixedAxis) {
+			continue;
+		}
+		bodies[i] = objects;
+		std::sort(bodies[i].begin(), bodies[i].end(), [&](GameObject* a, GameObject* b) {
+			Vector3 sizeA;
+			Vector3 sizeB;
+			a->GetBroadphaseAABB(sizeA);
+			b->GetBroadphaseAABB(sizeB);
+			return	a->GetTransform().GetPosition()[i] - sizeA[i] <
+					b->GetTransform().GetPosition()[i] - sizeB[i];
+		});
+		for (int j = 0; j < 3; ++j) {
+			mins[i][j].resize(objects.size());
+			maxs[i][j].resize(objects.size());
+		}
+		Refresh(i);
+	}
+	sweepAxis		= (axisCount == 1) ? fixedAxis : ChooseSweepAxis();
+	worldVersion	= world.GetObjectListVersion();
+}
+
+void SweepAndPrune::Refresh(int order) {
+	const int n = (int)bodies[order].size();
+
+	float* minX = mins[order][0].data();
+	float* minY = mins[order][1].data();
+	float* minZ = mins[order][2].data();
+	float* maxX = maxs[order][0].data();
+	float* maxY = maxs[order][1].data();
+	float* maxZ = maxs[order][2].data();
+
+	for (int i = 0; i < n; ++i) {
+		GameObject* o = bodies[order][i];
+		Vector3 halfSize;
+		o->GetBroadphaseAABB(halfSize);
+		Vector3 pos = o->GetTransform().GetPosition();
+
+		minX[i] = pos.x - halfSize.x;
+		minY[i] = pos.y - halfSize.y;
+		minZ[i] = pos.z - halfSize.z;
+		maxX[i] = pos.x + halfSize.x;
+		maxY[i] = pos.y + halfSize.y;
+		maxZ[i] = pos.z + halfSize.z;
+	}
+}
+
+/*
+Objects rarely pass each other between steps, so most entries are already
+in place, and the inner loop only runs for the few that have moved past a
+neighbour. Entries are shifted up rather than swapped, so each one that is
+out of place is only written once per array.
+*/
+void SweepAndPrune::InsertionSort(int order, int axis) {
+	const int n = (int)bodies[order].size();
+
+	GameObject** objects	= bodies[order].data();
+	float* key				= mins[order][axis].data();
+
+	for (int i = 1; i < n; ++i) {
+		if (key[i - 1] <= key[i]) {
+			continue;
+		}
+		GameObject* object = objects[i];
+		float savedMin[3];
+		float savedMax[3];
+		for (int a = 0; a < 3; ++a) {
+			savedMin[a] = mins[order][a][i];
+			savedMax[a] = maxs[order][a][i];
+		}
+		float value = key[i];
+
+		int j = i;
+		while (j > 0 && key[j - 1] > value) {
+			objects[j] = objects[j - 1];
+			for (int a = 0; a < 3; ++a) {
+				mins[order][a][j] = mins[order][a][j - 1];
+				maxs[order][a][j] = maxs[order][a][j - 1];
+			}
+			--j;
+		}
+		objects[j] = object;
+		for (int a = 0; a < 3; ++a) {
+			mins[order][a][j] = savedMin[a];
+			maxs[order][a][j] = savedMax[a];
+		}
+	}
+}
+
+//Picks the axis with the greatest variance of object centres
+int SweepAndPrune::ChooseSweepAxis() const {
+	const int n = (int)bodies[0].size();
+	if (n == 0) {
+		return fixedAxis;
+	}
+	int		bestAxis		= 0;
+	float	bestVariance	= -1.0f;
+
+	for (int a = 0; a < 3; ++a) {
+		const float* lo = mins[0][a].data();
+		const float* hi = maxs[0][a].data();
+
+		float sum	= 0.0f;
+		float sumSq = 0.0f;
+		for (int i = 0; i < n; ++i) {
+			float centre = (lo[i] + hi[i]) * 0.5f;
+			sum		+= centre;
+			sumSq	+= centre * centre;
+		}
+		float mean		= sum / n;
+		float variance	= (sumSq / n) - (mean * mean);
+
+		if (variance > bestVariance) {
+			bestVariance	= variance;
+			bestAxis		= a;
+		}
+	}
+	return bestAxis;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include <vector>
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		class GameObject;
+		class GameWorld;
+
+		/*
+		An incremental sort-and-sweep broadphase. Every object's broadphase
+		AABB is copied into packed arrays of floats, kept sorted by their
+		minimum extent along the sweep axis. As objects only move a little
+		each step, last step's order is almost right already, and insertion
+		sort only has to do a few swaps to fix it up again.
+
+		With one axis, the sweep is always along the chosen axis. With three,
+		all three orders are maintained, and the sweep uses whichever axis
+		the objects are most spread out along that step.
+		*/
+		class SweepAndPrune {
+		public:
+			SweepAndPrune(int axisCount = 1, int sweepAxis = 0);
+			~SweepAndPrune();
+
+			void SetAxisCount(int count);
+			int  GetAxisCount() const {
+				return axisCount;
+			}
+
+			void Clear();
+
+			//Refreshes the packed arrays from the world, and re-sorts them
+			void Update(GameWorld& world);
+
+			/*
+			Calls func(a, b) for every pair of objects whose AABBs overlap on
+			all three axes. Must be called after Update.
+			*/
+			template<class F>
+			void FindPairs(F func) const {
+				const int		n		= (int)bodies[sweepAxis].size();
+				const float*	lo		= mins[sweepAxis][sweepAxis].data();
+				const float*	hi		= maxs[sweepAxis][sweepAxis].data();
+
+				const int		axisA	= (sweepAxis + 1) % 3;
+				const int		axisB	= (sweepAxis + 2) % 3;
+				const float*	loA		= mins[sweepAxis][axisA].data();
+				const float*	hiA		= maxs[sweepAxis][axisA].data();
+				const float*	loB		= mins[sweepAxis][axisB].data();
+				const float*	hiB		= maxs[sweepAxis][axisB].data();
+
+				GameObject* const* objects = bodies[sweepAxis].data();
+
+				for (int i = 0; i < n; ++i) {
+					const float end = hi[i];
+					for (int j = i + 1; j < n && lo[j] <= end; ++j) {
+						if (loA[j] <= hiA[i] && hiA[j] >= loA[i] &&
+							loB[j] <= hiB[i] && hiB[j] >= loB[i]) {
+							func(objects[i], objects[j]);
+						}
+					}
+				}
+			}
+
+		protected:
+			void Rebuild(GameWorld& world);
+			void Refresh(int order);
+			void InsertionSort(int order, int axis);
+			int  ChooseSweepAxis() const;
+
+			int axisCount;
+			int fixedAxis;
+			int sweepAxis;
+			int worldVersion;
+
+			/*
+			One sorted order per maintained axis. Each order keeps its own
+			copy of all six extents, in that order's sequence, so the sweep
+			only ever walks contiguous memory.
+			*/
+			std::vector<GameObject*>	bodies[3];
+			std::vector<float>			mins[3][3];
+			std::vector<float>			maxs[3][3];
+		};
+	}
+}
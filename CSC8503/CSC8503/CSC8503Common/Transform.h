@@ -34,12 +34,46 @@ namespace NCL {
 				return orientation;
 			}
 
+			/*
+			Setting the position or orientation just marks the matrix as out of
+			date, and it's only rebuilt when something asks for it. The physics
+			system moves objects many times a frame, but they're only drawn once.
+			*/
 			Matrix4 GetMatrix() const {
+				if (matrixDirty) {
+					UpdateMatrix();
+				}
 				return matrix;
 			}
-			void UpdateMatrix();
+			void UpdateMatrix() const;
+
+			/*
+			Physics objects are drawn part way between their last two steps,
+			so that they move smoothly even when the physics rate doesn't
+			match the frame rate. Setting the position or orientation directly
+			goes back to drawing the object exactly where it is.
+			*/
+			void SetRenderState(const Vector3& renderPos, const Quaternion& renderOr);
+
+			Matrix4 GetRenderMatrix() const {
+				if (!hasRenderState) {
+					return GetMatrix();
+				}
+				if (renderMatrixDirty) {
+					UpdateRenderMatrix();
+				}
+				return renderMatrix;
+			}
 		protected:
-			Matrix4		matrix;
+			void UpdateRenderMatrix() const;
+
+			mutable Matrix4	matrix;
+			mutable bool	matrixDirty;
+			mutable Matrix4	renderMatrix;
+			mutable bool	renderMatrixDirty;
+			bool			hasRenderState;
+			Vector3			renderPosition;
+			Quaternion		renderOrientation;
 			Quaternion	orientation;
 			Vector3		position;
 
@@ -146,7 +146,7 @@ void GameTechRenderer::RenderShadowMap() {
 	shadowMatrix = biasMatrix * mvMatrix; //we'll use this one later on
 
 	for (const auto&i : activeObjects) {
-		Matrix4 modelMatrix = (*i).GetTransform()->GetMatrix();
+		Matrix4 modelMatrix = (*i).GetTransform()->GetRenderMatrix();
 		Matrix4 mvpMatrix	= mvMatrix * modelMatrix;
 		glUniformMatrix4fv(mvpLocation, 1, false, (float*)&mvpMatrix);
 		BindMesh((*i).GetMesh());
@@ -251,7 +251,7 @@ void GameTechRenderer::RenderCamera() {
 			activeShader = shader;
 		}
 
-		Matrix4 modelMatrix = (*i).GetTransform()->GetMatrix();
+		Matrix4 modelMatrix = (*i).GetTransform()->GetRenderMatrix();
 		glUniformMatrix4fv(modelLocation, 1, false, (float*)&modelMatrix);			
 		
 		Matrix4 fullShadowMat = shadowMatrix * modelMatrix;
@@ -282,3 +282,11 @@ Matrix4 GameTechRenderer::SetupDebugLineMatrix()	const  {
 Matrix4 GameTechRenderer::SetupDebugStringMatrix()	const {
 	return Matrix4::Orthographic(-1, 1.0f, 100, 0, 0, 100);
 }
+
+void GameTechRenderer::DrawDebugString(const std::string& text, const Vector2& pos, const Vector4& colour) {
+	DrawString(text, pos, colour);
+}
+
+void GameTechRenderer::DrawDebugLine(const Vector3& start, const Vector3& end, const Vector4& colour) {
+	DrawLine(start, end, colour);
+}
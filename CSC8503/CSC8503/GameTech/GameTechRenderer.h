@@ -5,6 +5,7 @@
 #include "../../Plugins/OpenGLRendering/OGLMesh.h"
 
 #include "../CSC8503Common/GameWorld.h"
+#include "../CSC8503Common/Debug.h"
 
 namespace NCL {
 	class Maths::Vector3;
@@ -12,11 +13,14 @@ namespace NCL {
 	namespace CSC8503 {
 		class RenderObject;
 
-		class GameTechRenderer : public OGLRenderer	{
+		class GameTechRenderer : public OGLRenderer, public DebugDrawer	{
 		public:
 			GameTechRenderer(GameWorld& world);
 			~GameTechRenderer();
 
+			void DrawDebugString(const std::string& text, const Vector2& pos, const Vector4& colour) override;
+			void DrawDebugLine(const Vector3& start, const Vector3& end, const Vector4& colour) override;
+
 		protected:
 			void RenderFrame()	override;
 
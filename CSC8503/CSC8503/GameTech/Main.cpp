@@ -4,6 +4,7 @@
 #include "../CSC8503Common/StateTransition.h"
 #include "../CSC8503Common/State.h"
 #include "../CSC8503Common/NavigationGrid.h"
+#include "../CSC8503Common/BenchmarkMap.h"
 #include "../CSC8503Common/BehaviourAction.h"
 #include "../CSC8503Common/BehaviourSequence.h"
 #include "../CSC8503Common/BehaviourSelector.h"
@@ -12,6 +13,12 @@
 
 #include "TutorialGame.h"
 
+#include "../CSC8503Common/GameWorld.h"
+#include "../CSC8503Common/PhysicsSystem.h"
+#include "../CSC8503Common/SATAlgorithm.h"
+#include "../../Common/GameTimer.h"
+#include <iomanip>
+
 using namespace NCL;
 using namespace CSC8503;
 
@@ -207,6 +214,253 @@ void TestStateMachine()
 	}
 }
 
+/*
+Times the collision detection phase of the PhysicsSystem on ever larger
+worlds of randomly scattered spheres. The density is kept constant as the
+body count grows, so the broadphase should scale roughly linearly, while the
+brute force all-pairs test is quadratic (and so only run on smaller worlds).
+*/
+class BenchmarkPhysicsSystem : public PhysicsSystem {
+public:
+	BenchmarkPhysicsSystem(GameWorld& g) : PhysicsSystem(g) {}
+
+	using PhysicsSystem::FixedStep;
+	using PhysicsSystem::BasicCollisionDetection;
+	using PhysicsSystem::BroadPhase;
+	using PhysicsSystem::NarrowPhase;
+
+	size_t GetBroadphasePairCount() const {
+		return broadphaseCollisions.GetCount();
+	}
+};
+
+void TestBroadphaseScaling()
+{
+	const int	bodyCounts[]	= { 1000, 5000, 10000, 25000, 50000 };
+	const int	maxBruteForce	= 5000;
+	const int	iterations		= 10;
+	const float	bodySpacing		= 4.0f;
+
+	for (int count : bodyCounts)
+	{
+		GameWorld				world;
+		BenchmarkPhysicsSystem	physics(world);
+
+		float worldSize = sqrt((float)count) * bodySpacing;
+		for (int i = 0; i < count; ++i)
+		{
+			GameObject* sphere = new GameObject("Sphere");
+			Vector3 position(
+				(rand() / (float)RAND_MAX - 0.5f) * worldSize,
+				0.0f,
+				(rand() / (float)RAND_MAX - 0.5f) * worldSize);
+
+			sphere->SetBoundingVolume((CollisionVolume*)new SphereVolume(1.0f));
+			sphere->GetTransform().SetPosition(position);
+			sphere->SetPhysicsObject(new PhysicsObject(&sphere->GetTransform(), sphere->GetBoundingVolume()));
+			sphere->GetPhysicsObject()->InitSphereInertia();
+			world.AddGameObject(sphere);
+		}
+
+		GameTimer t;
+		t.GetTimeDeltaSeconds();
+		for (int i = 0; i < iterations; ++i)
+		{
+			physics.BroadPhase();
+			physics.NarrowPhase();
+		}
+		t.Tick();
+		float broadTime = t.GetTimeDeltaMSec() / iterations;
+
+		std::cout << count << " bodies: broadphase " << broadTime << "ms";
+
+		if (count <= maxBruteForce)
+		{
+			t.Tick();
+			for (int i = 0; i < iterations; ++i)
+			{
+				physics.BasicCollisionDetection();
+			}
+			t.Tick();
+			std::cout << ", brute force " << t.GetTimeDeltaMSec() / iterations << "ms";
+		}
+		std::cout << std::endl;
+
+		world.ClearAndErase();
+	}
+}
+
+/*
+Compares the tree and sort and sweep broadphases on the coursework maps,
+repeated side by side to make a world 10x the size.
+*/
+void TestBroadphaseComparison()
+{
+	const string	maps[]		= { "Mode 1.txt", "Mode 2.txt" };
+	const int		copies		= 10;
+	const int		frames		= 200;
+	const float		frameTime	= 1.0f / 120.0f;
+
+	for (const string& map : maps)
+	{
+		for (int type = 0; type < 2; ++type)
+		{
+			GameWorld				world;
+			BenchmarkPhysicsSystem	physics(world);
+			physics.SetBroadPhaseType(type == 0 ? BroadPhaseType::DynamicTree : BroadPhaseType::SortAndSweep);
+
+			srand(0);
+			BuildBenchmarkMap(world, map, copies);
+
+			GameTimer	t;
+			float		totalTime	= 0.0f;
+			size_t		totalPairs	= 0;
+			for (int i = 0; i < frames; ++i)
+			{
+				world.OperateOnContents([&](GameObject* o) {
+					Vector3 velocity = o->GetPhysicsObject()->GetLinearVelocity();
+					o->GetTransform().SetPosition(o->GetTransform().GetPosition() + velocity * frameTime);
+				});
+				t.Tick();
+				physics.BroadPhase();
+				t.Tick();
+				totalTime	+= t.GetTimeDeltaMSec();
+				totalPairs	+= physics.GetBroadphasePairCount();
+			}
+			std::cout << map << (type == 0 ? " tree: " : " sort and sweep: ")
+				<< totalTime / frames << "ms per step, "
+				<< totalPairs / frames << " pairs per step" << std::endl;
+
+			world.ClearAndErase();
+		}
+	}
+}
+
+/*
+Steps a world of thousands of small, separate piles of boxes and balls
+with an increasing number of worker threads. Each pile is its own island,
+so the solve should speed up with the thread count, while the final
+positions should come out exactly the same every time.
+*/
+void TestIslandSolverScaling()
+{
+	const int	workerCounts[]	= { 0, 1, 3, 7, 15 };
+	const int	pileCount		= 4000;
+	const int	pileHeight		= 6;
+	const int	steps			= 240;
+	const float	stepTime		= 1.0f / 120.0f;
+
+	for (int workers : workerCounts)
+	{
+		GameWorld				world;
+		BenchmarkPhysicsSystem	physics(world);
+		physics.SetWorkerThreads(workers);
+		physics.UseGravity(true);
+
+		GameObject* floor = new GameObject("Floor");
+		floor->SetBoundingVolume((CollisionVolume*)new AABBVolume(Vector3(1000, 1, 1000)));
+		floor->GetTransform().SetPosition(Vector3(0, -1, 0));
+		floor->SetPhysicsObject(new PhysicsObject(&floor->GetTransform(), floor->GetBoundingVolume()));
+		floor->GetPhysicsObject()->SetInverseMass(0.0f);
+		floor->GetPhysicsObject()->InitCubeInertia();
+		world.AddGameObject(floor);
+
+		int rowLength = (int)sqrt((float)pileCount);
+		for (int p = 0; p < pileCount; ++p)
+		{
+			Vector3 base(((p % rowLength) - rowLength / 2) * 6.0f, 0.5f, ((p / rowLength) - rowLength / 2) * 6.0f);
+			for (int i = 0; i < pileHeight; ++i)
+			{
+				GameObject* o = new GameObject();
+				if (i % 2)
+					o->SetBoundingVolume((CollisionVolume*)new SphereVolume(0.5f));
+				else
+					o->SetBoundingVolume((CollisionVolume*)new AABBVolume(Vector3(0.5f, 0.5f, 0.5f)));
+
+				o->GetTransform().SetPosition(base + Vector3((i % 3) * 0.1f, i * 1.05f, 0));
+				o->SetPhysicsObject(new PhysicsObject(&o->GetTransform(), o->GetBoundingVolume()));
+				if (i % 2)
+					o->GetPhysicsObject()->InitSphereInertia();
+				else
+					o->GetPhysicsObject()->InitCubeInertia();
+				world.AddGameObject(o);
+			}
+		}
+
+		GameTimer t;
+		t.GetTimeDeltaSeconds();
+		for (int i = 0; i < steps; ++i)
+		{
+			physics.FixedStep(stepTime);
+		}
+		t.Tick();
+
+		//Sum up where everything ended up, to check the result doesn't depend on the thread count
+		double checksum = 0.0;
+		world.OperateOnContents([&](GameObject* o) {
+			Vector3 pos = o->GetTransform().GetPosition();
+			checksum += pos.x + pos.y * 3.0 + pos.z * 7.0;
+		});
+
+		std::cout << workers << " worker threads: " << t.GetTimeDeltaMSec() / steps << "ms per step, "
+			<< physics.GetIslandCount() << " islands, checksum " << std::setprecision(12) << checksum << std::endl;
+
+		world.ClearAndErase();
+	}
+}
+
+/*
+Times the box / box SAT on its own, away from the rest of the physics.
+The pairs are randomly placed and rotated close enough together that
+most of them overlap, so the contact clipping gets timed too, rather
+than just the early outs.
+*/
+void TestBoxSATThroughput()
+{
+	const int	pairCount	= 4096;
+	const int	passes		= 500;
+
+	std::vector<SATAlgorithm::Box> boxes;
+	boxes.reserve(pairCount * 2);
+	for (int i = 0; i < pairCount * 2; ++i)
+	{
+		Vector3 position(
+			(rand() / (float)RAND_MAX - 0.5f) * 1.5f,
+			(rand() / (float)RAND_MAX - 0.5f) * 1.5f,
+			(rand() / (float)RAND_MAX - 0.5f) * 1.5f);
+		Vector3 axis(rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f);
+		Quaternion orientation = Quaternion::AxisAngleToQuaterion(axis.Normalised(), rand() / (float)RAND_MAX * 360.0f);
+		Vector3 halfSize(
+			0.25f + rand() / (float)RAND_MAX * 0.5f,
+			0.25f + rand() / (float)RAND_MAX * 0.5f,
+			0.25f + rand() / (float)RAND_MAX * 0.5f);
+
+		boxes.emplace_back(position, orientation, halfSize);
+	}
+
+	int		hits		= 0;
+	int		points		= 0;
+	GameTimer t;
+	for (int p = 0; p < passes; ++p)
+	{
+		for (int i = 0; i < pairCount; ++i)
+		{
+			CollisionDetection::CollisionInfo info;
+			if (SATAlgorithm::BoxIntersection(boxes[i * 2], boxes[i * 2 + 1], info))
+			{
+				hits++;
+				points += info.pointCount;
+			}
+		}
+	}
+	t.Tick();
+
+	float seconds = t.GetTimeDeltaSeconds();
+	std::cout << "Box SAT: " << (pairCount * (double)passes) / seconds / 1000000.0 << " million pairs per second, "
+		<< (hits * 100.0f) / (pairCount * (float)passes) << "% overlapping, "
+		<< (hits ? points / (float)hits : 0.0f) << " contacts per hit" << std::endl;
+}
+
 /*
 
 The main function should look pretty familar to you!
@@ -232,6 +486,10 @@ int main() {
 	TutorialGame* g = new TutorialGame();
 
 	//TestPathfinding();
+	//TestBroadphaseScaling();
+	//TestBroadphaseComparison();
+	//TestIslandSolverScaling();
+	//TestBoxSATThroughput();
 
 	w->GetTimer()->GetTimeDeltaSeconds(); //Clear the timer so we don't get a larget first dt!
 	while (w->UpdateWindow() && !g->isQuit/*&& !Window::GetKeyboard()->KeyDown(KeyboardKeys::ESCAPE)*/) {
@@ -0,0 +1,159 @@
+#include "MousePicking.h"
+#include "../../Common/Window.h"
+#include "../../Common/Vector2.h"
+#include "../../Common/Vector4.h"
+#include "../../Common/Maths.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+Vector3 MousePicking::Unproject(const Vector3& screenPos, const Camera& cam) {
+	Vector2 screenSize = Window::GetWindow()->GetScreenSize();
+
+	float aspect	= screenSize.x / screenSize.y;
+	float fov		= cam.GetFieldOfVision();
+	float nearPlane = cam.GetNearPlane();
+	float farPlane  = cam.GetFarPlane();
+
+	//Create our inverted matrix! Note how that to get a correct inverse matrix,
+	//the order of matrices used to form it are inverted, too.
+	Matrix4 invVP = GenerateInverseView(cam) * GenerateInverseProjection(aspect, fov, nearPlane, farPlane);
+
+	//Our mouse position x and y values are in 0 to screen dimensions range,
+	//so we need to turn them into the -1 to 1 axis range of clip space.
+	//We can do that by dividing the mouse values by the width and height of the
+	//screen (giving us a range of 0.0 to 1.0), multiplying by 2 (0.0 to 2.0)
+	//and then subtracting 1 (-1.0 to 1.0).
+	Vector4 clipSpace = Vector4(
+		(screenPos.x / (float)screenSize.x) * 2.0f - 1.0f,
+		(screenPos.y / (float)screenSize.y) * 2.0f - 1.0f,
+		(screenPos.z),
+		1.0f
+	);
+
+	//Then, we multiply our clipspace coordinate by our inverted matrix
+	Vector4 transformed = invVP * clipSpace;
+
+	//our transformed w coordinate is now the 'inverse' perspective divide, so
+	//we can reconstruct the final world space by dividing x,y,and z by w.
+	return Vector3(transformed.x / transformed.w, transformed.y / transformed.w, transformed.z / transformed.w);
+}
+
+Ray MousePicking::BuildRayFromMouse(const Camera& cam) {
+	Vector2 screenMouse = Window::GetMouse()->GetAbsolutePosition();
+	Vector2 screenSize	= Window::GetWindow()->GetScreenSize();
+
+	//We remove the y axis mouse position from height as OpenGL is 'upside down',
+	//and thinks the bottom left is the origin, instead of the top left!
+	Vector3 nearPos = Vector3(screenMouse.x,
+		screenSize.y - screenMouse.y,
+		-0.99999f
+	);
+
+	//We also don't use exactly 1.0 (the normalised 'end' of the far plane) as this
+	//causes the unproject function to go a bit weird. 
+	Vector3 farPos = Vector3(screenMouse.x,
+		screenSize.y - screenMouse.y,
+		0.99999f
+	);
+
+	Vector3 a = Unproject(nearPos, cam);
+	Vector3 b = Unproject(farPos, cam);
+	Vector3 c = b - a;
+
+	c.Normalise();
+
+	//std::cout << "Ray Direction:" << c << std::endl;
+
+	return Ray(cam.GetPosition(), c);
+}
+
+//http://bookofhook.com/mousepick.pdf
+Matrix4 MousePicking::GenerateInverseProjection(float aspect, float fov, float nearPlane, float farPlane) {
+	Matrix4 m;
+
+	float t = tan(fov*PI_OVER_360);
+
+	float neg_depth = nearPlane - farPlane;
+
+	const float h = 1.0f / t;
+
+	float c = (farPlane + nearPlane) / neg_depth;
+	float e = -1.0f;
+	float d = 2.0f*(nearPlane*farPlane) / neg_depth;
+
+	m.array[0]  = aspect / h;
+	m.array[5]  = tan(fov*PI_OVER_360);
+
+	m.array[10] = 0.0f;
+	m.array[11] = 1.0f / d;
+
+	m.array[14] = 1.0f / e;
+
+	m.array[15] = -c / (d*e);
+
+	return m;
+}
+
+/*
+And here's how we generate an inverse view matrix. It's pretty much
+an exact inversion of the BuildViewMatrix function of the Camera class!
+*/
+Matrix4 MousePicking::GenerateInverseView(const Camera &c) {
+	float pitch = c.GetPitch();
+	float yaw	= c.GetYaw();
+	Vector3 position = c.GetPosition();
+
+	Matrix4 iview =
+Matrix4::Translation(position) *
+Matrix4::Rotation(yaw, Vector3(0, 1, 0)) *
+Matrix4::Rotation(pitch, Vector3(1, 0, 0));
+
+return iview;
+}
+
+
+/*
+If you've read through the Deferred Rendering tutorial you should have a pretty
+good idea what this function does. It takes a 2D position, such as the mouse
+position, and 'unprojects' it, to generate a 3D world space position for it.
+
+Just as we turn a world space position into a clip space position by multiplying
+it by the model, view, and projection matrices, we can turn a clip space
+position back to a 3D position by multiply it by the INVERSE of the
+view projection matrix (the model matrix has already been assumed to have
+'transformed' the 2D point). As has been mentioned a few times, inverting a
+matrix is not a nice operation, either to understand or code. But! We can cheat
+the inversion process again, just like we do when we create a view matrix using
+the camera.
+
+So, to form the inverted matrix, we need the aspect and fov used to create the
+projection matrix of our scene, and the camera used to form the view matrix.
+
+*/
+Vector3	MousePicking::UnprojectScreenPosition(Vector3 position, float aspect, float fov, const Camera &c) {
+	//Create our inverted matrix! Note how that to get a correct inverse matrix,
+	//the order of matrices used to form it are inverted, too.
+	Matrix4 invVP = GenerateInverseView(c) * GenerateInverseProjection(aspect, fov, c.GetNearPlane(), c.GetFarPlane());
+
+	Vector2 screenSize = Window::GetWindow()->GetScreenSize();
+
+	//Our mouse position x and y values are in 0 to screen dimensions range,
+	//so we need to turn them into the -1 to 1 axis range of clip space.
+	//We can do that by dividing the mouse values by the width and height of the
+	//screen (giving us a range of 0.0 to 1.0), multiplying by 2 (0.0 to 2.0)
+	//and then subtracting 1 (-1.0 to 1.0).
+	Vector4 clipSpace = Vector4(
+		(position.x / (float)screenSize.x) * 2.0f - 1.0f,
+		(position.y / (float)screenSize.y) * 2.0f - 1.0f,
+		(position.z) - 1.0f,
+		1.0f
+	);
+
+	//Then, we multiply our clipspace coordinate by our inverted matrix
+	Vector4 transformed = invVP * clipSpace;
+
+	//our transformed w coordinate is now the 'inverse' perspective divide, so
+	//we can reconstruct the final world space by dividing x,y,and z by w.
+	return Vector3(transformed.x / transformed.w, transformed.y / transformed.w, transformed.z / transformed.w);
+}
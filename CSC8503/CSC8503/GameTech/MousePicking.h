@@ -0,0 +1,26 @@
+#pragma once
+#include "../../Common/Camera.h"
+#include "../../Common/Vector3.h"
+#include "../../Common/Matrix4.h"
+#include "../CSC8503Common/Ray.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Turns points on the screen into positions and rays in the world, for
+		picking things with the mouse. These read the mouse and the size of
+		the game's window, so they live with the game, rather than with the
+		physics, which has to run on servers that have no window at all.
+		*/
+		class MousePicking {
+		public:
+			static Ray BuildRayFromMouse(const Camera& c);
+
+			static Vector3 Unproject(const Vector3& screenPos, const Camera& cam);
+
+			static Vector3		UnprojectScreenPosition(Vector3 position, float aspect, float fov, const Camera &c);
+			static Matrix4		GenerateInverseProjection(float aspect, float fov, float nearPlane, float farPlane);
+			static Matrix4		GenerateInverseView(const Camera &c);
+		};
+	}
+}
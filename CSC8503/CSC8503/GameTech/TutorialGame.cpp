@@ -1,10 +1,10 @@
 #include "TutorialGame.h"
 #include "../CSC8503Common/GameWorld.h"
+#include "MousePicking.h"
 #include "../../Plugins/OpenGLRendering/OGLMesh.h"
 #include "../../Plugins/OpenGLRendering/OGLShader.h"
 #include "../../Plugins/OpenGLRendering/OGLTexture.h"
 #include "../../Common/TextureLoader.h"
-#include "../CSC8503Common/PositionConstraint.h"
 #include "..//CSC8503Common/StateGameObject.h"
 
 using namespace NCL;
@@ -25,6 +25,20 @@ TutorialGame::TutorialGame()	{
 	Debug::SetRenderer(renderer);
 
 	InitialiseAssets();
+	InitMaterials();
+}
+
+void TutorialGame::InitMaterials() {
+	PhysicsMaterial prop;
+	prop.restitution	= 0.825f;
+	prop.softContacts	= true;
+	propMaterial		= physics->AddMaterial(prop);
+
+	PhysicsMaterial slope;
+	slope.staticFriction	= 1.2f;
+	slope.dynamicFriction	= 0.9f;
+	slope.frictionCombine	= MaterialCombine::Maximum;
+	slopeMaterial			= physics->AddMaterial(slope);
 }
 
 /*
@@ -136,10 +150,13 @@ void TutorialGame::Mode1Playing(float dt)
 	else {
 		Debug::Print("(G)ravity off", Vector2(5, 95));
 	}
+	Debug::Print("Awake: " + std::to_string(physics->GetAwakeBodyCount()) +
+		" Asleep: " + std::to_string(physics->GetSleepingBodyCount()), Vector2(5, 90));
 
 	SelectObject();
 	MoveSelectedObject();
 	physics->Update(dt);
+	DrawRopes();
 
 	if (lockedObject != nullptr) {
 		LockCameraToObject(lockedObject, Vector3(0, 50, 10), world);
@@ -153,7 +170,7 @@ void TutorialGame::Mode1Playing(float dt)
 
 	for (auto i : world->GetAllObjs())
 	{
-		if(i->GetTag() == "Prop")
+		if(i->GetLayer() == PropLayer)
 			Debug::DrawAxisLines(i->GetTransform().GetMatrix(), 2.0f);
 	}
 
@@ -169,6 +186,7 @@ void TutorialGame::Mode2Playing(float dt)
 	GameLose();
 
 	physics->Update(dt);
+	DrawRopes();
 
 	if (lockedObject != nullptr) {
 		LockCameraToObject(lockedObject, Vector3(0, 50, 10), world);
@@ -179,16 +197,24 @@ void TutorialGame::Mode2Playing(float dt)
 void TutorialGame::BonusCollect()
 {
 	Debug::Print("Score: " + std::to_string(playerScore), Vector2(5, 15));
-	if (player->OnTriggerEnter(world->GetAllObjs(), "Coin"))
+	QueryFilter filter;
+	filter.layerMask = 1u << BonusLayer;
+
+	GameObject* bonus = nullptr;
+	if (world->OverlapVolume(*player->GetBoundingVolume(), player->GetTransform(), &bonus, 1, filter))
 	{
 		playerScore++;
-		world->RemoveGameObject(player->GetTriggerObj(), true);
+		world->RemoveGameObject(bonus, true);
 	}
 }
 
 void TutorialGame::GameWin()
 {
-	if (player->OnTriggerEnter(world->GetAllObjs(), "Finish"))
+	QueryFilter filter;
+	filter.layerMask = 1u << FinishLayer;
+
+	GameObject* finish = nullptr;
+	if (world->OverlapVolume(*player->GetBoundingVolume(), player->GetTransform(), &finish, 1, filter))
 	{
 		pdMachine->SetActiveState(new WinState());
 	}
@@ -217,6 +243,23 @@ void TutorialGame::UpdateKeys() {
 		useGravity = !useGravity; //Toggle gravity!
 		physics->UseGravity(useGravity);
 	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::B)) {
+		physics->UseBroadPhase(!physics->UsingBroadPhase());
+		std::cout << "Setting broadphase to " << physics->UsingBroadPhase() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::N)) {
+		bool useTree = physics->GetBroadPhaseType() != BroadPhaseType::DynamicTree;
+		physics->SetBroadPhaseType(useTree ? BroadPhaseType::DynamicTree : BroadPhaseType::SortAndSweep);
+		std::cout << "Setting broadphase type to " << (useTree ? "tree" : "sort and sweep") << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::I)) {
+		physics->SetConstraintIterations(physics->GetConstraintIterations() - 1);
+		std::cout << "Setting constraint iterations to " << physics->GetConstraintIterations() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::O)) {
+		physics->SetConstraintIterations(physics->GetConstraintIterations() + 1);
+		std::cout << "Setting constraint iterations to " << physics->GetConstraintIterations() << std::endl;
+	}
 	//Running certain physics updates in a consistent order might cause some
 	//bias in the calculations - the same objects might keep 'winning' the constraint
 	//allowing the other one to stretch too much etc. Shuffling the order so that it
@@ -394,24 +437,26 @@ void TutorialGame::InitGridMap(string filename)
 			if (n.type == '.')
 			{
 				AddCubeToWorld(n.position, Vector3(0.5, 0.1, 0.5) * gridSize, "Floor", "Default", 0);
-				AddBonusToWorld(n.position + Vector3(0, 5, 0), 0.25f, "Coin", "Default");
+				AddBonusToWorld(n.position + Vector3(0, 5, 0), 0.25f, "Coin", "Default")->SetLayer(BonusLayer);
 			}
 			if (n.type == 'e')
 			{
-				AddCubeToWorld(n.position, Vector3(0.5, 0.1, 0.5) * gridSize, "Finish", "Default", 0, Vector4(1, 0, 0, 1));
+				AddCubeToWorld(n.position, Vector3(0.5, 0.1, 0.5) * gridSize, "Finish", "Default", 0, Vector4(1, 0, 0, 1))->SetLayer(FinishLayer);
 			}
 			if (n.type == 'p')
 			{
 				AddCubeToWorld(n.position, Vector3(0.5, 0.1, 0.5) * gridSize, "Floor", "Default", 0);
-				AddCubeToWorld(n.position + Vector3(0, 6, 0), Vector3(0.5, 0.5, 0.5) * gridSize, "Prop", "Prop", 0.5, Vector4(0, 0.5, 0, 1));
+				GameObject* prop = AddCubeToWorld(n.position + Vector3(0, 6, 0), Vector3(0.5, 0.5, 0.5) * gridSize, "Prop", "Prop", 0.5, Vector4(0, 0.5, 0, 1));
+				prop->SetLayer(PropLayer);
+				prop->GetPhysicsObject()->SetMaterial(propMaterial);
 			}
 			if (n.type == '/')
 			{
-				AddOBBToWorld(n.position + Vector3(0, 3, 0), Vector3(0.5, 0.1, 0.5) * gridSize, Quaternion::AxisAngleToQuaterion(Vector3(0, 0, 1), 30), "Slope", "Default", 0, Vector4(1, 0, 0, 1));
+				AddOBBToWorld(n.position + Vector3(0, 3, 0), Vector3(0.5, 0.1, 0.5) * gridSize, Quaternion::AxisAngleToQuaterion(Vector3(0, 0, 1), 30), "Slope", "Default", 0, Vector4(1, 0, 0, 1))->GetPhysicsObject()->SetMaterial(slopeMaterial);
 			}
 			if (n.type == '\\')
 			{
-				AddOBBToWorld(n.position + Vector3(0, 3, 0), Vector3(0.5, 0.1, 0.5) * gridSize, Quaternion::AxisAngleToQuaterion(Vector3(0, 0, 1), -30), "Slope", "Default", 0, Vector4(1, 0, 0, 1));
+				AddOBBToWorld(n.position + Vector3(0, 3, 0), Vector3(0.5, 0.1, 0.5) * gridSize, Quaternion::AxisAngleToQuaterion(Vector3(0, 0, 1), -30), "Slope", "Default", 0, Vector4(1, 0, 0, 1))->GetPhysicsObject()->SetMaterial(slopeMaterial);
 			}
 			if (n.type == 'o')
 			{
@@ -420,13 +465,13 @@ void TutorialGame::InitGridMap(string filename)
 			if (n.type == 'l')
 			{
 				AddCubeToWorld(n.position, Vector3(0.5, 0.1, 0.5) * gridSize, "Floor", "Default", 0);
-				AddBonusToWorld(n.position + Vector3(0, 5, 0), 0.25f, "Coin", "Default");
+				AddBonusToWorld(n.position + Vector3(0, 5, 0), 0.25f, "Coin", "Default")->SetLayer(BonusLayer);
 				InitPendulum(n.position + Vector3(0, 130, 0), true);
 			}
 			if (n.type == 'r')
 			{
 				AddCubeToWorld(n.position, Vector3(0.5, 0.1, 0.5) * gridSize, "Floor", "Default", 0);
-				AddBonusToWorld(n.position + Vector3(0, 5, 0), 0.25f, "Coin", "Default");
+				AddBonusToWorld(n.position + Vector3(0, 5, 0), 0.25f, "Coin", "Default")->SetLayer(BonusLayer);
 				InitPendulum(n.position + Vector3(0, 130, 0), false);
 			}
 			else
@@ -443,29 +488,36 @@ void TutorialGame::InitSpherePlayer()
 void TutorialGame::InitPendulum(Vector3 s, bool isLeft)
 {
 	Vector3 cubeSize		= Vector3(4, 4, 4);
-	float	invCubeMass		= 1;	//How heavy the middle pieces are
-	int		numLinks		= 2;
-	float	maxDistance		= 40;	//Constraint distance
-	float	cubeDistance	= 20;	//Distance between links
+	float	invLinkMass		= 100;	//How heavy each bit of rope is
+	int		numLinks		= 12;
+	float	ropeLength		= 120;
+	float	ballDistance	= 80;	//How far out the ball starts, with the rope slack
 
 	if (isLeft)
-		cubeDistance = -cubeDistance;
+		ballDistance = -ballDistance;
 
 	Vector3		startPos	= s/*Vector3(130, 130, 60)*/;
 	GameObject* start		= AddCubeToWorld(startPos + Vector3(0, 0, 0), cubeSize, 0);
-	GameObject* end			= AddSphereToWorld(startPos + Vector3((numLinks + 2) * cubeDistance, 0, 0), 7.5f, "Obstacle", "Default", 1, Vector4(1, 0, 0, 1));
+	GameObject* end			= AddSphereToWorld(startPos + Vector3(ballDistance, 0, 0), 7.5f, "Obstacle", "Default", 1, Vector4(1, 0, 0, 1));
 
-	GameObject* previous	= start;
+	//The rope is just particles, rather than a chain of cubes held together by constraints
+	RopeSystem& ropes	= physics->GetRopes();
+	int			rope	= ropes.AddRope(start->GetTransform().GetPosition(), end->GetTransform().GetPosition(), numLinks, ropeLength, invLinkMass);
+	ropes.Attach(rope, 0, start);
+	ropes.Attach(rope, numLinks, end);
+}
 
-	for (int i = 0; i < numLinks; ++i)
+void TutorialGame::DrawRopes()
+{
+	const RopeSystem& ropes = physics->GetRopes();
+	for (int i = 0; i < ropes.GetRopeCount(); ++i)
 	{
-		GameObject* block = AddCubeToWorld(startPos + Vector3((i + 1) * cubeDistance, 0, 0), cubeSize, invCubeMass);
-		PositionConstraint* constraint = new PositionConstraint(previous, block, maxDistance);
-		world->AddConstraint(constraint);
-		previous = block;
+		const Vector3* points = ropes.GetRenderPositions(i);
+		for (int j = 1; j < ropes.GetParticleCount(i); ++j)
+		{
+			Debug::DrawLine(points[j - 1], points[j], Vector4(0.6f, 0.4f, 0.2f, 1));
+		}
 	}
-	PositionConstraint* constraint = new PositionConstraint(previous, end, maxDistance);
-	world->AddConstraint(constraint);
 }
 
 #pragma endregion
@@ -542,7 +594,6 @@ GameObject* TutorialGame::AddSphereToWorld(const Vector3& position, float radius
 
 	sphere->GetPhysicsObject()->SetInverseMass(inverseMass);
 	sphere->GetPhysicsObject()->InitSphereInertia();
-	//sphere->GetPhysicsObject()->SetFirction(1.0f);
 
 	world->AddGameObject(sphere);
 
@@ -567,7 +618,6 @@ GameObject* TutorialGame::AddSphereToWorld(const Vector3& position, float radius
 
 	sphere->GetPhysicsObject()->SetInverseMass(inverseMass);
 	sphere->GetPhysicsObject()->InitSphereInertia();
-	//sphere->GetPhysicsObject()->SetFirction(1.0f);
 
 	world->AddGameObject(sphere);
 
@@ -814,7 +864,7 @@ bool TutorialGame::SelectObject() {
 				lockedObject	= nullptr;
 			}
 
-			Ray ray = CollisionDetection::BuildRayFromMouse(*world->GetMainCamera());
+			Ray ray = MousePicking::BuildRayFromMouse(*world->GetMainCamera());
 			RayCollision closestCollision;
 			if (world->Raycast(ray, closestCollision, true)) {
 				selectionObject = (GameObject*)closestCollision.node;
@@ -872,7 +922,7 @@ void TutorialGame::MoveSelectedObject() {
 	//Push the selected obj
 	if (Window::GetMouse()->ButtonPressed(NCL::MouseButtons::RIGHT))
 	{
-		Ray ray = CollisionDetection::BuildRayFromMouse(*world->GetMainCamera());
+		Ray ray = MousePicking::BuildRayFromMouse(*world->GetMainCamera());
 		RayCollision closestCollision;
 		if (world->Raycast(ray, closestCollision, true))
 		{
@@ -882,7 +932,7 @@ void TutorialGame::MoveSelectedObject() {
 			}*/
 			if (closestCollision.node == selectionObject)
 			{
-				if (selectionObject->GetTag() == "Prop")
+				if (selectionObject->GetLayer() == PropLayer)
 				{
 					selectionObject->GetPhysicsObject()->AddForce(ray.GetDirection() * forceMagnitude);
 				}
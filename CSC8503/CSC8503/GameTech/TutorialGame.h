@@ -45,6 +45,14 @@ namespace NCL {
 			void BonusCollect();
 			void GameWin();
 			void GameLose();
+			void DrawRopes();
+
+			//Coins and the finish are on layers of their own, so the player can find them with a single overlap query
+			static const int BonusLayer		= 1;
+			static const int FinishLayer	= 2;
+			static const int PropLayer		= 3;
+
+			void InitMaterials();
 
 			bool SelectObject();
 			void MoveSelectedObject();
@@ -76,6 +84,10 @@ namespace NCL {
 
 			int					playerScore;
 
+			//Props are soft, and the slopes are rough enough to stop things sliding straight down them
+			int					propMaterial;
+			int					slopeMaterial;
+
 			bool				useGravity;
 			bool				inSelectionMode;
 			bool				hasInitLevel;
@@ -0,0 +1,601 @@
+#include "../CSC8503Common/GameWorld.h"
+#include "../CSC8503Common/GameObject.h"
+#include "../CSC8503Common/PhysicsSystem.h"
+#include "../CSC8503Common/BenchmarkMap.h"
+#include "../CSC8503Common/AABBVolume.h"
+#include "../CSC8503Common/SphereVolume.h"
+#include "../CSC8503Common/CollisionKernels.h"
+#include "../CSC8503Common/CompoundVolume.h"
+#include "../../Common/GameTimer.h"
+#include "../../Common/Assets.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <cfloat>
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+Runs the physics for a map without opening a window or touching the
+renderer, for dedicated servers and for timing the physics on machines
+that can't run the game. The map is stepped for a fixed number of frames
+at a fixed frame time, so the same arguments always do the same work.
+
+The checksum at the end is a hash of every object's final position, so
+a change that was only meant to make things faster can be checked to
+still give exactly the same simulation.
+*/
+
+void PrintUsage()
+{
+	std::cout << "Usage: CSC8503Headless [options]\n"
+		<< "  --map <file>      map to load (default \"Mode 1.txt\")\n"
+		<< "  --data <dir>      directory the map is in (default " << Assets::DATADIR << ")\n"
+		<< "  --frames <n>      frames to simulate (default 600)\n"
+		<< "  --copies <n>      copies of the map side by side (default 10)\n"
+		<< "  --workers <n>     extra worker threads (default 0)\n"
+		<< "  --hz <n>          frames per second to simulate at (default 60)\n"
+		<< "  --sweep           use sort and sweep rather than the tree broadphase\n"
+		<< "  --gravity         turn gravity on\n"
+		<< "  --mesh            build the level as one static triangle mesh\n"
+		<< "  --rays <n>        afterwards, time n raycasts onto the level, one by one and batched\n"
+		<< "  --pendulums <n>   hang n balls on ropes above the level, swinging down into it\n"
+		<< "  --tables <n>      check the compound inertia maths, then drop n compound tables onto the level\n"
+		<< "  --deterministic   step the physics in deterministic mode\n"
+		<< "  --rollback <n>    deterministic, and every n frames, go back n frames and simulate them again\n"
+		<< "  --kernels <n>     first, check n of each simple pair through every SIMD collision kernel\n";
+}
+
+uint64_t WorldChecksum(GameWorld& world)
+{
+	uint64_t hash = 14695981039346656037ull;
+	world.OperateOnContents([&](GameObject* o) {
+		Vector3 p = o->GetTransform().GetPosition();
+		unsigned char bytes[sizeof(float) * 3];
+		memcpy(bytes, &p.x, sizeof(float));
+		memcpy(bytes + sizeof(float), &p.y, sizeof(float));
+		memcpy(bytes + sizeof(float) * 2, &p.z, sizeof(float));
+		for (unsigned char b : bytes)
+		{
+			hash = (hash ^ b) * 1099511628211ull;
+		}
+	});
+	return hash;
+}
+
+/*
+Each pendulum is a static block with a heavy ball tied to it by a rope,
+like the swinging hazards in the game. They're spread evenly along the
+level, with the balls held out to the side so they swing down into it.
+Every fourth ball is as light as one of the rope's particles instead, and
+just hangs straight down, as that's where the rope and the body it's tied
+to are hardest to keep together.
+*/
+void AddPendulums(GameWorld& world, PhysicsSystem& physics, int count)
+{
+	Vector3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	world.OperateOnContents([&](GameObject* o) {
+		Vector3 p = o->GetTransform().GetPosition();
+		boundsMin = Vector3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+		boundsMax = Vector3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+	});
+
+	auto addObject = [&](const Vector3& pos, CollisionVolume* volume, float inverseMass) {
+		GameObject* o = new GameObject();
+		o->SetBoundingVolume(volume);
+		o->GetTransform().SetPosition(pos);
+		o->SetPhysicsObject(new PhysicsObject(&o->GetTransform(), o->GetBoundingVolume()));
+		o->GetPhysicsObject()->SetInverseMass(inverseMass);
+		o->GetPhysicsObject()->InitSphereInertia();
+		world.AddGameObject(o);
+		return o;
+	};
+
+	const int	links		= 12;
+	const float	ropeLength	= 120.0f;
+	for (int i = 0; i < count; ++i)
+	{
+		float	x		= boundsMin.x + (boundsMax.x - boundsMin.x) * (i + 0.5f) / count;
+		float	z		= (boundsMin.z + boundsMax.z) * 0.5f;
+		Vector3 anchor	= Vector3(x, boundsMax.y + ropeLength + 10.0f, z);
+		bool	light	= i % 4 == 3;
+		Vector3 ball	= anchor + (light ? Vector3(0, -ropeLength, 0) : Vector3(0, 0, (i % 2) ? ropeLength : -ropeLength));
+
+		GameObject* start	= addObject(anchor, (CollisionVolume*)new AABBVolume(Vector3(4, 4, 4)), 0.0f);
+		GameObject* end		= addObject(ball, (CollisionVolume*)new SphereVolume(light ? 1.0f : 7.5f), light ? 100.0f : 1.0f);
+
+		RopeSystem& ropes	= physics.GetRopes();
+		int			rope	= ropes.AddRope(anchor, ball, links, ropeLength, 100.0f);
+		ropes.Attach(rope, 0, start);
+		ropes.Attach(rope, links, end);
+	}
+}
+
+/*
+Each table is a single body made of a CompoundVolume - a top with a leg
+at each corner. They're dropped onto the level tilted, so they land on
+a corner and have to turn about axes that aren't their principal ones.
+The bounds are only of the objects' centres, so they're dropped from
+well above them, to start clear of the tops of the walls.
+*/
+void AddTables(GameWorld& world, int count)
+{
+	Vector3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	world.OperateOnContents([&](GameObject* o) {
+		Vector3 p = o->GetTransform().GetPosition();
+		boundsMin = Vector3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+		boundsMax = Vector3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+	});
+
+	for (int i = 0; i < count; ++i)
+	{
+		CompoundVolume* table = new CompoundVolume();
+		table->AddBox(Vector3(0, 0.75f, 0), Vector3(1.5f, 0.15f, 1.0f));
+		for (int leg = 0; leg < 4; ++leg)
+		{
+			table->AddBox(Vector3((leg & 1) ? 1.3f : -1.3f, 0, (leg & 2) ? 0.8f : -0.8f), Vector3(0.12f, 0.6f, 0.12f));
+		}
+		table->Recentre();
+		table->Build();
+
+		float x = boundsMin.x + (boundsMax.x - boundsMin.x) * (i + 0.5f) / count;
+		float z = (boundsMin.z + boundsMax.z) * 0.5f;
+
+		GameObject* o = new GameObject();
+		o->SetBoundingVolume((CollisionVolume*)table);
+		o->GetTransform()
+			.SetPosition(Vector3(x, boundsMax.y + 15.0f, z))
+			.SetOrientation(Quaternion::EulerAnglesToQuaternion(20.0f, i * 37.0f, 15.0f));
+		o->SetPhysicsObject(new PhysicsObject(&o->GetTransform(), o->GetBoundingVolume()));
+		o->GetPhysicsObject()->SetInverseMass(0.25f);
+		o->GetPhysicsObject()->InitCompoundInertia();
+		world.AddGameObject(o);
+	}
+}
+
+/*
+A lone box in the middle of a compound has to have the same inertia as
+it would on its own, and a pair of boxes either side of the middle has
+to pick up the products of inertia the parallel axis theorem gives them.
+The pair is then put on a body, to check that what InitCompoundInertia
+stores for it turns back into the same tensor. Anything wrong fails the
+run, as every compound body would be turning the wrong way.
+*/
+bool CheckCompoundInertia()
+{
+	auto Matches = [](const char* name, const Matrix3& got, const float* want) {
+		float largest = 0.0f;
+		for (int i = 0; i < 9; ++i)
+		{
+			largest = std::max(largest, std::abs(want[i]));
+		}
+		for (int i = 0; i < 9; ++i)
+		{
+			if (std::abs(got.array[i] - want[i]) > largest * 1e-4f)
+			{
+				std::cout << "  " << name << " has " << got.array[i] << " at row " << i / 3 << ", column " << i % 3
+					<< ", rather than " << want[i] << std::endl;
+				return false;
+			}
+		}
+		return true;
+	};
+	bool passed = true;
+
+	//A box of mass 6 has m(b^2 + c^2) / 3 about each axis, from the other two half sizes
+	CompoundVolume box;
+	box.AddBox(Vector3(), Vector3(1, 2, 3));
+	const float boxInertia[9] = {
+		26, 0, 0,
+		0, 20, 0,
+		0, 0, 10
+	};
+	passed &= Matches("A centred box", box.GetInertia(6.0f), boxInertia);
+
+	/*
+	Two cubes of mass 1, which Recentre should leave at (1, 2, 3) and
+	(-1, -2, -3). Each has 1/6 about every axis through its own centre,
+	and each adds |p|^2 - (p.x * p.x) to the first moment, and -(p.x * p.y)
+	to the first product, and so on, for its position p.
+	*/
+	CompoundVolume* pair = new CompoundVolume();
+	pair->AddBox(Vector3(2, 2, 3), Vector3(0.5f, 0.5f, 0.5f));
+	pair->AddBox(Vector3(0, -2, -3), Vector3(0.5f, 0.5f, 0.5f));
+	Vector3 centre = pair->Recentre();
+	if (std::abs(centre.x - 1.0f) > 1e-5f || std::abs(centre.y) > 1e-5f || std::abs(centre.z) > 1e-5f)
+	{
+		std::cout << "  An off centre pair was recentred by " << centre;
+		passed = false;
+	}
+	const float third = 1.0f / 3.0f;
+	const float pairInertia[9] = {
+		26 + third, -4, -6,
+		-4, 20 + third, -12,
+		-6, -12, 10 + third
+	};
+	passed &= Matches("An off centre pair", pair->GetInertia(2.0f), pairInertia);
+
+	GameObject body;
+	body.SetBoundingVolume((CollisionVolume*)pair);
+	body.SetPhysicsObject(new PhysicsObject(&body.GetTransform(), body.GetBoundingVolume()));
+	body.GetPhysicsObject()->SetInverseMass(0.5f);
+	body.GetPhysicsObject()->InitCompoundInertia();
+	body.GetPhysicsObject()->UpdateInertiaTensor();
+
+	//Matrix3's float array constructor expects a Matrix4's layout
+	Matrix3 tensor;
+	std::copy(pairInertia, pairInertia + 9, tensor.array);
+	const float identity[9] = {
+		1, 0, 0,
+		0, 1, 0,
+		0, 0, 1
+	};
+	passed &= Matches("An off centre pair's body", body.GetPhysicsObject()->GetInertiaTensor() * tensor, identity);
+
+	std::cout << "  compound inertia: " << (passed ? "matches" : "doesn't match") << std::endl;
+	return passed;
+}
+
+/*
+Rays are fired down onto the level from random points above it, tilted a
+little, first one at a time and then all together as a batch. Both ways
+should hit exactly the same things.
+*/
+void TimeRaycasts(GameWorld& world, int rayCount)
+{
+	Vector3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	world.OperateOnContents([&](GameObject* o) {
+		Vector3 p = o->GetTransform().GetPosition();
+		boundsMin = Vector3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+		boundsMax = Vector3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+	});
+
+	srand(1);
+	std::vector<Ray> rays;
+	rays.reserve(rayCount);
+	const int	tileSize	= 8;
+	int			tiles		= std::max(1, (int)std::sqrt((float)rayCount / (tileSize * tileSize)));
+	int			side		= tiles * tileSize;
+	for (int i = 0; i < rayCount; ++i)
+	{
+		int		tile	= (i / (tileSize * tileSize)) % (tiles * tiles);
+		int		cellX	= ((tile % tiles) * tileSize) + (i % tileSize);
+		int		cellZ	= ((tile / tiles) * tileSize) + ((i / tileSize) % tileSize);
+		float	x		= boundsMin.x + (boundsMax.x - boundsMin.x) * (cellX + (rand() / (float)RAND_MAX)) / side;
+		float	z		= boundsMin.z + (boundsMax.z - boundsMin.z) * (cellZ + (rand() / (float)RAND_MAX)) / side;
+		Vector3 tilt	= Vector3((rand() / (float)RAND_MAX) - 0.5f, -2.0f, (rand() / (float)RAND_MAX) - 0.5f);
+		rays.emplace_back(Vector3(x, boundsMax.y + 10.0f, z), tilt.Normalised());
+	}
+
+	std::vector<RayCollision> single(rayCount);
+	std::vector<RayCollision> batched(rayCount);
+
+	GameTimer t;
+	t.Tick();
+	for (int i = 0; i < rayCount; ++i)
+	{
+		world.Raycast(rays[i], single[i], true);
+	}
+	t.Tick();
+	float singleTime = t.GetTimeDeltaMSec();
+
+	t.Tick();
+	int hits = world.RaycastBatch(rays.data(), rayCount, batched.data());
+	t.Tick();
+	float batchTime = t.GetTimeDeltaMSec();
+
+	int mismatches = 0;
+	for (int i = 0; i < rayCount; ++i)
+	{
+		mismatches += single[i].node != batched[i].node ? 1 : 0;
+	}
+	std::cout << "  rays: " << rayCount << " (" << hits << " hits) in " << singleTime << "ms one by one, "
+		<< batchTime << "ms batched, " << mismatches << " different" << std::endl;
+}
+
+/*
+Sphere, AABB and AABB/sphere pairs are put through BatchIntersection on
+the scalar path, and then on every SIMD path this CPU can run. Each path
+has to find the same pairs touching, with the same contacts, so any
+difference at all means a kernel has gone wrong, and fails the run.
+*/
+bool CheckCollisionKernels(int pairCount)
+{
+	const int	passes		= 100;
+	const float	tolerance	= 1e-5f;
+
+	srand(2);
+	std::vector<GameObject*> objects;
+	auto AddObject = [&](bool sphere) {
+		GameObject* o = new GameObject();
+		if (sphere)
+		{
+			o->SetBoundingVolume((CollisionVolume*)new SphereVolume(0.25f + rand() / (float)RAND_MAX * 0.5f));
+		}
+		else
+		{
+			o->SetBoundingVolume((CollisionVolume*)new AABBVolume(Vector3(
+				0.25f + rand() / (float)RAND_MAX * 0.5f,
+				0.25f + rand() / (float)RAND_MAX * 0.5f,
+				0.25f + rand() / (float)RAND_MAX * 0.5f)));
+		}
+		o->GetTransform().SetPosition(Vector3(
+			(rand() / (float)RAND_MAX - 0.5f) * 3.0f,
+			(rand() / (float)RAND_MAX - 0.5f) * 3.0f,
+			(rand() / (float)RAND_MAX - 0.5f) * 3.0f));
+		objects.emplace_back(o);
+		return o;
+	};
+
+	//Both orders of box and sphere, as the kernels are only written for the box first
+	std::vector<CollisionDetection::PairQuery> pairs;
+	for (int i = 0; i < pairCount; ++i)
+	{
+		pairs.push_back({ AddObject(true), AddObject(true), nullptr, 0 });
+		pairs.push_back({ AddObject(false), AddObject(false), nullptr, 0 });
+		pairs.push_back({ AddObject(false), AddObject(true), nullptr, 0 });
+		pairs.push_back({ AddObject(true), AddObject(false), nullptr, 0 });
+	}
+	//Some pairs sat exactly on top of each other, where the normal has to be made up
+	for (int i = 0; i < (int)pairs.size(); i += 61)
+	{
+		pairs[i].b->GetTransform().SetPosition(pairs[i].a->GetTransform().GetPosition());
+	}
+	for (CollisionDetection::PairQuery& p : pairs)
+	{
+		p.pairType = CollisionDetection::PairType(*p.a->GetBoundingVolume(), *p.b->GetBoundingVolume());
+	}
+	std::stable_sort(pairs.begin(), pairs.end(), [](const CollisionDetection::PairQuery& a, const CollisionDetection::PairQuery& b) {
+		return a.pairType < b.pairType;
+	});
+
+	auto Differs = [&](const Vector3& a, const Vector3& b) {
+		return	std::abs(a.x - b.x) > tolerance ||
+				std::abs(a.y - b.y) > tolerance ||
+				std::abs(a.z - b.z) > tolerance;
+	};
+
+	const char*				pathNames[]	= { "Scalar", "SSE", "AVX" };
+	CollisionKernels::Path	best		= CollisionKernels::DetectPath();
+
+	std::vector<CollisionDetection::CollisionInfo> expected(pairs.size());
+	std::vector<CollisionDetection::CollisionInfo> results(pairs.size());
+	int expectedHits = 0;
+
+	bool	passed = true;
+	GameTimer t;
+	for (int path = 0; path <= (int)best; ++path)
+	{
+		CollisionKernels::SetPath((CollisionKernels::Path)path);
+		std::vector<CollisionDetection::CollisionInfo>& out = path == 0 ? expected : results;
+
+		int hits = 0;
+		t.Tick();
+		for (int p = 0; p < passes; ++p)
+		{
+			hits = CollisionDetection::BatchIntersection(pairs.data(), (int)pairs.size(), out.data());
+		}
+		t.Tick();
+		float seconds = t.GetTimeDeltaSeconds();
+
+		int mismatches = 0;
+		if (path == 0)
+		{
+			expectedHits = hits;
+		}
+		else if (hits != expectedHits)
+		{
+			std::cout << "  " << pathNames[path] << " found " << hits << " pairs touching, rather than " << expectedHits << std::endl;
+			mismatches++;
+		}
+		else
+		{
+			for (int i = 0; i < hits; ++i)
+			{
+				const CollisionDetection::CollisionInfo& want	= expected[i];
+				const CollisionDetection::CollisionInfo& got	= results[i];
+
+				bool different = want.a != got.a || want.b != got.b || want.pointCount != got.pointCount;
+				for (int j = 0; !different && j < want.pointCount; ++j)
+				{
+					const CollisionDetection::ContactPoint& w = want.points[j];
+					const CollisionDetection::ContactPoint& g = got.points[j];
+					different =	Differs(w.normal, g.normal) || Differs(w.localA, g.localA) || Differs(w.localB, g.localB) ||
+								std::abs(w.penetration - g.penetration) > tolerance;
+				}
+				if (different && mismatches++ == 0)
+				{
+					const CollisionDetection::ContactPoint& w = want.points[0];
+					const CollisionDetection::ContactPoint& g = got.points[0];
+					std::cout << "  " << pathNames[path] << " gave a different contact to the scalar path, with penetration "
+						<< g.penetration << " rather than " << w.penetration << ", and normal\n"
+						<< "    " << g.normal << "  rather than\n"
+						<< "    " << w.normal;
+				}
+			}
+		}
+		std::cout << "  kernels: " << pathNames[path] << " " << (pairs.size() * (double)passes) / seconds / 1000000.0
+			<< " million pairs per second, " << hits << " hits, " << mismatches << " different" << std::endl;
+		passed &= mismatches == 0;
+	}
+	CollisionKernels::SetPath(best);
+
+	for (GameObject* o : objects)
+	{
+		delete o;
+	}
+	return passed;
+}
+
+int main(int argc, char** argv)
+{
+	std::string	map			= "Mode 1.txt";
+	std::string	dataDir		= Assets::DATADIR;
+	int			frames		= 600;
+	int			copies		= 10;
+	int			workers		= 0;
+	int			hz			= 60;
+	bool		sweep		= false;
+	bool		gravity		= false;
+	bool		mesh		= false;
+	int			rayCount	= 0;
+	int			pendulums	= 0;
+	int			tables		= 0;
+	bool		deterministic	= false;
+	int			rollback		= 0;
+	int			kernelPairs		= 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg		= argv[i];
+		bool		hasValue	= i + 1 < argc;
+
+		if (arg == "--map" && hasValue)				map		= argv[++i];
+		else if (arg == "--data" && hasValue)		dataDir	= argv[++i];
+		else if (arg == "--frames" && hasValue)		frames	= atoi(argv[++i]);
+		else if (arg == "--copies" && hasValue)		copies	= atoi(argv[++i]);
+		else if (arg == "--workers" && hasValue)	workers	= atoi(argv[++i]);
+		else if (arg == "--hz" && hasValue)			hz		= atoi(argv[++i]);
+		else if (arg == "--sweep")					sweep	= true;
+		else if (arg == "--gravity")				gravity	= true;
+		else if (arg == "--mesh")					mesh	= true;
+		else if (arg == "--rays" && hasValue)		rayCount = atoi(argv[++i]);
+		else if (arg == "--pendulums" && hasValue)	pendulums = atoi(argv[++i]);
+		else if (arg == "--tables" && hasValue)		tables	= atoi(argv[++i]);
+		else if (arg == "--deterministic")			deterministic = true;
+		else if (arg == "--rollback" && hasValue)	rollback = atoi(argv[++i]);
+		else if (arg == "--kernels" && hasValue)	kernelPairs = atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	if (!dataDir.empty() && dataDir.back() != '/' && dataDir.back() != '\\')
+	{
+		dataDir += '/';
+	}
+	frames	= std::max(frames, 1);
+	hz		= std::max(hz, 1);
+
+	if (kernelPairs > 0 && !CheckCollisionKernels(kernelPairs))
+	{
+		std::cout << "The SIMD collision kernels don't match the scalar path" << std::endl;
+		return 1;
+	}
+	if (tables > 0 && !CheckCompoundInertia())
+	{
+		std::cout << "Compound inertia is wrong" << std::endl;
+		return 1;
+	}
+
+	GameWorld		world;
+	PhysicsSystem	physics(world);
+	physics.SetWorkerThreads(workers);
+	physics.UseGravity(gravity);
+	physics.UseInterpolation(false);
+	physics.SetBroadPhaseType(sweep ? BroadPhaseType::SortAndSweep : BroadPhaseType::DynamicTree);
+	physics.UseDeterministicMode(deterministic || rollback > 0);
+
+	srand(0);
+	BuildBenchmarkMap(world, map, copies, dataDir, mesh);
+	AddPendulums(world, physics, pendulums);
+	AddTables(world, tables);
+
+	int objectCount = 0;
+	world.OperateOnContents([&](GameObject*) {
+		objectCount++;
+	});
+	if (objectCount == 0)
+	{
+		std::cout << "Couldn't load any objects from " << dataDir << map << std::endl;
+		return 1;
+	}
+	std::cout << "Loaded " << objectCount << " objects from " << copies << " copies of " << dataDir << map << std::endl;
+
+	const float frameTime = 1.0f / hz;
+
+	GameTimer	t;
+	float		totalTime	= 0.0f;
+	float		slowest		= 0.0f;
+	float		fastest		= 1e9f;
+
+	//A rolled back run should end up exactly where one that never rolled back does
+	StateBuffer	snapshot;
+	GameTimer	stateTimer;
+	float		saveTime	= 0.0f;
+	float		restoreTime	= 0.0f;
+	int			rollbacks	= 0;
+	for (int i = 0; i < frames; ++i)
+	{
+		t.Tick();
+		if (rollback > 0 && i % rollback == 0)
+		{
+			stateTimer.Tick();
+			physics.SaveState(snapshot);
+			stateTimer.Tick();
+			saveTime += stateTimer.GetTimeDeltaMSec();
+		}
+		world.UpdateWorld(frameTime);
+		physics.Update(frameTime);
+		if (rollback > 0 && i % rollback == rollback - 1)
+		{
+			stateTimer.Tick();
+			if (!physics.RestoreState(snapshot))
+			{
+				std::cout << "Couldn't restore the saved state" << std::endl;
+				return 1;
+			}
+			stateTimer.Tick();
+			restoreTime += stateTimer.GetTimeDeltaMSec();
+			rollbacks++;
+
+			for (int j = 0; j < rollback; ++j)
+			{
+				world.UpdateWorld(frameTime);
+				physics.Update(frameTime);
+			}
+		}
+		t.Tick();
+
+		float ms	= t.GetTimeDeltaMSec();
+		totalTime	+= ms;
+		slowest		= std::max(slowest, ms);
+		fastest		= std::min(fastest, ms);
+	}
+
+	const PhysicsStats& stats = physics.GetStats();
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << frames << " frames at " << hz << "hz in " << totalTime << "ms" << std::endl;
+	std::cout << "  per frame: " << totalTime / frames << "ms average, "
+		<< fastest << "ms fastest, " << slowest << "ms slowest" << std::endl;
+	std::cout << "  bodies: " << physics.GetAwakeBodyCount() << " awake, "
+		<< physics.GetSleepingBodyCount() << " sleeping, "
+		<< physics.GetIslandCount() << " islands" << std::endl;
+	std::cout << "  dropped: " << stats.totalDroppedTime << "s over " << stats.droppedUpdates << " updates" << std::endl;
+	if (rollbacks > 0)
+	{
+		std::cout << "  rollbacks: " << rollbacks << " of " << snapshot.GetSize() << " bytes, "
+			<< (saveTime * 1000.0f) / rollbacks << "us to save, "
+			<< (restoreTime * 1000.0f) / rollbacks << "us to restore" << std::endl;
+	}
+	if (rayCount > 0)
+	{
+		TimeRaycasts(world, rayCount);
+	}
+	std::cout << "  checksum: " << std::hex << WorldChecksum(world) << std::dec << std::endl;
+
+	world.ClearAndErase();
+	return 0;
+}
@@ -38,6 +38,12 @@ namespace NCL {
 		}
 	
 
+		void Perpendiculars(const Vector3& axis, Vector3& outA, Vector3& outB) {
+			outA = std::abs(axis.x) < 0.57f ? Vector3(0, axis.z, -axis.y) : Vector3(axis.y, -axis.x, 0);
+			outA.Normalise();
+			outB = Vector3::Cross(axis, outA);
+		}
+
 		Vector3 Clamp(const Vector3& a, const Vector3&mins, const Vector3& maxs) {
 			return Vector3(
 				Clamp(a.x, mins.x, maxs.x),
@@ -8,6 +8,7 @@ https://research.ncl.ac.uk/game/
 */
 #pragma once
 #include <algorithm>
+#include <cmath>
 
 namespace NCL {
 	namespace Maths {
@@ -54,5 +55,8 @@ namespace NCL {
 		float FloatAreaOfTri(const Vector3 &a, const Vector3 &b, const Vector3 & c);
 
 		float CrossAreaOfTri(const Vector3 &a, const Vector3 &b, const Vector3 & c);
+
+		//Any two directions at right angles to the (unit length) axis, and to each other
+		void Perpendiculars(const Vector3& axis, Vector3& outA, Vector3& outB);
 	}
 }
\ No newline at end of file
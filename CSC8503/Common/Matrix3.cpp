@@ -134,7 +134,7 @@ Matrix3 Matrix3::Scale( const Vector3 &scale )	{
 
 void	Matrix3::ToZero()	{
 	for(int i = 0; i < 9; ++i) {
-		array[0] = 0.0f;
+		array[i] = 0.0f;
 	}
 }
 
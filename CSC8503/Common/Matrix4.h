@@ -8,6 +8,7 @@ https://research.ncl.ac.uk/game/
 */
 #pragma once
 
+#include <cstring>
 #include <iostream>
 
 namespace NCL {